@@ -0,0 +1,203 @@
+#include "FaceAligner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+
+// ArcFace 112x112 标准关键点 (左眼、右眼、鼻尖、左嘴角、右嘴角)
+static const float REFERENCE_PTS_112[5][2] = {
+    {38.2946f, 51.6963f}, {73.5318f, 51.5014f}, {56.0252f, 71.7366f},
+    {41.5493f, 92.3655f}, {70.7299f, 92.2041f}
+};
+
+// 直接路径忽略旋转时，112 窗口角点 (离中心 56√2 ≈ 79 像素) 的最大允许偏移 (像素)
+// 关键点处 (靠近中心) 的偏移更小，低于 RetinaFace 关键点本身的抖动 (通常 2~3 像素)
+static const float DIRECT_MAX_CORNER_ERROR = 2.0f;
+// 对应的旋转角上限 (弧度)：2 / 79 ≈ 0.025，约 1.45°，正对摄像头的人脸大多落在这个范围
+static const float DIRECT_MAX_ANGLE = DIRECT_MAX_CORNER_ERROR / (FaceAligner::OUTPUT_SIZE * 0.70710678f);
+
+// RGA 处理 YUV 帧时要求裁剪区域的起点与宽高都是 2 的倍数
+static bool needsEvenRect(int format) {
+    return format != RK_FORMAT_BGR_888 && format != RK_FORMAT_RGB_888;
+}
+
+float SimilarityTransform::scale() const {
+    return std::sqrt(a * a + b * b);
+}
+
+float SimilarityTransform::angle() const {
+    return std::atan2(b, a);
+}
+
+SimilarityTransform SimilarityTransform::inverse() const {
+    SimilarityTransform inv;
+    float s2 = a * a + b * b;
+    if (s2 < 1e-12f) return inv;
+    inv.a = a / s2;
+    inv.b = -b / s2;
+    inv.tx = -(inv.a * tx - inv.b * ty);
+    inv.ty = -(inv.b * tx + inv.a * ty);
+    return inv;
+}
+
+cv::Matx23d SimilarityTransform::toAffine() const {
+    cv::Matx23d M;
+    M(0, 0) = a;  M(0, 1) = -b; M(0, 2) = tx;
+    M(1, 0) = b;  M(1, 1) = a;  M(1, 2) = ty;
+    return M;
+}
+
+/**
+ * Umeyama 最小二乘相似变换 (二维闭式解)
+ * 两组点去中心化后：
+ *   a = Σ(xs*xd + ys*yd) / Σ|s|²,  b = Σ(xs*yd - ys*xd) / Σ|s|²
+ * 即 Umeyama 中 SVD 旋转与 trace(DS)/σ² 缩放在二维 (无反射) 时的展开形式
+ */
+SimilarityTransform FaceAligner::estimate(const cv::Point2f landmarks[5]) {
+    float msx = 0, msy = 0, mdx = 0, mdy = 0;
+    for (int i = 0; i < 5; i++) {
+        msx += landmarks[i].x;
+        msy += landmarks[i].y;
+        mdx += REFERENCE_PTS_112[i][0];
+        mdy += REFERENCE_PTS_112[i][1];
+    }
+    msx /= 5; msy /= 5; mdx /= 5; mdy /= 5;
+
+    float num_a = 0, num_b = 0, den = 0;
+    for (int i = 0; i < 5; i++) {
+        float xs = landmarks[i].x - msx, ys = landmarks[i].y - msy;
+        float xd = REFERENCE_PTS_112[i][0] - mdx, yd = REFERENCE_PTS_112[i][1] - mdy;
+        num_a += xs * xd + ys * yd;
+        num_b += xs * yd - ys * xd;
+        den += xs * xs + ys * ys;
+    }
+
+    SimilarityTransform t;
+    if (den < 1e-6f) return t;     // 关键点重合 (无效检测)
+    t.a = num_a / den;
+    t.b = num_b / den;
+    t.tx = mdx - (t.a * msx - t.b * msy);
+    t.ty = mdy - (t.b * msx + t.a * msy);
+    return t;
+}
+
+cv::Mat FaceAligner::warp(const cv::Mat& bgr, const cv::Point2f landmarks[5]) {
+    cv::Mat aligned;
+    warp(bgr, landmarks, aligned);
+    return aligned;
+}
+
+void FaceAligner::warp(const cv::Mat& bgr, const cv::Point2f landmarks[5], cv::Mat& out) {
+    if (bgr.empty()) {
+        out.release();
+        return;
+    }
+    cv::warpAffine(bgr, out, estimate(landmarks).toAffine(), cv::Size(OUTPUT_SIZE, OUTPUT_SIZE));
+}
+
+int FaceAligner::alignTo(const CameraFrame& frame, const cv::Point2f landmarks[5], const Target& dst) {
+    if (frame.empty() || frame.compressed || (dst.fd < 0 && !dst.virt)) return -1;
+
+    SimilarityTransform t = estimate(landmarks);
+    if (alignRga(frame, t, dst) >= 0) return 0;
+    if (!dst.virt) return -1;
+
+    // RGA 路径失败时 (裁剪区域不合法、驱动报错等) 退回整帧 CPU warpAffine
+    if (cropRga(frame, t, dst) >= 0) return 1;
+    cv::Mat bgr = frame.toBgrMat();
+    if (bgr.empty()) return -1;
+    size_t dst_step = (size_t)dst.wstride * 3;
+    cv::Mat out(OUTPUT_SIZE, OUTPUT_SIZE, CV_8UC3, (unsigned char*)dst.virt + dst.y_offset * dst_step, dst_step);
+    cv::warpAffine(bgr, out, t.toAffine(), out.size(), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar());
+    return 1;
+}
+
+int FaceAligner::alignRga(const CameraFrame& frame, const SimilarityTransform& t, const Target& dst) {
+    // 近似正立时目标窗口在原图中就是以 inv(窗口中心) 为中心、边长 112 / s 的正方形
+    if (std::fabs(t.angle()) >= DIRECT_MAX_ANGLE) return -1;
+    float s = t.scale();
+    if (s < 1e-6f) return -1;
+    const float n = (float)OUTPUT_SIZE;
+    cv::Point2f center = t.inverse().apply(cv::Point2f(n / 2, n / 2));
+    float side = n / s;
+
+    im_rect srect = { (int)std::lround(center.x - side / 2), (int)std::lround(center.y - side / 2),
+                      (int)std::lround(side), (int)std::lround(side) };
+    if (needsEvenRect(frame.format)) {
+        srect.x &= ~1; srect.y &= ~1;
+        srect.width = (srect.width + 1) & ~1;
+        srect.height = (srect.height + 1) & ~1;
+    }
+    // 只处理完全在画面内的情况，越界部分需要补黑边，交给 CPU
+    if (srect.x < 0 || srect.y < 0 || srect.width < 2 || srect.height < 2 ||
+        srect.x + srect.width > frame.width || srect.y + srect.height > frame.height) return -1;
+
+    rga_buffer_t src = frame.toRgaBuffer();
+    rga_buffer_t out = dst.fd >= 0
+        ? wrapbuffer_fd_t(dst.fd, OUTPUT_SIZE, dst.height, dst.wstride, dst.height, RK_FORMAT_BGR_888)
+        : wrapbuffer_virtualaddr_t(dst.virt, OUTPUT_SIZE, dst.height, dst.wstride, dst.height, RK_FORMAT_BGR_888);
+    rga_buffer_t pat;
+    memset(&pat, 0, sizeof(pat));
+    im_rect drect = { 0, dst.y_offset, OUTPUT_SIZE, OUTPUT_SIZE };
+    im_rect prect = {0, 0, 0, 0};
+    if (improcess(src, out, pat, srect, drect, prect, -1, NULL, NULL, IM_SYNC) != IM_STATUS_SUCCESS) return -1;
+    return 0;
+}
+
+int FaceAligner::cropRga(const CameraFrame& frame, const SimilarityTransform& t, const Target& dst) {
+    // 1. 目标窗口在原图中的外接矩形
+    SimilarityTransform inv = t.inverse();
+    const float n = (float)OUTPUT_SIZE;
+    const cv::Point2f corners[4] = {
+        inv.apply(cv::Point2f(0, 0)), inv.apply(cv::Point2f(n, 0)),
+        inv.apply(cv::Point2f(0, n)), inv.apply(cv::Point2f(n, n))
+    };
+    float x0 = corners[0].x, x1 = corners[0].x, y0 = corners[0].y, y1 = corners[0].y;
+    for (int i = 1; i < 4; i++) {
+        x0 = std::min(x0, corners[i].x); x1 = std::max(x1, corners[i].x);
+        y0 = std::min(y0, corners[i].y); y1 = std::max(y1, corners[i].y);
+    }
+
+    // 2. RGA 把外接矩形 (裁到画面内) 缩放到 112 尺度的小图，CPU 只做剩余旋转
+    int bx0 = std::max(0, (int)std::floor(x0));
+    int by0 = std::max(0, (int)std::floor(y0));
+    int bx1 = std::min(frame.width, (int)std::ceil(x1));
+    int by1 = std::min(frame.height, (int)std::ceil(y1));
+    if (needsEvenRect(frame.format)) {
+        // 起点向下、终点向上取偶，外接矩形只会变大；画面宽高为奇数时终点向下取偶
+        bx0 &= ~1; by0 &= ~1;
+        bx1 = std::min(frame.width & ~1, (bx1 + 1) & ~1);
+        by1 = std::min(frame.height & ~1, (by1 + 1) & ~1);
+    }
+    int bw = bx1 - bx0, bh = by1 - by0;
+    if (bw < 2 || bh < 2) return -1;
+
+    float s = t.scale();
+    int pw = std::max(2, (int)std::lround(bw * s));
+    int ph = std::max(2, (int)std::lround(bh * s));
+    int pstride = (pw + 15) & ~15;
+    m_patch.resize((size_t)pstride * ph * 3);
+
+    rga_buffer_t src = frame.toRgaBuffer();
+    rga_buffer_t patch_buf = wrapbuffer_virtualaddr_t(m_patch.data(), pw, ph, pstride, ph, RK_FORMAT_BGR_888);
+    im_rect srect = { bx0, by0, bw, bh };
+    if (imcrop(src, patch_buf, srect) != IM_STATUS_SUCCESS) {
+        std::cerr << "[FaceAligner] RGA crop failed, fallback to CPU" << std::endl;
+        return -1;
+    }
+
+    // 小图坐标 q 对应原图 p = q / k + (bx0, by0)，代入 t 得到小图 -> 112x112 的变换
+    float kx = (float)pw / bw, ky = (float)ph / bh;
+    cv::Matx23d M;
+    M(0, 0) = t.a / kx;  M(0, 1) = -t.b / ky;
+    M(0, 2) = t.a * bx0 - t.b * by0 + t.tx;
+    M(1, 0) = t.b / kx;  M(1, 1) = t.a / ky;
+    M(1, 2) = t.b * bx0 + t.a * by0 + t.ty;
+
+    cv::Mat patch(ph, pw, CV_8UC3, m_patch.data(), (size_t)pstride * 3);
+    size_t dst_step = (size_t)dst.wstride * 3;
+    cv::Mat out(OUTPUT_SIZE, OUTPUT_SIZE, CV_8UC3, (unsigned char*)dst.virt + dst.y_offset * dst_step, dst_step);
+    cv::warpAffine(patch, out, M, out.size(), cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar());
+    return 0;
+}
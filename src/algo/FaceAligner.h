@@ -0,0 +1,74 @@
+#ifndef FACEALIGNER_H
+#define FACEALIGNER_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include "device/CameraFrame.h"
+
+/**
+ * @brief 二维相似变换 (旋转 + 等比缩放 + 平移)
+ *
+ *   x' = a * x - b * y + tx
+ *   y' = b * x + a * y + ty
+ * 其中 a = s * cos(θ)，b = s * sin(θ)
+ */
+struct SimilarityTransform {
+    float a = 1.0f, b = 0.0f, tx = 0.0f, ty = 0.0f;
+
+    float scale() const;
+    float angle() const;            // 弧度
+    SimilarityTransform inverse() const;
+    cv::Point2f apply(const cv::Point2f& p) const {
+        return cv::Point2f(a * p.x - b * p.y + tx, b * p.x + a * p.y + ty);
+    }
+    // 2x3 仿射矩阵，供 cv::warpAffine 使用 (栈上的 Matx，不申请堆内存)
+    cv::Matx23d toAffine() const;
+};
+
+/**
+ * @brief 112x112 人脸对齐
+ *
+ * 变换由 5 个关键点对 REFERENCE_PTS_112 的 Umeyama 最小二乘闭式解得到 (无 RANSAC)。
+ * alignTo() 把对齐结果直接写入目标缓冲区 (通常是 MobileFaceNet 的输入张量)：
+ *   - 人脸近似正立 (约 1.5° 以内) 且完全在画面内：RGA 一次完成裁剪 + 缩放 + 颜色转换，CPU 不碰像素
+ *   - 其他情况：RGA 先把人脸外接矩形裁剪、缩放到约 112 尺度并转成 BGR，
+ *     CPU 只在这块很小的图上做剩余的旋转 (输入约 160x160，与原图大小无关)
+ *   - RGA 失败时退回整帧转 BGR + warpAffine
+ * RGA 不支持任意角度仿射，这是它能承担的最大部分；YUV 帧的裁剪区域会对齐到偶数。
+ * 非线程安全：中间缓冲区每个实例一份，每个 NPU 上下文各持有一个实例。
+ */
+class FaceAligner {
+public:
+    static const int OUTPUT_SIZE = 112;
+
+    // 对齐目标：OUTPUT_SIZE x OUTPUT_SIZE 的 BGR888 区域
+    struct Target {
+        int fd = -1;                // DMA-BUF fd (-1 表示只有虚拟地址)
+        void* virt = nullptr;       // CPU 地址 (缓冲区起始)
+        int wstride = OUTPUT_SIZE;  // 行跨度 (像素)
+        int height = OUTPUT_SIZE;   // 缓冲区总行数 (多 batch 张量为 batch * 112)
+        int y_offset = 0;           // 目标区域的起始行
+    };
+
+    // 关键点到 REFERENCE_PTS_112 的相似变换 (Umeyama 闭式解)
+    static SimilarityTransform estimate(const cv::Point2f landmarks[5]);
+
+    // CPU 路径：warpAffine 输出 112x112 BGR
+    static cv::Mat warp(const cv::Mat& bgr, const cv::Point2f landmarks[5]);
+    // 写入调用方的 out：out 已是 112x112 BGR 时复用其缓冲区 (每帧对齐不再申请内存)
+    static void warp(const cv::Mat& bgr, const cv::Point2f landmarks[5], cv::Mat& out);
+
+    // RGA 路径：对齐结果写入 dst
+    // 返回 -1 失败，0 表示只有 RGA 写入 (无需刷 CPU 缓存)，1 表示 CPU 写入过 dst
+    int alignTo(const CameraFrame& frame, const cv::Point2f landmarks[5], const Target& dst);
+
+private:
+    // RGA 直接裁剪缩放进 dst (忽略小角度旋转)，不适用或失败返回 -1
+    int alignRga(const CameraFrame& frame, const SimilarityTransform& t, const Target& dst);
+    // RGA 裁剪外接矩形 + CPU 旋转小图，失败返回 -1
+    int cropRga(const CameraFrame& frame, const SimilarityTransform& t, const Target& dst);
+
+    std::vector<unsigned char> m_patch;     // RGA 输出的中间小图 (BGR)
+};
+
+#endif // FACEALIGNER_H
@@ -0,0 +1,13 @@
+#ifndef FACEINFO_H
+#define FACEINFO_H
+
+#include <opencv2/core.hpp>
+
+// 定义检测结果结构体
+struct FaceInfo {
+    cv::Rect box;           // 人脸框
+    float score;            // 置信度
+    cv::Point2f landmarks[5]; // 5个关键点 (左眼, 右眼, 鼻, 左嘴, 右嘴)
+};
+
+#endif // FACEINFO_H
@@ -0,0 +1,54 @@
+#include "FaceNms.h"
+#include <algorithm>
+
+void FaceNms::reserve(int capacity)
+{
+    if (capacity < 1) capacity = 1;
+    m_boxes.resize(capacity);
+    m_order.resize(capacity);
+    m_areas.resize(capacity);
+    m_suppressed.resize(capacity);
+}
+
+int FaceNms::run(int count, float iou_thresh, std::vector<FaceInfo>& out)
+{
+    if (count > capacity()) count = capacity();
+    if (count <= 0) return 0;
+
+    for (int i = 0; i < count; i++) {
+        m_order[i] = i;
+        m_areas[i] = (float)m_boxes[i].box.area();
+        m_suppressed[i] = 0;
+    }
+    // 同分时按下标排序，与 OpenCV 的稳定排序一致 (std::stable_sort 会申请临时内存)
+    std::sort(m_order.begin(), m_order.begin() + count, [this](int a, int b) {
+        if (m_boxes[a].score != m_boxes[b].score) return m_boxes[a].score > m_boxes[b].score;
+        return a < b;
+    });
+
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        int a = m_order[i];
+        if (m_suppressed[a]) continue;
+        out.push_back(m_boxes[a]);
+        kept++;
+
+        const cv::Rect& ra = m_boxes[a].box;
+        for (int j = i + 1; j < count; j++) {
+            int b = m_order[j];
+            if (m_suppressed[b]) continue;
+            const cv::Rect& rb = m_boxes[b].box;
+
+            int x1 = std::max(ra.x, rb.x);
+            int y1 = std::max(ra.y, rb.y);
+            int x2 = std::min(ra.x + ra.width, rb.x + rb.width);
+            int y2 = std::min(ra.y + ra.height, rb.y + rb.height);
+            if (x2 <= x1 || y2 <= y1) continue;
+
+            float inter = (float)(x2 - x1) * (float)(y2 - y1);
+            float uni = m_areas[a] + m_areas[b] - inter;
+            if (uni > 0.0f && inter / uni > iou_thresh) m_suppressed[b] = 1;
+        }
+    }
+    return kept;
+}
@@ -0,0 +1,37 @@
+#ifndef FACENMS_H
+#define FACENMS_H
+
+#include <vector>
+#include "algo/FaceInfo.h"
+
+/**
+ * @brief 人脸框贪心 NMS (无堆分配)
+ *
+ * 候选框写入 buffer() 指向的固定容量缓冲区，run() 原地按分数排序并抑制重叠框。
+ * 所有中间数组在 reserve() 时一次性分配，之后每帧不再申请内存；
+ * 与 cv::dnn::NMSBoxes(score_thresh 已预先过滤, eta = 1) 结果一致。
+ * 非线程安全：每个检测上下文各持有一个实例。
+ */
+class FaceNms {
+public:
+    FaceNms() {}
+
+    // 分配容量 (候选框数量上限)
+    void reserve(int capacity);
+    int capacity() const { return (int)m_boxes.size(); }
+
+    // 候选框缓冲区，容量为 capacity()
+    FaceInfo* buffer() { return m_boxes.data(); }
+
+    // 对 buffer() 中前 count 个候选做 NMS，IoU 大于 iou_thresh 的低分框被抑制；
+    // 保留的框按分数从高到低追加到 out，返回保留个数
+    int run(int count, float iou_thresh, std::vector<FaceInfo>& out);
+
+private:
+    std::vector<FaceInfo> m_boxes;
+    std::vector<int> m_order;           // 按分数降序的下标
+    std::vector<float> m_areas;
+    std::vector<unsigned char> m_suppressed;
+};
+
+#endif // FACENMS_H
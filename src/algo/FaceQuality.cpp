@@ -0,0 +1,140 @@
+#include "FaceQuality.h"
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+// 正脸时鼻尖在眼与嘴之间的纵向比例 (ArcFace 112x112 参考点：眼 51.6，鼻 71.7，嘴 92.3)
+static const float FRONTAL_NOSE_RATIO = 0.495f;
+// 鼻尖相对眼睛 / 嘴所在平面的深度：水平方向按眼距、纵向按眼嘴距离的比例 (经验值)
+static const float NOSE_DEPTH = 0.5f;
+
+static const float RAD_TO_DEG = 57.2957795f;
+
+FaceQuality::Thresholds FaceQuality::recognitionThresholds() {
+    return Thresholds();
+}
+
+FaceQuality::Thresholds FaceQuality::enrollmentThresholds() {
+    Thresholds th;
+    th.min_size = 80;
+    th.max_yaw = 20.0f;
+    th.max_pitch = 20.0f;
+    th.max_roll = 20.0f;
+    th.min_sharpness = 50.0f;
+    th.min_brightness = 60.0f;
+    th.max_brightness = 200.0f;
+    return th;
+}
+
+void FaceQuality::estimatePose(const FaceInfo& face, float& yaw, float& pitch, float& roll) {
+    const cv::Point2f* lm = face.landmarks;
+    float dx = lm[1].x - lm[0].x, dy = lm[1].y - lm[0].y;
+    float eye_dist = std::sqrt(dx * dx + dy * dy);
+    roll = std::atan2(dy, dx) * RAD_TO_DEG;
+    if (eye_dist < 1e-3f) {
+        // 关键点重合 (无效检测)，当作极端姿态
+        yaw = pitch = 90.0f;
+        return;
+    }
+
+    // 转到两眼水平、原点在两眼中点的坐标系
+    float c = dx / eye_dist, s = dy / eye_dist;
+    cv::Point2f eye_mid = (lm[0] + lm[1]) * 0.5f;
+    auto derotate = [&](const cv::Point2f& p) {
+        float x = p.x - eye_mid.x, y = p.y - eye_mid.y;
+        return cv::Point2f(c * x + s * y, -s * x + c * y);
+    };
+    cv::Point2f nose = derotate(lm[2]);
+    cv::Point2f mouth = derotate((lm[3] + lm[4]) * 0.5f);
+
+    yaw = std::atan(nose.x / (NOSE_DEPTH * eye_dist)) * RAD_TO_DEG;
+    if (mouth.y < 1e-3f) {
+        pitch = 90.0f;
+        return;
+    }
+    pitch = std::atan((nose.y / mouth.y - FRONTAL_NOSE_RATIO) / NOSE_DEPTH) * RAD_TO_DEG;
+}
+
+float FaceQuality::geometricScore(const FaceInfo& face) {
+    float yaw, pitch, roll;
+    estimatePose(face, yaw, pitch, roll);
+    float size = std::min(1.0f, std::min(face.box.width, face.box.height) / 112.0f);
+    float pose = std::max(0.0f, std::cos(yaw / RAD_TO_DEG) * std::cos(pitch / RAD_TO_DEG));
+    return face.score * size * pose;
+}
+
+FaceQuality::Verdict FaceQuality::evaluate(const CameraFrame& frame, const FaceInfo& face,
+                                           const Thresholds& th, Result& out) {
+    out = Result();
+    estimatePose(face, out.yaw, out.pitch, out.roll);
+    out.score = geometricScore(face);
+
+    Verdict verdict = QUALITY_OK;
+    if (std::min(face.box.width, face.box.height) < th.min_size) {
+        verdict = QUALITY_TOO_SMALL;
+    } else if (std::fabs(out.yaw) > th.max_yaw || std::fabs(out.pitch) > th.max_pitch
+               || std::fabs(out.roll) > th.max_roll) {
+        verdict = QUALITY_POSE;
+    } else if (!frame.empty() && !frame.compressed
+               && measurePixels(frame, face.box, out.sharpness, out.brightness) == 0) {
+        if (out.sharpness < th.min_sharpness) verdict = QUALITY_BLUR;
+        else if (out.brightness < th.min_brightness) verdict = QUALITY_DARK;
+        else if (out.brightness > th.max_brightness) verdict = QUALITY_BRIGHT;
+        // 清晰度达到阈值两倍后不再加分
+        out.score *= std::min(1.0f, out.sharpness / (2.0f * std::max(1.0f, th.min_sharpness)));
+    }
+    out.verdict = verdict;
+    return verdict;
+}
+
+const char* FaceQuality::verdictMessage(Verdict verdict) {
+    switch (verdict) {
+    case QUALITY_TOO_SMALL: return "请靠近摄像头";
+    case QUALITY_POSE:      return "请正对摄像头";
+    case QUALITY_BLUR:      return "画面模糊，请保持不动";
+    case QUALITY_DARK:      return "光线太暗";
+    case QUALITY_BRIGHT:    return "光线太亮";
+    default:                return "";
+    }
+}
+
+int FaceQuality::measurePixels(const CameraFrame& frame, const cv::Rect& box, float& sharpness, float& brightness) {
+    cv::Rect area = box & cv::Rect(0, 0, frame.width, frame.height);
+    if (area.width < 2 || area.height < 2) return -1;
+
+    // 1. RGA 裁剪 + 缩放 + 转灰度 (Y 通道)，失败时 (例如 BGR Mat 不满足 RGA 对齐要求) 用 CPU
+    m_patch.resize(PATCH_SIZE * PATCH_SIZE);
+    cv::Mat patch(PATCH_SIZE, PATCH_SIZE, CV_8UC1, m_patch.data());
+    rga_buffer_t src = frame.toRgaBuffer();
+    rga_buffer_t dst = wrapbuffer_virtualaddr_t(m_patch.data(), PATCH_SIZE, PATCH_SIZE,
+                                                PATCH_SIZE, PATCH_SIZE, RK_FORMAT_YCbCr_400);
+    im_rect rect = { area.x, area.y, area.width, area.height };
+    if (imcrop(src, dst, rect) != IM_STATUS_SUCCESS) {
+        cv::Mat bgr = frame.toBgrMat();
+        if (bgr.empty()) return -1;
+        cv::Mat gray;
+        cv::cvtColor(bgr(area), gray, cv::COLOR_BGR2GRAY);
+        cv::resize(gray, patch, patch.size(), 0, 0, cv::INTER_AREA);
+    }
+
+    // 2. 亮度均值与拉普拉斯方差 (整数累加，只有 4096 个像素)
+    const unsigned char* p = m_patch.data();
+    const int n = PATCH_SIZE;
+    int64_t sum = 0;
+    for (int i = 0; i < n * n; i++) sum += p[i];
+
+    int64_t lap_sum = 0, lap_sq = 0;
+    for (int y = 1; y < n - 1; y++) {
+        const unsigned char* row = p + y * n;
+        for (int x = 1; x < n - 1; x++) {
+            int l = 4 * row[x] - row[x - 1] - row[x + 1] - row[x - n] - row[x + n];
+            lap_sum += l;
+            lap_sq += l * l;
+        }
+    }
+    double count = (double)(n - 2) * (n - 2);
+    double mean = lap_sum / count;
+    sharpness = (float)(lap_sq / count - mean * mean);
+    brightness = (float)sum / (n * n);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef FACEQUALITY_H
+#define FACEQUALITY_H
+
+#include <vector>
+#include "algo/FaceInfo.h"
+#include "device/CameraFrame.h"
+
+/**
+ * @brief 人脸质量评估：特征提取 / 录入之前过滤过小、侧脸、模糊、过暗过亮的人脸
+ *
+ * 几何部分只用 FaceInfo (框与 5 个关键点)，不读像素：
+ *   - 尺寸：人脸框短边 (原图像素)
+ *   - 姿态：由关键点估算 yaw / pitch / roll (度)，见 estimatePose()
+ * 像素部分：RGA 把人脸框裁剪缩放成 PATCH_SIZE x PATCH_SIZE 的灰度图 (Y 通道)，
+ * CPU 只在这 4096 个像素上计算：
+ *   - 清晰度：4 邻域拉普拉斯响应的方差 (模糊的人脸高频少，方差小)
+ *   - 亮度：灰度均值
+ * 几何检查不通过时跳过像素检查 (省一次 RGA)。
+ * 非线程安全：中间缓冲区每个实例一份 (与 FaceAligner 相同)。
+ */
+class FaceQuality {
+public:
+    static const int PATCH_SIZE = 64;
+
+    enum Verdict {
+        QUALITY_OK = 0,
+        QUALITY_TOO_SMALL,
+        QUALITY_POSE,       // 侧脸 / 抬头低头 / 歪头超过阈值
+        QUALITY_BLUR,
+        QUALITY_DARK,
+        QUALITY_BRIGHT
+    };
+
+    struct Thresholds {
+        int min_size = 40;              // 人脸框短边 (像素)
+        float max_yaw = 35.0f;          // 度
+        float max_pitch = 30.0f;
+        float max_roll = 35.0f;
+        float min_sharpness = 30.0f;    // 灰度小图的拉普拉斯方差
+        float min_brightness = 40.0f;   // 灰度均值 (0~255)
+        float max_brightness = 220.0f;
+    };
+
+    struct Result {
+        Verdict verdict = QUALITY_OK;
+        float yaw = 0, pitch = 0, roll = 0;
+        float sharpness = -1;           // -1 表示未测量 (几何检查未通过或码流帧)
+        float brightness = -1;
+        float score = 0;                // 综合质量分 (0~1)，用于在多帧中挑选最好的一帧
+    };
+
+    // 识别用的阈值 (宽松：不合格只是推迟到下一帧)；录入用的阈值 (严格：特征会长期留在库里)
+    static Thresholds recognitionThresholds();
+    static Thresholds enrollmentThresholds();
+
+    // 由 5 个关键点估算头部姿态 (度)：
+    //   roll  = 两眼连线的倾角
+    //   yaw   = 去掉 roll 后鼻尖相对两眼中点的水平偏移；鼻尖约在眼睛平面前 0.5 个眼距，
+    //           偏移 / 眼距 = 0.5 * tan(yaw)
+    //   pitch = 鼻尖在眼与嘴之间的纵向位置相对正脸比例 (ArcFace 参考点约 0.49) 的偏离，正值为低头
+    static void estimatePose(const FaceInfo& face, float& yaw, float& pitch, float& roll);
+
+    // 只用几何信息的质量分：置信度 x 尺寸项 (小于 112 时线性降低) x 姿态项 (cos yaw * cos pitch)
+    static float geometricScore(const FaceInfo& face);
+
+    // 完整评估；frame 为码流或空帧时只做几何检查
+    Verdict evaluate(const CameraFrame& frame, const FaceInfo& face, const Thresholds& th, Result& out);
+
+    // 不合格原因的提示语 (显示给用户)
+    static const char* verdictMessage(Verdict verdict);
+
+private:
+    std::vector<unsigned char> m_patch;     // 灰度小图
+
+    // 人脸框缩放为灰度小图后测量清晰度与亮度，成功返回0
+    int measurePixels(const CameraFrame& frame, const cv::Rect& box, float& sharpness, float& brightness);
+};
+
+#endif // FACEQUALITY_H
@@ -0,0 +1,159 @@
+#include "FaceTracker.h"
+#include <algorithm>
+#include <cmath>
+
+// Kalman 噪声：过程噪声为加速度方差 (像素/秒²)²，测量噪声约为检测框抖动的方差 (像素²)
+static const float PROCESS_NOISE = 400.0f;
+static const float MEASURE_NOISE = 16.0f;
+
+void FaceTracker::Kalman1D::init(float z) {
+    x = z;
+    v = 0;
+    p00 = MEASURE_NOISE; p01 = 0; p11 = PROCESS_NOISE;
+}
+
+void FaceTracker::Kalman1D::predict(float dt, float q) {
+    // x = x + v * dt;  P = F P F^T + Q (离散白噪声加速度模型)
+    x += v * dt;
+    float dt2 = dt * dt;
+    p00 += dt * (2 * p01 + dt * p11) + q * dt2 * dt2 / 4;
+    p01 += dt * p11 + q * dt2 * dt / 2;
+    p11 += q * dt2;
+}
+
+void FaceTracker::Kalman1D::correct(float z, float r) {
+    float s = p00 + r;
+    float k0 = p00 / s, k1 = p01 / s;
+    float y = z - x;
+    x += k0 * y;
+    v += k1 * y;
+    p11 -= k1 * p01;
+    p01 -= k0 * p01;
+    p00 -= k0 * p00;
+}
+
+FaceTracker::FaceTracker() : m_nextId(1), m_ttlMs(3000) {
+}
+
+void FaceTracker::clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tracks.clear();
+}
+
+float FaceTracker::iou(const cv::Rect& a, const cv::Rect& b) {
+    int inter = (a & b).area();
+    int uni = a.area() + b.area() - inter;
+    return uni > 0 ? (float)inter / uni : 0.0f;
+}
+
+void FaceTracker::update(const std::vector<FaceInfo>& detections, int64_t now_ms, std::vector<Track>& out) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // 1. 预测所有轨迹在本帧的位置
+    for (State& t : m_tracks) {
+        float dt = std::max(0.0f, (now_ms - t.last_ms) / 1000.0f);
+        t.cx.predict(dt, PROCESS_NOISE);
+        t.cy.predict(dt, PROCESS_NOISE);
+        t.w.predict(dt, PROCESS_NOISE);
+        t.h.predict(dt, PROCESS_NOISE);
+        t.predicted = cv::Rect((int)(t.cx.x - t.w.x / 2), (int)(t.cy.x - t.h.x / 2),
+                               (int)std::max(1.0f, t.w.x), (int)std::max(1.0f, t.h.x));
+    }
+
+    // 2. 按 IoU 从大到小贪心关联 (人脸数很少，不需要匈牙利算法)
+    std::vector<Pair>& pairs = m_pairs;
+    pairs.clear();
+    for (int ti = 0; ti < (int)m_tracks.size(); ti++) {
+        for (int di = 0; di < (int)detections.size(); di++) {
+            float v = iou(m_tracks[ti].predicted, detections[di].box);
+            if (v >= IOU_THRESHOLD) pairs.push_back({ v, ti, di });
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& a, const Pair& b) { return a.iou > b.iou; });
+
+    std::vector<int>& det_to_track = m_detToTrack;
+    std::vector<unsigned char>& track_used = m_trackUsed;
+    det_to_track.assign(detections.size(), -1);
+    track_used.assign(m_tracks.size(), 0);
+    for (const Pair& p : pairs) {
+        if (track_used[p.track] || det_to_track[p.det] >= 0) continue;
+        track_used[p.track] = 1;
+        det_to_track[p.det] = p.track;
+    }
+
+    // 3. 未关联的轨迹计一次丢失，超过上限删除
+    for (int ti = 0; ti < (int)m_tracks.size(); ti++) {
+        if (!track_used[ti]) m_tracks[ti].misses++;
+    }
+
+    // 4. 更新关联到的轨迹，未关联的检测新建轨迹
+    out.resize(detections.size());
+    for (int di = 0; di < (int)detections.size(); di++) {
+        const FaceInfo& det = detections[di];
+        float cx = det.box.x + det.box.width / 2.0f;
+        float cy = det.box.y + det.box.height / 2.0f;
+
+        int ti = det_to_track[di];
+        if (ti < 0) {
+            State t;
+            t.id = m_nextId++;
+            t.cx.init(cx); t.cy.init(cy);
+            t.w.init((float)det.box.width); t.h.init((float)det.box.height);
+            t.face_id = -1;
+            t.embed_quality = 0;
+            t.embed_ms = -1;
+            m_tracks.push_back(t);
+            track_used.push_back(1);
+            ti = (int)m_tracks.size() - 1;
+        } else {
+            State& t = m_tracks[ti];
+            t.cx.correct(cx, MEASURE_NOISE);
+            t.cy.correct(cy, MEASURE_NOISE);
+            t.w.correct((float)det.box.width, MEASURE_NOISE);
+            t.h.correct((float)det.box.height, MEASURE_NOISE);
+        }
+
+        State& t = m_tracks[ti];
+        t.misses = 0;
+        t.last_ms = now_ms;
+
+        Track& r = out[di];
+        r.track_id = t.id;
+        r.face = det;
+        r.face_id = t.face_id;
+        r.quality = quality(det);
+        // 未匹配的轨迹 (陌生人或上次结果被队列丢弃) 用更短的间隔重试
+        int64_t ttl = t.face_id > 0 ? m_ttlMs : UNKNOWN_RETRY_MS;
+        r.need_embed = t.embed_ms < 0
+                    || now_ms - t.embed_ms >= ttl
+                    || r.quality > t.embed_quality * QUALITY_GAIN;
+        if (r.need_embed) {
+            t.embed_quality = r.quality;
+            t.embed_ms = now_ms;
+        }
+    }
+
+    m_tracks.erase(std::remove_if(m_tracks.begin(), m_tracks.end(),
+        [](const State& t) { return t.misses > MAX_MISSES; }), m_tracks.end());
+}
+
+void FaceTracker::deferEmbed(int track_id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (State& t : m_tracks) {
+        if (t.id == track_id) {
+            t.embed_quality = 0;
+            t.embed_ms = -1;
+            return;
+        }
+    }
+}
+
+void FaceTracker::setIdentity(int track_id, int face_id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (State& t : m_tracks) {
+        if (t.id == track_id) {
+            t.face_id = face_id;
+            return;
+        }
+    }
+}
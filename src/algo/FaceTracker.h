@@ -0,0 +1,93 @@
+#ifndef FACETRACKER_H
+#define FACETRACKER_H
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "algo/FaceInfo.h"
+#include "algo/FaceQuality.h"
+
+/**
+ * @brief 轻量多目标人脸跟踪 (IoU 关联 + 匀速 Kalman)
+ *
+ * 每个轨迹的框中心与宽高各用一个一维匀速 Kalman 滤波预测，新一帧的检测框按 IoU
+ * 贪心关联到预测框；连续 MAX_MISSES 帧未关联的轨迹被删除。
+ * 每个轨迹缓存特征匹配结果 (人脸ID)，只有以下情况才要求重新提取特征：
+ *   - 新轨迹，尚未识别
+ *   - 距上次提取超过 TTL (未匹配的轨迹每 UNKNOWN_RETRY_MS 重试)
+ *   - 当前质量比上次提取时高出 QUALITY_GAIN 倍 (例如走近、转正)
+ * 调用方的质量检查没通过 (模糊、侧脸等) 而没有提取时调用 deferEmbed()，下一帧重新判断。
+ * 这样特征提取与数据库检索每人只做一次，而不是每帧一次。
+ * 检测线程调用 update()，比对线程调用 setIdentity()，内部加锁。
+ */
+class FaceTracker {
+public:
+    // 一帧中的一张跟踪人脸
+    struct Track {
+        int track_id;
+        FaceInfo face;          // 本帧关联到的检测结果
+        int face_id;            // 缓存的识别结果，-1 表示未识别或未匹配
+        float quality;          // 本帧质量
+        bool need_embed;        // 本帧需要重新提取特征
+    };
+
+    FaceTracker();
+
+    // 新一帧的检测结果 (now_ms 为单调时钟毫秒)，out 与 detections 一一对应
+    void update(const std::vector<FaceInfo>& detections, int64_t now_ms, std::vector<Track>& out);
+
+    // 比对完成后缓存识别结果 (轨迹已删除时忽略)
+    void setIdentity(int track_id, int face_id);
+
+    // 本帧要求提取但质量不合格、没有提取：撤销本次记录，下一帧重新要求 (缓存的识别结果保留)
+    void deferEmbed(int track_id);
+
+    // 缓存过期时间 (毫秒)
+    void setTtl(int ttl_ms) { m_ttlMs = ttl_ms; }
+
+    void clear();
+
+    // 检测结果的质量分：置信度 x 尺寸项 (人脸小于模型输入 112 时线性降低) x 姿态项
+    static float quality(const FaceInfo& face) { return FaceQuality::geometricScore(face); }
+
+private:
+    // 一维匀速 Kalman 滤波 (状态：位置 + 速度)
+    struct Kalman1D {
+        float x = 0, v = 0;
+        float p00 = 1, p01 = 0, p11 = 1;
+        void init(float z);
+        void predict(float dt, float q);
+        void correct(float z, float r);
+    };
+
+    struct Pair { float iou; int track; int det; };
+
+    struct State {
+        int id;
+        Kalman1D cx, cy, w, h;
+        int misses;
+        int face_id;
+        float embed_quality;    // 上次提取特征时的质量
+        int64_t embed_ms;       // 上次提取特征的时间，-1 表示从未提取
+        int64_t last_ms;
+        cv::Rect predicted;
+    };
+
+    static const int MAX_MISSES = 10;
+    static const int UNKNOWN_RETRY_MS = 500;
+    static constexpr float IOU_THRESHOLD = 0.3f;
+    static constexpr float QUALITY_GAIN = 1.2f;
+
+    std::mutex m_mutex;
+    std::vector<State> m_tracks;
+    // update() 的关联缓冲区，跨帧复用 (受 m_mutex 保护)
+    std::vector<Pair> m_pairs;
+    std::vector<int> m_detToTrack;
+    std::vector<unsigned char> m_trackUsed;
+    int m_nextId;
+    int m_ttlMs;
+
+    static float iou(const cv::Rect& a, const cv::Rect& b);
+};
+
+#endif // FACETRACKER_H
@@ -1,26 +1,31 @@
 #include "MobileFaceNet.h"
+#include "common/Tracer.h"
+#include "common/MappedFile.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <algorithm>
 
-MobileFaceNet::MobileFaceNet() : ctx(0), is_init(false) {}
+MobileFaceNet::MobileFaceNet() : input_attrs(nullptr), output_attrs(nullptr), is_init(false) {}
 
 MobileFaceNet::~MobileFaceNet() {
     release();
 }
 
 int MobileFaceNet::init(const std::string& model_path) {
-    int model_len = 0;
-    unsigned char* model_data = load_model(model_path.c_str(), &model_len);
-    if (!model_data) return -1;
-
-    // 1. 初始化 RKNN 上下文
-    int ret = rknn_init(&ctx, model_data, model_len, 0, NULL);
-    free(model_data);
+    // 模型文件直接映射给 rknn_init，不再读入堆缓冲区
+    MappedFile model;
+    if (model.open(model_path) != 0) return -1;
+
+    // 1. 按调度策略创建 RKNN 上下文 (rknn_dup_context 共享权重)
+    NpuScheduler::Policy policy = NpuScheduler::policyFor(NPU_TASK_EMBED);
+    int ret = pool.init(model.data(), (uint32_t)model.size(), policy.flags, policy.core_masks);
+    model.close();
     if (ret < 0) {
         printf("rknn_init error ret=%d\n", ret);
         return -1;
     }
+    rknn_context ctx = pool.primary();
 
     // 2. 查询输入输出数量
     ret = rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
@@ -40,6 +45,31 @@ int MobileFaceNet::init(const std::string& model_path) {
         rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
     }
 
+    // 多 batch 模型 (转换时指定 batch > 1) 输入第 0 维即 batch，输出按 batch 平分
+    batch_size = 1;
+    if (input_attrs[0].n_dims == 4 && input_attrs[0].dims[0] > 1) {
+        batch_size = input_attrs[0].dims[0];
+    }
+    feature_dim = output_attrs[0].n_elems / batch_size;
+    printf("MobileFaceNet: batch=%d, feature dim=%d\n", batch_size, feature_dim);
+
+    // 4. 为每个上下文绑定常驻输入输出张量，失败时回退到 rknn_inputs_set
+    io_mems.clear();
+    if (use_io_mem) {
+        for (int i = 0; i < pool.size(); i++) {
+            std::unique_ptr<RknnIoMem> mem(new RknnIoMem());
+            if (mem->init(pool.at(i), io_num) < 0) {
+                printf("MobileFaceNet: io mem unavailable, fallback to rknn_inputs_set\n");
+                io_mems.clear();
+                break;
+            }
+            io_mems.push_back(std::move(mem));
+        }
+    }
+    aligners.assign(pool.size(), FaceAligner());
+    pack_bufs.assign(io_mems.empty() ? pool.size() : 0,
+                     std::vector<unsigned char>((size_t)batch_size * IMG_WIDTH * IMG_HEIGHT * IMG_CHANNELS));
+
     is_init = true;
     return 0;
 }
@@ -47,56 +77,175 @@ int MobileFaceNet::init(const std::string& model_path) {
 int MobileFaceNet::extractFeature(const cv::Mat& face_img, std::vector<float>& feature) {
     if (!is_init) return -1;
 
-    // 1. 设置输入数据
-    rknn_input inputs[1];
-    memset(inputs, 0, sizeof(inputs));
-    inputs[0].index = 0;
-    inputs[0].type = RKNN_TENSOR_UINT8; // 常用格式
-    inputs[0].size = IMG_WIDTH * IMG_HEIGHT * IMG_CHANNELS;
-    inputs[0].fmt = RKNN_TENSOR_NHWC; // RKNN 默认通常是 NHWC
-    inputs[0].buf = face_img.data;
+    // 借出一个特征上下文，多核平台上多个线程可以同时提取
+    NpuContextPool::Lease lease = pool.acquire();
+    if (!lease) return -1;
+    if (runBatch(lease.index(), lease.ctx(), &face_img, 1, &feature) != 0) return -1;
+    return feature.empty() ? -1 : 0;
+}
 
-    rknn_inputs_set(ctx, io_num.n_input, inputs);
+int MobileFaceNet::extractFeatures(const CameraFrame& frame, const std::vector<FaceInfo>& faces,
+                                   std::vector<std::vector<float>>& features) {
+    resetFeatures(features, faces.size());
+    if (!is_init || faces.empty() || frame.empty()) return 0;
+
+    NpuContextPool::Lease lease = pool.acquire();
+    if (!lease) return 0;
+    int done = 0;
+    for (size_t i = 0; i < faces.size(); i += batch_size) {
+        int count = (int)std::min(faces.size() - i, (size_t)batch_size);
+        if (alignBatch(lease.index(), lease.ctx(), frame, &faces[i], count, &features[i]) == 0) {
+            for (int b = 0; b < count; b++) {
+                if (!features[i + b].empty()) done++;
+            }
+        }
+    }
+    return done;
+}
 
-    // 2. 执行推理
-    rknn_run(ctx, NULL);
+int MobileFaceNet::extractFeatures(const std::vector<cv::Mat>& faces,
+                                   std::vector<std::vector<float>>& features) {
+    resetFeatures(features, faces.size());
+    if (!is_init || faces.empty()) return 0;
+
+    // 整批只借用一次上下文，按模型 batch 分组推理
+    NpuContextPool::Lease lease = pool.acquire();
+    if (!lease) return 0;
+    int done = 0;
+    for (size_t i = 0; i < faces.size(); i += batch_size) {
+        int count = (int)std::min(faces.size() - i, (size_t)batch_size);
+        if (runBatch(lease.index(), lease.ctx(), &faces[i], count, &features[i]) == 0) {
+            for (int b = 0; b < count; b++) {
+                if (!features[i + b].empty()) done++;
+            }
+        }
+    }
+    return done;
+}
 
-    // 3. 获取输出
-    rknn_output outputs[1];
-    memset(outputs, 0, sizeof(outputs));
-    outputs[0].want_float = 1; // 让 SDK 自动做反量化（dequantization）
+// 调整为 count 个空特征：已有元素只清空不释放，调用方每帧复用同一个 features 时不再申请内存
+void MobileFaceNet::resetFeatures(std::vector<std::vector<float>>& features, size_t count) {
+    features.resize(count);
+    for (std::vector<float>& feature : features) feature.clear();
+}
+
+int MobileFaceNet::runBatch(int ctx_index, rknn_context ctx, const cv::Mat* faces, int count,
+                            std::vector<float>* features) {
+    RknnIoMem* mem = io_mems.empty() ? nullptr : io_mems[ctx_index].get();
+
+    // 1. 把 count 张人脸依次打包进一块连续的输入缓冲区
+    // 常驻张量直接写入 NPU 内存 (行跨度可能大于 112)，否则写入该上下文的打包缓冲区
+    int row_bytes = IMG_WIDTH * IMG_CHANNELS;
+    int stride_bytes = mem ? mem->inputWidthStride(0) * IMG_CHANNELS : row_bytes;
+    size_t image_bytes = (size_t)stride_bytes * IMG_HEIGHT;
+    unsigned char* dst = mem ? (unsigned char*)mem->input(0)->virt_addr : pack_bufs[ctx_index].data();
+
+    TraceScope trace(Tracer::STAGE_ALIGN);
+    int valid_count = 0;
+    for (int b = 0; b < count; b++) {
+        const cv::Mat& face = faces[b];
+        features[b].clear();    // 无效输入保持为空
+        if (face.cols != IMG_WIDTH || face.rows != IMG_HEIGHT || face.type() != CV_8UC3) continue;
+        unsigned char* slot = dst + b * image_bytes;
+        for (int y = 0; y < IMG_HEIGHT; y++) {
+            memcpy(slot + y * stride_bytes, face.ptr(y), row_bytes);
+        }
+        features[b].resize(feature_dim);
+        valid_count++;
+    }
+    trace.stop();
+    if (valid_count == 0) return -1;
 
-    int ret = rknn_outputs_get(ctx, io_num.n_output, outputs, NULL);
-    if (ret < 0) return -1;
+    return infer(ctx_index, ctx, count, features, true);
+}
 
-    // 4. 拷贝特征值 (w600k_mbf 通常输出 128 或 512 维)
-    int count = output_attrs[0].n_elems;
-    float* out_data = (float*)outputs[0].buf;
-    feature.assign(out_data, out_data + count);
+int MobileFaceNet::alignBatch(int ctx_index, rknn_context ctx, const CameraFrame& frame,
+                              const FaceInfo* faces, int count, std::vector<float>* features) {
+    RknnIoMem* mem = io_mems.empty() ? nullptr : io_mems[ctx_index].get();
+
+    // 1. 每张人脸由 RGA 对齐后直接写入输入张量的第 b 个槽位 (多 batch 张量视为 batch*112 行的图)
+    FaceAligner::Target target;
+    target.fd = mem ? mem->input(0)->fd : -1;
+    target.virt = mem ? mem->input(0)->virt_addr : (void*)pack_bufs[ctx_index].data();
+    target.wstride = mem ? mem->inputWidthStride(0) : IMG_WIDTH;
+    target.height = batch_size * IMG_HEIGHT;
+
+    TraceScope trace(Tracer::STAGE_ALIGN);
+    int valid_count = 0;
+    bool cpu_written = false;
+    for (int b = 0; b < count; b++) {
+        features[b].clear();
+        target.y_offset = b * IMG_HEIGHT;
+        int ret = aligners[ctx_index].alignTo(frame, faces[b].landmarks, target);
+        if (ret < 0) continue;
+        cpu_written |= (ret == 1);
+        features[b].resize(feature_dim);
+        valid_count++;
+    }
+    trace.stop();
+    if (valid_count == 0) return -1;
 
-    // L2 归一化（人脸识别比对前通常需要归一化）
-    cv::Mat feat_mat(1, count, CV_32FC1, feature.data());
-    cv::normalize(feat_mat, feat_mat, 1.0, 0, cv::NORM_L2);
+    // 只有 CPU 写过张量时才需要刷缓存
+    return infer(ctx_index, ctx, count, features, cpu_written);
+}
 
-    rknn_outputs_release(ctx, io_num.n_output, outputs);
+int MobileFaceNet::infer(int ctx_index, rknn_context ctx, int count,
+                         std::vector<float>* features, bool sync_inputs) {
+    RknnIoMem* mem = io_mems.empty() ? nullptr : io_mems[ctx_index].get();
+    unsigned char* dst = mem ? nullptr : pack_bufs[ctx_index].data();
+    TraceScope trace(Tracer::STAGE_EMBED);
+
+    // 2. 执行推理
+    rknn_output outputs[1];
+    RknnTensorView out;
+    if (mem) {
+        if (sync_inputs) mem->syncInputs();
+        int64_t run_begin = Tracer::instance().enabled() ? Tracer::nowUs() : -1;
+        if (rknn_run(ctx, NULL) < 0) return -1;
+        if (run_begin >= 0) NpuScheduler::traceRun(NPU_TASK_EMBED, run_begin, Tracer::nowUs());
+        mem->syncOutputs();
+        out = mem->outputView(0);
+    } else {
+        rknn_input inputs[1];
+        memset(inputs, 0, sizeof(inputs));
+        inputs[0].index = 0;
+        inputs[0].type = RKNN_TENSOR_UINT8; // 常用格式
+        inputs[0].size = pack_bufs[ctx_index].size();
+        inputs[0].fmt = RKNN_TENSOR_NHWC; // RKNN 默认通常是 NHWC
+        inputs[0].buf = dst;
+
+        rknn_inputs_set(ctx, io_num.n_input, inputs);
+        if (rknn_run(ctx, NULL) < 0) return -1;
+
+        memset(outputs, 0, sizeof(outputs));
+        outputs[0].want_float = 1; // 让 SDK 自动做反量化（dequantization）
+        if (rknn_outputs_get(ctx, io_num.n_output, outputs, NULL) < 0) return -1;
+        if (Tracer::instance().enabled()) NpuScheduler::tracePerfRun(ctx, NPU_TASK_EMBED);
+        out.data = outputs[0].buf;
+    }
+
+    // 3. 按 batch 拆分输出并 L2 归一化 (w600k_mbf 通常输出 128 或 512 维)
+    for (int b = 0; b < count; b++) {
+        std::vector<float>& feature = features[b];
+        if (feature.empty()) continue;
+        int base = b * feature_dim;
+        for (int i = 0; i < feature_dim; i++) feature[i] = out.at(base + i);
+
+        cv::Mat feat_mat(1, feature_dim, CV_32FC1, feature.data());
+        cv::normalize(feat_mat, feat_mat, 1.0, 0, cv::NORM_L2);
+    }
+
+    if (!mem) rknn_outputs_release(ctx, io_num.n_output, outputs);
     return 0;
 }
 
 void MobileFaceNet::release() {
-    if (ctx > 0) rknn_destroy(ctx);
+    // 张量内存必须先于上下文释放
+    io_mems.clear();
+    pool.release();
     if (input_attrs) free(input_attrs);
     if (output_attrs) free(output_attrs);
+    input_attrs = nullptr;
+    output_attrs = nullptr;
+    is_init = false;
 }
-
-unsigned char* MobileFaceNet::load_model(const char* filename, int* model_size) {
-    FILE* fp = fopen(filename, "rb");
-    if (fp == NULL) return NULL;
-    fseek(fp, 0L, SEEK_END);
-    int size = ftell(fp);
-    fseek(fp, 0L, SEEK_SET);
-    unsigned char* data = (unsigned char*)malloc(size);
-    fread(data, 1, size, fp);
-    fclose(fp);
-    *model_size = size;
-    return data;
-}
\ No newline at end of file
@@ -3,7 +3,12 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 #include "rknn_api.h"
+#include "algo/NpuScheduler.h"
+#include "algo/RknnIoMem.h"
+#include "algo/FaceAligner.h"
+#include "algo/FaceInfo.h"
 #include <opencv2/opencv.hpp>
 
 class MobileFaceNet {
@@ -11,25 +16,71 @@ public:
     MobileFaceNet();
     ~MobileFaceNet();
 
+    // 是否使用常驻 NPU 输入输出张量 (rknn_create_mem)，需在 init() 之前设置，默认开启
+    void setIoMemEnabled(bool enable) { use_io_mem = enable; }
+
     // 加载模型
     int init(const std::string& model_path);
     
-    // 执行推理：输入112x112的Mat，输出特征向量
+    // 执行推理：输入112x112的Mat，输出特征向量 (feature 已有足够容量时不重新分配)
     int extractFeature(const cv::Mat& face_img, std::vector<float>& feature);
 
+    // 批量推理：features 与 faces 一一对应，只借用一次上下文
+    // 多 batch 模型每次 rknn_run 处理 batchSize() 张；单 batch 模型在同一上下文中逐张推理
+    // 返回成功提取的个数，失败的人脸对应的特征为空
+    int extractFeatures(const std::vector<cv::Mat>& faces, std::vector<std::vector<float>>& features);
+
+    // 对齐 + 批量推理：每张人脸由 FaceAligner (RGA) 按关键点对齐后直接写入输入张量，
+    // 不经过 CPU 的整帧 BGR 转换与 warpAffine
+    int extractFeatures(const CameraFrame& frame, const std::vector<FaceInfo>& faces,
+                        std::vector<std::vector<float>>& features);
+
+    // 模型输入的 batch 大小 (输入张量第 0 维)
+    int batchSize() const { return batch_size; }
+
+    // NPU 上下文个数 (可同时推理的线程数)
+    int contextCount() const { return pool.size(); }
+
+    // 特征维度 (init 后有效)
+    int featureDim() const { return feature_dim; }
+
+    // librknnrt / NPU 驱动版本，init 后有效，成功返回 0
+    int sdkVersion(std::string& api_version, std::string& driver_version) const {
+        return pool.sdkVersion(api_version, driver_version);
+    }
+
 private:
-    rknn_context ctx;
+    // RKNN 上下文池 (低优先级，多核平台在检测以外的核心上各开一个上下文)
+    NpuContextPool pool;
+    // 每个上下文一组常驻输入输出张量，下标与 pool 的上下文下标一致；为空表示未启用
+    std::vector<std::unique_ptr<RknnIoMem>> io_mems;
+    bool use_io_mem = true;
     rknn_input_output_num io_num;
     rknn_tensor_attr* input_attrs;
     rknn_tensor_attr* output_attrs;
+
+    int batch_size = 1;
+    int feature_dim = 0;
+    // 非常驻张量路径下每个上下文一块连续的打包输入缓冲区 (batch x 112 x 112 x 3)
+    std::vector<std::vector<unsigned char>> pack_bufs;
+    // 每个上下文一个对齐器 (持有 RGA 中间缓冲区)
+    std::vector<FaceAligner> aligners;
     
     bool is_init = false;
     const int IMG_WIDTH = 112;
     const int IMG_HEIGHT = 112;
     const int IMG_CHANNELS = 3;
 
-    unsigned char* load_model(const char* filename, int* model_size);
+    // 在已借出的上下文上推理 count (<= batch_size) 张人脸，成功返回0
+    int runBatch(int ctx_index, rknn_context ctx, const cv::Mat* faces, int count,
+                 std::vector<float>* features);
+    // 对齐 count 张人脸直接写入输入张量后推理
+    int alignBatch(int ctx_index, rknn_context ctx, const CameraFrame& frame,
+                   const FaceInfo* faces, int count, std::vector<float>* features);
+    // 输入已打包好：推理并拆分输出，features[b] 为空的槽位跳过
+    int infer(int ctx_index, rknn_context ctx, int count, std::vector<float>* features, bool sync_inputs);
     void release();
+    static void resetFeatures(std::vector<std::vector<float>>& features, size_t count);
 };
 
 #endif
\ No newline at end of file
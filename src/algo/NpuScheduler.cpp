@@ -0,0 +1,326 @@
+#include "NpuScheduler.h"
+#include "common/Tracer.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+// 当前线程的流编号与截止时间 (NpuStreamScope)
+static thread_local int t_stream = -1;
+static thread_local int64_t t_deadline_us = 0;
+static thread_local bool t_drop_late = false;
+
+static std::atomic<int> g_streamCount(1);
+static std::atomic<int> g_schedulePolicy(NPU_SCHEDULE_ROUND_ROBIN);
+
+// 每类任务最多的上下文数 (每个上下文多占一份中间 tensor 内存)
+static const int MAX_CONTEXTS_PER_TASK = 4;
+
+// ---------------------------------------------------------
+// NpuStreamScope
+// ---------------------------------------------------------
+NpuStreamScope::NpuStreamScope(int stream, int64_t deadline_us, bool drop_late)
+    : m_prevStream(t_stream), m_prevDeadline(t_deadline_us), m_prevDropLate(t_drop_late)
+{
+    t_stream = stream;
+    t_deadline_us = deadline_us;
+    t_drop_late = drop_late;
+}
+
+NpuStreamScope::~NpuStreamScope()
+{
+    t_stream = m_prevStream;
+    t_deadline_us = m_prevDeadline;
+    t_drop_late = m_prevDropLate;
+}
+
+int NpuStreamScope::currentStream()
+{
+    return t_stream;
+}
+
+int64_t NpuStreamScope::currentDeadline()
+{
+    return t_deadline_us;
+}
+
+bool NpuStreamScope::currentDropLate()
+{
+    return t_drop_late;
+}
+
+// ---------------------------------------------------------
+// NpuContextPool::Lease
+// ---------------------------------------------------------
+NpuContextPool::Lease::Lease(Lease&& other) noexcept
+    : m_pool(other.m_pool), m_index(other.m_index)
+{
+    other.m_pool = nullptr;
+    other.m_index = -1;
+}
+
+NpuContextPool::Lease& NpuContextPool::Lease::operator=(Lease&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_pool = other.m_pool;
+        m_index = other.m_index;
+        other.m_pool = nullptr;
+        other.m_index = -1;
+    }
+    return *this;
+}
+
+rknn_context NpuContextPool::Lease::ctx() const
+{
+    return m_pool ? m_pool->at(m_index) : 0;
+}
+
+void NpuContextPool::Lease::release()
+{
+    if (m_pool) {
+        m_pool->giveBack(m_index);
+        m_pool = nullptr;
+        m_index = -1;
+    }
+}
+
+// ---------------------------------------------------------
+// NpuContextPool
+// ---------------------------------------------------------
+NpuContextPool::NpuContextPool()
+{
+}
+
+NpuContextPool::~NpuContextPool()
+{
+    release();
+}
+
+int NpuContextPool::init(void* model_data, uint32_t model_size, uint32_t flags,
+                         const std::vector<rknn_core_mask>& core_masks)
+{
+    release();
+    if (!model_data || core_masks.empty()) return -1;
+
+    rknn_context first = 0;
+    int ret = rknn_init(&first, model_data, model_size, flags, NULL);
+    if (ret < 0) {
+        printf("[NpuContextPool] rknn_init error ret=%d\n", ret);
+        return -1;
+    }
+    m_contexts.push_back(first);
+
+    // 其余上下文复制自第一个，共享同一份权重
+    for (size_t i = 1; i < core_masks.size(); i++) {
+        rknn_context dup = 0;
+        ret = rknn_dup_context(&first, &dup);
+        if (ret < 0) {
+            // 复制失败不致命，用已有的上下文继续工作
+            printf("[NpuContextPool] rknn_dup_context error ret=%d, pool size=%d\n",
+                   ret, (int)m_contexts.size());
+            break;
+        }
+        m_contexts.push_back(dup);
+    }
+
+    // 单核平台不支持设置核心掩码，AUTO 时跳过
+    for (size_t i = 0; i < m_contexts.size(); i++) {
+        if (core_masks[i] == RKNN_NPU_CORE_AUTO) continue;
+        ret = rknn_set_core_mask(m_contexts[i], core_masks[i]);
+        if (ret < 0) {
+            printf("[NpuContextPool] rknn_set_core_mask(%d) error ret=%d\n", (int)core_masks[i], ret);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int i = (int)m_contexts.size() - 1; i >= 0; i--) m_free.push_back(i);
+    return 0;
+}
+
+void NpuContextPool::release()
+{
+    // 调用方需保证此时没有未归还的 Lease
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = m_contexts.size(); i > 0; i--) {
+        if (m_contexts[i - 1]) rknn_destroy(m_contexts[i - 1]);
+    }
+    m_contexts.clear();
+    m_free.clear();
+}
+
+int NpuContextPool::sdkVersion(std::string& api_version, std::string& driver_version) const
+{
+    if (m_contexts.empty()) return -1;
+    rknn_sdk_version version;
+    memset(&version, 0, sizeof(version));
+    if (rknn_query(m_contexts[0], RKNN_QUERY_SDK_VERSION, &version, sizeof(version)) != RKNN_SUCC) return -1;
+    api_version = version.api_version;
+    driver_version = version.drv_version;
+    return 0;
+}
+
+NpuContextPool::Lease NpuContextPool::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_contexts.empty()) return Lease();
+
+    // 排队：只有轮到自己并且有空闲上下文时才取 (没有竞争时立即返回)
+    Waiter self{ NpuStreamScope::currentStream(), NpuStreamScope::currentDeadline(), m_nextTicket++ };
+    m_waiters.push_back(&self);
+    auto ready = [this, &self] { return !m_free.empty() && nextWaiter() == &self; };
+    bool granted;
+    if (NpuStreamScope::currentDropLate() && self.deadline_us > 0) {
+        // Tracer::nowUs 与 steady_clock 同源，截止时间可以直接换算成 time_point
+        std::chrono::steady_clock::time_point until{ std::chrono::microseconds(self.deadline_us) };
+        granted = m_cond.wait_until(lock, until, ready);
+    } else {
+        m_cond.wait(lock, ready);
+        granted = true;
+    }
+    m_waiters.erase(std::find(m_waiters.begin(), m_waiters.end(), &self));
+    if (!granted) {
+        // 放弃排队：如果本来轮到自己，让下一个等待者接上
+        bool others = !m_free.empty() && !m_waiters.empty();
+        lock.unlock();
+        if (others) m_cond.notify_all();
+        return Lease();
+    }
+
+    int index = m_free.back();
+    m_free.pop_back();
+    m_lastStream = self.stream;
+    // 还有空闲上下文时让下一个等待者也去检查
+    bool more = !m_free.empty() && !m_waiters.empty();
+    lock.unlock();
+    if (more) m_cond.notify_all();
+    return Lease(this, index);
+}
+
+void NpuContextPool::giveBack(int index)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(index);
+        if (m_waiters.empty()) return;
+    }
+    // 等待者只有个位数 (每路流的几个工作线程)，全部唤醒后由 nextWaiter 决定谁拿到
+    m_cond.notify_all();
+}
+
+const NpuContextPool::Waiter* NpuContextPool::nextWaiter() const
+{
+    bool deadline = NpuScheduler::schedulePolicy() == NPU_SCHEDULE_DEADLINE;
+    // 轮询：按流编号排在 m_lastStream 之后的距离排序 (流编号从 -1 开始，整体加 1 变成非负)
+    auto distance = [this](int stream) {
+        const int span = 1 << 16;
+        return ((stream - m_lastStream - 1) % span + span) % span;
+    };
+
+    const Waiter* best = nullptr;
+    for (const Waiter* w : m_waiters) {
+        if (!best) {
+            best = w;
+            continue;
+        }
+        bool before;
+        if (deadline) {
+            int64_t a = w->deadline_us > 0 ? w->deadline_us : INT64_MAX;
+            int64_t b = best->deadline_us > 0 ? best->deadline_us : INT64_MAX;
+            before = a != b ? a < b : w->ticket < best->ticket;
+        } else {
+            int a = distance(w->stream), b = distance(best->stream);
+            before = a != b ? a < b : w->ticket < best->ticket;
+        }
+        if (before) best = w;
+    }
+    return best;
+}
+
+// ---------------------------------------------------------
+// NpuScheduler
+// ---------------------------------------------------------
+int NpuScheduler::coreCount()
+{
+    static int count = [] {
+        // compatible 为若干个以 '\0' 分隔的字符串，例如 "rockchip,rk3588-evb\0rockchip,rk3588\0"
+        std::ifstream ifs("/proc/device-tree/compatible", std::ios::binary);
+        std::string compat((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        if (compat.find("rk3588") != std::string::npos) return 3;
+        if (compat.find("rk3576") != std::string::npos) return 2;
+        return 1;
+    }();
+    return count;
+}
+
+NpuScheduler::Policy NpuScheduler::policyFor(NpuTask task)
+{
+    Policy policy;
+    int cores = coreCount();
+
+    if (task == NPU_TASK_DETECT) {
+        policy.flags = RKNN_FLAG_PRIOR_HIGH;
+        policy.core_masks.push_back(cores > 1 ? RKNN_NPU_CORE_0 : RKNN_NPU_CORE_AUTO);
+    } else {
+        // NPU_TASK_EMBED
+        policy.flags = RKNN_FLAG_PRIOR_LOW;
+        if (cores == 1) {
+            policy.core_masks.push_back(RKNN_NPU_CORE_AUTO);
+        } else {
+            static const rknn_core_mask others[] = { RKNN_NPU_CORE_1, RKNN_NPU_CORE_2 };
+            for (int i = 1; i < cores && i <= 2; i++) policy.core_masks.push_back(others[i - 1]);
+        }
+    }
+
+    // 多路流：按原有核心分配循环补足上下文，每路至少能同时持有一个
+    size_t base = policy.core_masks.size();
+    size_t wanted = std::min(streamCount(), MAX_CONTEXTS_PER_TASK);
+    while (policy.core_masks.size() < wanted) {
+        policy.core_masks.push_back(policy.core_masks[policy.core_masks.size() % base]);
+    }
+    return policy;
+}
+
+void NpuScheduler::setStreamCount(int streams)
+{
+    g_streamCount = std::max(1, streams);
+}
+
+int NpuScheduler::streamCount()
+{
+    return g_streamCount;
+}
+
+void NpuScheduler::setSchedulePolicy(NpuSchedulePolicy policy)
+{
+    g_schedulePolicy = policy;
+}
+
+NpuSchedulePolicy NpuScheduler::schedulePolicy()
+{
+    return (NpuSchedulePolicy)g_schedulePolicy.load();
+}
+
+void NpuScheduler::tracePerfRun(rknn_context ctx, NpuTask task)
+{
+    Tracer& tracer = Tracer::instance();
+    if (!tracer.enabled()) return;
+
+    rknn_perf_run perf;
+    if (rknn_query(ctx, RKNN_QUERY_PERF_RUN, &perf, sizeof(perf)) != RKNN_SUCC) return;
+    // 只有时长，按 "刚刚结束" 记录
+    int64_t end = Tracer::nowUs();
+    tracer.record(task == NPU_TASK_DETECT ? Tracer::STAGE_NPU_DETECT : Tracer::STAGE_NPU_EMBED,
+                  end - perf.run_duration, end);
+}
+
+void NpuScheduler::traceRun(NpuTask task, int64_t begin_us, int64_t end_us)
+{
+    Tracer::instance().record(task == NPU_TASK_DETECT ? Tracer::STAGE_NPU_DETECT : Tracer::STAGE_NPU_EMBED,
+                              begin_us, end_us);
+}
@@ -0,0 +1,172 @@
+#ifndef NPUSCHEDULER_H
+#define NPUSCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "rknn_api.h"
+
+// 使用 NPU 的任务种类，决定上下文的优先级与核心分配
+enum NpuTask {
+    NPU_TASK_DETECT = 0,    // RetinaFace：每帧都跑，延迟敏感
+    NPU_TASK_EMBED          // MobileFaceNet：只在检测到人脸时跑，允许突发
+};
+
+// 多路流 (多个摄像头) 共用上下文池时，空闲上下文分给哪个等待者
+enum NpuSchedulePolicy {
+    NPU_SCHEDULE_ROUND_ROBIN = 0,   // 各路轮流：上次分给流 k，下次优先 k+1、k+2 ...，同一路内先来先得
+    NPU_SCHEDULE_DEADLINE           // 截止时间最早的请求优先 (EDF)，没有截止时间的排在最后
+};
+
+/**
+ * @brief 标记当前线程发出的 NPU 请求属于哪一路流、截止时间是多少 (线程局部，析构时恢复)
+ *
+ * RecognitionPipeline 的工作线程每处理一帧设置一次：流编号为摄像头序号，
+ * 截止时间为采集时间 + 帧预算。上下文池在 acquire() 时读取，用于跨流调度；
+ * 没有设置的线程 (工具、服务的远程图片) 属于流 -1，截止时间为 0 (不限)。
+ * drop_late 为 true 时，排队等到截止时间仍没有拿到上下文就放弃 (acquire 返回空 Lease)，
+ * 过期的帧不再占用 NPU，把时间让给其他路。
+ */
+class NpuStreamScope {
+public:
+    explicit NpuStreamScope(int stream, int64_t deadline_us = 0, bool drop_late = false);
+    ~NpuStreamScope();
+
+    NpuStreamScope(const NpuStreamScope&) = delete;
+    NpuStreamScope& operator=(const NpuStreamScope&) = delete;
+
+    static int currentStream();
+    static int64_t currentDeadline();
+    static bool currentDropLate();
+
+private:
+    int m_prevStream;
+    int64_t m_prevDeadline;
+    bool m_prevDropLate;
+};
+
+/**
+ * @brief 同一模型的一组 RKNN 上下文
+ *
+ * 第一个上下文由 rknn_init 创建，其余用 rknn_dup_context 复制 (共享权重，
+ * 只多占一份中间 tensor 内存)。每个上下文可以绑定到不同的 NPU 核心。
+ * 调用方通过 acquire() 借出一个空闲上下文，Lease 析构时归还；
+ * 同一上下文同一时刻只会被一个线程使用，rknn_run 不需要额外加锁。
+ * 上下文不够时等待者排队，按 NpuScheduler::schedulePolicy() 决定下一个拿到上下文的流，
+ * 多个摄像头共用一个模型时 NPU 时间在各路之间公平分配。
+ */
+class NpuContextPool {
+public:
+    // 借出的上下文 (RAII)，只能移动
+    class Lease {
+    public:
+        Lease() : m_pool(nullptr), m_index(-1) {}
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { release(); }
+
+        explicit operator bool() const { return m_pool != nullptr; }
+        rknn_context ctx() const;
+        // 上下文在池中的下标，可用于索引每个上下文私有的缓冲区
+        int index() const { return m_index; }
+        void release();
+
+    private:
+        friend class NpuContextPool;
+        Lease(NpuContextPool* pool, int index) : m_pool(pool), m_index(index) {}
+        NpuContextPool* m_pool;
+        int m_index;
+    };
+
+    NpuContextPool();
+    ~NpuContextPool();
+
+    NpuContextPool(const NpuContextPool&) = delete;
+    NpuContextPool& operator=(const NpuContextPool&) = delete;
+
+    // 创建 core_masks.size() 个上下文，第 i 个绑定到 core_masks[i]
+    // flags 为 rknn_init 的标志位 (RKNN_FLAG_PRIOR_* 等)。成功返回 0
+    int init(void* model_data, uint32_t model_size, uint32_t flags,
+             const std::vector<rknn_core_mask>& core_masks);
+    void release();
+
+    int size() const { return (int)m_contexts.size(); }
+    // 第一个上下文，仅用于 rknn_query 等只读查询
+    rknn_context primary() const { return m_contexts.empty() ? 0 : m_contexts[0]; }
+    rknn_context at(int index) const { return m_contexts[index]; }
+
+    // librknnrt 与 NPU 驱动版本 (RKNN_QUERY_SDK_VERSION)，成功返回 0
+    int sdkVersion(std::string& api_version, std::string& driver_version) const;
+
+    // 借出一个空闲上下文，全部忙时按调度策略排队等待；池未初始化
+    // 或等到截止时间仍未轮到 (drop_late) 时返回空 Lease
+    // 流编号与截止时间取自当前线程的 NpuStreamScope
+    Lease acquire();
+
+private:
+    // 排队中的请求 (在 acquire 的栈上)
+    struct Waiter {
+        int stream;
+        int64_t deadline_us;
+        uint64_t ticket;                // 到达顺序
+    };
+
+    std::vector<rknn_context> m_contexts;
+    std::vector<int> m_free;            // 空闲上下文下标 (按栈使用，优先复用刚归还的)
+    std::vector<const Waiter*> m_waiters;
+    uint64_t m_nextTicket = 0;
+    int m_lastStream = -1;              // 上一次拿到上下文的流 (轮询用)
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    void giveBack(int index);
+    // 按调度策略选出下一个应当拿到上下文的等待者 (持锁调用)
+    const Waiter* nextWaiter() const;
+};
+
+/**
+ * @brief NPU 调度策略
+ *
+ * 按板子的 NPU 核心数给检测 / 特征两类任务分配优先级与核心：
+ *   - 单核 (RK3566/RK3568)：两者共用核心，检测用高优先级、特征用低优先级，
+ *     驱动在两个任务同时排队时先执行检测
+ *   - 多核 (RK3588 三核 / RK3576 双核)：检测独占核心 0，
+ *     特征在其余核心上各开一个上下文，互不抢占
+ * 多路摄像头共用模型时 (setStreamCount)，每类任务至少开 "流数" 个上下文 (rknn_dup_context，
+ * 共享权重)，一路的 CPU 前后处理可以与另一路的 NPU 推理重叠；排队顺序由 setSchedulePolicy 决定。
+ */
+class NpuScheduler {
+public:
+    struct Policy {
+        uint32_t flags;                         // rknn_init 标志位
+        std::vector<rknn_core_mask> core_masks; // 每个上下文绑定的核心
+    };
+
+    // 当前平台的 NPU 核心数 (读取 /proc/device-tree/compatible，只探测一次)
+    static int coreCount();
+
+    // 指定任务的调度策略
+    static Policy policyFor(NpuTask task);
+
+    // 共用模型的流 (摄像头) 数，需在模型 init 之前设置，默认 1
+    static void setStreamCount(int streams);
+    static int streamCount();
+
+    // 上下文池的跨流调度策略，可随时切换，默认轮询
+    static void setSchedulePolicy(NpuSchedulePolicy policy);
+    static NpuSchedulePolicy schedulePolicy();
+
+    // 只能在 rknn_outputs_get 之后调用 (RKNN_QUERY_PERF_RUN 此前无效)：查询本次推理在 NPU 上的
+    // 实际耗时，记入 Tracer 的 npu.* 阶段，用于计算 NPU 利用率。
+    // 每次查询都是一次 ioctl，调用方先判断 Tracer::instance().enabled()
+    static void tracePerfRun(rknn_context ctx, NpuTask task);
+    // 零拷贝 (io-mem) 路径不调用 rknn_outputs_get，查不到 PERF_RUN：
+    // 改为记录 rknn_run 的墙钟区间 (含驱动提交开销，比实际执行时间略长)
+    static void traceRun(NpuTask task, int64_t begin_us, int64_t end_us);
+};
+
+#endif // NPUSCHEDULER_H
@@ -1,94 +1,479 @@
 #include "RetinaFace.h"
-#include <fstream>
+#include "common/Tracer.h"
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// 人脸置信度阈值 / NMS IoU 阈值
+static const float CONF_THRESHOLD = 0.5f;
+static const float NMS_THRESHOLD = 0.4f;
+// NMS 前最多保留的候选数 (按分数 top-K)，0 表示不限制
+static const int NMS_TOP_K = 256;
+
+// ROI 检测：ROI 边长为人脸框长边的倍数，最小边长 (放大倍数不超过 RGA 的 16 倍限制)
+static const float ROI_EXPAND = 2.5f;
+static const int ROI_MIN_SIZE = 96;
+// ROI 数量超过该值或总面积超过整帧的该比例时，直接做一次整帧检测更快
+static const int ROI_MAX_COUNT = 3;
+static const float ROI_MAX_AREA_RATIO = 0.5f;
+
+// 把浮点阈值换算到量化域：返回满足 (q - zp) * scale >= thresh 的最小整数 q
+// 超出 [qmin, qmax] 时截断 (qmax + 1 表示没有任何值能通过)
+static inline int quantizeThreshold(float thresh, int32_t zp, float scale, int qmin, int qmax) {
+    if (scale <= 0.0f) return qmin;
+    float q = ceilf(thresh / scale + (float)zp);
+    if (q < (float)qmin) return qmin;
+    if (q > (float)qmax) return qmax + 1;
+    return (int)q;
+}
 
-// 112x112 参考点
-static float REFERENCE_PTS_112[5][2] = {
-    {38.2946f, 51.6963f}, {73.5318f, 51.5014f}, {56.0252f, 71.7366f},
-    {41.5493f, 92.3655f}, {70.7299f, 92.2041f}
-};
+// 分辨率切换：EMA 平滑系数、两次切换之间至少间隔的检测次数
+static const float LOAD_EMA_ALPHA = 0.1f;
+static const int SWITCH_COOLDOWN = 30;
+// RESOLUTION_LOAD：按面积估算升级后的耗时，低于预算的该比例才升级 (留出余量避免抖动)
+static const float LOAD_UPGRADE_MARGIN = 0.8f;
+// RESOLUTION_FACE_SIZE：最小人脸在模型输入中的边长 (像素)
+// 小于 FACE_SMALL 升一级 (最小 anchor 为 16)，在低一级模型中仍不小于 FACE_LARGE 则降一级
+static const float FACE_SMALL = 24.0f;
+static const float FACE_LARGE = 48.0f;
+
+RetinaFace::RetinaFace(const std::string& modelPath) : active(0) {
+    loadModel(modelPath);
+}
 
-static inline float clip(float x, float min, float max) {
-    return x < min ? min : (x > max ? max : x);
+RetinaFace::RetinaFace(const std::vector<std::string>& modelPaths) : active(0) {
+    for (const std::string& path : modelPaths) loadModel(path);
 }
 
-RetinaFace::RetinaFace(const std::string& modelPath) : ctx(0), model_data(nullptr) {
-    std::ifstream ifs(modelPath, std::ios::binary);
-    if (ifs.is_open()) {
-        ifs.seekg(0, std::ios::end);
-        model_data_size = ifs.tellg();
-        ifs.seekg(0, std::ios::beg);
-        model_data = new unsigned char[model_data_size];
-        ifs.read((char*)model_data, model_data_size);
-        ifs.close();
-    } else {
-        std::cerr << "[RetinaFace] Error loading model: " << modelPath << std::endl;
+RetinaFace::~RetinaFace() {
+    for (auto& m : models) {
+        // 张量内存必须先于上下文释放
+        m->io_mems.clear();
+        m->pool.release();
     }
 }
 
-RetinaFace::~RetinaFace() {
-    if (ctx) rknn_destroy(ctx);
-    if (model_data) delete[] model_data;
-    if (input_attrs) delete[] input_attrs;
-    if (output_attrs) delete[] output_attrs;
+void RetinaFace::loadModel(const std::string& path) {
+    std::unique_ptr<Model> m(new Model());
+    if (m->file.open(path) != 0) {
+        std::cerr << "[RetinaFace] Error loading model: " << path << std::endl;
+        return;
+    }
+    m->path = path;
+    models.push_back(std::move(m));
 }
 
 // ---------------------------------------------------------
-// 动态生成 Anchors
+// Anchors (320x320 编译期生成，其他尺寸运行期生成)
 // ---------------------------------------------------------
-void RetinaFace::initPriors() {
-    // 针对 320x320 的配置
-    // Strides: 8, 16, 32
-    // MinSizes: [16,32], [64,128], [256,512]
-    int strides[] = {8, 16, 32};
-    std::vector<std::vector<float>> min_sizes = {
-        {16.0f, 32.0f}, {64.0f, 128.0f}, {256.0f, 512.0f}
-    };
-    
-    priors.clear();
-    for (int k = 0; k < 3; k++) {
-        int stride = strides[k];
-        int feature_w = (int)ceil(MODEL_WIDTH / (float)stride);
-        int feature_h = (int)ceil(MODEL_HEIGHT / (float)stride);
-        
-        for (int i = 0; i < feature_h; i++) {
-            for (int j = 0; j < feature_w; j++) {
-                for (auto min_size : min_sizes[k]) {
-                    float s_kx = min_size / MODEL_WIDTH;
-                    float s_ky = min_size / MODEL_HEIGHT;
-                    float cx = (j + 0.5f) * stride / MODEL_WIDTH;
-                    float cy = (i + 0.5f) * stride / MODEL_HEIGHT;
-                    priors.push_back({cx, cy, s_kx, s_ky});
-                }
-            }
+static constexpr RetinaFacePriorTable<320, 320> PRIORS_320 = makeRetinaFacePriors<320, 320>();
+static_assert(RetinaFacePriorTable<320, 320>::count == 4200, "320x320 应该生成 4200 个 anchor");
+
+// ---------------------------------------------------------
+// 解码内核：NEON 一次处理 16 个 (INT8) / 4 个 (FP32) anchor 的置信度，
+// 4 个候选 anchor 的框和关键点；非 ARM 平台走等价的标量实现
+// ---------------------------------------------------------
+static const float VARIANCE0 = 0.1f;
+static const float VARIANCE1 = 0.2f;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+// exp 近似 (Cephes 多项式)，在 [-87, 88] 内相对误差 ~1e-7
+static inline float32x4_t exp_f32x4(float32x4_t x) {
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-87.0f)), vdupq_n_f32(88.0f));
+    float32x4_t n = vrndnq_f32(vmulq_n_f32(x, 1.44269504f));
+    float32x4_t r = vfmsq_f32(x, n, vdupq_n_f32(0.693359375f));
+    r = vfmsq_f32(r, n, vdupq_n_f32(-2.12194440e-4f));
+
+    float32x4_t p = vdupq_n_f32(1.9875691500e-4f);
+    p = vfmaq_f32(vdupq_n_f32(1.3981999507e-3f), p, r);
+    p = vfmaq_f32(vdupq_n_f32(8.3334519073e-3f), p, r);
+    p = vfmaq_f32(vdupq_n_f32(4.1665795894e-2f), p, r);
+    p = vfmaq_f32(vdupq_n_f32(1.6666665459e-1f), p, r);
+    p = vfmaq_f32(vdupq_n_f32(5.0000001201e-1f), p, r);
+    p = vfmaq_f32(vaddq_f32(r, vdupq_n_f32(1.0f)), p, vmulq_f32(r, r));
+
+    int32x4_t e = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23);
+    return vmulq_f32(p, vreinterpretq_f32_s32(e));
+}
+#endif
+
+// 扫描 [bg, face] 交错的置信度，把 face 分数 >= 阈值的 anchor 下标写入 out，返回个数
+// 量化输出在整数域比较 (q_thresh 由 quantizeThreshold 换算)，浮点输出直接比较
+static int scanScores(const RknnTensorView& score, int count, float thresh, int q_thresh, int* out) {
+    int n = 0;
+    int i = 0;
+
+    if (score.type == RKNN_TENSOR_INT8) {
+        if (q_thresh > 127) return 0;
+        const int8_t* s = (const int8_t*)score.data;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+        int8x16_t vt = vdupq_n_s8((int8_t)q_thresh);
+        for (; i + 16 <= count; i += 16) {
+            int8x16x2_t v = vld2q_s8(s + i * 2);
+            if (vmaxvq_u8(vcgeq_s8(v.val[1], vt)) == 0) continue;
+            for (int k = i; k < i + 16; k++) if (s[k * 2 + 1] >= q_thresh) out[n++] = k;
+        }
+#endif
+        for (; i < count; i++) if (s[i * 2 + 1] >= q_thresh) out[n++] = i;
+    } else if (score.type == RKNN_TENSOR_UINT8) {
+        if (q_thresh > 255) return 0;
+        const uint8_t* s = (const uint8_t*)score.data;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+        uint8x16_t vt = vdupq_n_u8((uint8_t)q_thresh);
+        for (; i + 16 <= count; i += 16) {
+            uint8x16x2_t v = vld2q_u8(s + i * 2);
+            if (vmaxvq_u8(vcgeq_u8(v.val[1], vt)) == 0) continue;
+            for (int k = i; k < i + 16; k++) if (s[k * 2 + 1] >= q_thresh) out[n++] = k;
+        }
+#endif
+        for (; i < count; i++) if (s[i * 2 + 1] >= q_thresh) out[n++] = i;
+    } else {
+        const float* s = (const float*)score.data;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+        float32x4_t vt = vdupq_n_f32(thresh);
+        for (; i + 4 <= count; i += 4) {
+            float32x4x2_t v = vld2q_f32(s + i * 2);
+            if (vmaxvq_u32(vcgeq_f32(v.val[1], vt)) == 0) continue;
+            for (int k = i; k < i + 4; k++) if (s[k * 2 + 1] >= thresh) out[n++] = k;
+        }
+#endif
+        for (; i < count; i++) if (s[i * 2 + 1] >= thresh) out[n++] = i;
+    }
+    return n;
+}
+
+// 解码最多 4 个候选 anchor 的框和关键点 (原图坐标)，lanes 为有效个数 (1~4)
+static void decodeBatch4(const RknnTensorView& loc, const RknnTensorView& landm,
+                         const RetinaFacePriors& priors, const int* idx, int lanes,
+                         const RetinaFace::InputMapping& map, FaceInfo* out) {
+    const float scale_w = map.scale_x, scale_h = map.scale_y;
+    const float off_x = map.off_x, off_y = map.off_y;
+    // 收集 4 个 anchor 的数据到 SoA 临时数组 (不足 4 个时重复最后一个)
+    float pcx[4], pcy[4], pw[4], ph[4];
+    float l[4][4], lm[10][4];
+    for (int k = 0; k < 4; k++) {
+        int a = idx[k < lanes ? k : lanes - 1];
+        pcx[k] = priors.cx[a];
+        pcy[k] = priors.cy[a];
+        pw[k] = priors.w[a];
+        ph[k] = priors.h[a];
+        for (int c = 0; c < 4; c++) l[c][k] = loc.at(a * 4 + c);
+        for (int c = 0; c < 10; c++) lm[c][k] = landm.at(a * 10 + c);
+    }
+
+    float x1[4], y1[4], bw[4], bh[4];
+    float lx[5][4], ly[5][4];
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t vpcx = vld1q_f32(pcx), vpcy = vld1q_f32(pcy);
+    float32x4_t vpw = vld1q_f32(pw), vph = vld1q_f32(ph);
+    // 先乘上方差，后面只需一次 FMA
+    float32x4_t vpw0 = vmulq_n_f32(vpw, VARIANCE0), vph0 = vmulq_n_f32(vph, VARIANCE0);
+
+    float32x4_t cx = vfmaq_f32(vpcx, vld1q_f32(l[0]), vpw0);
+    float32x4_t cy = vfmaq_f32(vpcy, vld1q_f32(l[1]), vph0);
+    float32x4_t w = vmulq_f32(vpw, exp_f32x4(vmulq_n_f32(vld1q_f32(l[2]), VARIANCE1)));
+    float32x4_t h = vmulq_f32(vph, exp_f32x4(vmulq_n_f32(vld1q_f32(l[3]), VARIANCE1)));
+
+    float32x4_t vox = vdupq_n_f32(off_x), voy = vdupq_n_f32(off_y);
+    vst1q_f32(x1, vfmaq_n_f32(vox, vfmsq_f32(cx, w, vdupq_n_f32(0.5f)), scale_w));
+    vst1q_f32(y1, vfmaq_n_f32(voy, vfmsq_f32(cy, h, vdupq_n_f32(0.5f)), scale_h));
+    vst1q_f32(bw, vmulq_n_f32(w, scale_w));
+    vst1q_f32(bh, vmulq_n_f32(h, scale_h));
+
+    for (int p = 0; p < 5; p++) {
+        vst1q_f32(lx[p], vfmaq_n_f32(vox, vfmaq_f32(vpcx, vld1q_f32(lm[p * 2]), vpw0), scale_w));
+        vst1q_f32(ly[p], vfmaq_n_f32(voy, vfmaq_f32(vpcy, vld1q_f32(lm[p * 2 + 1]), vph0), scale_h));
+    }
+#else
+    for (int k = 0; k < 4; k++) {
+        float cx = pcx[k] + l[0][k] * VARIANCE0 * pw[k];
+        float cy = pcy[k] + l[1][k] * VARIANCE0 * ph[k];
+        float w = pw[k] * expf(l[2][k] * VARIANCE1);
+        float h = ph[k] * expf(l[3][k] * VARIANCE1);
+        x1[k] = (cx - w / 2.0f) * scale_w + off_x;
+        y1[k] = (cy - h / 2.0f) * scale_h + off_y;
+        bw[k] = w * scale_w;
+        bh[k] = h * scale_h;
+        for (int p = 0; p < 5; p++) {
+            lx[p][k] = (pcx[k] + lm[p * 2][k] * VARIANCE0 * pw[k]) * scale_w + off_x;
+            ly[p][k] = (pcy[k] + lm[p * 2 + 1][k] * VARIANCE0 * ph[k]) * scale_h + off_y;
+        }
+    }
+#endif
+
+    for (int k = 0; k < lanes; k++) {
+        FaceInfo& face = out[k];
+        face.box.x = x1[k];
+        face.box.y = y1[k];
+        face.box.width = bw[k];
+        face.box.height = bh[k];
+        for (int p = 0; p < 5; p++) {
+            face.landmarks[p].x = lx[p][k];
+            face.landmarks[p].y = ly[p][k];
         }
     }
-    // 320x320 应该生成 4200 个 anchor
-    // std::cout << "Priors generated: " << priors.size() << std::endl;
 }
 
 int RetinaFace::init() {
-    if (!model_data) return -1;
-    int ret = rknn_init(&ctx, model_data, model_data_size, 0, NULL);
+    // 各分辨率的模型互不依赖，并行初始化 (rknn_init 的耗时主要是读模型与分配 NPU 内存)
+    std::vector<int> rets(models.size(), -1);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < models.size(); i++) {
+        threads.emplace_back([this, &rets, i] { rets[i] = initModel(*models[i]); });
+    }
+    if (!models.empty()) rets[0] = initModel(*models[0]);
+    for (auto& t : threads) t.join();
+
+    // 初始化失败的模型直接丢弃，其余按输入面积从小到大排列
+    std::vector<std::unique_ptr<Model>> ready;
+    for (size_t i = 0; i < models.size(); i++) {
+        std::unique_ptr<Model>& m = models[i];
+        if (rets[i] == 0) {
+            ready.push_back(std::move(m));
+        } else {
+            std::cerr << "[RetinaFace] Failed to init model: " << m->path << std::endl;
+            m->io_mems.clear();
+            m->pool.release();
+        }
+    }
+    models = std::move(ready);
+    if (models.empty()) return -1;
+
+    std::sort(models.begin(), models.end(), [](const std::unique_ptr<Model>& a, const std::unique_ptr<Model>& b) {
+        return a->width * a->height < b->width * b->height;
+    });
+    active = 0;
+    for (const auto& m : models) {
+        std::cout << "[RetinaFace] " << m->path << ": " << m->width << "x" << m->height
+                  << ", " << m->priors.count << " anchors" << std::endl;
+    }
+    return 0;
+}
+
+int RetinaFace::initModel(Model& m) {
+    if (!m.file.isOpen()) return -1;
+    NpuScheduler::Policy npu = NpuScheduler::policyFor(NPU_TASK_DETECT);
+    int ret = m.pool.init(m.file.data(), (uint32_t)m.file.size(), npu.flags, npu.core_masks);
+    // 模型已拷贝进 NPU 内存，映射不再需要
+    m.file.close();
     if (ret < 0) return -1;
 
-    rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
-    input_attrs = new rknn_tensor_attr[io_num.n_input];
-    output_attrs = new rknn_tensor_attr[io_num.n_output];
+    rknn_context ctx = m.pool.primary();
+    rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &m.io_num, sizeof(m.io_num));
+    if (m.io_num.n_input < 1 || m.io_num.n_output < 3) return -1;
+    m.input_attrs.assign(m.io_num.n_input, rknn_tensor_attr());
+    m.output_attrs.assign(m.io_num.n_output, rknn_tensor_attr());
 
-    for (int i = 0; i < io_num.n_input; i++) {
-        input_attrs[i].index = i;
-        rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &(input_attrs[i]), sizeof(rknn_tensor_attr));
+    for (uint32_t i = 0; i < m.io_num.n_input; i++) {
+        memset(&m.input_attrs[i], 0, sizeof(rknn_tensor_attr));
+        m.input_attrs[i].index = i;
+        rknn_query(ctx, RKNN_QUERY_INPUT_ATTR, &m.input_attrs[i], sizeof(rknn_tensor_attr));
     }
-    for (int i = 0; i < io_num.n_output; i++) {
-        output_attrs[i].index = i;
-        rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &(output_attrs[i]), sizeof(rknn_tensor_attr));
+    for (uint32_t i = 0; i < m.io_num.n_output; i++) {
+        memset(&m.output_attrs[i], 0, sizeof(rknn_tensor_attr));
+        m.output_attrs[i].index = i;
+        rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &m.output_attrs[i], sizeof(rknn_tensor_attr));
     }
-    
-    // 生成 Anchor
-    initPriors();
-    
+
+    // 输入尺寸：NHWC 为 [1, H, W, 3]，NCHW 为 [1, 3, H, W]
+    const rknn_tensor_attr& in = m.input_attrs[0];
+    if (in.n_dims != 4) return -1;
+    if (in.fmt == RKNN_TENSOR_NCHW) {
+        m.height = in.dims[2];
+        m.width = in.dims[3];
+    } else {
+        m.height = in.dims[1];
+        m.width = in.dims[2];
+    }
+    if (m.width <= 0 || m.height <= 0) return -1;
+
+    // Anchor 表必须与模型输出的 anchor 数一致 (Location 输出为 [1, N, 4])
+    if (m.width == 320 && m.height == 320) {
+        m.priors = PRIORS_320.view();
+    } else {
+        m.prior_buf.generate(m.width, m.height);
+        m.priors = m.prior_buf.view();
+    }
+    if ((int)m.output_attrs[0].n_elems != m.priors.count * 4) {
+        std::cerr << "[RetinaFace] anchor count mismatch: model " << m.output_attrs[0].n_elems / 4
+                  << ", priors " << m.priors.count << std::endl;
+        return -1;
+    }
+
+    // 为每个上下文绑定常驻输入输出张量
+    m.io_mems.clear();
+    if (use_io_mem) {
+        for (int i = 0; i < m.pool.size(); i++) {
+            std::unique_ptr<RknnIoMem> mem(new RknnIoMem());
+            if (mem->init(m.pool.at(i), m.io_num) < 0) {
+                std::cerr << "[RetinaFace] io mem unavailable, fallback to rknn_inputs_set" << std::endl;
+                m.io_mems.clear();
+                break;
+            }
+            m.io_mems.push_back(std::move(mem));
+        }
+    }
+
+    // 普通路径的常驻输入缓冲区；填充区尚未写入
+    m.host_inputs.clear();
+    if (m.io_mems.empty()) {
+        for (int i = 0; i < m.pool.size(); i++) m.host_inputs.push_back(cv::Mat(m.height, m.width, CV_8UC3));
+    }
+    m.content_rects.assign(m.pool.size(), im_rect{ 0, 0, 0, 0 });
+
+    // 按上下文数预分配解码缓冲区
+    m.scratch.assign(m.pool.size(), DecodeScratch());
+    for (auto& buf : m.scratch) {
+        buf.candidates.resize(m.priors.count);
+        buf.nms.reserve(NMS_TOP_K > 0 ? NMS_TOP_K : m.priors.count);
+        buf.outputs.resize(m.io_num.n_output);
+    }
+    return 0;
+}
+
+cv::Size RetinaFace::inputSize() const {
+    if (models.empty()) return cv::Size();
+    const Model& m = *models[active];
+    return cv::Size(m.width, m.height);
+}
+
+void RetinaFace::setVariant(int index) {
+    if (index < 0 || index >= (int)models.size()) return;
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    switchTo(index, "manual");
+}
+
+void RetinaFace::setResolutionPolicy(ResolutionPolicy p, float budget) {
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    policy = p;
+    budget_ms = budget;
+    since_switch = 0;
+}
+
+void RetinaFace::switchTo(int index, const char* reason) {
+    if (index == active) return;
+    active = index;
+    since_switch = 0;
+    const Model& m = *models[index];
+    std::cout << "[RetinaFace] switch to " << m.width << "x" << m.height << " (" << reason << ")" << std::endl;
+}
+
+void RetinaFace::updateLoad(Model& m, float elapsed_ms) {
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    m.avg_ms = m.avg_ms > 0 ? m.avg_ms + LOAD_EMA_ALPHA * (elapsed_ms - m.avg_ms) : elapsed_ms;
+    // 推理期间已切换到别的模型 (其他线程触发)：只更新该模型的均值，不参与切换判断
+    int cur = active;
+    if (models[cur].get() != &m) return;
+    since_switch++;
+    if (policy != RESOLUTION_LOAD || models.size() < 2 || since_switch < SWITCH_COOLDOWN) return;
+
+    if (m.avg_ms > budget_ms && cur > 0) {
+        switchTo(cur - 1, "over budget");
+    } else if (cur + 1 < (int)models.size()) {
+        // 高一级模型测过就用实测值，否则按输入面积估算
+        const Model& up = *models[cur + 1];
+        float estimate = up.avg_ms > 0 ? up.avg_ms
+                       : m.avg_ms * (float)(up.width * up.height) / (m.width * m.height);
+        if (estimate < budget_ms * LOAD_UPGRADE_MARGIN) switchTo(cur + 1, "under budget");
+    }
+}
+
+void RetinaFace::reportFaceSize(int min_side, int frame_w, int frame_h) {
+    if (min_side <= 0 || frame_w <= 0 || frame_h <= 0) return;
+    std::lock_guard<std::mutex> lock(policy_mutex);
+    if (policy != RESOLUTION_FACE_SIZE || models.size() < 2 || since_switch < SWITCH_COOLDOWN) return;
+
+    // 整帧检测为 letterbox 等比缩放，缩放比取宽高两个方向中较小的
+    auto sideInModel = [&](const Model& m) {
+        return min_side * std::min((float)m.width / frame_w, (float)m.height / frame_h);
+    };
+    int cur = active;
+    if (sideInModel(*models[cur]) < FACE_SMALL && cur + 1 < (int)models.size()) {
+        switchTo(cur + 1, "small faces");
+    } else if (cur > 0 && sideInModel(*models[cur - 1]) >= FACE_LARGE) {
+        switchTo(cur - 1, "large faces");
+    }
+}
+
+// ---------------------------------------------------------
+// Letterbox 预处理：等比缩放进输入张量中居中的子矩形，其余部分为填充色
+// ---------------------------------------------------------
+// 填充色取训练时的均值 (RGB 123/117/104)，减均值后为 0，对检测没有干扰
+// RGA 填充色格式为 0xAABBGGRR
+static const int LETTERBOX_COLOR = (int)0xff68757bu;
+
+// area (原图区域) 等比缩放后在 dst_w x dst_h 输入中的位置，起点与尺寸 2 像素对齐
+static im_rect letterboxRect(const cv::Rect& area, int dst_w, int dst_h) {
+    float scale = std::min((float)dst_w / area.width, (float)dst_h / area.height);
+    int w = std::max(2, std::min(dst_w, (int)std::lround(area.width * scale))) & ~1;
+    int h = std::max(2, std::min(dst_h, (int)std::lround(area.height * scale))) & ~1;
+    im_rect r = { ((dst_w - w) / 2) & ~1, ((dst_h - h) / 2) & ~1, w, h };
+    return r;
+}
+
+// 用填充色写满 content 以外的区域 (上下或左右两条)
+static IM_STATUS fillLetterbox(rga_buffer_t& dst, int dst_w, int dst_h, const im_rect& content) {
+    im_rect bands[4];
+    int n = 0;
+    if (content.y > 0) bands[n++] = { 0, 0, dst_w, content.y };
+    if (content.y + content.height < dst_h) {
+        bands[n++] = { 0, content.y + content.height, dst_w, dst_h - content.y - content.height };
+    }
+    if (content.x > 0) bands[n++] = { 0, content.y, content.x, content.height };
+    if (content.x + content.width < dst_w) {
+        bands[n++] = { content.x + content.width, content.y, dst_w - content.x - content.width, content.height };
+    }
+    for (int i = 0; i < n; i++) {
+        IM_STATUS status = imfill(dst, bands[i], LETTERBOX_COLOR);
+        if (status != IM_STATUS_SUCCESS) return status;
+    }
+    return IM_STATUS_SUCCESS;
+}
+
+// RGA 把源图的 rect 区域缩放到目标的 drect，同时做颜色转换
+static IM_STATUS cropResize(const rga_buffer_t& src, const rga_buffer_t& dst,
+                            const cv::Rect& rect, const im_rect& drect) {
+    rga_buffer_t pat;
+    memset(&pat, 0, sizeof(pat));
+    im_rect srect = { rect.x, rect.y, rect.width, rect.height };
+    im_rect prect = { 0, 0, 0, 0 };
+    return improcess(src, dst, pat, srect, drect, prect, -1, NULL, NULL, IM_SYNC);
+}
+
+int RetinaFace::letterboxInto(Model& m, int index, const rga_buffer_t& src, rga_buffer_t& dst,
+                              const cv::Rect& area, InputMapping& map) {
+    im_rect content = letterboxRect(area, m.width, m.height);
+
+    // 填充区只在布局变化时重写 (整帧与 ROI 交替时)，其余帧只有一次 RGA 缩放
+    im_rect& last = m.content_rects[index];
+    if (last.x != content.x || last.y != content.y || last.width != content.width || last.height != content.height) {
+        IM_STATUS status = fillLetterbox(dst, m.width, m.height, content);
+        if (status != IM_STATUS_SUCCESS) {
+            std::cerr << "[RetinaFace] RGA fill failed: " << status << std::endl;
+            last = im_rect{ 0, 0, 0, 0 };
+            return -1;
+        }
+        last = content;
+    }
+
+    IM_STATUS status = cropResize(src, dst, area, content);
+    if (status != IM_STATUS_SUCCESS) {
+        std::cerr << "[RetinaFace] RGA resize failed: " << status << std::endl;
+        return -1;
+    }
+
+    // 解码输出的是相对模型输入的归一化坐标：先乘输入尺寸，去掉填充偏移，再按缩放比映射回原图
+    float sx = (float)content.width / area.width;
+    float sy = (float)content.height / area.height;
+    map.scale_x = m.width / sx;
+    map.scale_y = m.height / sy;
+    map.off_x = area.x - content.x / sx;
+    map.off_y = area.y - content.y / sy;
     return 0;
 }
 
@@ -96,40 +481,99 @@ int RetinaFace::init() {
 // 推理核心 (已适配官方 Output 格式)
 // ---------------------------------------------------------
 int RetinaFace::detect(const cv::Mat& inputImg, std::vector<FaceInfo>& faces) {
-    if(!ctx) return -1;
+    return detect(CameraFrame::fromMat(inputImg), faces);
+}
 
-    // 准备目标容器 (320x320, RGB)
+int RetinaFace::detect(const CameraFrame& frame, std::vector<FaceInfo>& faces) {
+    return detect(frame, cv::Rect(0, 0, frame.width, frame.height), faces);
+}
+
+int RetinaFace::detect(const CameraFrame& frame, const cv::Rect& roi, std::vector<FaceInfo>& faces) {
+    if (models.empty() || frame.empty()) return -1;
+
+    // YUV 源的裁剪起点与尺寸需要 2 像素对齐
+    cv::Rect area = roi & cv::Rect(0, 0, frame.width, frame.height);
+    area.x &= ~1; area.y &= ~1;
+    area.width &= ~1; area.height &= ~1;
+    if (area.width < 2 || area.height < 2) return -1;
+
+    // 只统计 rknn_run：排队等上下文的时间反映的是并发度，不是模型本身的开销
+    Model& m = *models[active];
+    float run_ms = 0;
+    int ret = runModel(m, frame, area, faces, &run_ms);
+    if (ret == 0) updateLoad(m, run_ms);
+    return ret;
+}
+
+int RetinaFace::runModel(Model& m, const CameraFrame& frame, const cv::Rect& area, std::vector<FaceInfo>& faces,
+                         float* run_ms) {
+    if (!m.pool.size()) return -1;
+
+    // 借出一个检测上下文，函数返回时自动归还；等过了截止时间 (NpuStreamScope drop_late) 时放弃本帧
+    NpuContextPool::Lease lease = m.pool.acquire();
+    if (!lease) return -1;
+    rknn_context ctx = lease.ctx();
+
+    // 1. 包装源图像 buffer
+    // OpenCV 帧为 BGR 虚拟地址；V4L2 帧为 DMA-BUF (YUV)，RGA 同时完成颜色转换
+    rga_buffer_t src_rga = frame.toRgaBuffer();
+
+    // ---- 零拷贝路径：RGA 直接写 NPU 输入张量，后处理直接读量化输出 ----
+    if (!m.io_mems.empty()) {
+        RknnIoMem& mem = *m.io_mems[lease.index()];
+        rga_buffer_t dst_rga = wrapbuffer_fd_t(
+            mem.input(0)->fd,
+            m.width, m.height,
+            mem.inputWidthStride(0), m.height,
+            RK_FORMAT_RGB_888
+        );
+        InputMapping map;
+        {
+            TraceScope trace(Tracer::STAGE_RESIZE);
+            if (letterboxInto(m, lease.index(), src_rga, dst_rga, area, map) != 0) return -1;
+        }
+        {
+            TraceScope trace(Tracer::STAGE_DET_RUN);
+            int64_t run_begin = Tracer::nowUs();
+            if (rknn_run(ctx, NULL) < 0) return -1;
+            int64_t run_end = Tracer::nowUs();
+            *run_ms = (run_end - run_begin) / 1000.0f;
+            if (Tracer::instance().enabled()) NpuScheduler::traceRun(NPU_TASK_DETECT, run_begin, run_end);
+        }
+        {
+            TraceScope trace(Tracer::STAGE_DET_OUTPUT);
+            mem.syncOutputs();
+        }
+
+        RknnTensorView outs[3] = { mem.outputView(0), mem.outputView(1), mem.outputView(2) };
+        decodeOutputs(outs, m.priors, map, m.scratch[lease.index()], faces);
+        return 0;
+    }
+
+    // ---- 普通路径：rknn_inputs_set + want_float ----
+    // 目标容器 (模型输入尺寸, RGB) 每个上下文一份常驻，保留上次的填充区
     // 注意：RKNN通常需要RGB格式，而OpenCV默认是BGR
-    cv::Mat resized_img(MODEL_HEIGHT, MODEL_WIDTH, CV_8UC3);
-
-    // 1. 包装源图像 buffer (假设 OpenCV 读取的是 BGR)
-    // 必须确保 inputImg 内存是连续的，OpenCV 默认 Mat 只要不是裁剪的一般都是连续的
-    rga_buffer_t src_rga = wrapbuffer_virtualaddr(
-        (void*)inputImg.data, 
-        inputImg.cols, 
-        inputImg.rows, 
-        RK_FORMAT_BGR_888 // 对应 CV_8UC3 (BGR)
-    );
+    cv::Mat& resized_img = m.host_inputs[lease.index()];
 
     // 2. 包装目标图像 buffer (RGB)
     rga_buffer_t dst_rga = wrapbuffer_virtualaddr(
         (void*)resized_img.data, 
-        MODEL_WIDTH, 
-        MODEL_HEIGHT, 
+        m.width, 
+        m.height, 
         RK_FORMAT_RGB_888 // 目标需要 RGB
     );
 
-    // 3. 调用 RGA 执行 Resize + Format Conversion
-    // imresize 内部会自动处理颜色空间转换
-    IM_STATUS status = imresize(src_rga, dst_rga);
-    if (status != IM_STATUS_SUCCESS) {
-        std::cerr << "[RetinaFace] RGA resize failed: " << status << std::endl;
-        return -1;
+    // 3. 调用 RGA 执行 Crop + Letterbox Resize + Format Conversion
+    // 内部会自动处理颜色空间转换
+    InputMapping map;
+    {
+        TraceScope trace(Tracer::STAGE_RESIZE);
+        if (letterboxInto(m, lease.index(), src_rga, dst_rga, area, map) != 0) return -1;
     }
 
     /* 用openCV：
     cv::Mat resized_img;
-    cv::resize(inputImg, resized_img, cv::Size(MODEL_WIDTH, MODEL_HEIGHT));
+    cv::resize(inputImg, resized_img, cv::Size(m.width, m.height));
     cv::cvtColor(resized_img, resized_img, cv::COLOR_BGR2RGB);
     */
 
@@ -138,100 +582,180 @@ int RetinaFace::detect(const cv::Mat& inputImg, std::vector<FaceInfo>& faces) {
     inputs[0].index = 0;
     inputs[0].type = RKNN_TENSOR_UINT8;
     inputs[0].fmt = RKNN_TENSOR_NHWC;
-    inputs[0].size = MODEL_WIDTH * MODEL_HEIGHT * 3;
+    inputs[0].size = m.width * m.height * 3;
     inputs[0].buf = resized_img.data;
-    rknn_inputs_set(ctx, io_num.n_input, inputs);
+    TraceScope run_trace(Tracer::STAGE_DET_RUN);
+    rknn_inputs_set(ctx, m.io_num.n_input, inputs);
+    int64_t run_begin = Tracer::nowUs();
+    if (rknn_run(ctx, NULL) < 0) return -1;
+    *run_ms = (Tracer::nowUs() - run_begin) / 1000.0f;
+    run_trace.stop();
+
+    // 量化模型直接取 INT8/UINT8 原始输出，不让运行时整表反量化
+    // 输出描述符每个上下文一份常驻 (init 时按输出个数分配)
+    std::vector<rknn_output>& outputs = m.scratch[lease.index()].outputs;
+    memset(outputs.data(), 0, outputs.size() * sizeof(rknn_output));
+    RknnTensorView outs[3];
+    for (uint32_t i = 0; i < m.io_num.n_output; i++) {
+        const rknn_tensor_attr& attr = m.output_attrs[i];
+        bool quantized = attr.type == RKNN_TENSOR_INT8 || attr.type == RKNN_TENSOR_UINT8;
+        outputs[i].want_float = quantized ? 0 : 1;
+        if (i < 3 && quantized) {
+            outs[i].type = attr.type;
+            outs[i].zp = attr.zp;
+            outs[i].scale = attr.scale;
+        }
+    }
+    TraceScope output_trace(Tracer::STAGE_DET_OUTPUT);
+    if (rknn_outputs_get(ctx, m.io_num.n_output, outputs.data(), NULL) < 0) return -1;
+    output_trace.stop();
+    if (Tracer::instance().enabled()) NpuScheduler::tracePerfRun(ctx, NPU_TASK_DETECT);
+    for (int i = 0; i < 3; i++) outs[i].data = outputs[i].buf;
+    decodeOutputs(outs, m.priors, map, m.scratch[lease.index()], faces);
+
+    rknn_outputs_release(ctx, m.io_num.n_output, outputs.data());
+    return 0;
+}
 
-    rknn_run(ctx, NULL);
+int RetinaFace::makeRois(const std::vector<cv::Rect>& boxes, int img_w, int img_h, cv::Rect* rois) {
+    const cv::Rect frame_rect(0, 0, img_w, img_h);
+    int count = 0;
+    for (const cv::Rect& box : boxes) {
+        // 以人脸中心为中心的正方形 (模型输入是正方形，避免缩放变形)
+        int side = std::max(ROI_MIN_SIZE, (int)(std::max(box.width, box.height) * ROI_EXPAND));
+        side = std::min(side, std::min(img_w, img_h));
+        int cx = box.x + box.width / 2, cy = box.y + box.height / 2;
+        // 靠近边缘时整体平移回画面内，而不是裁小
+        int x = std::max(0, std::min(cx - side / 2, img_w - side));
+        int y = std::max(0, std::min(cy - side / 2, img_h - side));
+        cv::Rect roi = cv::Rect(x, y, side, side) & frame_rect;
+        if (roi.area() > 0) rois[count++] = roi;
+    }
+
+    // 重叠的 ROI 合并为外接矩形，直到两两不相交
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (int i = 0; i < count && !merged; i++) {
+            for (int j = i + 1; j < count; j++) {
+                if ((rois[i] & rois[j]).area() == 0) continue;
+                int x0 = std::min(rois[i].x, rois[j].x), y0 = std::min(rois[i].y, rois[j].y);
+                int x1 = std::max(rois[i].br().x, rois[j].br().x), y1 = std::max(rois[i].br().y, rois[j].br().y);
+                rois[i] = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+                std::copy(rois + j + 1, rois + count, rois + j);
+                count--;
+                merged = true;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+int RetinaFace::detectAround(const CameraFrame& frame, const std::vector<cv::Rect>& boxes,
+                             std::vector<FaceInfo>& faces, FrameArena* arena) {
+    if (frame.empty()) return -1;
+
+    // ROI 列表：有每帧临时内存时从中分配，否则用局部数组
+    std::vector<cv::Rect> local;
+    cv::Rect* rois;
+    if (arena) {
+        rois = arena->alloc<cv::Rect>(boxes.size());
+    } else {
+        local.resize(boxes.size());
+        rois = local.data();
+    }
+    int roi_count = rois ? makeRois(boxes, frame.width, frame.height, rois) : 0;
+
+    long long roi_area = 0;
+    for (int i = 0; i < roi_count; i++) roi_area += rois[i].area();
+    if (roi_count == 0 || roi_count > ROI_MAX_COUNT ||
+        roi_area > (long long)(ROI_MAX_AREA_RATIO * frame.width * frame.height)) {
+        return detect(frame, faces);
+    }
 
-    rknn_output outputs[io_num.n_output];
-    memset(outputs, 0, sizeof(outputs));
-    for (int i = 0; i < io_num.n_output; i++) {
-        outputs[i].want_float = 1; 
+    size_t first = faces.size();
+    for (int i = 0; i < roi_count; i++) {
+        if (detect(frame, rois[i], faces) != 0) return -1;
     }
-    rknn_outputs_get(ctx, io_num.n_output, outputs, NULL);
 
+    // ROI 互不相交，但人脸恰好在 ROI 边界时两边可能各检出一半，保留置信度高的
+    std::sort(faces.begin() + first, faces.end(),
+        [](const FaceInfo& a, const FaceInfo& b) { return a.score > b.score; });
+    size_t kept = first;
+    for (size_t i = first; i < faces.size(); i++) {
+        bool dup = false;
+        for (size_t k = first; k < kept && !dup; k++) {
+            int inter = (faces[i].box & faces[k].box).area();
+            int uni = faces[i].box.area() + faces[k].box.area() - inter;
+            dup = uni > 0 && inter > NMS_THRESHOLD * uni;
+        }
+        if (!dup) faces[kept++] = faces[i];
+    }
+    faces.resize(kept);
+    return 0;
+}
+
+void RetinaFace::decodeOutputs(const RknnTensorView outs[3], const RetinaFacePriors& priors,
+                               const InputMapping& map, DecodeScratch& buf, std::vector<FaceInfo>& faces) {
     // ==========================================
     // 关键修正：解析官方格式 (Loc, Conf, Landm)
     // ==========================================
     // 官方模型通常顺序: 
-    // outputs[0] -> Location [1, 4200, 4]
-    // outputs[1] -> Score    [1, 4200, 2]
-    // outputs[2] -> Landmark [1, 4200, 10]
+    // outputs[0] -> Location [1, N, 4]   (320x320 时 N = 4200)
+    // outputs[1] -> Score    [1, N, 2]
+    // outputs[2] -> Landmark [1, N, 10]
     
-    float* out_loc   = (float*)outputs[0].buf;
-    float* out_score = (float*)outputs[1].buf;
-    float* out_landm = (float*)outputs[2].buf;
-
-    float variance[2] = {0.1f, 0.2f};
-    float scale_w = (float)inputImg.cols; // 此时是相对坐标，直接乘原图宽高
-    float scale_h = (float)inputImg.rows;
-
-    std::vector<FaceInfo> proposals;
-    int num_priors = priors.size(); // 4200
-
-    // 遍历所有 Anchor
-    for (int i = 0; i < num_priors; i++) {
-        // Score: Index 1 is face confidence (Softmax后的结果)
-        // 格式: [bg_score, face_score]
-        float score = out_score[i * 2 + 1]; 
-        
-        if (score < 0.5f) continue; // CONF_THRESHOLD
-
-        // Decode Box
-        float* loc_ptr = out_loc + i * 4;
-        float prior_cx = priors[i][0];
-        float prior_cy = priors[i][1];
-        float prior_w  = priors[i][2];
-        float prior_h  = priors[i][3];
-
-        float cx = prior_cx + loc_ptr[0] * variance[0] * prior_w;
-        float cy = prior_cy + loc_ptr[1] * variance[0] * prior_h;
-        float w  = prior_w  * exp(loc_ptr[2] * variance[1]);
-        float h  = prior_h  * exp(loc_ptr[3] * variance[1]);
-
-        // 转回原图坐标
-        FaceInfo face;
-        face.score = score;
-        face.box.x = (cx - w / 2.0f) * scale_w;
-        face.box.y = (cy - h / 2.0f) * scale_h;
-        face.box.width = w * scale_w;
-        face.box.height = h * scale_h;
-
-        // Decode Landmarks
-        float* landm_ptr = out_landm + i * 10;
-        for (int k = 0; k < 5; k++) {
-            float lcx = prior_cx + landm_ptr[k * 2] * variance[0] * prior_w;
-            float lcy = prior_cy + landm_ptr[k * 2 + 1] * variance[0] * prior_h;
-            face.landmarks[k].x = lcx * scale_w;
-            face.landmarks[k].y = lcy * scale_h;
-        }
-
-        proposals.push_back(face);
+    const RknnTensorView& out_loc   = outs[0];
+    const RknnTensorView& out_score = outs[1];
+    const RknnTensorView& out_landm = outs[2];
+    TraceScope decode_trace(Tracer::STAGE_DECODE);
+
+    // 1. 置信度扫描：量化输出的阈值预先换算到整数域，
+    //    99% 以上被拒绝的 anchor 只做一次向量化的整数比较
+    int q_thresh = 0;
+    if (out_score.type == RKNN_TENSOR_INT8) {
+        q_thresh = quantizeThreshold(CONF_THRESHOLD, out_score.zp, out_score.scale, -128, 127);
+    } else if (out_score.type == RKNN_TENSOR_UINT8) {
+        q_thresh = quantizeThreshold(CONF_THRESHOLD, out_score.zp, out_score.scale, 0, 255);
     }
-
-    // NMS (OpenCV 辅助)
-    std::vector<int> indices;
-    std::vector<cv::Rect> bboxes;
-    std::vector<float> scores;
-    for (const auto& p : proposals) {
-        bboxes.push_back(p.box);
-        scores.push_back(p.score);
+    int* candidates = buf.candidates.data();
+    int num_candidates = scanScores(out_score, priors.count, CONF_THRESHOLD, q_thresh, candidates);
+
+    // 2. 候选过多时 (大脸 / 误检) 先按分数选出 top-K，限制后续解码与 NMS 的开销
+    if (NMS_TOP_K > 0 && num_candidates > NMS_TOP_K) {
+        std::nth_element(candidates, candidates + NMS_TOP_K, candidates + num_candidates,
+            [&out_score](int a, int b) { return out_score.at(a * 2 + 1) > out_score.at(b * 2 + 1); });
+        num_candidates = NMS_TOP_K;
     }
-    
-    cv::dnn::NMSBoxes(bboxes, scores, 0.5f, 0.4f, indices);
-
-    for (int idx : indices) {
-        faces.push_back(proposals[idx]);
+    if (num_candidates > buf.nms.capacity()) num_candidates = buf.nms.capacity();
+
+    // 3. 只对通过的 anchor 反量化并解码，每批 4 个，直接写入 NMS 的候选缓冲区
+    FaceInfo* proposals = buf.nms.buffer();
+    for (int b = 0; b < num_candidates; b += 4) {
+        int lanes = std::min(4, num_candidates - b);
+        decodeBatch4(out_loc, out_landm, priors, candidates + b, lanes,
+                     map, proposals + b);
+    }
+    // Score: Index 1 is face confidence (Softmax后的结果)
+    // 格式: [bg_score, face_score]
+    for (int c = 0; c < num_candidates; c++) {
+        proposals[c].score = out_score.at(candidates[c] * 2 + 1);
     }
 
-    rknn_outputs_release(ctx, io_num.n_output, outputs);
-    return 0;
+    decode_trace.stop();
+
+    // 4. 贪心 NMS (原地，无堆分配)
+    TraceScope nms_trace(Tracer::STAGE_NMS);
+    buf.nms.run(num_candidates, NMS_THRESHOLD, faces);
 }
 
 cv::Mat RetinaFace::getAlignedFaceFromCamera(CameraManager& camera) {
-    cv::Mat frame;
-    if (!camera.getLatestFrame(frame) || frame.empty()) return cv::Mat();
+    // 零拷贝取帧：检测阶段直接让 RGA 读取摄像头缓冲区
+    // ref 在函数结束前一直持有，保证对齐时帧内容不被采集线程覆盖
+    FrameRef ref;
+    if (!camera.getLatestFrame(ref)) return cv::Mat();
+    const CameraFrame& frame = *ref;
 
     std::vector<FaceInfo> faces;
     detect(frame, faces);
@@ -242,19 +766,17 @@ cv::Mat RetinaFace::getAlignedFaceFromCamera(CameraManager& camera) {
     auto bestFace = *std::max_element(faces.begin(), faces.end(), 
         [](const FaceInfo& a, const FaceInfo& b){ return a.box.area() < b.box.area(); });
 
-    return preprocessFace(frame, bestFace.landmarks);
+    // 只有检测到人脸时才需要 CPU 可读的 BGR 图像做仿射对齐
+    cv::Mat bgr = frame.toBgrMat();
+    if (bgr.empty()) return cv::Mat();
+    return preprocessFace(bgr, bestFace.landmarks);
 }
 
 cv::Mat RetinaFace::preprocessFace(const cv::Mat& img, const cv::Point2f landmarks[5]) {
-    cv::Mat aligned;
-    std::vector<cv::Point2f> src_pts;
-    std::vector<cv::Point2f> dst_pts;
-    for(int i=0; i<5; i++) src_pts.push_back(landmarks[i]);
-    for(int i=0; i<5; i++) dst_pts.push_back(cv::Point2f(REFERENCE_PTS_112[i][0], REFERENCE_PTS_112[i][1]));
-
-    cv::Mat M = cv::estimateAffinePartial2D(src_pts, dst_pts);
-    if(!M.empty()) {
-        cv::warpAffine(img, aligned, M, cv::Size(112, 112));
-    }
-    return aligned;
-}
\ No newline at end of file
+    // Umeyama 闭式解 (不再使用 RANSAC 的 estimateAffinePartial2D)
+    return FaceAligner::warp(img, landmarks);
+}
+
+void RetinaFace::preprocessFace(const cv::Mat& img, const cv::Point2f landmarks[5], cv::Mat& out) {
+    FaceAligner::warp(img, landmarks, out);
+}
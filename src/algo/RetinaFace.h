@@ -3,53 +3,157 @@
 
 #include <string>
 #include <vector>
-#include <opencv2/opencv.hpp>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
 #include "rknn_api.h"
 #include "im2d.hpp"
 #include "rga.h"
+#include "algo/NpuScheduler.h"
+#include "algo/RknnIoMem.h"
+#include "algo/RetinaFacePriors.h"
+#include "algo/FaceInfo.h"
+#include "algo/FaceNms.h"
+#include "algo/FaceAligner.h"
+#include "common/MappedFile.h"
+#include "common/FrameArena.h"
 #include "device/CameraManager.h"
 
-// 定义检测结果结构体
-struct FaceInfo {
-    cv::Rect box;           // 人脸框
-    float score;            // 置信度
-    cv::Point2f landmarks[5]; // 5个关键点 (左眼, 右眼, 鼻, 左嘴, 右嘴)
-};
-
+/**
+ * 输入尺寸在 init 时从模型的输入属性读取，Anchor 表按该尺寸生成，
+ * 因此同一份代码可以加载 320 / 480 / 640 等不同分辨率导出的 .rknn。
+ * 可以同时加载多个分辨率，由 ResolutionPolicy 在运行时切换：
+ * 每个分辨率各有一个上下文池，切换只是改变后续 detect() 使用的模型，不重新加载。
+ */
 class RetinaFace {
 public:
+    // 模型输入的归一化坐标 -> 原图坐标：x = nx * scale_x + off_x (letterbox 与 ROI 偏移都折算在内)
+    struct InputMapping {
+        float scale_x = 1.0f, scale_y = 1.0f;
+        float off_x = 0.0f, off_y = 0.0f;
+    };
+
+    // 分辨率切换策略 (只加载了一个模型时无效)
+    enum ResolutionPolicy {
+        RESOLUTION_FIXED,       // 固定使用 setVariant() 指定的模型
+        RESOLUTION_LOAD,        // 按实测检测耗时：超过预算降一级，按面积估算升一级后仍有余量则升级
+        RESOLUTION_FACE_SIZE,   // 按 reportFaceSize() 反馈的最小人脸：在模型输入中太小升一级，足够大降一级
+    };
+
     RetinaFace(const std::string& modelPath);
+    // 加载多个分辨率的模型，init 后按输入尺寸从小到大排列；文件不存在的模型被跳过
+    explicit RetinaFace(const std::vector<std::string>& modelPaths);
     ~RetinaFace();
 
-    // 初始化模型（加载RKNN等）
+    // 初始化模型（加载RKNN等）；多个分辨率并行初始化，可在后台线程调用 (完成前不能 detect)
     int init();
 
+    // 已初始化的模型数 / 当前使用的模型下标 (按输入尺寸从小到大)
+    int variantCount() const { return (int)models.size(); }
+    int currentVariant() const { return active; }
+    void setVariant(int index);
+    // 当前模型的输入尺寸
+    cv::Size inputSize() const;
+
+    // 设置切换策略，budget_ms 为 RESOLUTION_LOAD 下单次检测的耗时预算
+    void setResolutionPolicy(ResolutionPolicy policy, float budget_ms = 33.0f);
+    // 反馈最近一次检测到的最小人脸边长 (原图像素) 与原图尺寸，供 RESOLUTION_FACE_SIZE 使用
+    void reportFaceSize(int min_side, int frame_w, int frame_h);
+
+    // 是否使用常驻 NPU 输入输出张量 (rknn_create_mem)，需在 init() 之前设置，默认开启
+    // 开启后 RGA 直接写入输入张量，后处理直接读取量化输出；绑定失败时自动回退
+    void setIoMemEnabled(bool enable) { use_io_mem = enable; }
+
     // 核心业务函数：从相机获取帧 -> 检测 -> 对齐 -> 返回112x112人脸
     // 如果没检测到人脸，返回空的 cv::Mat
     cv::Mat getAlignedFaceFromCamera(CameraManager& camera);
 
-private:
-    // RKNN 上下文
-    rknn_context ctx;
-    unsigned char* model_data;
-    int model_data_size;
-    rknn_input_output_num io_num;
-    rknn_tensor_attr* input_attrs;
-    rknn_tensor_attr* output_attrs;
-
-    // 模型输入尺寸
-    const int MODEL_WIDTH = 320;
-    const int MODEL_HEIGHT = 320;
-
-    // 存储预计算的 Anchor (cx, cy, w, h)
-    // 对应官方代码里的 BOX_PRIORS_320
-    std::vector<std::vector<float>> priors; 
-
+    // 单独的检测 / 对齐步骤，供 RecognitionPipeline 分阶段调用
     int detect(const cv::Mat& inputImg, std::vector<FaceInfo>& faces);
+    // 直接对摄像头帧检测：V4L2 帧以 DMA-BUF fd 交给 RGA，不经过 CPU
+    int detect(const CameraFrame& frame, std::vector<FaceInfo>& faces);
+    // 只检测 roi 区域：RGA 把 roi 裁剪并缩放到同一个 320x320 输入，小脸在模型输入中被放大
+    // 结果换算回原图坐标后追加到 faces
+    int detect(const CameraFrame& frame, const cv::Rect& roi, std::vector<FaceInfo>& faces);
+    // 在上一次的人脸框附近检测 (两次整帧检测之间使用)：
+    // 每个框扩展为正方形 ROI，重叠的 ROI 合并，逐个检测后去重；
+    // ROI 太多或总面积接近整帧时退化为整帧检测
+    // arena 非空时 ROI 列表从调用方的每帧临时内存中分配 (流水线检测线程)
+    int detectAround(const CameraFrame& frame, const std::vector<cv::Rect>& boxes,
+                     std::vector<FaceInfo>& faces, FrameArena* arena = nullptr);
+    // 根据 5 个关键点做相似变换，输出 112x112 对齐人脸 (纯 CPU，不访问 RKNN 上下文)
+    // 需要直接写入 NPU 输入张量时使用 MobileFaceNet::extractFeatures(frame, faces)
     cv::Mat preprocessFace(const cv::Mat& img, const cv::Point2f landmarks[5]);
-    
-    // 初始化 Anchors
-    void initPriors();
+    // 同上，写入调用方复用的 out (例如从 BufferPool 取出的 Mat)
+    void preprocessFace(const cv::Mat& img, const cv::Point2f landmarks[5], cv::Mat& out);
+
+private:
+    // 每个检测上下文私有的解码缓冲区，init 时按 anchor 数预分配，下标与 pool 一致
+    struct DecodeScratch {
+        std::vector<int> candidates;    // 通过置信度阈值的 anchor 下标
+        FaceNms nms;                    // 解码后的候选框缓冲区 + NMS
+        std::vector<rknn_output> outputs;   // 普通路径的 rknn_outputs_get 描述符 (每个输出一项)
+    };
+
+    // 一个分辨率的模型及其运行时资源
+    struct Model {
+        std::string path;
+        MappedFile file;                // 只在 init 之前持有，rknn_init 后释放
+        // RKNN 上下文池 (高优先级，多核平台独占核心 0)
+        NpuContextPool pool;
+        // 每个上下文一组常驻输入输出张量，下标与 pool 的上下文下标一致；为空表示未启用
+        std::vector<std::unique_ptr<RknnIoMem>> io_mems;
+        rknn_input_output_num io_num;
+        std::vector<rknn_tensor_attr> input_attrs;
+        std::vector<rknn_tensor_attr> output_attrs;
+        // 模型输入尺寸 (来自 input_attrs)
+        int width = 0;
+        int height = 0;
+        // Anchor 表 (SoA: cx[] / cy[] / w[] / h[])：320x320 使用编译期表，其他尺寸运行期生成
+        RetinaFacePriors priors;
+        RetinaFacePriorBuffer prior_buf;
+        std::vector<DecodeScratch> scratch;
+        // 每个上下文的输入缓冲区上次写入的 letterbox 内容区 (填充区只在布局变化时重写)
+        std::vector<im_rect> content_rects;
+        // 普通路径 (未启用常驻张量) 的输入缓冲区
+        std::vector<cv::Mat> host_inputs;
+        float avg_ms = 0;               // 检测耗时的指数滑动平均，0 表示尚未测量
+    };
+
+    std::vector<std::unique_ptr<Model>> models;
+    std::atomic<int> active;
+    bool use_io_mem = true;
+
+    // 切换策略状态 (检测线程与 reportFaceSize 调用方共享)
+    std::mutex policy_mutex;
+    ResolutionPolicy policy = RESOLUTION_FIXED;
+    float budget_ms = 33.0f;
+    int since_switch = 0;               // 距上次切换的检测次数 (冷却，避免来回抖动)
+
+    // 映射模型文件 (只建立映射并发起预读，init 时才真正读取)
+    void loadModel(const std::string& path);
+    // 初始化单个模型：上下文池、输入输出属性、常驻张量、Anchor 表、解码缓冲区
+    int initModel(Model& m);
+    // 用指定模型检测原图中的 area 区域 (已对齐、已裁到画面内)
+    // run_ms 返回 rknn_run 本身的耗时 (不含等待上下文、缩放与解码)，供负载策略使用
+    int runModel(Model& m, const CameraFrame& frame, const cv::Rect& area, std::vector<FaceInfo>& faces,
+                 float* run_ms);
+    // RGA 把 area 等比缩放进输入缓冲区 dst (letterbox)，map 返回解码用的坐标映射
+    int letterboxInto(Model& m, int index, const rga_buffer_t& src, rga_buffer_t& dst,
+                      const cv::Rect& area, InputMapping& map);
+    // 记录模型 m 的一次推理耗时，并按 RESOLUTION_LOAD 策略切换
+    void updateLoad(Model& m, float elapsed_ms);
+    void switchTo(int index, const char* reason);
+
+    // 上一次人脸框 -> 检测 ROI (正方形、偶数对齐、裁到画面内、重叠合并)
+    // rois 至少 boxes.size() 个元素，返回 ROI 个数
+    static int makeRois(const std::vector<cv::Rect>& boxes, int img_w, int img_h, cv::Rect* rois);
+
+    // 解码三路输出 (Loc, Conf, Landm) 并做 NMS，结果追加到 faces
+    static void decodeOutputs(const RknnTensorView outs[3], const RetinaFacePriors& priors,
+                              const InputMapping& map, DecodeScratch& buf, std::vector<FaceInfo>& faces);
 };
 
 #endif // RETINAFACE_H
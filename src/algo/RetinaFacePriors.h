@@ -0,0 +1,93 @@
+#ifndef RETINAFACEPRIORS_H
+#define RETINAFACEPRIORS_H
+
+#include <vector>
+
+/**
+ * @brief RetinaFace 的 Anchor 表 (结构数组 SoA，编译期生成)
+ *
+ * 常用的 320x320 在编译期生成，其他输入尺寸 (480 / 640 等) 由 RetinaFacePriorBuffer 在运行期生成，
+ * 两者使用同一个生成函数，数值完全一致。
+ * 配置与官方 BOX_PRIORS 一致：
+ *   Strides:  8, 16, 32
+ *   MinSizes: [16,32], [64,128], [256,512]
+ * 顺序为 层级 -> 行 -> 列 -> min_size，与模型输出的 anchor 顺序一一对应。
+ * cx / cy / w / h 分别连续存放，解码时可以直接向量化加载。
+ */
+
+// 只读视图，供解码时使用
+struct RetinaFacePriors {
+    const float* cx;
+    const float* cy;
+    const float* w;
+    const float* h;
+    int count;
+};
+
+constexpr int retinaFacePriorCount(int width, int height) {
+    return ((width + 7) / 8) * ((height + 7) / 8) * 2
+         + ((width + 15) / 16) * ((height + 15) / 16) * 2
+         + ((width + 31) / 32) * ((height + 31) / 32) * 2;
+}
+
+// 按 width x height 生成 anchor，写入 cx / cy / w / h (长度至少为 retinaFacePriorCount)
+constexpr void fillRetinaFacePriors(int width, int height, float* cx, float* cy, float* w, float* h) {
+    const int strides[3] = {8, 16, 32};
+    const float min_sizes[3][2] = {{16.0f, 32.0f}, {64.0f, 128.0f}, {256.0f, 512.0f}};
+
+    int n = 0;
+    for (int k = 0; k < 3; k++) {
+        int stride = strides[k];
+        int feature_w = (width + stride - 1) / stride;
+        int feature_h = (height + stride - 1) / stride;
+        for (int i = 0; i < feature_h; i++) {
+            for (int j = 0; j < feature_w; j++) {
+                for (int m = 0; m < 2; m++) {
+                    cx[n] = (j + 0.5f) * stride / width;
+                    cy[n] = (i + 0.5f) * stride / height;
+                    w[n] = min_sizes[k][m] / width;
+                    h[n] = min_sizes[k][m] / height;
+                    n++;
+                }
+            }
+        }
+    }
+}
+
+template <int W, int H>
+struct RetinaFacePriorTable {
+    static constexpr int count = retinaFacePriorCount(W, H);
+    float cx[count] = {};
+    float cy[count] = {};
+    float w[count] = {};
+    float h[count] = {};
+
+    RetinaFacePriors view() const { return RetinaFacePriors{cx, cy, w, h, count}; }
+};
+
+template <int W, int H>
+constexpr RetinaFacePriorTable<W, H> makeRetinaFacePriors() {
+    RetinaFacePriorTable<W, H> table;
+    fillRetinaFacePriors(W, H, table.cx, table.cy, table.w, table.h);
+    return table;
+}
+
+// 运行期生成的 Anchor 表 (任意输入尺寸)
+struct RetinaFacePriorBuffer {
+    std::vector<float> cx, cy, w, h;
+
+    void generate(int width, int height) {
+        int count = retinaFacePriorCount(width, height);
+        cx.assign(count, 0.0f);
+        cy.assign(count, 0.0f);
+        w.assign(count, 0.0f);
+        h.assign(count, 0.0f);
+        fillRetinaFacePriors(width, height, cx.data(), cy.data(), w.data(), h.data());
+    }
+
+    RetinaFacePriors view() const {
+        return RetinaFacePriors{cx.data(), cy.data(), w.data(), h.data(), (int)cx.size()};
+    }
+};
+
+#endif // RETINAFACEPRIORS_H
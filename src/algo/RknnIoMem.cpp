@@ -0,0 +1,115 @@
+#include "RknnIoMem.h"
+#include <stdio.h>
+#include <string.h>
+
+RknnIoMem::RknnIoMem() : m_ctx(0)
+{
+}
+
+RknnIoMem::~RknnIoMem()
+{
+    release();
+}
+
+int RknnIoMem::init(rknn_context ctx, const rknn_input_output_num& io_num)
+{
+    release();
+    m_ctx = ctx;
+
+    m_inputAttrs.resize(io_num.n_input);
+    m_inputs.assign(io_num.n_input, nullptr);
+    for (uint32_t i = 0; i < io_num.n_input; i++) {
+        rknn_tensor_attr& attr = m_inputAttrs[i];
+        memset(&attr, 0, sizeof(attr));
+        attr.index = i;
+        if (rknn_query(ctx, RKNN_QUERY_NATIVE_INPUT_ATTR, &attr, sizeof(attr)) < 0) {
+            printf("[RknnIoMem] query native input %u failed\n", i);
+            release();
+            return -1;
+        }
+        // 由运行时完成归一化 / 量化，输入只需是 UINT8 NHWC 像素
+        attr.type = RKNN_TENSOR_UINT8;
+        attr.fmt = RKNN_TENSOR_NHWC;
+        attr.pass_through = 0;
+
+        uint32_t size = attr.size_with_stride ? attr.size_with_stride : attr.size;
+        m_inputs[i] = rknn_create_mem(ctx, size);
+        if (!m_inputs[i] || rknn_set_io_mem(ctx, m_inputs[i], &attr) < 0) {
+            printf("[RknnIoMem] bind input %u failed\n", i);
+            release();
+            return -1;
+        }
+    }
+
+    m_outputAttrs.resize(io_num.n_output);
+    m_outputs.assign(io_num.n_output, nullptr);
+    for (uint32_t i = 0; i < io_num.n_output; i++) {
+        rknn_tensor_attr& attr = m_outputAttrs[i];
+        memset(&attr, 0, sizeof(attr));
+        attr.index = i;
+        // NHWC 原生布局：对非 4 维输出 (RetinaFace / MobileFaceNet) 与普通布局一致
+        if (rknn_query(ctx, RKNN_QUERY_NATIVE_NHWC_OUTPUT_ATTR, &attr, sizeof(attr)) < 0) {
+            printf("[RknnIoMem] query native output %u failed\n", i);
+            release();
+            return -1;
+        }
+
+        uint32_t size;
+        if (attr.type == RKNN_TENSOR_INT8 || attr.type == RKNN_TENSOR_UINT8) {
+            size = attr.n_elems;
+        } else {
+            attr.type = RKNN_TENSOR_FLOAT32;
+            size = attr.n_elems * sizeof(float);
+        }
+        attr.pass_through = 0;
+
+        m_outputs[i] = rknn_create_mem(ctx, size);
+        if (!m_outputs[i] || rknn_set_io_mem(ctx, m_outputs[i], &attr) < 0) {
+            printf("[RknnIoMem] bind output %u failed\n", i);
+            release();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void RknnIoMem::release()
+{
+    if (m_ctx) {
+        for (rknn_tensor_mem* mem : m_inputs) if (mem) rknn_destroy_mem(m_ctx, mem);
+        for (rknn_tensor_mem* mem : m_outputs) if (mem) rknn_destroy_mem(m_ctx, mem);
+    }
+    m_inputs.clear();
+    m_outputs.clear();
+    m_inputAttrs.clear();
+    m_outputAttrs.clear();
+    m_ctx = 0;
+}
+
+int RknnIoMem::inputWidthStride(int i) const
+{
+    const rknn_tensor_attr& attr = m_inputAttrs[i];
+    if (attr.w_stride) return (int)attr.w_stride;
+    // NHWC: dims = [N, H, W, C]
+    return (int)attr.dims[2];
+}
+
+RknnTensorView RknnIoMem::outputView(int i) const
+{
+    RknnTensorView view;
+    view.data = m_outputs[i]->virt_addr;
+    view.type = m_outputAttrs[i].type;
+    view.zp = m_outputAttrs[i].zp;
+    view.scale = m_outputAttrs[i].scale;
+    return view;
+}
+
+void RknnIoMem::syncInputs()
+{
+    for (rknn_tensor_mem* mem : m_inputs) rknn_mem_sync(m_ctx, mem, RKNN_MEMORY_SYNC_TO_DEVICE);
+}
+
+void RknnIoMem::syncOutputs()
+{
+    for (rknn_tensor_mem* mem : m_outputs) rknn_mem_sync(m_ctx, mem, RKNN_MEMORY_SYNC_FROM_DEVICE);
+}
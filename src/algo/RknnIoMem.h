@@ -0,0 +1,75 @@
+#ifndef RKNNIOMEM_H
+#define RKNNIOMEM_H
+
+#include <vector>
+#include <cstdint>
+#include "rknn_api.h"
+
+/**
+ * @brief 输出张量的只读视图
+ *
+ * 统一 want_float 输出 (FLOAT32) 与原生量化输出 (INT8/UINT8) 的读取方式，
+ * 量化类型在 at() 中按 zp / scale 反量化，只有真正用到的元素才会被转换。
+ */
+struct RknnTensorView {
+    const void* data = nullptr;
+    rknn_tensor_type type = RKNN_TENSOR_FLOAT32;
+    int32_t zp = 0;
+    float scale = 1.0f;
+
+    float at(int i) const {
+        switch (type) {
+        case RKNN_TENSOR_INT8:  return ((float)((const int8_t*)data)[i] - zp) * scale;
+        case RKNN_TENSOR_UINT8: return ((float)((const uint8_t*)data)[i] - zp) * scale;
+        default:                return ((const float*)data)[i];
+        }
+    }
+};
+
+/**
+ * @brief 单个 RKNN 上下文的常驻输入 / 输出张量 (rknn_create_mem + rknn_set_io_mem)
+ *
+ * init() 时按原生属性一次性分配 NPU 可见的 DMA 内存并绑定到上下文：
+ *   - 输入：UINT8 NHWC，RGA 可以直接以 fd 写入，省掉 rknn_inputs_set 的拷贝
+ *   - 输出：保留原生量化类型 (INT8/UINT8)，后处理通过 RknnTensorView 按需反量化；
+ *     原生类型为浮点时让运行时转换为 FLOAT32
+ * 之后每次推理只需 rknn_run，不再有 rknn_outputs_get 的分配与整表反量化。
+ * 每个上下文各需一个实例，且必须在上下文销毁前 release()。
+ */
+class RknnIoMem {
+public:
+    RknnIoMem();
+    ~RknnIoMem();
+
+    RknnIoMem(const RknnIoMem&) = delete;
+    RknnIoMem& operator=(const RknnIoMem&) = delete;
+
+    // 分配并绑定所有输入输出张量，失败返回 -1 (调用方应回退到 rknn_inputs_set 路径)
+    int init(rknn_context ctx, const rknn_input_output_num& io_num);
+    void release();
+    bool valid() const { return m_ctx != 0; }
+
+    rknn_tensor_mem* input(int i) const { return m_inputs[i]; }
+    const rknn_tensor_attr& inputAttr(int i) const { return m_inputAttrs[i]; }
+    rknn_tensor_mem* output(int i) const { return m_outputs[i]; }
+    const rknn_tensor_attr& outputAttr(int i) const { return m_outputAttrs[i]; }
+
+    // 输入每行的像素跨度 (w_stride 为 0 时等于宽度)
+    int inputWidthStride(int i) const;
+    // 输出张量视图 (调用前先 syncOutputs)
+    RknnTensorView outputView(int i) const;
+
+    // CPU 写完输入后刷到设备 (RGA 写入时不需要)
+    void syncInputs();
+    // rknn_run 之后、CPU 读取输出之前调用
+    void syncOutputs();
+
+private:
+    rknn_context m_ctx;
+    std::vector<rknn_tensor_attr> m_inputAttrs;
+    std::vector<rknn_tensor_attr> m_outputAttrs;
+    std::vector<rknn_tensor_mem*> m_inputs;
+    std::vector<rknn_tensor_mem*> m_outputs;
+};
+
+#endif // RKNNIOMEM_H
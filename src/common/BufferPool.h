@@ -0,0 +1,59 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief 可复用缓冲区池 (特征向量、cv::Mat 等自带堆内存的对象)
+ *
+ * acquire() 取出一个已归还的对象，它保留着上次的容量 (vector 的 capacity、Mat 的像素缓冲区)，
+ * 按相同尺寸重新填充时不会再申请内存；release() 把用完的对象放回池中。
+ * 池中最多保留 max_free 个对象，空闲表在构造时一次性分配，之后的取还不产生堆分配。
+ * 线程安全：可以由一个线程取出、另一个线程归还 (例如流水线的特征阶段与比对阶段)。
+ */
+template <typename T>
+class BufferPool {
+public:
+    explicit BufferPool(size_t max_free = 16) : m_maxFree(max_free ? max_free : 1), m_misses(0) {
+        m_free.reserve(m_maxFree);
+    }
+
+    // 取出一个对象；池空时返回默认构造的新对象 (记入 misses)
+    T acquire() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free.empty()) {
+            m_misses++;
+            return T();
+        }
+        T item = std::move(m_free.back());
+        m_free.pop_back();
+        return item;
+    }
+
+    // 归还一个对象，池已满时直接释放
+    void release(T&& item) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_free.size() < m_maxFree) m_free.push_back(std::move(item));
+    }
+
+    size_t freeCount() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_free.size();
+    }
+
+    // 池空时新建对象的次数 (预热后不再增长)
+    uint64_t misses() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_misses;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<T> m_free;
+    size_t m_maxFree;
+    uint64_t m_misses;
+};
+
+#endif // BUFFERPOOL_H
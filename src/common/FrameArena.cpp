@@ -0,0 +1,66 @@
+#include "FrameArena.h"
+#include <cstdlib>
+
+static const size_t BLOCK_ALIGN = 64;       // 常驻块按缓存行对齐
+
+static void* alignedAlloc(size_t bytes, size_t align)
+{
+    void* p = nullptr;
+    if (align < sizeof(void*)) align = sizeof(void*);
+    if (posix_memalign(&p, align, bytes ? bytes : 1) != 0) return nullptr;
+    return p;
+}
+
+FrameArena::FrameArena(size_t capacity)
+    : m_base(nullptr), m_capacity(0), m_used(0), m_spillBytes(0), m_highWater(0), m_overflows(0)
+{
+    if (capacity > 0) {
+        m_base = static_cast<unsigned char*>(alignedAlloc(capacity, BLOCK_ALIGN));
+        if (m_base) m_capacity = capacity;
+    }
+}
+
+FrameArena::~FrameArena()
+{
+    for (void* p : m_spills) free(p);
+    free(m_base);
+}
+
+void* FrameArena::allocBytes(size_t bytes, size_t align)
+{
+    size_t offset = (m_used + align - 1) & ~(align - 1);
+    if (m_base && offset + bytes <= m_capacity) {
+        m_used = offset + bytes;
+        if (m_used + m_spillBytes > m_highWater) m_highWater = m_used + m_spillBytes;
+        return m_base + offset;
+    }
+
+    // 常驻块不够：本帧临时向堆申请，reset 时按高水位扩容
+    void* p = alignedAlloc(bytes, align);
+    if (!p) return nullptr;
+    m_spills.push_back(p);
+    m_spillBytes += bytes + align;
+    m_overflows++;
+    if (m_capacity + m_spillBytes > m_highWater) m_highWater = m_capacity + m_spillBytes;
+    return p;
+}
+
+void FrameArena::reset()
+{
+    for (void* p : m_spills) free(p);
+    m_spills.clear();
+    m_used = 0;
+
+    if (m_spillBytes > 0) {
+        // 留 25% 余量，避免用量小幅波动时反复扩容
+        size_t capacity = m_highWater + m_highWater / 4;
+        capacity = (capacity + 4095) & ~(size_t)4095;
+        unsigned char* base = static_cast<unsigned char*>(alignedAlloc(capacity, BLOCK_ALIGN));
+        if (base) {
+            free(m_base);
+            m_base = base;
+            m_capacity = capacity;
+        }
+        m_spillBytes = 0;
+    }
+}
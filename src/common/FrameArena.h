@@ -0,0 +1,74 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief 每帧临时内存 (bump allocator)
+ *
+ * 一帧内的临时数组 (ROI 列表、查询向量、倒排表行号、候选打分等) 从一块常驻内存中顺序切出，
+ * 帧结束时 reset() 整体回收，不逐个释放。
+ * 本帧用量超过容量时临时向堆申请 (记入 overflows())，下一次 reset() 按高水位扩容，
+ * 预热几帧之后稳定状态下不再有堆分配，长时间运行也不会产生碎片。
+ * 只适用于无需析构的简单类型 (不调用构造 / 析构，取出后直接赋值)。
+ * 非线程安全：每个工作线程 (或持有锁的对象) 各持有一个实例。
+ */
+class FrameArena {
+public:
+    static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    // capacity 为 0 时首次使用才分配 (全部来自溢出，reset 后按用量建立常驻块)
+    explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+    ~FrameArena();
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // n 个未初始化的 T，按 alignof(T) 对齐 (至少 16 字节，便于 NEON 加载)
+    template <typename T>
+    T* alloc(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+        return static_cast<T*>(allocBytes(n * sizeof(T), alignof(T) > 16 ? alignof(T) : 16));
+    }
+    void* allocBytes(size_t bytes, size_t align);
+
+    // 帧开始时调用：回收本帧的全部内存，上一帧溢出时扩容到高水位
+    void reset();
+
+    // 嵌套使用 (同一帧内多次调用的函数)：记住当前位置，用完回退
+    size_t mark() const { return m_used; }
+    void rewind(size_t mark) { if (mark <= m_used) m_used = mark; }
+
+    size_t capacity() const { return m_capacity; }
+    size_t used() const { return m_used; }
+    // 单帧最大用量 (含溢出部分)
+    size_t highWater() const { return m_highWater; }
+    // 累计溢出到堆的次数 (稳定状态下不再增长)
+    uint64_t overflows() const { return m_overflows; }
+
+    // 作用域内的分配在离开时回退
+    class Scope {
+    public:
+        explicit Scope(FrameArena& arena) : m_arena(arena), m_mark(arena.mark()) {}
+        ~Scope() { m_arena.rewind(m_mark); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        FrameArena& m_arena;
+        size_t m_mark;
+    };
+
+private:
+    unsigned char* m_base;
+    size_t m_capacity;
+    size_t m_used;
+    size_t m_spillBytes;                // 本帧溢出部分的字节数
+    size_t m_highWater;
+    uint64_t m_overflows;
+    std::vector<void*> m_spills;        // 本帧溢出的堆块，reset 时释放
+};
+
+#endif // FRAMEARENA_H
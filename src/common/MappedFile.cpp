@@ -0,0 +1,51 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+
+MappedFile::MappedFile() : m_data(nullptr), m_size(0) {}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+int MappedFile::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "[MappedFile] Cannot open " << path << std::endl;
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        std::cerr << "[MappedFile] Empty or unreadable file: " << path << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // 映射建立后 fd 不再需要
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "[MappedFile] mmap failed: " << path << std::endl;
+        return -1;
+    }
+
+    // rknn_init 顺序读取整个模型：提前让内核开始预读
+    madvise(data, (size_t)st.st_size, MADV_WILLNEED);
+    m_data = data;
+    m_size = (size_t)st.st_size;
+    return 0;
+}
+
+void MappedFile::close()
+{
+    if (m_data) munmap(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief 只读映射一个文件 (mmap)，用于把 .rknn 模型交给 rknn_init
+ *
+ * 与读入堆缓冲区相比，不需要先分配一份与模型同样大的内存再拷贝：
+ * 页面直接来自页缓存，open() 时发起异步预读 (MADV_WILLNEED)，
+ * 多个模型先全部 open() 再逐个 init，磁盘读取与 rknn_init 重叠。
+ * 映射为 MAP_PRIVATE 可写 (写时复制)，rknn_init 的非 const 参数即使被写也不会改到文件。
+ * rknn_init 返回后模型已拷贝进 NPU 内存，可以立即 close() 释放映射。
+ */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // 映射整个文件，成功返回0 (空文件视为失败)
+    int open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    void* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    void* m_data;
+    size_t m_size;
+};
+
+#endif // MAPPEDFILE_H
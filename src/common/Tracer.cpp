@@ -0,0 +1,149 @@
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+static const char* STAGE_NAMES[Tracer::STAGE_COUNT] = {
+    "capture", "preview", "detect", "det.resize", "det.rknn_run", "det.output",
+    "det.decode", "det.nms", "quality", "align", "embed", "db.search", "npu.detect", "npu.embed"
+};
+
+Tracer& Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::Tracer() : m_enabled(true), m_head(0), m_originUs(nowUs())
+{
+    for (Histogram& h : m_hist) {
+        for (auto& b : h.buckets) b.store(0, std::memory_order_relaxed);
+    }
+}
+
+int64_t Tracer::nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* Tracer::stageName(Stage stage)
+{
+    return stage >= 0 && stage < STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+// 0~3us 各占一桶；之后每个 2 的幂 [2^e, 2^(e+1)) 按高 2 位分成 4 桶
+int Tracer::bucketOf(int64_t us)
+{
+    if (us < 4) return us < 0 ? 0 : (int)us;
+    int e = 63 - __builtin_clzll((unsigned long long)us);
+    int index = (e - 1) * 4 + (int)((us >> (e - 2)) & 3);
+    return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+}
+
+int64_t Tracer::bucketUpperUs(int index)
+{
+    if (index < 4) return index + 1;
+    int e = index / 4 + 1, sub = index % 4;
+    return (int64_t)(4 + sub + 1) << (e - 2);
+}
+
+int Tracer::threadIndex()
+{
+    // Chrome trace 的 tid：按线程第一次记录的顺序编号，比系统 tid 更好读
+    static std::atomic<int> next{1};
+    static thread_local int index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+void Tracer::record(Stage stage, int64_t begin_us, int64_t end_us)
+{
+    if (!enabled() || stage < 0 || stage >= STAGE_COUNT) return;
+    int64_t dur = end_us > begin_us ? end_us - begin_us : 0;
+
+    Histogram& h = m_hist[stage];
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.total_us.fetch_add((uint64_t)dur, std::memory_order_relaxed);
+    h.buckets[bucketOf(dur)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t n = m_head.fetch_add(1, std::memory_order_relaxed);
+    Event& e = m_ring[n & (RING_SIZE - 1)];
+    e.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.begin_us.store(begin_us, std::memory_order_relaxed);
+    e.dur_us.store((int32_t)std::min<int64_t>(dur, INT32_MAX), std::memory_order_relaxed);
+    e.stage.store((int16_t)stage, std::memory_order_relaxed);
+    e.tid.store((int16_t)threadIndex(), std::memory_order_relaxed);
+    e.seq.store(n + 1, std::memory_order_release);
+}
+
+void Tracer::snapshot(StageStats* out) const
+{
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        const Histogram& h = m_hist[s];
+        out[s].count = h.count.load(std::memory_order_relaxed);
+        out[s].total_us = h.total_us.load(std::memory_order_relaxed);
+        for (int b = 0; b < BUCKET_COUNT; b++) {
+            out[s].buckets[b] = h.buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+double Tracer::StageStats::percentileMs(double q) const
+{
+    uint64_t total = 0;
+    for (uint32_t c : buckets) total += c;
+    if (total == 0) return 0.0;
+
+    uint64_t target = (uint64_t)(q * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKET_COUNT; b++) {
+        seen += buckets[b];
+        if (seen >= target) return bucketUpperUs(b) / 1000.0;
+    }
+    return bucketUpperUs(BUCKET_COUNT - 1) / 1000.0;
+}
+
+Tracer::StageStats Tracer::StageStats::since(const StageStats& earlier) const
+{
+    StageStats d;
+    d.count = count - earlier.count;
+    d.total_us = total_us - earlier.total_us;
+    for (int b = 0; b < BUCKET_COUNT; b++) d.buckets[b] = buckets[b] - earlier.buckets[b];
+    return d;
+}
+
+int Tracer::exportChromeTrace(const std::string& path) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        std::cerr << "[Tracer] Cannot open " << path << std::endl;
+        return -1;
+    }
+
+    // 只读取仍在环形缓冲区中的最近 RING_SIZE 个事件；写到一半或已被覆盖的跳过
+    uint64_t head = m_head.load(std::memory_order_acquire);
+    uint64_t first = head > (uint64_t)RING_SIZE ? head - RING_SIZE : 0;
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool comma = false;
+    for (uint64_t n = first; n < head; n++) {
+        const Event& e = m_ring[n & (RING_SIZE - 1)];
+        uint64_t seq = e.seq.load(std::memory_order_acquire);
+        int64_t begin = e.begin_us.load(std::memory_order_relaxed);
+        int32_t dur = e.dur_us.load(std::memory_order_relaxed);
+        int stage = e.stage.load(std::memory_order_relaxed);
+        int tid = e.tid.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq != n + 1 || e.seq.load(std::memory_order_relaxed) != seq) continue;
+
+        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%d}",
+                comma ? ",\n" : "", stageName((Stage)stage), tid, (long long)(begin - m_originUs), dur);
+        comma = true;
+    }
+    fprintf(fp, "\n]}\n");
+
+    bool ok = fclose(fp) == 0;
+    if (!ok) std::cerr << "[Tracer] Failed to write " << path << std::endl;
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,128 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief 流水线各阶段的耗时统计与事件记录 (低开销，可在任意线程调用)
+ *
+ * 每次记录只做几次原子操作，不加锁、不分配内存：
+ *   - 每个阶段一个对数分桶直方图 (每个 2 的幂分 4 桶，精度约 19%)，用于均值 / 分位数
+ *   - 所有事件写入固定大小的无锁环形缓冲区 (覆盖最旧的)，可导出为 Chrome trace JSON，
+ *     用 chrome://tracing 或 ui.perfetto.dev 打开查看每帧的时间线
+ * 阶段用 TraceScope 包住即可；setEnabled(false) 后记录点只剩一次原子读。
+ */
+class Tracer {
+public:
+    enum Stage {
+        STAGE_CAPTURE = 0,  // 采集：驱动交出一帧到发布 (含 MJPG 解码)
+        STAGE_PREVIEW,      // 预览图 RGA 缩放 + 颜色转换
+        STAGE_DETECT,       // 一次检测 (整帧或 ROI) 的总耗时
+        STAGE_RESIZE,       // 检测输入 letterbox (RGA)
+        STAGE_DET_RUN,      // 检测 rknn_run (CPU 侧等待时间)
+        STAGE_DET_OUTPUT,   // 检测输出获取 (rknn_outputs_get / 缓存同步)
+        STAGE_DECODE,       // 置信度扫描 + 框 / 关键点解码
+        STAGE_NMS,
+        STAGE_QUALITY,      // 人脸质量评估 (姿态 + RGA 灰度小图的清晰度 / 亮度)
+        STAGE_ALIGN,        // 人脸对齐 (RGA / warpAffine) 与输入打包
+        STAGE_EMBED,        // 特征提取推理 (rknn_run + 输出 + 归一化，按 batch)
+        STAGE_DB_SEARCH,    // 特征库检索
+        STAGE_NPU_DETECT,   // 检测在 NPU 上的实际执行时间 (RKNN_QUERY_PERF_RUN)
+        STAGE_NPU_EMBED,    // 特征提取在 NPU 上的实际执行时间
+        STAGE_COUNT
+    };
+
+    static const int BUCKET_COUNT = 80;     // 覆盖 0 ~ 约 2 秒
+
+    // 一个阶段的直方图快照
+    struct StageStats {
+        uint64_t count = 0;
+        uint64_t total_us = 0;
+        uint32_t buckets[BUCKET_COUNT] = {};
+
+        double meanMs() const { return count ? total_us / 1000.0 / count : 0.0; }
+        // 分位数 (q 取 0~1)，返回所在桶的上界
+        double percentileMs(double q) const;
+        // 两次快照之差，用于显示最近一段时间的统计
+        StageStats since(const StageStats& earlier) const;
+    };
+
+    static Tracer& instance();
+
+    // 单调时钟 (微秒)
+    static int64_t nowUs();
+    static const char* stageName(Stage stage);
+
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    // 记录一次 [begin_us, end_us) 的阶段耗时
+    void record(Stage stage, int64_t begin_us, int64_t end_us);
+
+    // 读取所有阶段的直方图 (out 至少 STAGE_COUNT 个)
+    void snapshot(StageStats* out) const;
+
+    // 把环形缓冲区中的事件写成 Chrome trace JSON，成功返回 0
+    int exportChromeTrace(const std::string& path) const;
+
+private:
+    Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static const int RING_SIZE = 8192;      // 必须是 2 的幂
+
+    struct Histogram {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_us{0};
+        std::atomic<uint32_t> buckets[BUCKET_COUNT];
+    };
+
+    // 环形缓冲区的一个事件；seq 为 0 表示正在写入，读者据此丢弃写了一半的事件
+    struct Event {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<int64_t> begin_us{0};
+        std::atomic<int32_t> dur_us{0};
+        std::atomic<int16_t> stage{0};
+        std::atomic<int16_t> tid{0};
+    };
+
+    std::atomic<bool> m_enabled;
+    Histogram m_hist[STAGE_COUNT];
+    Event m_ring[RING_SIZE];
+    std::atomic<uint64_t> m_head;           // 已写入的事件总数
+    int64_t m_originUs;                     // trace 时间零点
+
+    static int bucketOf(int64_t us);
+    static int64_t bucketUpperUs(int index);
+    static int threadIndex();
+};
+
+/**
+ * @brief 作用域计时：构造时记下开始时间，析构 (或 stop()) 时记录到 Tracer
+ */
+class TraceScope {
+public:
+    explicit TraceScope(Tracer::Stage stage)
+        : m_stage(stage), m_begin(Tracer::instance().enabled() ? Tracer::nowUs() : -1) {}
+    ~TraceScope() { stop(); }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    // 提前结束计时 (同一作用域里还有不想计入的代码时)
+    void stop()
+    {
+        if (m_begin < 0) return;
+        Tracer::instance().record(m_stage, m_begin, Tracer::nowUs());
+        m_begin = -1;
+    }
+
+private:
+    Tracer::Stage m_stage;
+    int64_t m_begin;
+};
+
+#endif // TRACER_H
@@ -3,19 +3,42 @@
  * @brief 人脸特征数据库实现
  *
  * 使用SQLite存储人脸特征向量，通过余弦相似度算法实现人脸录入和识别功能。
- * 主要功能包括：防重复录入、相似度匹配识别、数据库管理等。
+ * 主要功能包括：防重复录入、多模板身份、相似度匹配识别、数据库管理等。
+ * 数据库使用 WAL 日志 + synchronous=NORMAL，常用语句在 init 时预编译并缓存复用。
+ * 内存特征库默认与打开同一数据库的其他进程共享 (<db_path>.gallery)。
  */
 
 #include "FaceDatabase.h"
+#include "common/Tracer.h"
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <cstdio>
+
+/**
+ * @brief 缓存语句的作用域守卫
+ * 离开作用域时 reset 并清除绑定，避免语句长期持有读事务 (阻塞 WAL checkpoint)
+ */
+namespace {
+struct StmtScope {
+    sqlite3_stmt* stmt;
+    explicit StmtScope(sqlite3_stmt* s) : stmt(s) {}
+    ~StmtScope() {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+};
+}
 
 /**
  * @brief 构造函数
  * 初始化数据库指针为空，标记为未初始化状态
  */
 FaceDatabase::FaceDatabase() : db(nullptr), is_init(false) {
+    for (int i = 0; i < STMT_NUM; i++) {
+        stmts[i] = nullptr;
+    }
 }
 
 /**
@@ -23,12 +46,52 @@ FaceDatabase::FaceDatabase() : db(nullptr), is_init(false) {
  * 释放数据库资源，关闭SQLite连接
  */
 FaceDatabase::~FaceDatabase() {
+    saveAnnIndex();     // 保存运行期间增量录入的索引分配
+    finalizeStatements();
     if (db) {
         sqlite3_close(db);  // 关闭数据库连接
         db = nullptr;
     }
 }
 
+/**
+ * @brief 设置内存特征库的存储格式
+ * @param format FP32 / FP16 / INT8
+ * @param rerank_top_k 压缩格式下参与 FP32 精确重排的候选数
+ *
+ * 数据库中始终保存原始 FP32 特征，格式只影响内存中的特征库；默认 INT8 + top-8 重排
+ */
+void FaceDatabase::setGalleryFormat(FeatureGallery::Format format, int rerank_top_k) {
+    if (is_init) {
+        std::cerr << "setGalleryFormat must be called before init()" << std::endl;
+        return;
+    }
+    gallery_format = format;
+    this->rerank_top_k = rerank_top_k;
+}
+
+/**
+ * @brief 设置是否与其他进程共享内存特征库
+ * @param enabled 为 true (默认) 时特征矩阵保存在 <db_path>.gallery 并以只读映射共享，
+ *                主程序、录入工具与识别服务看到同一份数据，启动时文件与数据库一致则不再全表读取
+ */
+void FaceDatabase::setSharedGallery(bool enabled) {
+    if (is_init) {
+        std::cerr << "setSharedGallery must be called before init()" << std::endl;
+        return;
+    }
+    shared_gallery = enabled;
+}
+
+/**
+ * @brief 设置近似检索参数
+ * @param nprobe IVF 每次查询扫描的簇数，越大召回率越高、耗时越长
+ */
+void FaceDatabase::setSearchParams(int nprobe) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ann.setNprobe(nprobe);
+}
+
 /**
  * @brief 初始化数据库
  * @param db_path 数据库文件路径
@@ -49,29 +112,80 @@ int FaceDatabase::init(const std::string& db_path) {
         return -1;
     }
 
+    configureJournal();
+
     // 创建数据表
     ret = createTable();
     if (ret != 0) {
         return -1;
     }
 
+    ret = prepareStatements();
+    if (ret != 0) {
+        return -1;
+    }
+
+    // 加载特征到内存，之后的识别不再查询数据库
+    gallery.setFormat(gallery_format);
+    ret = shared_gallery ? openSharedGallery(db_path + ".gallery") : loadGallery();
+    if (ret != 0) {
+        return -1;
+    }
+
+    // 大规模特征库启用 IVF 近似检索
+    ann_path = db_path + ".ivf";
+    buildAnnIndex();
+
     is_init = true;
     return 0;
 }
 
+/**
+ * @brief 配置日志模式
+ *
+ * 默认的回滚日志 + synchronous=FULL 下每次插入都要多次 fsync，在 eMMC 上代价很高。
+ * WAL + NORMAL 下普通提交只追加日志，checkpoint 时才 fsync；掉电最多丢失最近的提交，
+ * 但数据库不会损坏。设置失败 (例如文件系统不支持共享内存) 时保持默认模式继续运行
+ */
+void FaceDatabase::configureJournal() {
+    const char* sql =
+        "PRAGMA journal_mode=WAL;"
+        "PRAGMA synchronous=NORMAL;";
+
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::cerr << "Failed to configure journal: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+    }
+}
+
 /**
  * @brief 创建人脸特征表
  * @return 成功返回0，失败返回-1
  *
  * 表结构：
+ *   faces (身份)
  *   - id: INTEGER 自增主键，唯一标识每个人脸
- *   - feature: BLOB 二进制数据，存储人脸特征向量(float数组)
+ *   - feature: BLOB 二进制数据，存储各模板的中心向量(float数组)
+ *   templates (模板)
+ *   - id: INTEGER 自增主键
+ *   - face_id: 所属身份
+ *   - feature: BLOB 录入时提取的原始特征
+ *
+ * 旧版本的数据库只有 faces 表，把其中的特征复制为各身份的第一个模板
  */
 int FaceDatabase::createTable() {
     const char* sql =
         "CREATE TABLE IF NOT EXISTS faces ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT,"  // 自增主键
-        "feature BLOB NOT NULL);";                // 特征向量的二进制存储
+        "feature BLOB NOT NULL);"                 // 特征向量的二进制存储
+        "CREATE TABLE IF NOT EXISTS templates ("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "face_id INTEGER NOT NULL,"
+        "feature BLOB NOT NULL);"
+        "CREATE INDEX IF NOT EXISTS templates_face_id ON templates (face_id);"
+        "INSERT INTO templates (face_id, feature) "
+        "SELECT id, feature FROM faces WHERE id NOT IN (SELECT face_id FROM templates);";
 
     char* err_msg = nullptr;
     int ret = sqlite3_exec(db, sql, nullptr, nullptr, &err_msg);
@@ -85,75 +199,672 @@ int FaceDatabase::createTable() {
     return 0;
 }
 
+int FaceDatabase::execSql(const char* sql) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::cerr << "Failed to execute \"" << sql << "\": " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 预编译常用语句
+ * @return 成功返回0，失败返回-1
+ */
+int FaceDatabase::prepareStatements() {
+    static const char* const sqls[STMT_NUM] = {
+        "INSERT INTO faces (feature) VALUES (?);",
+        "UPDATE faces SET feature = ? WHERE id = ?;",
+        "INSERT INTO templates (face_id, feature) VALUES (?, ?);",
+        "UPDATE templates SET feature = ? WHERE id = ?;",
+        "SELECT id, feature FROM templates WHERE face_id = ? ORDER BY id;",
+        "SELECT COUNT(*) FROM faces;",
+    };
+
+    for (int i = 0; i < STMT_NUM; i++) {
+        if (sqlite3_prepare_v2(db, sqls[i], -1, &stmts[i], nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to prepare statement: " << sqlite3_errmsg(db) << std::endl;
+            finalizeStatements();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void FaceDatabase::finalizeStatements() {
+    for (int i = 0; i < STMT_NUM; i++) {
+        if (stmts[i]) {
+            sqlite3_finalize(stmts[i]);
+            stmts[i] = nullptr;
+        }
+    }
+}
+
+/**
+ * @brief 加载内存特征库
+ * @return 成功返回0，失败返回-1
+ *
+ * 只在 init() 时执行一次全表读取，之后识别只访问内存特征库
+ */
+int FaceDatabase::loadGallery() {
+    const char* sql = "SELECT id, feature FROM faces ORDER BY id;";
+    sqlite3_stmt* stmt = nullptr;
+
+    int ret = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    if (ret != SQLITE_OK) {
+        std::cerr << "Failed to load gallery: " << sqlite3_errmsg(db) << std::endl;
+        return -1;
+    }
+
+    gallery.clear();
+    std::vector<float> row;     // BLOB 不保证 4 字节对齐，先拷到复用的缓冲区
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int id = sqlite3_column_int(stmt, 0);
+        const void* blob = sqlite3_column_blob(stmt, 1);
+        int blob_size = sqlite3_column_bytes(stmt, 1);
+        if (blob && blob_size > 0) {
+            row.resize(blob_size / sizeof(float));
+            std::memcpy(row.data(), blob, row.size() * sizeof(float));
+            if (gallery.add(id, row.data(), row.size()) != 0) {
+                std::cerr << "Skip face " << id << ": feature dimension mismatch" << std::endl;
+            }
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    return loadTemplateCounts();
+}
+
+/**
+ * @brief 统计各身份的模板数
+ * @return 成功返回0，失败返回-1
+ *
+ * 模板数用于判断识别时是否需要回查模板 (FP32 格式下单模板身份的中心向量就是模板本身)；
+ * 只读 templates_face_id 索引，不读取特征
+ */
+int FaceDatabase::loadTemplateCounts() {
+    sqlite3_stmt* stmt = nullptr;
+    int ret = sqlite3_prepare_v2(db, "SELECT face_id, COUNT(*) FROM templates GROUP BY face_id;", -1, &stmt, nullptr);
+    if (ret != SQLITE_OK) {
+        std::cerr << "Failed to count templates: " << sqlite3_errmsg(db) << std::endl;
+        return -1;
+    }
+    template_counts.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        template_counts[sqlite3_column_int(stmt, 0)] = sqlite3_column_int(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+/**
+ * @brief 打开共享特征库
+ * @param path 共享文件路径
+ * @return 成功返回0，失败返回-1
+ *
+ * 在写锁内检查已有文件：格式一致、上次写入未中断且行数 / ID 与 faces 表吻合时直接映射，
+ * 跳过全表读取；否则从数据库加载后写出新文件。共享文件不可用时退回进程私有的内存库
+ */
+int FaceDatabase::openSharedGallery(const std::string& path) {
+    if (gallery.openShared(path) != 0) {
+        std::cerr << "Cannot open shared gallery " << path << ", using a private copy" << std::endl;
+        return loadGallery();
+    }
+
+    gallery.beginWrite();
+    int ret;
+    if (gallery.attachShared() == 0 && gallery.format() == gallery_format && galleryMatchesDatabase()) {
+        ret = loadTemplateCounts();
+    } else {
+        gallery.detachShared();
+        gallery.setFormat(gallery_format);
+        ret = loadGallery();
+        if (ret == 0 && gallery.publishShared() != 0) {
+            std::cerr << "Failed to publish shared gallery " << path << ", using a private copy" << std::endl;
+        }
+    }
+    gallery.endWrite();
+    return ret;
+}
+
+/**
+ * @brief 检查共享特征库与 faces 表是否一致
+ * @return 行数、最大ID与ID之和都相同返回 true
+ *
+ * 只比较ID (读主键，不读特征)：能发现写入者在提交数据库后、写入特征库前退出的情况
+ */
+bool FaceDatabase::galleryMatchesDatabase() {
+    sqlite3_stmt* stmt = nullptr;
+    const char* sql = "SELECT COUNT(*), COALESCE(MAX(id), 0), COALESCE(SUM(id), 0) FROM faces;";
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    bool match = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        int64_t max_id = 0, sum_id = 0;
+        for (int r = 0; r < gallery.size(); r++) {
+            max_id = std::max<int64_t>(max_id, gallery.idAt(r));
+            sum_id += gallery.idAt(r);
+        }
+        match = sqlite3_column_int64(stmt, 0) == gallery.size()
+                && sqlite3_column_int64(stmt, 1) == max_id
+                && sqlite3_column_int64(stmt, 2) == sum_id;
+    }
+    sqlite3_finalize(stmt);
+    return match;
+}
+
+/**
+ * @brief 同步其他进程对共享特征库的写入
+ *
+ * 有新行时增量分配到 IVF 索引；库被清空或替换时重建索引。模板数随之重新统计
+ */
+void FaceDatabase::syncGallery() {
+    size_t first_new_row = 0;
+    FeatureGallery::SyncResult result = gallery.sync(first_new_row);
+    if (result == FeatureGallery::SYNC_NONE) {
+        return;
+    }
+
+    loadTemplateCounts();
+    if (result == FeatureGallery::SYNC_RESET) {
+        buildAnnIndex();
+    } else if (ann.trained()) {
+        for (size_t r = first_new_row; r < (size_t)gallery.size(); r++) {
+            ann.add(gallery, r);
+            ann_dirty = true;
+        }
+    } else if (gallery.size() >= ANN_MIN_FACES) {
+        buildAnnIndex();
+    }
+}
+
+/**
+ * @brief 开始写内存特征库：持有共享文件的写锁，并先合并其他进程的写入
+ */
+void FaceDatabase::beginGalleryWrite() {
+    if (gallery_txn) {
+        return;
+    }
+    if (gallery.beginWrite() != 0) {
+        std::cerr << "Failed to lock shared gallery" << std::endl;
+    }
+    syncGallery();
+}
+
+void FaceDatabase::endGalleryWrite() {
+    if (gallery_txn) {
+        return;
+    }
+    gallery.endWrite();
+}
+
+/**
+ * @brief 开始批量录入事务的内存侧：持有写锁直到事务结束，暂缓向其他进程发布
+ *
+ * 事务中途放锁会让其他进程看到 (甚至在其后追加) 尚未提交、可能被回滚的行
+ */
+void FaceDatabase::beginGalleryTransaction() {
+    beginGalleryWrite();
+    gallery.holdPublish();
+    gallery_txn = true;
+}
+
+/**
+ * @brief 结束批量录入事务的内存侧
+ * @param committed 事务是否提交成功；失败时丢弃未发布的行，调用方随后 reloadGallery()
+ */
+void FaceDatabase::endGalleryTransaction(bool committed) {
+    gallery_txn = false;
+    gallery.releasePublish(committed);
+    endGalleryWrite();
+}
+
+/**
+ * @brief 加载或训练 IVF 索引
+ *
+ * 优先加载 <db_path>.ivf；文件缺失、维度不符，或人脸数已增长到簇数明显偏少
+ * (nlist < sqrt(N) / 2) 时重新训练并保存
+ */
+void FaceDatabase::buildAnnIndex() {
+    int count = gallery.size();
+    if (count < ANN_MIN_FACES) {
+        ann.clear();
+        return;
+    }
+
+    int target_nlist = (int)std::sqrt((double)count);
+    if (ann.load(ann_path, gallery) == 0 && ann.nlist() * 2 >= target_nlist) {
+        ann_dirty = (int)ann.size() != count;
+        return;
+    }
+
+    std::cout << "Training ANN index: " << count << " faces, nlist=" << target_nlist << std::endl;
+    if (ann.train(gallery, target_nlist) == 0) {
+        ann_dirty = true;
+        saveAnnIndex();
+    }
+}
+
+void FaceDatabase::saveAnnIndex() {
+    if (!ann_dirty || !ann.trained()) return;
+    if (ann.save(ann_path, gallery) == 0) ann_dirty = false;
+}
+
 /**
  * @brief 录入人脸特征
  * @param feature 人脸特征向量(由MobileFaceNet提取的embedding)
- * @param message 输出消息，成功时为"录入成功，序号: X"，失败时为错误信息
- * @return 成功返回录入的人脸ID，失败返回-1
- *
- * 录入流程：
- *   1. 检查是否已存在相似人脸(相似度 >= 0.6)
- *   2. 如果存在则拒绝录入，提示"请不要重复录入"
- *   3. 否则将特征向量转换为BLOB格式并插入数据库
+ * @param message 输出消息，成功时为"录入成功，序号: X"或"X号已更新，模板数: N"，失败时为错误信息
+ * @return 成功返回录入 (或更新) 的人脸ID，失败返回-1
  */
 int FaceDatabase::enrollFace(const std::vector<float>& feature, std::string& message) {
+    Result result;
+    int ret = enroll(feature, result);
+    message = resultMessage(result);
+    return ret;
+}
+
+/**
+ * @brief 录入人脸特征 (结构化结果)
+ * @param feature 人脸特征向量
+ * @param result 输出参数，STATUS_ENROLLED / STATUS_UPDATED 表示成功
+ * @return 成功返回录入 (或更新) 的人脸ID，失败返回-1
+ */
+int FaceDatabase::enroll(const std::vector<float>& feature, Result& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    result = Result();
     if (!is_init || !db) {
-        message = "数据库未初始化";
         return -1;
     }
+    syncGallery();
+    enrollLocked(feature, true, result);
+    return resultSucceeded(result) ? result.face_id : -1;
+}
 
+/**
+ * @brief 录入一个特征 (调用方已持有锁)
+ * @param feature 人脸特征向量
+ * @param build_ann 新建身份后人脸数达到阈值时是否立即训练 IVF 索引
+ * @param result 输出参数
+ *
+ * 录入流程：
+ *   1. 检查是否已存在相似人脸(相似度 >= 0.6)
+ *   2. 如果存在则把特征追加为该身份的模板；与已有模板几乎相同时拒绝 (STATUS_DUPLICATE)
+ *   3. 否则将特征向量转换为BLOB格式，新建身份插入数据库
+ */
+void FaceDatabase::enrollLocked(const std::vector<float>& feature, bool build_ann, Result& result) {
+    result = Result();
     if (feature.empty()) {
-        message = "特征向量为空";
-        return -1;
+        result.status = STATUS_EMPTY_FEATURE;
+        return;
     }
 
     // 查找是否已存在相似的人脸(防止重复录入)
     float max_similarity = 0.0f;
     int similar_id = findMostSimilar(feature, max_similarity);
+    result.similarity = max_similarity;
 
-    // 相似度超过阈值则认为是同一个人，拒绝录入
+    // 相似度超过阈值则认为是同一个人，追加为该身份的模板
     if (similar_id > 0 && max_similarity >= SIMILARITY_THRESHOLD) {
-        message = "请不要重复录入";
-        return -1;
+        result.face_id = similar_id;
+        appendTemplate(similar_id, feature, result);
+        return;
     }
 
     // 插入新的人脸特征
-    const char* sql = "INSERT INTO faces (feature) VALUES (?);";
-    sqlite3_stmt* stmt = nullptr;
+    int new_id = insertFeature(feature, build_ann);
+    if (new_id < 0) {
+        result.status = STATUS_DB_ERROR;
+        return;
+    }
+    result.status = STATUS_ENROLLED;
+    result.face_id = new_id;
+    result.templates = 1;
+}
 
-    // 预处理SQL语句(prepared statement可防止SQL注入)
-    int ret = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-    if (ret != SQLITE_OK) {
-        message = "准备SQL语句失败";
+/**
+ * @brief 为指定身份追加模板
+ * @param face_id 身份序号
+ * @param feature 新模板
+ * @param message 输出消息
+ * @return 成功返回该身份的模板数，失败返回-1
+ *
+ * verify 为 false 时不检查新模板与该身份是否相似，由调用方保证 (例如门禁端确认了身份的抓拍)；
+ * 身份来自网络请求等不可信来源时必须核验，否则任何人都能把自己的脸追加到别人的身份上
+ */
+int FaceDatabase::addTemplate(int face_id, const std::vector<float>& feature, std::string& message, bool verify) {
+    Result result;
+    result.face_id = face_id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (is_init && db) {
+            syncGallery();
+            if (feature.empty()) {
+                result.status = STATUS_EMPTY_FEATURE;
+            } else if (template_counts.find(face_id) == template_counts.end()) {
+                result.status = STATUS_NO_SUCH_FACE;
+            } else if (verify && (result.similarity = centroidSimilarity(face_id, feature)) < SIMILARITY_THRESHOLD) {
+                result.status = STATUS_MISMATCH;
+            } else {
+                appendTemplate(face_id, feature, result);
+            }
+        }
+    }
+    message = resultMessage(result);
+    return result.status == STATUS_UPDATED ? result.templates : -1;
+}
+
+/**
+ * @brief 批量录入人脸特征
+ * @param features 特征向量列表
+ * @param ids 可选输出，每个特征对应的序号 (重复或为空的特征为 -1)
+ * @return 成功录入的个数，数据库写入失败时整体回滚并返回-1
+ *
+ * 所有插入在一个事务中完成，只在提交时写一次日志；批内特征之间同样做防重复检查。
+ * 批量导入的照片互相独立 (一人一张)，与已有身份相似的照片跳过而不是追加模板，
+ * 避免长相接近的两人被合并。IVF 索引的训练推迟到提交之后进行一次
+ */
+int FaceDatabase::enrollFaces(const std::vector<std::vector<float>>& features, std::vector<int>* ids) {
+    if (ids) {
+        ids->assign(features.size(), -1);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!is_init || !db) {
+        return -1;
+    }
+    syncGallery();
+
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::cerr << "Failed to begin transaction: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        return -1;
+    }
+    beginGalleryTransaction();
+
+    int enrolled = 0;
+    bool failed = false;
+    for (size_t i = 0; i < features.size(); i++) {
+        const std::vector<float>& feature = features[i];
+        if (feature.empty()) {
+            continue;
+        }
+
+        float max_similarity = 0.0f;
+        int similar_id = findMostSimilar(feature, max_similarity);
+        if (similar_id > 0 && max_similarity >= SIMILARITY_THRESHOLD) {
+            continue;
+        }
+
+        int new_id = insertFeature(feature, false);
+        if (new_id < 0) {
+            failed = true;
+            break;
+        }
+        if (ids) {
+            (*ids)[i] = new_id;
+        }
+        enrolled++;
+    }
+
+    if (!failed && sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::cerr << "Failed to commit transaction: " << err_msg << std::endl;
+        sqlite3_free(err_msg);
+        failed = true;
+    }
+
+    endGalleryTransaction(!failed);
+    if (failed) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        reloadGallery();
+        if (ids) {
+            ids->assign(features.size(), -1);
+        }
+        return -1;
+    }
+
+    // 提交后统一处理索引：人脸数达到阈值则训练，已有索引则保存增量
+    if (!ann.trained() && gallery.size() >= ANN_MIN_FACES) {
+        buildAnnIndex();
+    }
+    saveAnnIndex();
+    return enrolled;
+}
+
+/**
+ * @brief 在一个事务中依次录入多个特征 (与 enrollFace 相同的语义)
+ * @param features 特征向量列表
+ * @param results 输出参数，每个特征的结果
+ * @return 成功录入 (新建或更新) 的个数，事务提交失败时整体回滚并返回-1
+ *
+ * 供异步接口的写线程合并排队的录入请求：多次录入只提交一次
+ */
+int FaceDatabase::enrollBatch(const std::vector<std::vector<float>>& features, std::vector<Result>& results) {
+    results.assign(features.size(), Result());
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!is_init || !db) {
+        return -1;
+    }
+    syncGallery();
+
+    if (execSql("BEGIN IMMEDIATE;") != 0) {
+        return -1;
+    }
+    beginGalleryTransaction();
+    int enrolled = 0;
+    for (size_t i = 0; i < features.size(); i++) {
+        enrollLocked(features[i], false, results[i]);
+        if (resultSucceeded(results[i])) enrolled++;
+    }
+    bool committed = execSql("COMMIT;") == 0;
+    endGalleryTransaction(committed);
+    if (!committed) {
+        execSql("ROLLBACK;");
+        reloadGallery();
+        for (Result& r : results) {
+            if (resultSucceeded(r)) r.status = STATUS_DB_ERROR;
+        }
+        return -1;
+    }
+
+    if (!ann.trained() && gallery.size() >= ANN_MIN_FACES) {
+        buildAnnIndex();
+    }
+    saveAnnIndex();
+    return enrolled;
+}
+
+/**
+ * @brief 事务回滚后重新加载内存特征库与索引
+ *
+ * 回滚前内存特征库与索引已含未提交的行，从数据库重新加载 (共享模式下原地重写)
+ */
+void FaceDatabase::reloadGallery() {
+    beginGalleryWrite();
+    loadGallery();
+    endGalleryWrite();
+    buildAnnIndex();
+}
+
+/**
+ * @brief 新建身份并同步到内存特征库
+ * @param feature 特征向量 (同时作为第一个模板和中心向量)
+ * @param build_ann 人脸数达到阈值时是否立即训练 IVF 索引
+ * @return 成功返回新的人脸ID，失败返回-1
+ *
+ * faces 与 templates 两行在一个保存点内写入 (批量录入的事务中同样可用)
+ */
+int FaceDatabase::insertFeature(const std::vector<float>& feature, bool build_ann) {
+    if (execSql("SAVEPOINT insert_face;") != 0) {
         return -1;
     }
 
     // 将特征向量(vector<float>)转换为BLOB二进制数据
     std::vector<unsigned char> blob = featureToBlob(feature);
-    // 绑定BLOB参数到SQL语句的第1个占位符(?)
-    // SQLITE_TRANSIENT表示SQLite需要复制数据
-    ret = sqlite3_bind_blob(stmt, 1, blob.data(), blob.size(), SQLITE_TRANSIENT);
+    int new_id = -1;
+    {
+        sqlite3_stmt* stmt = stmts[STMT_INSERT];
+        StmtScope scope(stmt);
+        // 绑定BLOB参数到SQL语句的第1个占位符(?)
+        // SQLITE_STATIC：blob 在 step 完成前一直有效，无需 SQLite 复制
+        if (sqlite3_bind_blob(stmt, 1, blob.data(), blob.size(), SQLITE_STATIC) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_DONE) {
+            // 获取新插入记录的ID
+            new_id = sqlite3_last_insert_rowid(db);
+        }
+    }
+    if (new_id > 0) {
+        sqlite3_stmt* stmt = stmts[STMT_INSERT_TEMPLATE];
+        StmtScope scope(stmt);
+        sqlite3_bind_int(stmt, 1, new_id);
+        if (sqlite3_bind_blob(stmt, 2, blob.data(), blob.size(), SQLITE_STATIC) != SQLITE_OK
+            || sqlite3_step(stmt) != SQLITE_DONE) {
+            new_id = -1;
+        }
+    }
+    if (new_id < 0) {
+        std::cerr << "Failed to insert feature: " << sqlite3_errmsg(db) << std::endl;
+        execSql("ROLLBACK TO insert_face;");
+        execSql("RELEASE insert_face;");
+        return -1;
+    }
+    if (execSql("RELEASE insert_face;") != 0) {
+        return -1;
+    }
+    template_counts[new_id] = 1;
 
-    if (ret != SQLITE_OK) {
-        message = "绑定参数失败";
-        sqlite3_finalize(stmt);  // 释放语句资源
+    // 写入数据库成功后同步到内存特征库与 ANN 索引 (批量事务中提交后才对其他进程可见)
+    // 提交与加锁之间其他进程可能已经从数据库重建了共享特征库 (已包含这一行)，同步后不再重复追加
+    beginGalleryWrite();
+    if (gallery.rowOf(new_id) < 0 && gallery.add(new_id, feature.data(), feature.size()) == 0) {
+        if (ann.trained()) {
+            ann.add(gallery, gallery.size() - 1);
+            ann_dirty = true;
+        } else if (build_ann && gallery.size() >= ANN_MIN_FACES) {
+            buildAnnIndex();
+        }
+    }
+    endGalleryWrite();
+    return new_id;
+}
+
+/**
+ * @brief 为已有身份追加或替换模板
+ * @param face_id 身份序号
+ * @param feature 新模板
+ * @param result 输出参数，成功时为 STATUS_UPDATED 与新的模板数
+ * @return 成功返回模板数，失败返回-1
+ *
+ * 模板已满时替换与新模板最相似的那个：它与新模板信息重叠最多，替换后模板覆盖的姿态 / 光照最广。
+ * 中心向量变化不大，IVF 索引中的簇分配保持不变
+ */
+int FaceDatabase::appendTemplate(int face_id, const std::vector<float>& feature, Result& result) {
+    result.status = STATUS_DB_ERROR;
+    std::vector<Template> templates;
+    if (loadTemplates(face_id, templates) != 0) {
         return -1;
     }
 
-    // 执行SQL语句
-    ret = sqlite3_step(stmt);
-    if (ret != SQLITE_DONE) {
-        message = "插入数据失败";
-        sqlite3_finalize(stmt);
+    int nearest = -1;
+    float nearest_similarity = -1.0f;
+    for (size_t i = 0; i < templates.size(); i++) {
+        if (templates[i].feature.size() != feature.size()) continue;
+        float similarity = FeatureGallery::cosineSimilarity(feature.data(), templates[i].feature.data(), feature.size());
+        if (similarity > nearest_similarity) {
+            nearest_similarity = similarity;
+            nearest = (int)i;
+        }
+    }
+    if (nearest_similarity >= DUPLICATE_TEMPLATE_THRESHOLD) {
+        result.status = STATUS_DUPLICATE;
+        result.templates = (int)templates.size();
         return -1;
     }
 
-    // 获取新插入记录的ID
-    int new_id = sqlite3_last_insert_rowid(db);
-    sqlite3_finalize(stmt);  // 释放语句资源
+    if (execSql("SAVEPOINT add_template;") != 0) {
+        return -1;
+    }
 
-    message = "录入成功，序号: " + std::to_string(new_id);
-    return new_id;
+    std::vector<unsigned char> blob = featureToBlob(feature);
+    bool ok;
+    if ((int)templates.size() < MAX_TEMPLATES || nearest < 0) {
+        sqlite3_stmt* stmt = stmts[STMT_INSERT_TEMPLATE];
+        StmtScope scope(stmt);
+        sqlite3_bind_int(stmt, 1, face_id);
+        ok = sqlite3_bind_blob(stmt, 2, blob.data(), blob.size(), SQLITE_STATIC) == SQLITE_OK
+             && sqlite3_step(stmt) == SQLITE_DONE;
+        templates.push_back(Template{ (int)sqlite3_last_insert_rowid(db), feature });
+    } else {
+        sqlite3_stmt* stmt = stmts[STMT_UPDATE_TEMPLATE];
+        StmtScope scope(stmt);
+        sqlite3_bind_int(stmt, 2, templates[nearest].id);
+        ok = sqlite3_bind_blob(stmt, 1, blob.data(), blob.size(), SQLITE_STATIC) == SQLITE_OK
+             && sqlite3_step(stmt) == SQLITE_DONE;
+        templates[nearest].feature = feature;
+    }
+
+    std::vector<float> centroid;
+    if (!ok || updateCentroid(face_id, templates, centroid) != 0) {
+        std::cerr << "Failed to update templates: " << sqlite3_errmsg(db) << std::endl;
+        execSql("ROLLBACK TO add_template;");
+        execSql("RELEASE add_template;");
+        return -1;
+    }
+    if (execSql("RELEASE add_template;") != 0) {
+        return -1;
+    }
+
+    // 提交后同步内存：中心向量原地覆盖原来的行，行号不变；IVF 倒排表保存的是行号，
+    // 簇分配沿用旧中心向量的 (同一身份的中心变化不大)，索引无需改动
+    beginGalleryWrite();
+    gallery.update(face_id, centroid.data(), centroid.size());
+    endGalleryWrite();
+    template_counts[face_id] = (int)templates.size();
+
+    result.status = STATUS_UPDATED;
+    result.face_id = face_id;
+    result.templates = (int)templates.size();
+    return result.templates;
+}
+
+/**
+ * @brief 由模板计算中心向量并写回 faces 表
+ * @param face_id 身份序号
+ * @param templates 该身份的全部模板
+ * @param centroid 输出参数，归一化后的中心向量
+ * @return 成功返回0，失败返回-1
+ *
+ * 各模板先归一化再求和，避免范数大的模板主导中心
+ */
+int FaceDatabase::updateCentroid(int face_id, const std::vector<Template>& templates, std::vector<float>& centroid) {
+    if (templates.empty()) {
+        return -1;
+    }
+    size_t dim = templates[0].feature.size();
+    centroid.assign(dim, 0.0f);
+    for (const Template& t : templates) {
+        if (t.feature.size() != dim) continue;
+        float norm = std::sqrt(FeatureGallery::innerProduct(t.feature.data(), t.feature.data(), dim));
+        if (norm < 1e-6f) continue;
+        for (size_t i = 0; i < dim; i++) centroid[i] += t.feature[i] / norm;
+    }
+    float norm = std::sqrt(FeatureGallery::innerProduct(centroid.data(), centroid.data(), dim));
+    if (norm < 1e-6f) {
+        return -1;
+    }
+    for (float& v : centroid) v /= norm;
+
+    sqlite3_stmt* stmt = stmts[STMT_UPDATE_FACE];
+    StmtScope scope(stmt);
+    std::vector<unsigned char> blob = featureToBlob(centroid);
+    sqlite3_bind_int(stmt, 2, face_id);
+    if (sqlite3_bind_blob(stmt, 1, blob.data(), blob.size(), SQLITE_STATIC) != SQLITE_OK
+        || sqlite3_step(stmt) != SQLITE_DONE) {
+        return -1;
+    }
+    return 0;
 }
 
 /**
@@ -161,49 +872,88 @@ int FaceDatabase::enrollFace(const std::vector<float>& feature, std::string& mes
  * @param feature 待识别的人脸特征向量
  * @param message 输出消息，成功时为"你是X号"，失败时为"请先录入人脸"
  * @return 识别成功返回匹配的人脸ID，失败返回-1
+ */
+int FaceDatabase::recognizeFace(const std::vector<float>& feature, std::string& message) {
+    Result result;
+    int ret = recognize(feature, result);
+    message = resultMessage(result);
+    return ret;
+}
+
+/**
+ * @brief 识别人脸特征 (结构化结果)
+ * @param feature 待识别的人脸特征向量
+ * @param result 输出参数，STATUS_MATCHED 表示识别成功；未匹配时 similarity 为最接近身份的相似度
+ * @return 识别成功返回匹配的人脸ID，失败返回-1
  *
  * 识别流程：
- *   1. 遍历数据库中所有人脸特征
- *   2. 计算与当前特征的相似度，找到最相似的人脸
+ *   1. 在中心向量中检索候选身份，比对候选的模板
+ *   2. 找到最相似的人脸
  *   3. 如果相似度 >= 0.6，则认为匹配成功
  */
-int FaceDatabase::recognizeFace(const std::vector<float>& feature, std::string& message) {
+int FaceDatabase::recognize(const std::vector<float>& feature, Result& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    result = Result();
     if (!is_init || !db) {
-        message = "数据库未初始化";
         return -1;
     }
 
     if (feature.empty()) {
-        message = "特征向量为空";
+        result.status = STATUS_EMPTY_FEATURE;
         return -1;
     }
+    syncGallery();
 
     // 查找最相似的人脸
     float max_similarity = 0.0f;
     int similar_id = findMostSimilar(feature, max_similarity);
+    result.similarity = max_similarity;
 
     // 相似度达到阈值则认为识别成功
     if (similar_id > 0 && max_similarity >= SIMILARITY_THRESHOLD) {
-        message = "你是" + std::to_string(similar_id) + "号";
+        result.status = STATUS_MATCHED;
+        result.face_id = similar_id;
+        auto it = template_counts.find(similar_id);
+        result.templates = it == template_counts.end() ? 1 : it->second;
         return similar_id;
-    } else {
-        message = "请先录入人脸";
-        return -1;
+    }
+    result.status = STATUS_NOT_FOUND;
+    return -1;
+}
+
+/**
+ * @brief 把结果转换为界面提示文字
+ * @param result 录入 / 识别结果
+ * @return 中文提示 (与 enrollFace / recognizeFace 的 message 相同)
+ */
+std::string FaceDatabase::resultMessage(const Result& result) {
+    switch (result.status) {
+    case STATUS_MATCHED:      return "你是" + std::to_string(result.face_id) + "号";
+    case STATUS_ENROLLED:     return "录入成功，序号: " + std::to_string(result.face_id);
+    case STATUS_UPDATED:      return std::to_string(result.face_id) + "号已更新，模板数: " + std::to_string(result.templates);
+    case STATUS_NOT_FOUND:    return "请先录入人脸";
+    case STATUS_DUPLICATE:    return "请不要重复录入";
+    case STATUS_NO_SUCH_FACE: return std::to_string(result.face_id) + "号不存在";
+    case STATUS_EMPTY_FEATURE:return "特征向量为空";
+    case STATUS_DB_ERROR:     return "插入数据失败";
+    case STATUS_MISMATCH:     return "与" + std::to_string(result.face_id) + "号不是同一人，拒绝追加模板";
+    default:                  return "数据库未初始化";
     }
 }
 
 /**
  * @brief 清空人脸数据库
  *
- * 删除faces表中的所有记录，并重置自增ID计数器
+ * 删除faces表与templates表中的所有记录，并重置自增ID计数器
  */
 void FaceDatabase::clearAll() {
+    std::lock_guard<std::mutex> lock(mutex);
     if (!is_init || !db) {
         return;
     }
 
-    // 删除所有人脸记录
-    const char* sql = "DELETE FROM faces;";
+    // 删除所有人脸与模板记录
+    const char* sql = "DELETE FROM faces; DELETE FROM templates;";
     char* err_msg = nullptr;
     sqlite3_exec(db, sql, nullptr, nullptr, &err_msg);
 
@@ -213,8 +963,17 @@ void FaceDatabase::clearAll() {
     }
 
     // 重置自增ID计数器(sqlite_sequence表维护自增值)
-    sql = "DELETE FROM sqlite_sequence WHERE name='faces';";
+    sql = "DELETE FROM sqlite_sequence WHERE name IN ('faces', 'templates');";
     sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+
+    // 同步清空内存特征库与 ANN 索引
+    beginGalleryWrite();
+    gallery.clear();
+    endGalleryWrite();
+    template_counts.clear();
+    ann.clear();
+    ann_dirty = false;
+    std::remove(ann_path.c_str());
 }
 
 /**
@@ -222,120 +981,166 @@ void FaceDatabase::clearAll() {
  * @return 人脸数量，失败返回0
  */
 int FaceDatabase::getFaceCount() {
+    std::lock_guard<std::mutex> lock(mutex);
     if (!is_init || !db) {
         return 0;
     }
 
-    const char* sql = "SELECT COUNT(*) FROM faces;";
-    sqlite3_stmt* stmt = nullptr;
-
-    int ret = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-    if (ret != SQLITE_OK) {
-        return 0;
-    }
+    sqlite3_stmt* stmt = stmts[STMT_COUNT];
+    StmtScope scope(stmt);
 
     int count = 0;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
         count = sqlite3_column_int(stmt, 0);  // 获取第0列的整数值
     }
-
-    sqlite3_finalize(stmt);
     return count;
 }
 
 /**
- * @brief 计算两个特征向量的余弦相似度
- * @param feat1 特征向量1
- * @param feat2 特征向量2
- * @return 余弦相似度值(范围0-1)，值越大表示越相似
- *
- * 余弦相似度公式：cos(θ) = (A·B) / (|A|×|B|)
- *   - A·B: 向量点积(dot product)
- *   - |A|: 向量A的欧几里得范数(L2 norm)
- *   - |B|: 向量B的欧几里得范数
- *
- * 余弦相似度表示两个向量夹角的余弦值，用于衡量方向相似性
+ * @brief 获取指定身份的模板数
+ * @param face_id 身份序号
+ * @return 模板数，身份不存在返回0
  */
-float FaceDatabase::calculateSimilarity(const std::vector<float>& feat1, const std::vector<float>& feat2) {
-    // 检查向量维度是否一致
-    if (feat1.size() != feat2.size() || feat1.empty()) {
-        return 0.0f;
-    }
-
-    // 计算余弦相似度
-    float dot_product = 0.0f;  // 点积：Σ(A[i] * B[i])
-    float norm1 = 0.0f;        // 向量1的平方和
-    float norm2 = 0.0f;        // 向量2的平方和
-
-    for (size_t i = 0; i < feat1.size(); i++) {
-        dot_product += feat1[i] * feat2[i];
-        norm1 += feat1[i] * feat1[i];
-        norm2 += feat2[i] * feat2[i];
-    }
-
-    // 计算范数(norm = √(平方和))
-    norm1 = std::sqrt(norm1);
-    norm2 = std::sqrt(norm2);
-
-    // 避免除零错误
-    if (norm1 < 1e-6 || norm2 < 1e-6) {
-        return 0.0f;
+int FaceDatabase::getTemplateCount(int face_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (is_init) {
+        syncGallery();
     }
-
-    // 返回余弦相似度 = 点积 / (范数1 × 范数2)
-    return dot_product / (norm1 * norm2);
+    auto it = template_counts.find(face_id);
+    return it == template_counts.end() ? 0 : it->second;
 }
 
 /**
- * @brief 在数据库中查找与给定特征最相似的人脸
+ * @brief 查找与给定特征最相似的人脸
  * @param feature 待匹配的特征向量
  * @param max_similarity 输出参数，返回找到的最大相似度值
  * @return 最相似人脸的ID，未找到返回-1
  *
- * 遍历数据库中所有人脸特征，计算与输入特征的相似度，返回相似度最高的人脸ID
+ * 第一轮在内存特征库中对中心向量做向量化点积扫描 (库内特征已归一化，点积即余弦相似度)，
+ * 每个身份只扫描一行；第二轮只对 top-k 候选从数据库读取 FP32 模板，取模板中的最高相似度。
+ * FP32 格式下单模板身份的中心向量就是模板本身，不必回查；压缩格式不重排 (rerank_top_k <= 1)
+ * 时单模板身份直接使用近似相似度
  */
 int FaceDatabase::findMostSimilar(const std::vector<float>& feature, float& max_similarity) {
+    max_similarity = 0.0f;
     if (!is_init || !db) {
         return -1;
     }
+    TraceScope trace(Tracer::STAGE_DB_SEARCH);
 
-    // 查询所有人脸记录
-    const char* sql = "SELECT id, feature FROM faces;";
-    sqlite3_stmt* stmt = nullptr;
-
-    int ret = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-    if (ret != SQLITE_OK) {
+    // 临时内存与候选列表跨检索复用，稳定状态下检索不申请内存
+    search_arena.reset();
+    std::vector<GalleryMatch>& candidates = search_candidates;
+    int k = rerank_top_k > 1 ? rerank_top_k : 1;
+    if (searchCandidates(feature, k, candidates) == 0) {
         return -1;
     }
+    bool exact_gallery = gallery.format() == FeatureGallery::FORMAT_FP32 || rerank_top_k <= 1;
 
     int best_id = -1;
-    max_similarity = 0.0f;
+    for (const GalleryMatch& c : candidates) {
+        float similarity = c.similarity;    // 读取失败时退回近似值
+        auto it = template_counts.find(c.id);
+        bool multi = it != template_counts.end() && it->second > 1;
+        float best_template;
+        if ((multi || !exact_gallery) && templateSimilarity(c.id, feature, best_template) == 0) {
+            similarity = best_template;
+        }
+        if (best_id < 0 || similarity > max_similarity) {
+            max_similarity = similarity;
+            best_id = c.id;
+        }
+    }
+    return best_id;
+}
 
-    // 遍历所有记录
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int id = sqlite3_column_int(stmt, 0);  // 获取人脸ID
+/**
+ * @brief 检索 k 个最相似的候选
+ * @param feature 查询特征
+ * @param k 候选个数
+ * @param out 输出结果，按相似度降序
+ * @return 实际返回的候选个数
+ */
+int FaceDatabase::searchCandidates(const std::vector<float>& feature, int k, std::vector<GalleryMatch>& out) {
+    if (ann.trained()) {
+        return ann.search(gallery, feature.data(), feature.size(), k, out, &search_arena);
+    }
+    return gallery.searchTopK(feature.data(), feature.size(), k, out, &search_arena);
+}
 
-        // 获取BLOB数据(特征向量的二进制形式)
-        const unsigned char* blob = static_cast<const unsigned char*>(sqlite3_column_blob(stmt, 1));
-        int blob_size = sqlite3_column_bytes(stmt, 1);
+/**
+ * @brief 从数据库读取指定身份的全部模板
+ * @param face_id 身份序号
+ * @param templates 输出参数，FP32 模板 (按录入顺序)
+ * @return 成功返回0，没有模板或读取失败返回-1
+ */
+int FaceDatabase::loadTemplates(int face_id, std::vector<Template>& templates) {
+    sqlite3_stmt* stmt = stmts[STMT_SELECT_TEMPLATES];
+    StmtScope scope(stmt);
+    sqlite3_bind_int(stmt, 1, face_id);
 
+    templates.clear();
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const void* blob = sqlite3_column_blob(stmt, 1);
+        int blob_size = sqlite3_column_bytes(stmt, 1);
         if (blob && blob_size > 0) {
-            // 将BLOB数据还原为float向量
-            std::vector<float> db_feature = blobToFeature(blob, blob_size);
+            Template t;
+            t.id = sqlite3_column_int(stmt, 0);
+            t.feature.resize(blob_size / sizeof(float));
+            std::memcpy(t.feature.data(), blob, t.feature.size() * sizeof(float));
+            templates.push_back(std::move(t));
+        }
+    }
+    return templates.empty() ? -1 : 0;
+}
 
-            // 计算相似度
-            float similarity = calculateSimilarity(feature, db_feature);
+/**
+ * @brief 计算指定身份各模板与查询特征的最高相似度
+ * @param face_id 身份序号
+ * @param feature 查询特征
+ * @param similarity 输出参数，模板中的最高余弦相似度
+ * @return 成功返回0，没有维度相符的模板或读取失败返回-1
+ *
+ * 检索路径使用：BLOB 逐行拷贝到 search_arena 中的一块对齐缓冲区后比对，
+ * 不为每个模板构造 std::vector
+ */
+int FaceDatabase::templateSimilarity(int face_id, const std::vector<float>& feature, float& similarity) {
+    sqlite3_stmt* stmt = stmts[STMT_SELECT_TEMPLATES];
+    StmtScope scope(stmt);
+    sqlite3_bind_int(stmt, 1, face_id);
 
-            // 更新最佳匹配
-            if (similarity > max_similarity) {
-                max_similarity = similarity;
-                best_id = id;
-            }
-        }
+    // SQLite 返回的 BLOB 指针不保证按 float 对齐
+    float* buf = search_arena.alloc<float>(feature.size());
+    if (!buf) return -1;
+    const size_t bytes = feature.size() * sizeof(float);
+
+    bool found = false;
+    similarity = -1.0f;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const void* blob = sqlite3_column_blob(stmt, 1);
+        if (!blob || (size_t)sqlite3_column_bytes(stmt, 1) != bytes) continue;
+        std::memcpy(buf, blob, bytes);
+        similarity = std::max(similarity,
+            FeatureGallery::cosineSimilarity(feature.data(), buf, feature.size()));
+        found = true;
     }
+    return found ? 0 : -1;
+}
 
-    sqlite3_finalize(stmt);
-    return best_id;
+/**
+ * @brief 新特征与指定身份中心向量的相似度
+ * @param face_id 身份序号
+ * @param feature 新特征
+ * @return 余弦相似度 (压缩格式下为近似值)，身份不在内存特征库或维度不符返回-1
+ */
+float FaceDatabase::centroidSimilarity(int face_id, const std::vector<float>& feature) const {
+    int row = gallery.rowOf(face_id);
+    if (row < 0 || (int)feature.size() != gallery.dim()) {
+        return -1.0f;
+    }
+    std::vector<float> centroid(gallery.dim());
+    gallery.decodeRow(row, centroid.data());
+    return FeatureGallery::cosineSimilarity(feature.data(), centroid.data(), gallery.dim());
 }
 
 /**
@@ -354,23 +1159,3 @@ std::vector<unsigned char> FaceDatabase::featureToBlob(const std::vector<float>&
 
     return blob;
 }
-
-/**
- * @brief 将BLOB二进制数据转换为float向量
- * @param blob 字节数组指针
- * @param size 字节数组的大小(字节数)
- * @return 还原后的float向量
- *
- * 从数据库读取的BLOB数据转换回float数组
- */
-std::vector<float> FaceDatabase::blobToFeature(const unsigned char* blob, int size) {
-    // 计算float元素个数(总字节数 / 每个float的字节数)
-    int float_count = size / sizeof(float);
-
-    std::vector<float> feature(float_count);
-
-    // 内存拷贝：将字节数组按字节复制到float数组
-    std::memcpy(feature.data(), blob, size);
-
-    return feature;
-}
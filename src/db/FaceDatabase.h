@@ -1,51 +1,221 @@
 #ifndef FACEDATABASE_H
 #define FACEDATABASE_H
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <sqlite3.h>
+#include "db/FeatureGallery.h"
+#include "db/IvfIndex.h"
 
+// 公开接口内部加锁，摄像头流水线与识别服务的远程请求可以共用同一个实例
+//
+// 每个身份 (faces 表，序号即对外的人脸ID) 最多保存 MAX_TEMPLATES 个模板 (templates 表)，
+// faces.feature 为各模板归一化后的中心向量。识别时先用中心向量扫描出候选身份 (每个身份一行)，
+// 再只对候选逐个比对其模板，取模板中的最高相似度
 class FaceDatabase {
 public:
+    // 录入 / 识别的结构化结果 (异步接口与界面据此自行组织提示文字)
+    enum Status {
+        STATUS_NOT_INIT = 0,    // 数据库未初始化
+        STATUS_MATCHED,         // 识别成功
+        STATUS_ENROLLED,        // 新建了身份
+        STATUS_UPDATED,         // 追加 / 替换了已有身份的模板
+        STATUS_NOT_FOUND,       // 没有相似度达到阈值的人脸
+        STATUS_DUPLICATE,       // 与该身份已有模板几乎相同
+        STATUS_NO_SUCH_FACE,    // addTemplate 指定的身份不存在
+        STATUS_EMPTY_FEATURE,   // 特征向量为空
+        STATUS_DB_ERROR,        // 数据库读写失败
+        STATUS_MISMATCH         // addTemplate 要求核验时，新模板与该身份的中心向量不够相似
+    };
+
+    struct Result {
+        Status status = STATUS_NOT_INIT;
+        int face_id = -1;
+        float similarity = 0.0f;    // 与最相似身份的相似度 (库为空时为 0)
+        int templates = 0;          // 该身份的模板数
+    };
+
     FaceDatabase();
     ~FaceDatabase();
 
+    // 设置内存特征库的存储格式，需在 init() 之前调用
+    // 压缩格式 (FP16 / INT8) 下先近似扫描出 rerank_top_k 个候选，再读取数据库中的
+    // 原始 FP32 特征精确重排；rerank_top_k <= 1 则直接使用近似相似度
+    void setGalleryFormat(FeatureGallery::Format format, int rerank_top_k = DEFAULT_RERANK_TOP_K);
+
+    // 是否与打开同一数据库的其他进程共享内存特征库 (默认开启，文件为 <db_path>.gallery)，需在 init() 之前调用
+    // 共享时各进程只读映射同一份特征矩阵，任一进程录入后其他进程下次检索即可看到
+    void setSharedGallery(bool enabled);
+
+    // 近似检索的召回率 / 耗时旋钮：IVF 索引每次扫描的簇数，可随时调整
+    void setSearchParams(int nprobe);
+
     // 初始化数据库
     int init(const std::string& db_path);
 
-    // 录入人脸特征：如果已存在相同特征返回-1并设置错误信息"请不要重复录入"，成功返回录入的序号
+    // 录入人脸特征：与已有身份相似时追加为该身份的模板，否则新建身份；成功返回身份序号
+    // 与该身份已有模板几乎相同时返回-1并设置错误信息"请不要重复录入"
     int enrollFace(const std::vector<float>& feature, std::string& message);
 
+    // 与 enrollFace 相同，输出结构化结果
+    int enroll(const std::vector<float>& feature, Result& result);
+
+    // 在一个事务中依次录入多个特征 (语义同 enroll)：返回成功个数，提交失败时整体回滚并返回-1
+    int enrollBatch(const std::vector<std::vector<float>>& features, std::vector<Result>& results);
+
+    // 为指定身份追加一个模板 (模板已满时替换与之最相似的一个)，成功返回该身份的模板数，失败返回-1
+    // verify 为 true 时 (身份由不可信的调用方指定) 先核验：与该身份中心向量的相似度低于识别阈值则拒绝
+    int addTemplate(int face_id, const std::vector<float>& feature, std::string& message, bool verify = false);
+
+    // 批量录入 (单个事务)：返回成功录入的个数，失败时整体回滚并返回-1
+    // 每个特征新建一个身份；ids 非空时输出每个特征对应的序号，与已有身份相似或为空的特征记为 -1
+    int enrollFaces(const std::vector<std::vector<float>>& features, std::vector<int>* ids = nullptr);
+
     // 识别人脸特征：找到相同特征返回序号并设置message为"你是X号"，未找到返回-1并设置message为"请先录入人脸"
     int recognizeFace(const std::vector<float>& feature, std::string& message);
 
+    // 与 recognizeFace 相同，输出结构化结果
+    int recognize(const std::vector<float>& feature, Result& result);
+
+    // 结果对应的提示文字 ("你是X号"、"请不要重复录入" 等)
+    static std::string resultMessage(const Result& result);
+    // 录入 / 识别是否成功
+    static bool resultSucceeded(const Result& result) {
+        return result.status == STATUS_MATCHED || result.status == STATUS_ENROLLED || result.status == STATUS_UPDATED;
+    }
+
     // 清空数据库
     void clearAll();
 
-    // 获取数据库中的人脸数量
+    // 获取数据库中的人脸 (身份) 数量
     int getFaceCount();
 
+    // 获取指定身份的模板数，不存在返回0
+    int getTemplateCount(int face_id);
+
+    // 每个身份最多保存的模板数
+    static const int MAX_TEMPLATES = 5;
+    // 人脸数达到该值后启用 IVF 近似检索，索引保存在 <db_path>.ivf
+    static const int ANN_MIN_FACES = 2000;
+    // 压缩格式下默认参与 FP32 精确重排的候选数
+    static const int DEFAULT_RERANK_TOP_K = 8;
+
 private:
+    // 缓存的预编译语句，init 时准备一次，析构时释放
+    enum Statement {
+        STMT_INSERT = 0,        // INSERT INTO faces (feature) VALUES (?)
+        STMT_UPDATE_FACE,       // UPDATE faces SET feature = ? WHERE id = ?
+        STMT_INSERT_TEMPLATE,   // INSERT INTO templates (face_id, feature) VALUES (?, ?)
+        STMT_UPDATE_TEMPLATE,   // UPDATE templates SET feature = ? WHERE id = ?
+        STMT_SELECT_TEMPLATES,  // SELECT id, feature FROM templates WHERE face_id = ?
+        STMT_COUNT,             // SELECT COUNT(*) FROM faces
+        STMT_NUM
+    };
+
+    // 一个模板 (templates 表的一行)
+    struct Template {
+        int id;
+        std::vector<float> feature;
+    };
+
     sqlite3* db;
     bool is_init;
+    std::mutex mutex;           // 保护数据库连接、内存特征库与索引
+    sqlite3_stmt* stmts[STMT_NUM];
+
+    // 常驻内存的特征库 (每个身份一行中心向量)：init 时从数据库加载一次，录入 / 清空时与数据库同步写入
+    FeatureGallery gallery;
+    std::unordered_map<int, int> template_counts;  // 身份 -> 模板数
+    FeatureGallery::Format gallery_format = FeatureGallery::FORMAT_INT8;
+    int rerank_top_k = DEFAULT_RERANK_TOP_K;
+    bool shared_gallery = true;
+    bool gallery_txn = false;   // 处于 beginGalleryTransaction / endGalleryTransaction 之间
+
+    // 人脸数达到 ANN_MIN_FACES 后启用的 IVF 近似检索索引
+    IvfIndex ann;
+    std::string ann_path;
+    bool ann_dirty = false;     // 有尚未写入索引文件的增量
+
+    // 检索的临时内存 (查询向量、IVF 候选行、模板解码)，每次检索开始时回收；受 mutex 保护
+    FrameArena search_arena;
+    std::vector<GalleryMatch> search_candidates;
 
     // 相似度阈值，余弦相似度大于此值认为是同一个人
     const float SIMILARITY_THRESHOLD = 0.6f;
+    // 新模板与已有模板的相似度超过此值视为重复录入 (没有带来新的姿态 / 光照)
+    const float DUPLICATE_TEMPLATE_THRESHOLD = 0.95f;
+
+    // 配置 WAL 日志与 synchronous=NORMAL
+    void configureJournal();
 
-    // 创建表
+    // 创建表 (旧版本只有 faces 表的数据库迁移为每个身份一个模板)
     int createTable();
 
-    // 计算两个特征向量的余弦相似度
-    float calculateSimilarity(const std::vector<float>& feat1, const std::vector<float>& feat2);
+    // 执行一条不返回结果的 SQL，成功返回0
+    int execSql(const char* sql);
+
+    // 准备 / 释放缓存的预编译语句
+    int prepareStatements();
+    void finalizeStatements();
+
+    // 新建身份 (第一个模板即中心向量) 并同步到内存特征库，成功返回新的序号，失败返回-1
+    // build_ann 为 false 时 (批量录入中) 推迟 IVF 索引的训练
+    int insertFeature(const std::vector<float>& feature, bool build_ann);
+
+    // 录入一个特征 (已持有锁)：相似则追加模板，否则新建身份
+    void enrollLocked(const std::vector<float>& feature, bool build_ann, Result& result);
+
+    // 为已有身份追加 / 替换模板并更新中心向量，成功返回模板数，失败返回-1 (状态写入 result)
+    int appendTemplate(int face_id, const std::vector<float>& feature, Result& result);
+
+    // 事务回滚后从数据库重新加载内存特征库与 IVF 索引
+    void reloadGallery();
+
+    // 由模板重新计算中心向量，写回 faces 表，成功返回0 (内存特征库由调用方在提交后更新)
+    int updateCentroid(int face_id, const std::vector<Template>& templates, std::vector<float>& centroid);
 
-    // 在数据库中查找最相似的人脸，返回id和相似度
+    // 把数据库中的全部中心向量加载到内存特征库，并统计各身份的模板数
+    int loadGallery();
+    int loadTemplateCounts();
+
+    // 打开共享特征库：已有文件与数据库一致时直接映射，否则从数据库重建，成功返回0
+    int openSharedGallery(const std::string& path);
+    // 共享特征库的行数与ID是否与 faces 表一致
+    bool galleryMatchesDatabase();
+    // 合并其他进程写入共享特征库的变化 (IVF 索引、模板数)
+    void syncGallery();
+    // 写内存特征库前后调用：持有共享文件的写锁 (整批事务中为空操作，锁由事务持有)
+    void beginGalleryWrite();
+    void endGalleryWrite();
+    // 批量录入事务的 BEGIN 之后 / 结束时调用：整个事务期间持有写锁，
+    // 新增与改写的行在提交成功后才发布给其他进程，回滚时丢弃
+    void beginGalleryTransaction();
+    void endGalleryTransaction(bool committed);
+
+    // 加载或重新训练 IVF 索引 (人脸数不足时不启用)
+    void buildAnnIndex();
+    // 把索引增量写回文件
+    void saveAnnIndex();
+
+    // 检索 k 个候选：启用 IVF 时走近似检索，否则线性扫描
+    int searchCandidates(const std::vector<float>& feature, int k, std::vector<GalleryMatch>& out);
+
+    // 从数据库读取指定身份的全部 FP32 模板，成功返回0
+    int loadTemplates(int face_id, std::vector<Template>& templates);
+
+    // feature 与指定身份中心向量 (内存特征库中的行) 的相似度，身份不存在或维度不符返回-1
+    float centroidSimilarity(int face_id, const std::vector<float>& feature) const;
+
+    // 指定身份各模板与 feature 的最高相似度 (直接比对 BLOB，不拷贝模板)，没有模板返回-1
+    int templateSimilarity(int face_id, const std::vector<float>& feature, float& similarity);
+
+    // 在数据库中查找最相似的人脸，返回id和相似度 (候选身份各模板中的最高相似度)
     int findMostSimilar(const std::vector<float>& feature, float& max_similarity);
 
     // 将vector<float>转换为blob数据
     std::vector<unsigned char> featureToBlob(const std::vector<float>& feature);
-
-    // 将blob数据转换为vector<float>
-    std::vector<float> blobToFeature(const unsigned char* blob, int size);
 };
 
 #endif //FACEDATABASE_H
@@ -0,0 +1,823 @@
+/**
+ * @file FeatureGallery.cpp
+ * @brief 常驻内存的人脸特征库实现
+ *
+ * 把数据库中的特征一次性加载到连续内存，识别时直接做向量化点积扫描，
+ * 不再逐行解码 SQLite BLOB。支持 FP32 / FP16 / INT8 三种行格式。
+ * 共享模式下同一块特征矩阵以文件映射的形式在多个进程之间共享。
+ */
+
+#include "FeatureGallery.h"
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// 行对齐字节数 (一个 cache line)
+static const size_t ROW_ALIGN = 64;
+
+/**
+ * @brief 计算两个向量的点积
+ * @param a 向量a
+ * @param b 向量b
+ * @param n 元素个数
+ * @return 点积 Σ(a[i] * b[i])
+ *
+ * NEON 版本用 4 组累加器隐藏 FMA 延迟，每次迭代处理 16 个 float
+ */
+static inline float dotProduct(const float* a, const float* b, int n) {
+    int i = 0;
+    float sum = 0.0f;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t s0 = vdupq_n_f32(0.0f), s1 = s0, s2 = s0, s3 = s0;
+    for (; i + 16 <= n; i += 16) {
+        s0 = vfmaq_f32(s0, vld1q_f32(a + i),      vld1q_f32(b + i));
+        s1 = vfmaq_f32(s1, vld1q_f32(a + i + 4),  vld1q_f32(b + i + 4));
+        s2 = vfmaq_f32(s2, vld1q_f32(a + i + 8),  vld1q_f32(b + i + 8));
+        s3 = vfmaq_f32(s3, vld1q_f32(a + i + 12), vld1q_f32(b + i + 12));
+    }
+    sum = vaddvq_f32(vaddq_f32(vaddq_f32(s0, s1), vaddq_f32(s2, s3)));
+#endif
+    for (; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+// ---------------------------------------------------------
+// FP16 编解码 (IEEE 754 binary16，就近舍入到偶数)
+// ---------------------------------------------------------
+static inline uint16_t floatToHalf(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exp = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+
+    if (exp <= 0) {
+        // 非规格化数或下溢为 0
+        if (exp < -10) return (uint16_t)sign;
+        mant |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - exp);
+        uint32_t half = mant >> shift;
+        uint32_t rem = mant & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1))) half++;
+        return (uint16_t)(sign | half);
+    }
+    if (exp >= 31) return (uint16_t)(sign | 0x7c00);
+
+    uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+    uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;   // 进位可能进入指数，结果仍正确
+    return (uint16_t)half;
+}
+
+static inline float halfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            x = sign;
+        } else {
+            // 非规格化数：移位规格化
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400)) { mant <<= 1; exp--; }
+            x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        }
+    } else if (exp == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// FP32 查询与 FP16 行的点积
+static inline float dotHalf(const float* a, const uint16_t* b, int n) {
+    int i = 0;
+    float sum = 0.0f;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    float32x4_t s0 = vdupq_n_f32(0.0f), s1 = s0;
+    for (; i + 8 <= n; i += 8) {
+        float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(b + i));
+        s0 = vfmaq_f32(s0, vld1q_f32(a + i),     vcvt_f32_f16(vget_low_f16(h)));
+        s1 = vfmaq_f32(s1, vld1q_f32(a + i + 4), vcvt_high_f32_f16(h));
+    }
+    sum = vaddvq_f32(vaddq_f32(s0, s1));
+#endif
+    for (; i < n; i++) sum += a[i] * halfToFloat(b[i]);
+    return sum;
+}
+
+// INT8 点积：有 dotprod 扩展时用 sdot (一条指令 16 组乘加)，否则 smull + 成对累加
+static inline int32_t dotInt8(const int8_t* a, const int8_t* b, int n) {
+    int i = 0;
+    int32_t sum = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    int32x4_t acc = vdupq_n_s32(0);
+#if defined(__ARM_FEATURE_DOTPROD)
+    for (; i + 16 <= n; i += 16) {
+        acc = vdotq_s32(acc, vld1q_s8(a + i), vld1q_s8(b + i));
+    }
+#else
+    for (; i + 16 <= n; i += 16) {
+        int8x16_t va = vld1q_s8(a + i);
+        int8x16_t vb = vld1q_s8(b + i);
+        acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(va), vget_low_s8(vb)));
+        acc = vpadalq_s16(acc, vmull_high_s8(va, vb));
+    }
+#endif
+    sum = vaddvq_s32(acc);
+#endif
+    for (; i < n; i++) sum += (int32_t)a[i] * (int32_t)b[i];
+    return sum;
+}
+
+// 对称量化：scale = max|x| / 127，返回反量化系数
+static float quantizeInt8(const float* src, int n, int8_t* dst) {
+    float max_abs = 0.0f;
+    for (int i = 0; i < n; i++) max_abs = std::max(max_abs, std::fabs(src[i]));
+    if (max_abs < 1e-12f) {
+        std::memset(dst, 0, n);
+        return 0.0f;
+    }
+    float scale = max_abs / 127.0f;
+    float inv = 1.0f / scale;
+    for (int i = 0; i < n; i++) {
+        int q = (int)std::lround(src[i] * inv);
+        dst[i] = (int8_t)std::max(-127, std::min(127, q));
+    }
+    return scale;
+}
+
+static size_t elementSize(FeatureGallery::Format format) {
+    switch (format) {
+    case FeatureGallery::FORMAT_FP16: return sizeof(uint16_t);
+    case FeatureGallery::FORMAT_INT8: return sizeof(int8_t);
+    default:                          return sizeof(float);
+    }
+}
+
+// ---------------------------------------------------------
+// 共享文件布局
+// ---------------------------------------------------------
+namespace {
+const char SHARED_MAGIC[4] = { 'F', 'G', 'S', 'H' };
+const uint32_t SHARED_VERSION = 1;
+const size_t SHARED_HEADER_BYTES = 4096;
+
+/**
+ * @brief 共享文件头 (文件开头 4KB)
+ *
+ * 之后依次为 capacity 个 int32 ID、capacity 个 float scale (各自 64 字节对齐)、
+ * 页对齐的 capacity x row_bytes 特征矩阵。写入者先写好行内容再 release 递增 count / generation，
+ * 读者 acquire 读取 count 后只访问前 count 行
+ */
+struct SharedHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t dim;
+    uint32_t stride;
+    uint32_t row_bytes;
+    uint64_t capacity;
+    uint64_t ids_offset;
+    uint64_t scales_offset;
+    uint64_t data_offset;
+    std::atomic<uint64_t> count;        // 已发布的行数
+    std::atomic<uint64_t> generation;   // 每次写入后加一
+    std::atomic<uint64_t> epoch;        // 清空时加一：之前的行号全部失效
+    std::atomic<uint32_t> writing;      // 正在原地改写已有行 (写入者崩溃后残留为 1)
+    std::atomic<uint32_t> superseded;   // 已被新文件替换，读者需要重新映射
+};
+static_assert(sizeof(SharedHeader) <= SHARED_HEADER_BYTES, "shared header too large");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared header needs lock-free atomics");
+
+inline size_t alignUp(size_t v, size_t a) {
+    return (v + a - 1) / a * a;
+}
+
+inline SharedHeader* headerOf(void* map) {
+    return static_cast<SharedHeader*>(map);
+}
+}
+
+// ---------------------------------------------------------
+// FeatureGallery
+// ---------------------------------------------------------
+FeatureGallery::FeatureGallery()
+    : m_format(FORMAT_FP32), m_data(nullptr), m_ids(nullptr), m_scales(nullptr),
+      m_size(0), m_capacity(0), m_dim(0), m_stride(0), m_rowBytes(0),
+      m_lockFd(-1), m_map(nullptr), m_mapBytes(0), m_generation(0), m_epoch(0), m_writing(false),
+      m_holding(false), m_publishedSize(0) {
+}
+
+FeatureGallery::~FeatureGallery() {
+    releaseStorage();
+    if (m_lockFd >= 0) ::close(m_lockFd);
+}
+
+void FeatureGallery::releaseStorage() {
+    if (m_map) {
+        munmap(m_map, m_mapBytes);
+        m_map = nullptr;
+        m_mapBytes = 0;
+    } else {
+        free(m_data);
+        free(m_ids);
+        free(m_scales);
+    }
+    m_data = nullptr;
+    m_ids = nullptr;
+    m_scales = nullptr;
+    m_size = 0;
+    m_capacity = 0;
+}
+
+int FeatureGallery::setFormat(Format format) {
+    if (format == m_format) return 0;
+    if (m_size > 0 || m_map) return -1;
+
+    // 行字节数随格式变化，丢弃旧的内存布局
+    releaseStorage();
+    m_dim = 0;
+    m_stride = 0;
+    m_rowBytes = 0;
+    m_format = format;
+    return 0;
+}
+
+float FeatureGallery::innerProduct(const float* a, const float* b, int dim) {
+    return dotProduct(a, b, dim);
+}
+
+float FeatureGallery::cosineSimilarity(const float* a, const float* b, int dim) {
+    float norm_a = std::sqrt(dotProduct(a, a, dim));
+    float norm_b = std::sqrt(dotProduct(b, b, dim));
+    if (norm_a < 1e-6f || norm_b < 1e-6f) return 0.0f;
+    return dotProduct(a, b, dim) / (norm_a * norm_b);
+}
+
+bool FeatureGallery::reserve(size_t rows) {
+    if (rows <= m_capacity) return true;
+
+    // 容量按 2 倍增长，避免逐个录入时反复拷贝
+    size_t new_capacity = m_capacity ? m_capacity : 64;
+    while (new_capacity < rows) new_capacity *= 2;
+
+    if (m_map) {
+        return writeSharedFile(new_capacity) == 0;
+    }
+
+    void* mem = nullptr;
+    if (posix_memalign(&mem, ROW_ALIGN, new_capacity * m_rowBytes) != 0) {
+        return false;
+    }
+    int32_t* ids = static_cast<int32_t*>(realloc(m_ids, new_capacity * sizeof(int32_t)));
+    if (ids) m_ids = ids;
+    float* scales = ids ? static_cast<float*>(realloc(m_scales, new_capacity * sizeof(float))) : nullptr;
+    if (scales) m_scales = scales;
+    if (!ids || !scales) {
+        free(mem);
+        return false;
+    }
+    if (m_data) {
+        std::memcpy(mem, m_data, m_size * m_rowBytes);
+        free(m_data);
+    }
+    m_data = static_cast<unsigned char*>(mem);
+    m_capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @brief 添加一行特征
+ * @param id 人脸ID
+ * @param feature 特征向量
+ * @param dim 特征维度
+ * @return 成功返回0，失败返回-1
+ */
+int FeatureGallery::add(int id, const float* feature, int dim) {
+    if (!feature || dim <= 0) return -1;
+    if (m_dim == 0) {
+        // 第一行决定布局；共享文件中还没有行，容量清零后由 reserve 按新的行字节数重写
+        m_dim = dim;
+        m_stride = (dim + 15) / 16 * 16;
+        m_rowBytes = m_stride * elementSize(m_format);
+        if (m_map) m_capacity = 0;
+    }
+    if (dim != m_dim) return -1;
+    if (m_map && !m_writing) return -1;
+    if (!reserve(m_size + 1)) return -1;
+
+    encodeRow(m_size, feature, dim);
+    m_ids[m_size] = id;
+    m_size++;
+    if (m_map && !m_holding) {
+        headerOf(m_map)->count.store(m_size, std::memory_order_release);
+        publishWrite();
+    }
+    return 0;
+}
+
+int FeatureGallery::update(int id, const float* feature, int dim) {
+    if (!feature || dim != m_dim) return -1;
+    if (m_map && !m_writing) return -1;
+    int r = rowOf(id);
+    if (r < 0) return -1;
+    // 其他进程正在读已发布的行，改写推迟到提交之后；本次事务新增的行可以直接改
+    if (m_holding && (size_t)r < m_publishedSize) {
+        m_pendingUpdates.emplace_back(id, std::vector<float>(feature, feature + dim));
+        return 0;
+    }
+    if (m_holding) {
+        encodeRow(r, feature, dim);
+        return 0;
+    }
+
+    // 原地改写期间读者可能读到半新半旧的一行 (只影响该次的近似相似度)；
+    // writing 标记留给下次启动判断上次写入是否中断
+    if (m_map) headerOf(m_map)->writing.store(1, std::memory_order_release);
+    encodeRow(r, feature, dim);
+    if (m_map) {
+        headerOf(m_map)->writing.store(0, std::memory_order_release);
+        publishWrite();
+    }
+    return 0;
+}
+
+int FeatureGallery::rowOf(int id) const {
+    for (size_t r = 0; r < m_size; r++) {
+        if (m_ids[r] == id) return (int)r;
+    }
+    return -1;
+}
+
+void FeatureGallery::encodeRow(size_t r, const float* feature, int dim) {
+    // 先归一化，再按存储格式编码，补齐部分置零
+    std::vector<float> normalized(m_stride, 0.0f);
+    float norm = std::sqrt(dotProduct(feature, feature, dim));
+    float inv = norm < 1e-6f ? 0.0f : 1.0f / norm;
+    for (int i = 0; i < dim; i++) normalized[i] = feature[i] * inv;
+
+    unsigned char* row = m_data + r * m_rowBytes;
+    switch (m_format) {
+    case FORMAT_FP16: {
+        uint16_t* dst = reinterpret_cast<uint16_t*>(row);
+        for (int i = 0; i < m_stride; i++) dst[i] = floatToHalf(normalized[i]);
+        break;
+    }
+    case FORMAT_INT8:
+        m_scales[r] = quantizeInt8(normalized.data(), m_stride, reinterpret_cast<int8_t*>(row));
+        break;
+    default:
+        std::memcpy(row, normalized.data(), m_rowBytes);
+        break;
+    }
+}
+
+void FeatureGallery::clear() {
+    m_size = 0;
+    if (m_map && m_writing) {
+        SharedHeader* h = headerOf(m_map);
+        h->count.store(0, std::memory_order_release);
+        h->epoch.fetch_add(1, std::memory_order_acq_rel);
+        m_epoch = h->epoch.load(std::memory_order_acquire);
+        publishWrite();
+    }
+}
+
+// ---------------------------------------------------------
+// 共享模式
+// ---------------------------------------------------------
+/**
+ * @brief 指定共享文件并打开锁文件
+ * @param path 共享文件路径
+ * @return 成功返回0，失败返回-1
+ *
+ * 锁放在单独的文件上：共享文件扩容时会被新文件替换，锁必须跨替换保持不变
+ */
+int FeatureGallery::openShared(const std::string& path) {
+    if (m_lockFd >= 0) ::close(m_lockFd);
+    m_sharedPath = path;
+    m_lockFd = ::open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    return m_lockFd >= 0 ? 0 : -1;
+}
+
+int FeatureGallery::mapSharedFile() {
+    int fd = ::open(m_sharedPath.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= SHARED_HEADER_BYTES) {
+        map = mmap(nullptr, st.st_size, m_writing ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    // 校验布局：各段必须落在文件范围内
+    const SharedHeader* h = headerOf(map);
+    size_t bytes = st.st_size;
+    bool ok = std::memcmp(h->magic, SHARED_MAGIC, 4) == 0 && h->version == SHARED_VERSION
+              && h->format <= FORMAT_INT8
+              && h->ids_offset + h->capacity * sizeof(int32_t) <= bytes
+              && h->scales_offset + h->capacity * sizeof(float) <= bytes
+              && h->data_offset + h->capacity * h->row_bytes <= bytes
+              && h->count.load(std::memory_order_acquire) <= h->capacity
+              && h->row_bytes == h->stride * elementSize((Format)h->format)
+              && (h->data_offset % ROW_ALIGN) == 0;
+    if (!ok) {
+        munmap(map, bytes);
+        return -1;
+    }
+
+    releaseStorage();
+    m_map = map;
+    m_mapBytes = bytes;
+    m_format = (Format)h->format;
+    m_dim = h->dim;
+    m_stride = h->stride;
+    m_rowBytes = h->row_bytes;
+    m_capacity = h->capacity;
+    unsigned char* base = static_cast<unsigned char*>(map);
+    m_ids = reinterpret_cast<int32_t*>(base + h->ids_offset);
+    m_scales = reinterpret_cast<float*>(base + h->scales_offset);
+    m_data = base + h->data_offset;
+    m_generation = h->generation.load(std::memory_order_acquire);
+    m_epoch = h->epoch.load(std::memory_order_acquire);
+    m_size = h->count.load(std::memory_order_acquire);
+    return 0;
+}
+
+/**
+ * @brief 映射已有的共享文件
+ * @return 成功返回0；文件不存在、布局不符、已被替换或上次原地写入中断时返回-1
+ *
+ * 调用方应持有写锁 (beginWrite)，避免把正在进行的写入误判为中断
+ */
+int FeatureGallery::attachShared() {
+    if (m_lockFd < 0 || mapSharedFile() != 0) return -1;
+    const SharedHeader* h = headerOf(m_map);
+    if (h->writing.load(std::memory_order_acquire) != 0 || h->superseded.load(std::memory_order_acquire) != 0) {
+        detachShared();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 把当前内容写成新的共享文件并切换到共享模式
+ * @return 成功返回0，失败返回-1 (保持原来的存储)
+ */
+int FeatureGallery::publishShared() {
+    if (m_lockFd < 0) return -1;
+    return writeSharedFile(std::max<size_t>(m_capacity, 64));
+}
+
+void FeatureGallery::detachShared() {
+    if (!m_map) return;
+    releaseStorage();
+    m_dim = 0;
+    m_stride = 0;
+    m_rowBytes = 0;
+}
+
+/**
+ * @brief 写出新的共享文件
+ * @param capacity 新文件的行容量
+ * @return 成功返回0，失败返回-1
+ *
+ * 先写临时文件再 rename 原子替换，已映射旧文件的进程不受影响；
+ * 替换后在旧文件头部标记 superseded 并递增 generation，读者下次 sync 时重新映射
+ */
+int FeatureGallery::writeSharedFile(size_t capacity) {
+    if (m_map && !m_writing) return -1;
+
+    size_t ids_offset = SHARED_HEADER_BYTES;
+    size_t scales_offset = alignUp(ids_offset + capacity * sizeof(int32_t), ROW_ALIGN);
+    size_t data_offset = alignUp(scales_offset + capacity * sizeof(float), 4096);
+    size_t bytes = data_offset + capacity * m_rowBytes;
+
+    std::string tmp_path = m_sharedPath + ".tmp";
+    int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, bytes) == 0) {
+        map = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        std::remove(tmp_path.c_str());
+        return -1;
+    }
+
+    unsigned char* base = static_cast<unsigned char*>(map);
+    SharedHeader* h = new (map) SharedHeader();
+    std::memcpy(h->magic, SHARED_MAGIC, 4);
+    h->version = SHARED_VERSION;
+    h->format = m_format;
+    h->dim = m_dim;
+    h->stride = m_stride;
+    h->row_bytes = m_rowBytes;
+    h->capacity = capacity;
+    h->ids_offset = ids_offset;
+    h->scales_offset = scales_offset;
+    h->data_offset = data_offset;
+    if (m_size > 0) {
+        std::memcpy(base + ids_offset, m_ids, m_size * sizeof(int32_t));
+        if (m_format == FORMAT_INT8) std::memcpy(base + scales_offset, m_scales, m_size * sizeof(float));
+        std::memcpy(base + data_offset, m_data, m_size * m_rowBytes);
+    }
+    // 暂缓发布期间换文件：新文件同样只公开已发布的行
+    h->count.store(m_holding ? m_publishedSize : m_size, std::memory_order_relaxed);
+    h->generation.store(m_map ? headerOf(m_map)->generation.load(std::memory_order_relaxed) + 1 : 1,
+                        std::memory_order_relaxed);
+    h->epoch.store(m_map ? headerOf(m_map)->epoch.load(std::memory_order_relaxed) + 1 : 1,
+                   std::memory_order_relaxed);
+    h->writing.store(0, std::memory_order_relaxed);
+    h->superseded.store(0, std::memory_order_release);
+
+    if (rename(tmp_path.c_str(), m_sharedPath.c_str()) != 0) {
+        munmap(map, bytes);
+        std::remove(tmp_path.c_str());
+        return -1;
+    }
+    if (m_map) {
+        SharedHeader* old = headerOf(m_map);
+        old->superseded.store(1, std::memory_order_release);
+        old->generation.fetch_add(1, std::memory_order_release);
+    }
+    if (!m_writing) mprotect(map, bytes, PROT_READ);
+
+    size_t size = m_size;
+    releaseStorage();
+    m_map = map;
+    m_mapBytes = bytes;
+    m_capacity = capacity;
+    m_ids = reinterpret_cast<int32_t*>(base + ids_offset);
+    m_scales = reinterpret_cast<float*>(base + scales_offset);
+    m_data = base + data_offset;
+    m_size = size;
+    m_generation = h->generation.load(std::memory_order_relaxed);
+    m_epoch = h->epoch.load(std::memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief 开始写入：持有文件锁，临时开启映射的写权限
+ * @return 成功返回0，失败返回-1
+ *
+ * 调用方随后应先 sync()，在最新的内容上追加，避免覆盖其他进程刚写入的行
+ */
+int FeatureGallery::beginWrite() {
+    if (m_lockFd < 0) return 0;
+    if (flock(m_lockFd, LOCK_EX) != 0) return -1;
+    m_writing = true;
+    if (m_map && mprotect(m_map, m_mapBytes, PROT_READ | PROT_WRITE) != 0) {
+        m_writing = false;
+        flock(m_lockFd, LOCK_UN);
+        return -1;
+    }
+    return 0;
+}
+
+void FeatureGallery::endWrite() {
+    if (m_lockFd < 0 || !m_writing) return;
+    if (m_map) mprotect(m_map, m_mapBytes, PROT_READ);
+    m_writing = false;
+    flock(m_lockFd, LOCK_UN);
+}
+
+void FeatureGallery::holdPublish() {
+    if (!m_map || !m_writing || m_holding) return;
+    m_holding = true;
+    m_publishedSize = m_size;
+    m_pendingUpdates.clear();
+}
+
+/**
+ * @brief 结束暂缓发布
+ * @param commit 数据库事务是否已提交
+ *
+ * 提交：应用排队的改写，再更新行数并递增 generation，其他进程下次 sync 时一次看到全部变化。
+ * 回滚：截掉本次事务追加的行 (其他进程从未看到过它们)，丢弃排队的改写
+ */
+void FeatureGallery::releasePublish(bool commit) {
+    if (!m_holding) return;
+    m_holding = false;
+    if (!commit) {
+        m_size = m_publishedSize;
+        m_pendingUpdates.clear();
+        return;
+    }
+    for (const auto& pending : m_pendingUpdates) {
+        update(pending.first, pending.second.data(), (int)pending.second.size());
+    }
+    m_pendingUpdates.clear();
+    if (m_size != m_publishedSize) {
+        headerOf(m_map)->count.store(m_size, std::memory_order_release);
+        publishWrite();
+    }
+}
+
+void FeatureGallery::publishWrite() {
+    SharedHeader* h = headerOf(m_map);
+    m_generation = h->generation.fetch_add(1, std::memory_order_release) + 1;
+}
+
+/**
+ * @brief 检查其他进程的写入
+ * @param first_new_row 输出参数，SYNC_CHANGED 时为新增行的起始行号
+ * @return 变化类型
+ *
+ * 没有变化时只有一次原子读；文件被替换时重新映射 (失败则继续使用旧映射)
+ */
+FeatureGallery::SyncResult FeatureGallery::sync(size_t& first_new_row) {
+    first_new_row = m_size;
+    if (!m_map) return SYNC_NONE;
+
+    SharedHeader* h = headerOf(m_map);
+    uint64_t generation = h->generation.load(std::memory_order_acquire);
+    if (generation == m_generation) return SYNC_NONE;
+
+    if (h->superseded.load(std::memory_order_acquire) != 0) {
+        m_generation = generation;
+        if (mapSharedFile() != 0) return SYNC_NONE;
+        first_new_row = 0;
+        return SYNC_RESET;
+    }
+
+    m_generation = generation;
+    uint64_t epoch = h->epoch.load(std::memory_order_acquire);
+    m_size = h->count.load(std::memory_order_acquire);
+    if (epoch != m_epoch) {
+        m_epoch = epoch;
+        first_new_row = 0;
+        return SYNC_RESET;
+    }
+    // 行数只会增长 (清空会改变 epoch)
+    if (first_new_row > m_size) first_new_row = m_size;
+    return SYNC_CHANGED;
+}
+
+bool FeatureGallery::prepareQuery(const float* query, int dim, FrameArena& arena, Query& q) const {
+    if (m_size == 0 || dim != m_dim) return false;
+
+    q.fp32 = arena.alloc<float>(m_stride);
+    if (!q.fp32) return false;
+    float norm = std::sqrt(dotProduct(query, query, dim));
+    float inv = norm < 1e-6f ? 0.0f : 1.0f / norm;
+    for (int i = 0; i < dim; i++) q.fp32[i] = query[i] * inv;
+    for (int i = dim; i < m_stride; i++) q.fp32[i] = 0.0f;
+
+    if (m_format == FORMAT_INT8) {
+        q.int8 = arena.alloc<int8_t>(m_stride);
+        if (!q.int8) return false;
+        q.int8_scale = quantizeInt8(q.fp32, m_stride, q.int8);
+    }
+    return true;
+}
+
+float FeatureGallery::rowSimilarity(const Query& q, size_t r) const {
+    const unsigned char* row = m_data + r * m_rowBytes;
+    switch (m_format) {
+    case FORMAT_FP16:
+        return dotHalf(q.fp32, reinterpret_cast<const uint16_t*>(row), m_dim);
+    case FORMAT_INT8:
+        return (float)dotInt8(q.int8, reinterpret_cast<const int8_t*>(row), m_stride)
+               * q.int8_scale * m_scales[r];
+    default:
+        return dotProduct(q.fp32, reinterpret_cast<const float*>(row), m_dim);
+    }
+}
+
+/**
+ * @brief 查找最相似的一行
+ * @param query 查询特征
+ * @param dim 查询特征维度
+ * @param similarity 输出参数，最大余弦相似度 (压缩格式下为近似值)
+ * @param arena 查询向量所用的临时内存，为空时使用局部临时内存
+ * @return 最相似行的人脸ID，未找到返回-1
+ */
+int FeatureGallery::searchBest(const float* query, int dim, float& similarity, FrameArena* arena) const {
+    similarity = 0.0f;
+    FrameArena local(0);
+    FrameArena& scratch = arena ? *arena : local;
+    FrameArena::Scope scope(scratch);
+    Query q;
+    if (!prepareQuery(query, dim, scratch, q)) return -1;
+
+    int best = 0;
+    float best_sim = rowSimilarity(q, 0);
+    for (size_t r = 1; r < m_size; r++) {
+        float sim = rowSimilarity(q, r);
+        if (sim > best_sim) {
+            best_sim = sim;
+            best = (int)r;
+        }
+    }
+
+    similarity = best_sim;
+    return m_ids[best];
+}
+
+/**
+ * @brief 查找最相似的 k 行
+ * @param query 查询特征
+ * @param dim 查询特征维度
+ * @param k 需要的结果个数
+ * @param out 输出结果，按相似度降序
+ * @param arena 查询向量所用的临时内存，为空时使用局部临时内存
+ * @return 实际返回的结果个数
+ */
+int FeatureGallery::searchTopK(const float* query, int dim, int k, std::vector<GalleryMatch>& out,
+                               FrameArena* arena) const {
+    out.clear();
+    FrameArena local(0);
+    FrameArena& scratch = arena ? *arena : local;
+    FrameArena::Scope scope(scratch);
+    Query q;
+    if (k <= 0 || !prepareQuery(query, dim, scratch, q)) return 0;
+    out.reserve(k);
+
+    for (size_t r = 0; r < m_size; r++) {
+        pushTopK(out, k, GalleryMatch{ m_ids[r], rowSimilarity(q, r) });
+    }
+    return (int)out.size();
+}
+
+/**
+ * @brief 在指定的行中查找最相似的 k 行
+ * @param query 查询特征
+ * @param dim 查询特征维度
+ * @param rows 候选行号 (来自 ANN 索引的倒排表)
+ * @param count 候选行数
+ * @param k 需要的结果个数
+ * @param out 输出结果，按相似度降序
+ * @param arena 查询向量所用的临时内存，为空时使用局部临时内存
+ * @return 实际返回的结果个数
+ */
+int FeatureGallery::searchTopKInRows(const float* query, int dim, const uint32_t* rows, size_t count,
+                                     int k, std::vector<GalleryMatch>& out, FrameArena* arena) const {
+    out.clear();
+    FrameArena local(0);
+    FrameArena& scratch = arena ? *arena : local;
+    FrameArena::Scope scope(scratch);
+    Query q;
+    if (k <= 0 || !prepareQuery(query, dim, scratch, q)) return 0;
+    out.reserve(k);
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t r = rows[i];
+        if (r >= m_size) continue;
+        pushTopK(out, k, GalleryMatch{ m_ids[r], rowSimilarity(q, r) });
+    }
+    return (int)out.size();
+}
+
+void FeatureGallery::pushTopK(std::vector<GalleryMatch>& out, int k, const GalleryMatch& match) {
+    if ((int)out.size() == k && match.similarity <= out.back().similarity) return;
+
+    // k 通常很小，插入排序维护有序结果
+    if ((int)out.size() < k) out.push_back(match);
+    else out.back() = match;
+    for (size_t i = out.size() - 1; i > 0 && out[i].similarity > out[i - 1].similarity; i--) {
+        std::swap(out[i], out[i - 1]);
+    }
+}
+
+void FeatureGallery::decodeRow(size_t r, float* out) const {
+    const unsigned char* row = m_data + r * m_rowBytes;
+    switch (m_format) {
+    case FORMAT_FP16: {
+        const uint16_t* src = reinterpret_cast<const uint16_t*>(row);
+        for (int i = 0; i < m_dim; i++) out[i] = halfToFloat(src[i]);
+        break;
+    }
+    case FORMAT_INT8: {
+        const int8_t* src = reinterpret_cast<const int8_t*>(row);
+        for (int i = 0; i < m_dim; i++) out[i] = src[i] * m_scales[r];
+        break;
+    }
+    default:
+        std::memcpy(out, row, m_dim * sizeof(float));
+        break;
+    }
+}
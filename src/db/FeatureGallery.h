@@ -0,0 +1,173 @@
+#ifndef FEATUREGALLERY_H
+#define FEATUREGALLERY_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "common/FrameArena.h"
+
+// 检索结果：人脸ID与余弦相似度
+struct GalleryMatch {
+    int id;
+    float similarity;
+};
+
+/**
+ * @brief 常驻内存的人脸特征库
+ *
+ * 所有特征按行存放在一块 64 字节对齐的连续内存中 (行跨度补齐到 16 个元素)，
+ * 入库时做 L2 归一化，检索时只需计算点积即为余弦相似度。
+ * 行的存储格式可选：
+ *   - FORMAT_FP32：原始精度，NEON FMA 扫描
+ *   - FORMAT_FP16：半精度，内存减半，扫描时 vcvt 转回 FP32
+ *   - FORMAT_INT8：对称量化 + 每行一个 scale，内存 1/4，
+ *                  扫描用整数点积 (支持 dotprod 扩展时为 sdot)
+ * 压缩格式的相似度是近似值，需要精确结果时由调用方对 top-k 候选做 FP32 重排。
+ * 与 FaceDatabase 一样非线程安全，由持有者保证串行访问。
+ *
+ * 共享模式 (openShared / attachShared / publishShared) 下特征矩阵位于一个按固定布局
+ * (头部 + ID 数组 + scale 数组 + 对齐的特征矩阵) 写成的文件中，各进程 MAP_SHARED 只读映射，
+ * 同一份页缓存零拷贝共享。写入者在 beginWrite / endWrite 之间持有文件锁并临时开启写权限，
+ * 追加行后递增头部的 generation；其他进程 sync() 时发现 generation 变化即可看到新行，
+ * 容量不足时写出更大的新文件原子替换旧文件，并在旧文件头部标记 superseded 通知其他进程重新映射。
+ */
+class FeatureGallery {
+public:
+    enum Format {
+        FORMAT_FP32 = 0,
+        FORMAT_FP16,
+        FORMAT_INT8
+    };
+
+    FeatureGallery();
+    ~FeatureGallery();
+
+    FeatureGallery(const FeatureGallery&) = delete;
+    FeatureGallery& operator=(const FeatureGallery&) = delete;
+
+    // sync() 的结果
+    enum SyncResult {
+        SYNC_NONE = 0,      // 没有变化
+        SYNC_CHANGED,       // 其他进程追加了行 (从 first_new_row 开始) 或原地改写了行
+        SYNC_RESET          // 库被清空或重新映射，行号全部失效
+    };
+
+    // 设置存储格式，只能在库为空且非共享模式时调用 (已有数据时返回 -1)
+    int setFormat(Format format);
+    Format format() const { return m_format; }
+
+    // 添加一行特征 (拷贝、归一化并按存储格式编码)；第一行决定特征维度，维度不符返回 -1
+    int add(int id, const float* feature, int dim);
+    // 用新特征覆盖指定ID所在的行 (多模板身份的中心向量更新后调用)，找不到或维度不符返回 -1
+    int update(int id, const float* feature, int dim);
+
+    // 清空所有特征 (保留已分配的内存)
+    void clear();
+
+    int size() const { return (int)m_size; }
+    int dim() const { return m_dim; }
+    // 特征矩阵占用的字节数
+    size_t memoryBytes() const { return m_capacity * m_rowBytes + (m_format == FORMAT_INT8 ? m_capacity * sizeof(float) : 0); }
+
+    // 指定共享文件路径并打开其锁文件 (<path>.lock)，成功返回0；之后才能调用下列共享接口
+    int openShared(const std::string& path);
+    // 映射已有的共享文件 (格式与维度取自文件)，文件不存在、布局不符或上次写入中断返回 -1
+    int attachShared();
+    // 把当前内容写成新的共享文件 (原子替换已有文件) 并切换到共享模式，成功返回0
+    int publishShared();
+    // 放弃共享映射，回到空的私有内存库 (保留锁文件)
+    void detachShared();
+    bool isShared() const { return m_map != nullptr; }
+
+    // 写入 (add / update / clear) 前后调用：持有文件锁期间映射可写；非共享模式下为空操作
+    int beginWrite();
+    void endWrite();
+
+    // 数据库事务期间 (beginWrite 之后) 暂缓发布：新行只对本进程可见，对已发布行的 update 排队，
+    // releasePublish(true) 在提交成功后一次性应用并发布；false 丢弃未发布的行与排队的改写。
+    // 非共享模式下为空操作
+    void holdPublish();
+    void releasePublish(bool commit);
+
+    // 检查其他进程的写入，first_new_row 输出新增行的起始行号
+    SyncResult sync(size_t& first_new_row);
+
+    // 以下检索接口的 arena 为调用方的每帧临时内存，预处理后的查询向量从中分配；
+    // 为空时使用局部临时内存 (每次查询有堆分配)。out 跨查询复用时不再重新分配
+
+    // 查找最相似的一行：返回其ID并输出相似度，库为空或维度不符返回 -1
+    int searchBest(const float* query, int dim, float& similarity, FrameArena* arena = nullptr) const;
+
+    // 查找最相似的 k 行，结果按相似度降序写入 out，返回实际个数
+    int searchTopK(const float* query, int dim, int k, std::vector<GalleryMatch>& out,
+                   FrameArena* arena = nullptr) const;
+
+    // 只在指定的 count 行 (行号) 中查找最相似的 k 行，供 ANN 索引的倒排表使用
+    int searchTopKInRows(const float* query, int dim, const uint32_t* rows, size_t count,
+                         int k, std::vector<GalleryMatch>& out, FrameArena* arena = nullptr) const;
+
+    // 第 r 行的人脸ID
+    int idAt(size_t r) const { return m_ids[r]; }
+    // 按ID查找行号，找不到返回 -1
+    int rowOf(int id) const;
+    // 把第 r 行解码为归一化的 FP32 向量 (out 至少 dim() 个元素)
+    void decodeRow(size_t r, float* out) const;
+
+    // 两个 FP32 向量的精确余弦相似度 (用于重排)
+    static float cosineSimilarity(const float* a, const float* b, int dim);
+    // 两个 FP32 向量的点积 (NEON)
+    static float innerProduct(const float* a, const float* b, int dim);
+
+private:
+    // 按存储格式预处理后的查询向量 (存放在查询所用的 FrameArena 中)
+    struct Query {
+        float* fp32 = nullptr;          // 归一化后的查询 (FP32 / FP16 格式使用)
+        int8_t* int8 = nullptr;         // 量化后的查询 (INT8 格式使用)
+        float int8_scale = 0.0f;
+    };
+
+    Format m_format;
+    unsigned char* m_data;      // rows x m_rowBytes 的特征矩阵
+    int32_t* m_ids;             // 每行对应的人脸ID
+    float* m_scales;            // INT8 格式每行的反量化系数
+    size_t m_size;              // 行数 (共享模式下为最近一次 sync 看到的行数)
+    size_t m_capacity;          // 已分配的行数
+    int m_dim;                  // 特征维度
+    int m_stride;               // 行跨度 (元素个数)
+    size_t m_rowBytes;          // 行跨度 (字节)
+
+    // 共享模式
+    std::string m_sharedPath;
+    int m_lockFd;
+    void* m_map;                // 共享文件的映射 (为空时是私有内存库)
+    size_t m_mapBytes;
+    uint64_t m_generation;      // 最近一次看到的头部 generation / epoch
+    uint64_t m_epoch;
+    bool m_writing;             // 处于 beginWrite / endWrite 之间
+    bool m_holding;             // 处于 holdPublish / releasePublish 之间
+    size_t m_publishedSize;     // 暂缓发布期间其他进程可见的行数
+    std::vector<std::pair<int, std::vector<float>>> m_pendingUpdates;   // 暂缓发布期间排队的改写
+
+    // 保证至少能容纳 rows 行 (共享模式下换成更大的新文件)
+    bool reserve(size_t rows);
+    // 写出容量为 capacity 的共享文件并映射，替换当前存储
+    int writeSharedFile(size_t capacity);
+    // 映射 path 处的共享文件，成功返回0
+    int mapSharedFile();
+    // 释放当前存储 (私有内存或共享映射)
+    void releaseStorage();
+    // 写入后发布：递增 generation 并记住，自己的写入不会在 sync 中被当作变化
+    void publishWrite();
+    // 归一化 feature 并按存储格式写入第 r 行 (r == size() 时为追加)
+    void encodeRow(size_t r, const float* feature, int dim);
+    // 准备查询向量 (从 arena 分配)，维度不符返回 false
+    bool prepareQuery(const float* query, int dim, FrameArena& arena, Query& q) const;
+    // 查询与第 r 行的相似度
+    float rowSimilarity(const Query& q, size_t r) const;
+    // 把一个结果放入按相似度降序的 top-k 列表
+    static void pushTopK(std::vector<GalleryMatch>& out, int k, const GalleryMatch& match);
+};
+
+#endif // FEATUREGALLERY_H
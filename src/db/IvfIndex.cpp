@@ -0,0 +1,271 @@
+/**
+ * @file IvfIndex.cpp
+ * @brief IVF-Flat 近似最近邻索引实现
+ *
+ * 大规模特征库 (数万人) 下线性扫描超过一帧的时间，IVF 把每次查询的计算量
+ * 从 N 降到约 nlist + nprobe * N / nlist 次点积。
+ */
+
+#include "IvfIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <iostream>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 索引文件格式：magic + 版本 + dim + nlist + 行数 + 簇中心 + (人脸ID, 簇号) 对
+static const char IVF_MAGIC[4] = {'F', 'I', 'V', 'F'};
+static const int32_t IVF_VERSION = 1;
+
+// 每个簇参与训练的样本数上限 (控制训练耗时)
+static const int SAMPLES_PER_LIST = 32;
+
+static void normalize(float* v, int dim) {
+    float norm = std::sqrt(FeatureGallery::innerProduct(v, v, dim));
+    if (norm < 1e-6f) return;
+    float inv = 1.0f / norm;
+    for (int i = 0; i < dim; i++) v[i] *= inv;
+}
+
+IvfIndex::IvfIndex() : m_dim(0), m_nlist(0), m_nprobe(8), m_assigned(0) {
+}
+
+void IvfIndex::clear() {
+    m_dim = 0;
+    m_nlist = 0;
+    m_assigned = 0;
+    m_centroids.clear();
+    m_lists.clear();
+}
+
+int IvfIndex::nearestCentroid(const float* v) const {
+    int best = 0;
+    float best_dot = FeatureGallery::innerProduct(v, m_centroids.data(), m_dim);
+    for (int c = 1; c < m_nlist; c++) {
+        float dot = FeatureGallery::innerProduct(v, m_centroids.data() + (size_t)c * m_dim, m_dim);
+        if (dot > best_dot) {
+            best_dot = dot;
+            best = c;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief 训练索引 (球面 k-means)
+ * @param gallery 特征库
+ * @param nlist 簇数，<= 0 时取 sqrt(N)
+ * @param iterations k-means 迭代次数
+ * @return 成功返回0，失败返回-1
+ *
+ * 训练只使用随机抽取的 nlist * 32 个样本，之后把全部行分配到最近的簇
+ */
+int IvfIndex::train(const FeatureGallery& gallery, int nlist, int iterations) {
+    clear();
+    size_t n = gallery.size();
+    int dim = gallery.dim();
+    if (n == 0 || dim <= 0) return -1;
+
+    if (nlist <= 0) nlist = (int)std::sqrt((double)n);
+    nlist = std::max(1, std::min(nlist, (int)n));
+
+    // 1. 随机抽样并解码为 FP32
+    std::mt19937 rng(20240601);
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    size_t sample_n = std::min(n, (size_t)nlist * SAMPLES_PER_LIST);
+    for (size_t i = 0; i < sample_n; i++) {
+        std::uniform_int_distribution<size_t> pick(i, n - 1);
+        std::swap(order[i], order[pick(rng)]);
+    }
+    std::vector<float> sample(sample_n * dim);
+    for (size_t i = 0; i < sample_n; i++) gallery.decodeRow(order[i], sample.data() + i * dim);
+
+    // 2. 以前 nlist 个样本为初始中心迭代
+    m_dim = dim;
+    m_nlist = nlist;
+    m_centroids.assign(sample.begin(), sample.begin() + (size_t)nlist * dim);
+
+    std::vector<float> sums((size_t)nlist * dim);
+    std::vector<int> counts(nlist);
+    std::uniform_int_distribution<size_t> pick_sample(0, sample_n - 1);
+    for (int it = 0; it < iterations; it++) {
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < sample_n; i++) {
+            const float* v = sample.data() + i * dim;
+            int c = nearestCentroid(v);
+            float* sum = sums.data() + (size_t)c * dim;
+            for (int d = 0; d < dim; d++) sum[d] += v[d];
+            counts[c]++;
+        }
+        for (int c = 0; c < nlist; c++) {
+            float* centroid = m_centroids.data() + (size_t)c * dim;
+            if (counts[c] == 0) {
+                // 空簇：用一个随机样本重新播种
+                const float* v = sample.data() + pick_sample(rng) * dim;
+                std::copy(v, v + dim, centroid);
+            } else {
+                const float* sum = sums.data() + (size_t)c * dim;
+                std::copy(sum, sum + dim, centroid);
+                normalize(centroid, dim);
+            }
+        }
+    }
+
+    // 3. 分配全部行
+    m_lists.assign(nlist, std::vector<uint32_t>());
+    std::vector<float> row(dim);
+    for (size_t r = 0; r < n; r++) {
+        gallery.decodeRow(r, row.data());
+        m_lists[nearestCentroid(row.data())].push_back((uint32_t)r);
+    }
+    m_assigned = n;
+    return 0;
+}
+
+void IvfIndex::add(const FeatureGallery& gallery, size_t row) {
+    if (!trained() || gallery.dim() != m_dim || row >= (size_t)gallery.size()) return;
+
+    std::vector<float> v(m_dim);
+    gallery.decodeRow(row, v.data());
+    m_lists[nearestCentroid(v.data())].push_back((uint32_t)row);
+    m_assigned++;
+}
+
+/**
+ * @brief 近似查找最相似的 k 行
+ * @param gallery 特征库
+ * @param query 查询特征
+ * @param dim 查询特征维度
+ * @param k 需要的结果个数
+ * @param out 输出结果，按相似度降序
+ * @return 实际返回的结果个数
+ */
+int IvfIndex::search(const FeatureGallery& gallery, const float* query, int dim, int k,
+                     std::vector<GalleryMatch>& out, FrameArena* arena) const {
+    out.clear();
+    if (!trained() || dim != m_dim) return 0;
+    FrameArena local(0);
+    FrameArena& scratch = arena ? *arena : local;
+    FrameArena::Scope scope(scratch);
+
+    // 1. 选出最接近的 nprobe 个簇 (查询无需归一化，排序不受影响)
+    struct ClusterScore { float score; int cluster; };
+    ClusterScore* scores = scratch.alloc<ClusterScore>(m_nlist);
+    if (!scores) return 0;
+    for (int c = 0; c < m_nlist; c++) {
+        scores[c].score = FeatureGallery::innerProduct(query, m_centroids.data() + (size_t)c * m_dim, m_dim);
+        scores[c].cluster = c;
+    }
+    int probe = std::min(m_nprobe, m_nlist);
+    std::partial_sort(scores, scores + probe, scores + m_nlist,
+        [](const ClusterScore& a, const ClusterScore& b) { return a.score > b.score; });
+
+    // 2. 只扫描这些簇中的行
+    size_t count = 0;
+    for (int i = 0; i < probe; i++) count += m_lists[scores[i].cluster].size();
+    uint32_t* rows = scratch.alloc<uint32_t>(count);
+    if (!rows) return 0;
+    size_t n = 0;
+    for (int i = 0; i < probe; i++) {
+        const std::vector<uint32_t>& list = m_lists[scores[i].cluster];
+        std::copy(list.begin(), list.end(), rows + n);
+        n += list.size();
+    }
+    return gallery.searchTopKInRows(query, dim, rows, count, k, out, &scratch);
+}
+
+int IvfIndex::save(const std::string& path, const FeatureGallery& gallery) const {
+    if (!trained()) return -1;
+
+    // 多个进程共用同一个索引文件：每次写到各自唯一的临时文件，再 rename 原子替换
+    std::string tmp = path + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd < 0) return -1;
+    fchmod(fd, 0644);
+    FILE* fp = fdopen(fd, "wb");
+    if (!fp) {
+        ::close(fd);
+        std::remove(tmp.c_str());
+        return -1;
+    }
+
+    int32_t header[4] = { IVF_VERSION, m_dim, m_nlist, (int32_t)m_assigned };
+    bool ok = fwrite(IVF_MAGIC, 1, 4, fp) == 4
+           && fwrite(header, sizeof(int32_t), 4, fp) == 4
+           && fwrite(m_centroids.data(), sizeof(float), m_centroids.size(), fp) == m_centroids.size();
+    for (int c = 0; ok && c < m_nlist; c++) {
+        for (uint32_t r : m_lists[c]) {
+            int32_t pair[2] = { gallery.idAt(r), c };
+            if (fwrite(pair, sizeof(int32_t), 2, fp) != 2) { ok = false; break; }
+        }
+    }
+    ok = (fclose(fp) == 0) && ok;
+
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        std::cerr << "Failed to save ANN index: " << path << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int IvfIndex::load(const std::string& path, const FeatureGallery& gallery) {
+    clear();
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) return -1;
+
+    char magic[4];
+    int32_t header[4];
+    if (fread(magic, 1, 4, fp) != 4 || std::memcmp(magic, IVF_MAGIC, 4) != 0
+        || fread(header, sizeof(int32_t), 4, fp) != 4
+        || header[0] != IVF_VERSION || header[1] != gallery.dim() || header[2] <= 0 || header[3] < 0) {
+        fclose(fp);
+        return -1;
+    }
+    int dim = header[1];
+    int nlist = header[2];
+    int32_t count = header[3];
+
+    std::vector<float> centroids((size_t)nlist * dim);
+    if (fread(centroids.data(), sizeof(float), centroids.size(), fp) != centroids.size()) {
+        fclose(fp);
+        return -1;
+    }
+    std::unordered_map<int, int> id_to_list;
+    id_to_list.reserve(count);
+    for (int32_t i = 0; i < count; i++) {
+        int32_t pair[2];
+        if (fread(pair, sizeof(int32_t), 2, fp) != 2) break;
+        if (pair[1] >= 0 && pair[1] < nlist) id_to_list[pair[0]] = pair[1];
+    }
+    fclose(fp);
+
+    m_dim = dim;
+    m_nlist = nlist;
+    m_centroids.swap(centroids);
+    m_lists.assign(nlist, std::vector<uint32_t>());
+
+    // 与特征库对照：文件中没有的行 (例如上次退出前新录入的) 重新分配
+    std::vector<float> row(dim);
+    for (size_t r = 0; r < (size_t)gallery.size(); r++) {
+        auto it = id_to_list.find(gallery.idAt(r));
+        int c;
+        if (it != id_to_list.end()) {
+            c = it->second;
+        } else {
+            gallery.decodeRow(r, row.data());
+            c = nearestCentroid(row.data());
+        }
+        m_lists[c].push_back((uint32_t)r);
+    }
+    m_assigned = gallery.size();
+    return 0;
+}
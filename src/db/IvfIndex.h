@@ -0,0 +1,60 @@
+#ifndef IVFINDEX_H
+#define IVFINDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "db/FeatureGallery.h"
+
+/**
+ * @brief IVF-Flat 近似最近邻索引
+ *
+ * 用球面 k-means 把特征库划分为 nlist 个簇，每个簇记录属于它的特征库行号 (倒排表)。
+ * 查询时先与所有簇中心比较，只扫描最接近的 nprobe 个簇：
+ *   - nprobe 越大召回率越高、耗时越长；nprobe == nlist 时等价于线性扫描
+ * 特征本身仍存放在 FeatureGallery 中 (不额外复制)，索引只保存簇中心与行号。
+ * 索引文件保存簇中心和 (人脸ID, 簇号)，加载时与特征库对照，缺失的行增量分配。
+ */
+class IvfIndex {
+public:
+    IvfIndex();
+
+    // 在特征库上训练：nlist 为簇数 (<= 0 时按 sqrt(N) 自动选择)，训练后分配全部行
+    int train(const FeatureGallery& gallery, int nlist = 0, int iterations = 8);
+
+    // 特征库末尾新增了一行：分配到最近的簇 (未训练时忽略)
+    void add(const FeatureGallery& gallery, size_t row);
+
+    void clear();
+    bool trained() const { return m_nlist > 0; }
+    int nlist() const { return m_nlist; }
+    // 已分配到簇的行数
+    size_t size() const { return m_assigned; }
+
+    // 召回率 / 耗时旋钮：扫描的簇数
+    void setNprobe(int nprobe) { m_nprobe = nprobe > 0 ? nprobe : 1; }
+    int nprobe() const { return m_nprobe; }
+
+    // 查找最相似的 k 行，结果按相似度降序写入 out，返回实际个数
+    // arena 为调用方的每帧临时内存 (簇打分、候选行号、查询向量)，为空时使用局部临时内存
+    int search(const FeatureGallery& gallery, const float* query, int dim, int k,
+               std::vector<GalleryMatch>& out, FrameArena* arena = nullptr) const;
+
+    // 持久化到文件 (先写临时文件再 rename)，成功返回0
+    int save(const std::string& path, const FeatureGallery& gallery) const;
+    // 从文件加载并与特征库对照，文件不存在或维度不符返回 -1
+    int load(const std::string& path, const FeatureGallery& gallery);
+
+private:
+    int m_dim;
+    int m_nlist;
+    int m_nprobe;
+    size_t m_assigned;
+    std::vector<float> m_centroids;                 // nlist x dim，已归一化
+    std::vector<std::vector<uint32_t>> m_lists;     // 每个簇的特征库行号
+
+    // 最接近特征 v 的簇号
+    int nearestCentroid(const float* v) const;
+};
+
+#endif // IVFINDEX_H
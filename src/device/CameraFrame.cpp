@@ -0,0 +1,44 @@
+#include "CameraFrame.h"
+#include <cstring>
+#include <iostream>
+
+CameraFrame CameraFrame::fromMat(const cv::Mat& bgr) {
+    CameraFrame frame;
+    if (bgr.empty()) return frame;
+
+    frame.mat = bgr;
+    frame.vir_addr = (void*)bgr.data;
+    frame.width = bgr.cols;
+    frame.height = bgr.rows;
+    frame.wstride = (int)(bgr.step / bgr.elemSize());
+    frame.hstride = bgr.rows;
+    frame.format = RK_FORMAT_BGR_888;
+    return frame;
+}
+
+rga_buffer_t CameraFrame::toRgaBuffer() const {
+    if (rga_handle) {
+        return wrapbuffer_handle(rga_handle, width, height, format, wstride, hstride);
+    }
+    if (fd >= 0) {
+        return wrapbuffer_fd_t(fd, width, height, wstride, hstride, format);
+    }
+    return wrapbuffer_virtualaddr_t(vir_addr, width, height, wstride, hstride, format);
+}
+
+cv::Mat CameraFrame::toBgrMat() const {
+    if (empty() || compressed) return cv::Mat();
+    if (format == RK_FORMAT_BGR_888 && !mat.empty()) return mat;
+
+    cv::Mat bgr(height, width, CV_8UC3);
+    rga_buffer_t src = toRgaBuffer();
+    rga_buffer_t dst = wrapbuffer_virtualaddr((void*)bgr.data, width, height, RK_FORMAT_BGR_888);
+
+    // imcvtcolor 同时完成 YUV -> BGR 与 stride 对齐
+    IM_STATUS status = imcvtcolor(src, dst, format, RK_FORMAT_BGR_888);
+    if (status != IM_STATUS_SUCCESS) {
+        std::cerr << "[CameraFrame] RGA cvtcolor failed: " << imStrError(status) << std::endl;
+        return cv::Mat();
+    }
+    return bgr;
+}
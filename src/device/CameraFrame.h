@@ -0,0 +1,48 @@
+#ifndef CAMERAFRAME_H
+#define CAMERAFRAME_H
+
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include "im2d.hpp"
+#include "rga.h"
+
+/**
+ * @brief 一帧摄像头图像的统一描述
+ *
+ * 两种来源共用同一个结构体：
+ *   - OpenCV 后端：mat 持有 BGR 数据，fd = -1，vir_addr 指向 mat.data
+ *   - V4L2 后端：fd 为驱动导出的 DMA-BUF，vir_addr 为 mmap 地址，
+ *     holder 持有驱动缓冲区的引用，最后一个引用释放时缓冲区自动归还驱动队列
+ *
+ * 拷贝 CameraFrame 只增加引用计数，不拷贝像素数据。
+ */
+struct CameraFrame {
+    int fd = -1;                       // DMA-BUF fd，-1 表示只有虚拟地址
+    void* vir_addr = nullptr;          // CPU 可访问的地址
+    rga_buffer_handle_t rga_handle = 0; // 已导入 RGA 的 buffer handle (0 表示未导入)
+    int width = 0;
+    int height = 0;
+    int wstride = 0;                   // 行跨度 (像素)
+    int hstride = 0;                   // 列跨度 (像素)
+    int format = RK_FORMAT_BGR_888;    // RGA 像素格式 (RK_FORMAT_*)
+    bool compressed = false;           // MJPG 码流，需要先经过 MppJpegDecoder 解码
+    size_t bytesused = 0;              // 缓冲区中的有效字节数 (码流长度)
+    int64_t timestamp_us = 0;          // 采集时间 (Tracer::nowUs 单调时钟)，用于计算帧的截止时间
+
+    cv::Mat mat;                       // OpenCV 后端的 BGR 数据
+    std::shared_ptr<void> holder;      // V4L2 后端的缓冲区引用
+
+    bool empty() const { return vir_addr == nullptr && fd < 0; }
+
+    // 从 BGR Mat 构造 (不拷贝数据，共享 Mat 的引用计数)
+    static CameraFrame fromMat(const cv::Mat& bgr);
+
+    // 生成 RGA 描述符：优先使用导入的 handle，其次 fd，最后才用虚拟地址
+    rga_buffer_t toRgaBuffer() const;
+
+    // 需要 CPU 处理 (例如 warpAffine) 时转成 BGR Mat
+    // BGR 帧直接返回共享的 Mat；其他格式由 RGA 转换到新分配的 Mat；码流帧返回空 Mat
+    cv::Mat toBgrMat() const;
+};
+
+#endif // CAMERAFRAME_H
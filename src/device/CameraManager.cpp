@@ -1,8 +1,44 @@
 #include "CameraManager.h"
+#include "common/Tracer.h"
 #include <QDebug>
+#include <algorithm>
+#include <cstring>
+#include <linux/videodev2.h>
+
+// 采集连续失败 (例如 USB 摄像头被拔出) 时的退避与日志：
+// 第一次立即打印，之后每秒最多一条，等待时间逐次加长到 200ms
+struct CaptureFailures {
+    int count = 0;
+    int64_t last_log_us = 0;
+
+    void fail(const char *what)
+    {
+        count++;
+        int64_t now = Tracer::nowUs();
+        if (count == 1 || now - last_log_us >= 1000000) {
+            qWarning() << what << "(" << count << "consecutive failures )";
+            last_log_us = now;
+        }
+        QThread::msleep(std::min(200, 10 * count)); // 设备出错时 read/poll 会立即返回，避免空转
+    }
+    void recover()
+    {
+        if (count > 0) qDebug() << "Camera recovered after" << count << "failures";
+        count = 0;
+    }
+};
+
+// 槽位释放后消费者手里可能还留着这块像素的浅拷贝 (toBgrMat() 之类返回的 Mat)，
+// 这时不能原地解码覆盖，先断开让 retrieve() 分配新内存；只有本处持有时继续复用
+static void detachIfShared(cv::Mat &mat)
+{
+    if (mat.u && mat.u->refcount > 1) mat.release();
+}
 
 CameraManager::CameraManager(QObject *parent)
-    : QThread(parent), m_stopThread(false)
+    : QThread(parent), m_backend(BACKEND_OPENCV), m_width(1280), m_height(720),
+      m_targetFps(0), m_frames(6), m_stopThread(false), m_previewWidth(0), m_previewHeight(0),
+      m_previewFps(0), m_previewEnabled(true), m_analysisDecimation(1)
 {
 }
 
@@ -12,13 +48,105 @@ CameraManager::~CameraManager()
     wait(); // 等待线程完全退出
 }
 
-bool CameraManager::openCamera(int deviceId)
+void CameraManager::setResolution(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+}
+
+void CameraManager::setFrameRate(int fps)
+{
+    m_targetFps = std::max(0, fps);
+}
+
+void CameraManager::setPreviewSize(int width, int height)
+{
+    m_previewWidth = width;
+    m_previewHeight = height;
+}
+
+void CameraManager::setPreviewFps(int fps)
+{
+    m_previewFps = std::max(0, fps);
+}
+
+void CameraManager::setPreviewEnabled(bool enabled)
+{
+    m_previewEnabled = enabled;
+}
+
+void CameraManager::setAnalysisDecimation(int n)
+{
+    m_analysisDecimation = std::max(1, n);
+}
+
+bool CameraManager::FramePacer::due(int64_t now_us, int fps)
+{
+    if (fps <= 0) return true;
+    int64_t period = 1000000 / fps;
+    // 允许 1/4 周期的抖动，否则与传感器同频时会因时间戳抖动丢掉一半的帧
+    if (now_us < next_us - period / 4) return false;
+    // 落后超过一个周期 (刚启动或长时间没有帧) 时重新对齐，不补发
+    next_us = now_us - next_us > period ? now_us + period : next_us + period;
+    return true;
+}
+
+bool CameraManager::openCamera(int deviceId, Backend backend)
 {
     // 如果已经打开，先关闭
-    if (m_cap.isOpened()) {
+    if (m_cap.isOpened() || m_v4l2.isOpened()) {
         closeCamera();
     }
 
+    m_backend = backend;
+    if (m_backend == BACKEND_MPP) {
+        // MJPG 码流由 VPU 解码，CPU 只负责搬运几十 KB 的压缩数据
+        if (!MppJpegDecoder::available()) {
+            qCritical() << "Error: built without MPP support, rebuild with -DENABLE_MPP=ON";
+            return false;
+        }
+        std::string device = "/dev/video" + std::to_string(deviceId);
+        // 码流缓冲区解码后立即归还，4 个足够；解码输出由 MPP buffer group 按需分配
+        if (m_v4l2.open(device, m_width, m_height, V4L2_PIX_FMT_MJPEG, 4, m_targetFps) != 0) {
+            qCritical() << "Error: Cannot open MJPG camera" << deviceId;
+            return false;
+        }
+        if (m_mpp.init(m_v4l2.width(), m_v4l2.height()) != 0) {
+            qCritical() << "Error: Cannot init MPP MJPEG decoder";
+            m_v4l2.close();
+            return false;
+        }
+
+        qDebug() << "Camera opened successfully (V4L2 MJPG + MPP).";
+        m_stopThread = false;
+        start();
+        return true;
+    }
+
+    if (m_backend == BACKEND_V4L2) {
+        // 原生 V4L2：按 RGA 可直接读取的原始格式依次尝试
+        // NV12 (MIPI/ISP) -> YUYV / UYVY (USB UVC)
+        std::string device = "/dev/video" + std::to_string(deviceId);
+        const uint32_t formats[] = { V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_UYVY };
+        bool opened = false;
+        for (uint32_t fmt : formats) {
+            // 驱动缓冲区要多于帧交换槽位 (6)，槽位全被流水线占用时驱动仍有缓冲区可填
+            if (m_v4l2.open(device, m_width, m_height, fmt, 8, m_targetFps) == 0) {
+                opened = true;
+                break;
+            }
+        }
+        if (!opened) {
+            qCritical() << "Error: Cannot open V4L2 camera" << deviceId;
+            return false;
+        }
+
+        qDebug() << "Camera opened successfully (V4L2 DMA-BUF).";
+        m_stopThread = false;
+        start();
+        return true;
+    }
+
     // 打开摄像头设备 /dev/videoX
     m_cap.open(deviceId);
     if (!m_cap.isOpened()) {
@@ -30,8 +158,10 @@ bool CameraManager::openCamera(int deviceId)
     // 设置为 MJPG 格式，保证高帧率传输
     m_cap.set(cv::CAP_PROP_FOURCC, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'));
     // 设置分辨率，建议 1280x720，既清晰又比 1080p 跑得快(我就要1080p)
-    m_cap.set(cv::CAP_PROP_FRAME_WIDTH, 1280);
-    m_cap.set(cv::CAP_PROP_FRAME_HEIGHT, 720);
+    // 需要 1080p 且 CPU 吃紧时改用 BACKEND_MPP 走硬件解码
+    m_cap.set(cv::CAP_PROP_FRAME_WIDTH, m_width);
+    m_cap.set(cv::CAP_PROP_FRAME_HEIGHT, m_height);
+    if (m_targetFps > 0) m_cap.set(cv::CAP_PROP_FPS, m_targetFps);
 
     qDebug() << "Camera opened successfully.";
 
@@ -53,90 +183,210 @@ void CameraManager::closeCamera()
     if (m_cap.isOpened()) {
         m_cap.release();
     }
+    m_v4l2.close();
+    m_mpp.release();
+
+    // 释放未被引用的帧 (V4L2 后端会把缓冲区还给驱动)
+    m_frames.clear();
 }
 
 // 供算法层调用：线程安全地获取最新帧
 bool CameraManager::getLatestFrame(cv::Mat& outputFrame)
 {
-    QMutexLocker locker(&m_mutex); // 自动加锁，作用域结束自动解锁
-
-    if (m_currentFrame.empty()) {
+    FrameRef ref;
+    if (!getLatestFrame(ref)) {
         return false;
     }
+    const CameraFrame& frame = *ref;
 
     // 必须使用 clone() 深拷贝，否则外部修改图像会影响这里
-    outputFrame = m_currentFrame.clone();
-    return true;
+    // 非 BGR 帧 (V4L2) 由 RGA 转换到新的 Mat，本身就是一份独立拷贝
+    if (frame.format == RK_FORMAT_BGR_888 && !frame.mat.empty()) {
+        outputFrame = frame.mat.clone();
+    } else {
+        outputFrame = frame.toBgrMat();
+    }
+    return !outputFrame.empty();
+}
+
+bool CameraManager::getLatestFrame(FrameRef& outputFrame)
+{
+    // 无锁：只增加槽位引用计数，不复制像素，采集线程不会被阻塞
+    if (!m_frames.acquireLatest(outputFrame)) {
+        return false;
+    }
+    return !outputFrame->empty();
+}
+
+bool CameraManager::waitForFrame(uint64_t sequence, int timeout_ms)
+{
+    return m_frames.waitForNewer(sequence, timeout_ms);
 }
 
 // 线程主循环：不断读取摄像头并发送信号
 void CameraManager::run()
 {
-    cv::Mat tempFrame;
+    if (m_backend == BACKEND_V4L2 || m_backend == BACKEND_MPP) {
+        runV4l2();
+    } else {
+        runOpenCV();
+    }
+}
+
+// 两个采集循环都由设备驱动节奏：grab() / poll() 阻塞到下一帧到达，不额外睡眠。
+// 每帧依次决定：是否超出目标帧率 (丢弃)、是否交给算法、是否生成预览，都不需要时连解码都省掉
+void CameraManager::runOpenCV()
+{
+    FramePacer capture, preview;
+    CaptureFailures failures;
+    int64_t index = 0;
+    cv::Mat preview_mat;    // 只给 UI 的帧解码到这里，不占用帧交换槽位
 
     while (!m_stopThread) {
-        if (!m_cap.read(tempFrame)) {
-            qWarning() << "Failed to read frame from camera";
-            QThread::msleep(10); // 读不到数据时稍微休息一下，避免 CPU 100%
+        if (!m_cap.grab()) {
+            failures.fail("Failed to grab frame from camera");
             continue;
         }
+        failures.recover();
+
+        int64_t now = Tracer::nowUs();
+        if (!capture.due(now, m_targetFps)) continue;
+        bool analyze = index++ % m_analysisDecimation == 0;
+        bool show = m_previewEnabled && preview.due(now, m_previewFps);
 
-        if (tempFrame.empty()) continue;
+        // 直接解码到空闲槽位里，复用上次分配的 Mat 内存 (仍被外部引用时改用新内存)；
+        // 所有槽位都被消费者持有时只丢弃算法的这一份
+        CameraFrame* slot = analyze ? m_frames.beginWrite() : nullptr;
+        if (!slot && !show) continue;
 
-        // 1. 存入缓冲区供算法使用 (加锁保护)
-        {
-            QMutexLocker locker(&m_mutex);
-            m_currentFrame = tempFrame;
-            // 注意：这里保存的是 BGR 格式，因为 OpenCV 算法通常用 BGR
+        TraceScope trace(Tracer::STAGE_CAPTURE);
+        cv::Mat &target = slot ? slot->mat : preview_mat;
+        detachIfShared(target);
+        cv::Mat buffer = target;
+        if (!m_cap.retrieve(buffer) || buffer.empty()) {
+            if (slot) m_frames.abortWrite();
+            trace.stop();
+            failures.fail("Failed to decode frame from camera");
+            continue;
         }
 
-        // 2. 转换为 QImage 发送给 UI (不加锁，避免阻塞采集)
-        QImage image = matToQImage(tempFrame);
-        emit newFrameCaptured(image);
+        // 注意：这里保存的是 BGR 格式，因为 OpenCV 算法通常用 BGR
+        CameraFrame frame = CameraFrame::fromMat(buffer);
+        frame.timestamp_us = now;
+        if (slot) {
+            *slot = frame;
+            m_frames.commitWrite();
+        } else {
+            preview_mat = buffer;
+        }
+        trace.stop();
 
-        // 稍微休眠一下控制帧率，防止把 UI 线程卡死 (例如限制在 30fps)
-        QThread::msleep(16);
+        // 发布后槽位只会被读取，采集线程可以安全地拿它生成预览
+        if (show) emitPreview(frame);
     }
 }
 
-QImage CameraManager::matToQImage(const cv::Mat &mat)
+void CameraManager::runV4l2()
 {
-    if (mat.empty()) return QImage();
-    
-    // 1. 定义源数据 (OpenCV BGR)
-    rga_buffer_t src = wrapbuffer_virtualaddr(
-        (void*)mat.data, 
-        mat.cols, 
-        mat.rows, 
-        RK_FORMAT_BGR_888
-    );
+    FramePacer capture, preview;
+    CaptureFailures failures;
+    int64_t index = 0;
+
+    while (!m_stopThread) {
+        CameraFrame frame;
+        int ret = m_v4l2.dequeue(frame, 100); // poll 等待驱动填充，超时只用于检查停止标志
+        if (ret == 1) continue;
+        if (ret < 0) {
+            failures.fail("Failed to dequeue V4L2 buffer");
+            continue;
+        }
+        failures.recover();
+
+        // 丢弃的帧在 frame 析构时立即还给驱动
+        int64_t now = Tracer::nowUs();
+        frame.timestamp_us = now;
+        if (!capture.due(now, m_targetFps)) continue;
+        bool analyze = index++ % m_analysisDecimation == 0;
+        bool show = m_previewEnabled && preview.due(now, m_previewFps);
+        if (!analyze && !show) continue;
+
+        TraceScope trace(Tracer::STAGE_CAPTURE);
+        if (frame.compressed) {
+            // MJPG -> NV12 (VPU)，码流缓冲区在 frame 析构时归还驱动
+            CameraFrame decoded;
+            if (m_mpp.decode(frame, decoded) != 0) {
+                continue;
+            }
+            decoded.timestamp_us = frame.timestamp_us;
+            frame = decoded;
+        }
 
-    // 2. 准备目标 QImage
-    // 为了降低 UI 压力，这里其实可以顺便把图缩小(需要使用imresize)
-    // 比如：如果你的 UI 控件只有 640x360，这里直接生成 640x360 的 QImage 最好
-    // 下面演示保持原尺寸 (1280x720)，如果你想缩放，修改这里的 width/height 即可
-    int dstWidth = mat.cols;  // 或者 640
-    int dstHeight = mat.rows; // 或者 360
+        if (analyze) publishFrame(frame);
+        trace.stop();
+        if (show) emitPreview(frame);
+    }
+}
+
+void CameraManager::publishFrame(const CameraFrame &frame)
+{
+    // 存入帧交换供算法使用 (无锁，槽位全被占用时只丢弃本帧给算法的那份)
+    CameraFrame* slot = m_frames.beginWrite();
+    if (slot) {
+        *slot = frame;
+        m_frames.commitWrite();
+    }
+}
+
+void CameraManager::emitPreview(const CameraFrame &frame)
+{
+    TraceScope trace(Tracer::STAGE_PREVIEW);
+    QImage image = frameToQImage(frame);
+    trace.stop();
+    // 缓冲区都还在 UI 手里 (UI 跟不上) 时丢弃这一帧预览
+    if (image.isNull()) return;
+    emit newFrameCaptured(image);
+}
+
+QImage CameraManager::frameToQImage(const CameraFrame &frame)
+{
+    if (frame.empty()) return QImage();
     
-    // 创建一个空的 QImage 容器，分配内存
-    QImage image(dstWidth, dstHeight, QImage::Format_RGB888);
-
-    // 3. 定义目标数据 (QImage 内存, RGB)
-    rga_buffer_t dst = wrapbuffer_virtualaddr(
-        (void*)image.bits(), 
-        dstWidth, 
-        dstHeight, 
+    // 1. 定义源数据 (OpenCV BGR 虚拟地址，或 V4L2 DMA-BUF)
+    rga_buffer_t src = frame.toRgaBuffer();
+
+    // 2. 目标尺寸：按预览区域等比缩放 (相当于 Qt::KeepAspectRatio)，UI 线程不再做 scaled()
+    int dstWidth = frame.width;
+    int dstHeight = frame.height;
+    int boxWidth = m_previewWidth, boxHeight = m_previewHeight;
+    if (boxWidth > 0 && boxHeight > 0) {
+        float scale = std::min((float)boxWidth / frame.width, (float)boxHeight / frame.height);
+        dstWidth = std::max(2, (int)(frame.width * scale) & ~1);
+        dstHeight = std::max(2, (int)(frame.height * scale) & ~1);
+    }
+
+    // 从池中取缓冲区 (行跨度 16 像素对齐)，UI 释放 QImage 后自动归还
+    QImage image = m_previewPool.acquire(dstWidth, dstHeight);
+    if (image.isNull()) return QImage();
+
+    // 3. 定义目标数据 (池缓冲区, RGB)
+    rga_buffer_t dst = wrapbuffer_virtualaddr_t(
+        (void*)image.bits(),
+        dstWidth, dstHeight,
+        PreviewPool::strideFor(dstWidth), dstHeight,
         RK_FORMAT_RGB_888
     );
 
-    // 4. 执行转换 (Copy + Format Convert + Resize if needed)
-    // imresize 可以同时处理 缩放 和 格式转换
-    // imflip 同时支持 格式转换(BGR->RGB) 和 翻转，但不支持缩放
-    // 如果尺寸一样，它就只做格式转换
-    IM_STATUS status = imflip(src, dst, IM_HAL_TRANSFORM_FLIP_H);
+    // 4. 一次 RGA 调用完成 缩放 + 水平镜像 + 格式转换 (BGR/YUV -> RGB)
+    rga_buffer_t pat;
+    memset(&pat, 0, sizeof(pat));
+    im_rect srect = { 0, 0, frame.width, frame.height };
+    im_rect drect = { 0, 0, dstWidth, dstHeight };
+    im_rect prect = { 0, 0, 0, 0 };
+    IM_STATUS status = improcess(src, dst, pat, srect, drect, prect, -1, NULL, NULL,
+                                 IM_SYNC | IM_HAL_TRANSFORM_FLIP_H);
 
     if (status != IM_STATUS_SUCCESS) {
-        qWarning() << "RGA matToQImage failed:" << status;
+        qWarning() << "RGA frameToQImage failed:" << status;
         return QImage(); 
     }
 
@@ -4,25 +4,57 @@
 #include <QObject>
 #include <QThread>
 #include <QImage>
-#include <QMutex>
+#include <atomic>
 #include <opencv2/opencv.hpp>
 #include "im2d.hpp"
 #include "rga.h"
+#include "device/CameraFrame.h"
+#include "device/FrameExchange.h"
+#include "device/V4l2Capture.h"
+#include "device/MppJpegDecoder.h"
+#include "device/PreviewPool.h"
 
 class CameraManager : public QThread // 继承 QThread 以便在后台运行
 {
     Q_OBJECT
 
 public:
+    // 采集后端
+    enum Backend {
+        BACKEND_OPENCV, // cv::VideoCapture (MJPG，CPU 解码，兼容性最好)
+        BACKEND_V4L2,   // 原生 V4L2 mmap + DMA-BUF (原始 YUV 格式，零拷贝交给 RGA)
+        BACKEND_MPP     // V4L2 MJPG + MPP 硬件解码为 NV12 DMA 缓冲区 (需 ENABLE_MPP)
+    };
+
     explicit CameraManager(QObject *parent = nullptr);
     ~CameraManager();
 
     // 打开摄像头
-    bool openCamera(int deviceId = 0);
+    bool openCamera(int deviceId = 0, Backend backend = BACKEND_OPENCV);
+
+    // 设置采集分辨率 (需在 openCamera 之前调用，默认 1280x720)
+    void setResolution(int width, int height);
+
+    // 目标采集帧率 (需在 openCamera 之前调用，0 = 驱动默认)
+    // 先向驱动请求该帧率；驱动给的更高时，采集线程按时间戳丢弃多余的帧
+    void setFrameRate(int fps);
 
     // 关闭摄像头
     void closeCamera();
 
+    // 预览显示区域的尺寸 (可在任意线程调用，例如 UI 控件尺寸变化时)
+    // 预览图由 RGA 一次完成缩放 (保持宽高比、不超过该尺寸) + 镜像 + 颜色转换；0 表示使用原始分辨率
+    void setPreviewSize(int width, int height);
+
+    // 预览 (newFrameCaptured 信号) 的最高帧率，通常设为屏幕刷新率；0 = 每帧都发
+    void setPreviewFps(int fps);
+
+    // 关闭预览 (无界面运行时)：不再生成 QImage 也不发 newFrameCaptured，所有帧只给算法
+    void setPreviewEnabled(bool enabled);
+
+    // 每 n 帧交给算法 (帧交换) 一帧，1 = 每帧；与预览帧率互相独立
+    void setAnalysisDecimation(int n);
+
     /**
      * @brief 供算法层调用，获取当前最新的那一帧图像
      * @param outputFrame 用于接收图像的容器
@@ -30,6 +62,23 @@ public:
      */
     bool getLatestFrame(cv::Mat& outputFrame);
 
+    /**
+     * @brief 零拷贝获取最新帧：无锁，只增加槽位引用计数，不复制像素
+     * @param outputFrame 用于接收帧引用的容器 (V4L2 后端为 DMA-BUF)
+     * @return 成功返回 true
+     * @note 返回的帧是只读的；持有期间对应的缓冲区不会被采集线程覆盖，
+     *       用完尽快释放，不能比 CameraManager 活得更久
+     */
+    bool getLatestFrame(FrameRef& outputFrame);
+
+    /**
+     * @brief 阻塞等待比 sequence 更新的帧发布 (代替消费者轮询 getLatestFrame)
+     * @param sequence 上次处理的帧序号 (FrameRef::sequence())
+     * @param timeout_ms 最长等待时间，超时用于消费者检查自己的停止标志
+     * @return 有新帧返回 true，超时返回 false
+     */
+    bool waitForFrame(uint64_t sequence, int timeout_ms);
+
 signals:
     // 信号：通知 UI 层更新画面 (发送 QImage 方便 Qt 显示)
     void newFrameCaptured(const QImage &image);
@@ -39,13 +88,39 @@ protected:
     void run() override;
 
 private:
+    // 按时间戳把帧率限制在 fps 以内 (只丢帧，不睡眠)
+    struct FramePacer {
+        int64_t next_us = 0;
+        bool due(int64_t now_us, int fps);
+    };
+
+    Backend m_backend;           // 当前使用的采集后端
     cv::VideoCapture m_cap;      // OpenCV 视频捕获对象
-    cv::Mat m_currentFrame;      // 当前帧 (BGR格式，OpenCV原生)
+    V4l2Capture m_v4l2;          // 原生 V4L2 采集对象
+    MppJpegDecoder m_mpp;        // MJPG 硬件解码器 (BACKEND_MPP)
+    int m_width;                 // 请求的采集宽度
+    int m_height;                // 请求的采集高度
+    int m_targetFps;             // 目标采集帧率 (0 = 驱动决定)
+    FrameExchange m_frames;      // 无锁帧交换 (OpenCV 后端为 BGR Mat，V4L2 后端为 DMA-BUF)
     bool m_stopThread;           // 线程停止标志位
-    QMutex m_mutex;              // 互斥锁，保护 m_currentFrame 的读写安全
+    std::atomic<int> m_previewWidth;   // 预览目标尺寸 (0 = 原始分辨率)
+    std::atomic<int> m_previewHeight;
+    std::atomic<int> m_previewFps;     // 预览帧率上限 (0 = 不限)
+    std::atomic<bool> m_previewEnabled;
+    std::atomic<int> m_analysisDecimation; // 每 n 帧给算法一帧
+    PreviewPool m_previewPool;   // 预览图缓冲区 (UI 释放后复用)
+
+    // 两种后端各自的采集循环
+    void runOpenCV();
+    void runV4l2();
+
+    // 发布一帧给算法：存入帧交换并唤醒等待的消费者
+    void publishFrame(const CameraFrame &frame);
+    // 通知 UI 刷新预览
+    void emitPreview(const CameraFrame &frame);
 
-    // 辅助函数：将 OpenCV Mat 转换为 Qt QImage
-    QImage matToQImage(const cv::Mat &mat);
+    // 辅助函数：将帧转换为预览尺寸的 Qt QImage (RGA 直接读取 fd 或虚拟地址，写入池中的缓冲区)
+    QImage frameToQImage(const CameraFrame &frame);
 };
 
 #endif // CAMERAMANAGER_H
@@ -0,0 +1,189 @@
+#include "FrameExchange.h"
+#include <chrono>
+
+// ---------------------------------------------------------
+// FrameRef
+// ---------------------------------------------------------
+FrameRef::FrameRef(const FrameRef& other)
+    : m_exchange(other.m_exchange), m_index(other.m_index)
+{
+    if (m_exchange) m_exchange->addRef(m_index);
+}
+
+FrameRef::FrameRef(FrameRef&& other) noexcept
+    : m_exchange(other.m_exchange), m_index(other.m_index)
+{
+    other.m_exchange = nullptr;
+    other.m_index = -1;
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& other)
+{
+    if (this != &other) {
+        if (other.m_exchange) other.m_exchange->addRef(other.m_index);
+        release();
+        m_exchange = other.m_exchange;
+        m_index = other.m_index;
+    }
+    return *this;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_exchange = other.m_exchange;
+        m_index = other.m_index;
+        other.m_exchange = nullptr;
+        other.m_index = -1;
+    }
+    return *this;
+}
+
+const CameraFrame& FrameRef::frame() const
+{
+    static const CameraFrame empty_frame;
+    if (!m_exchange) return empty_frame;
+    return m_exchange->m_slots[m_index].frame;
+}
+
+uint64_t FrameRef::sequence() const
+{
+    if (!m_exchange) return 0;
+    return m_exchange->m_slots[m_index].sequence;
+}
+
+void FrameRef::release()
+{
+    if (m_exchange) {
+        m_exchange->releaseRef(m_index);
+        m_exchange = nullptr;
+        m_index = -1;
+    }
+}
+
+// ---------------------------------------------------------
+// FrameExchange
+// ---------------------------------------------------------
+FrameExchange::FrameExchange(int slot_count)
+    : m_slots(new Slot[slot_count < 3 ? 3 : slot_count]),
+      m_slotCount(slot_count < 3 ? 3 : slot_count),
+      m_latest(-1), m_writing(-1), m_sequence(0), m_published(0), m_waiters(0)
+{
+}
+
+FrameExchange::~FrameExchange()
+{
+}
+
+CameraFrame* FrameExchange::beginWrite()
+{
+    int latest = m_latest.load(std::memory_order_acquire);
+    for (int i = 0; i < m_slotCount; i++) {
+        if (i == latest) continue;      // 最新帧随时可能被消费者获取，不能覆盖
+        int expected = 0;
+        if (m_slots[i].refs.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)) {
+            m_writing = i;
+            return &m_slots[i].frame;
+        }
+    }
+    return nullptr;
+}
+
+void FrameExchange::commitWrite()
+{
+    if (m_writing < 0) return;
+
+    Slot& slot = m_slots[m_writing];
+    slot.sequence = ++m_sequence;
+    slot.refs.store(0, std::memory_order_release);
+    int previous = m_latest.exchange(m_writing, std::memory_order_acq_rel);
+    m_writing = -1;
+
+    // 先发布序号再检查等待者，与 waitForNewer() 的顺序相反，两边不会同时错过
+    m_published.store(m_sequence);
+    if (m_waiters.load() > 0) {
+        { std::lock_guard<std::mutex> lock(m_waitMutex); }
+        m_waitCond.notify_all();
+    }
+
+    // 上一帧已不会再被新的消费者拿到：如果没人持有，立刻释放它占用的驱动缓冲区，
+    // 但保留 Mat 的内存供下次 beginWrite() 复用
+    if (previous >= 0) {
+        int expected = 0;
+        Slot& old = m_slots[previous];
+        if (old.refs.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)) {
+            old.frame.holder.reset();
+            old.refs.store(0, std::memory_order_release);
+        }
+    }
+}
+
+void FrameExchange::abortWrite()
+{
+    if (m_writing < 0) return;
+    m_slots[m_writing].refs.store(0, std::memory_order_release);
+    m_writing = -1;
+}
+
+bool FrameExchange::acquireLatest(FrameRef& ref)
+{
+    for (;;) {
+        int index = m_latest.load(std::memory_order_acquire);
+        if (index < 0) return false;
+
+        std::atomic<int>& refs = m_slots[index].refs;
+        int count = refs.load(std::memory_order_acquire);
+        // 槽位刚被生产者重新占用，说明已经有更新的帧发布，重新读取下标
+        if (count == WRITING) continue;
+        if (!refs.compare_exchange_weak(count, count + 1, std::memory_order_acq_rel)) continue;
+
+        // 加引用前生产者可能已发布新帧并回收了这个槽位的缓冲区；
+        // 持有引用后再确认它仍是最新帧，否则放弃重来
+        if (m_latest.load(std::memory_order_acquire) != index) {
+            releaseRef(index);
+            continue;
+        }
+        ref = FrameRef(this, index);
+        return true;
+    }
+}
+
+bool FrameExchange::waitForNewer(uint64_t sequence, int timeout_ms)
+{
+    // clear() 之后没有最新帧，要等到下一次发布，否则关闭摄像头期间消费者会空转
+    auto ready = [&] { return m_published.load() > sequence && m_latest.load() >= 0; };
+    if (ready()) return true;
+
+    m_waiters.fetch_add(1);
+    bool ok;
+    {
+        std::unique_lock<std::mutex> lock(m_waitMutex);
+        ok = m_waitCond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                 ready);
+    }
+    m_waiters.fetch_sub(1);
+    return ok;
+}
+
+void FrameExchange::clear()
+{
+    m_latest.store(-1, std::memory_order_release);
+    for (int i = 0; i < m_slotCount; i++) {
+        int expected = 0;
+        if (m_slots[i].refs.compare_exchange_strong(expected, WRITING, std::memory_order_acquire)) {
+            m_slots[i].frame = CameraFrame();
+            m_slots[i].refs.store(0, std::memory_order_release);
+        }
+    }
+}
+
+void FrameExchange::addRef(int index)
+{
+    m_slots[index].refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameExchange::releaseRef(int index)
+{
+    m_slots[index].refs.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,114 @@
+#ifndef FRAMEEXCHANGE_H
+#define FRAMEEXCHANGE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "device/CameraFrame.h"
+
+class FrameExchange;
+
+/**
+ * @brief 最新帧的只读引用 (RAII)
+ *
+ * 持有期间对应槽位不会被采集线程覆盖；析构时自动释放引用。
+ * 拷贝只增加槽位引用计数，不复制像素数据。
+ * 注意：FrameRef 不能比创建它的 FrameExchange (即 CameraManager) 活得更久。
+ */
+class FrameRef {
+public:
+    FrameRef() : m_exchange(nullptr), m_index(-1) {}
+    FrameRef(const FrameRef& other);
+    FrameRef(FrameRef&& other) noexcept;
+    FrameRef& operator=(const FrameRef& other);
+    FrameRef& operator=(FrameRef&& other) noexcept;
+    ~FrameRef() { release(); }
+
+    bool valid() const { return m_exchange != nullptr; }
+    const CameraFrame& frame() const;
+    const CameraFrame* operator->() const { return &frame(); }
+    const CameraFrame& operator*() const { return frame(); }
+
+    // 帧序号：每发布一帧加一，可用于判断是否拿到了新帧
+    uint64_t sequence() const;
+
+    // 提前释放引用
+    void release();
+
+private:
+    friend class FrameExchange;
+    FrameRef(FrameExchange* exchange, int index) : m_exchange(exchange), m_index(index) {}
+
+    FrameExchange* m_exchange;
+    int m_index;
+};
+
+/**
+ * @brief 单生产者 / 多消费者的无锁帧交换
+ *
+ * 固定数量的槽位，每个槽位带一个原子引用计数：
+ *   - 生产者 (采集线程) 用 CAS 把一个空闲且不是最新的槽位从 0 置为 WRITING，
+ *     原地写入后恢复为 0，再原子地发布其下标为最新帧
+ *   - 消费者读取最新下标，只要槽位不在写入中，就用 CAS 把引用计数加一，
+ *     加上引用后再确认它仍是最新帧
+ * 两边都不会阻塞：生产者找不到空闲槽位时丢弃本帧，消费者只在生产者
+ * 恰好发布新帧时重试一次。槽位数需要大于 "同时持有帧的消费者数 + 2"。
+ * 消费者可以用 waitForNewer() 睡眠到下一帧发布，代替轮询；没有等待者时生产者不碰锁。
+ */
+class FrameExchange {
+public:
+    explicit FrameExchange(int slot_count = 4);
+    ~FrameExchange();
+
+    FrameExchange(const FrameExchange&) = delete;
+    FrameExchange& operator=(const FrameExchange&) = delete;
+
+    // ---- 生产者接口 (只能在采集线程调用) ----
+
+    // 申请一个可写槽位，没有空闲槽位时返回 nullptr (本帧应丢弃)
+    // 返回的帧保留上一次写入的内容，OpenCV 后端可以直接复用其中 Mat 的内存
+    CameraFrame* beginWrite();
+    // 发布刚写好的槽位为最新帧
+    void commitWrite();
+    // 放弃本次写入 (例如读帧失败)
+    void abortWrite();
+
+    // ---- 消费者接口 (任意线程) ----
+
+    // 获取最新帧的引用，还没有任何帧时返回 false
+    bool acquireLatest(FrameRef& ref);
+
+    // 等待序号大于 sequence 的帧发布：有新帧返回 true，超时返回 false
+    bool waitForNewer(uint64_t sequence, int timeout_ms);
+
+    // 丢弃所有未被引用的帧并清空最新帧 (关闭摄像头时调用)
+    void clear();
+
+private:
+    friend class FrameRef;
+
+    static const int WRITING = -1;
+
+    struct Slot {
+        std::atomic<int> refs{0};       // >=0: 读者数量；WRITING: 生产者正在写
+        uint64_t sequence = 0;          // 发布序号，只在持有引用时读取
+        CameraFrame frame;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    int m_slotCount;
+    std::atomic<int> m_latest;          // 最新帧的槽位下标，-1 表示没有
+    int m_writing;                      // 生产者当前占用的槽位
+    uint64_t m_sequence;                // 生产者的发布计数
+    std::atomic<uint64_t> m_published;  // 最近发布的序号 (供等待者读取)
+    std::atomic<int> m_waiters;         // 正在 waitForNewer() 中的消费者数
+    std::mutex m_waitMutex;
+    std::condition_variable m_waitCond;
+
+    void addRef(int index);
+    void releaseRef(int index);
+};
+
+#endif // FRAMEEXCHANGE_H
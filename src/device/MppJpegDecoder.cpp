@@ -0,0 +1,207 @@
+#include "MppJpegDecoder.h"
+#include <cstring>
+#include <iostream>
+
+#ifdef ENABLE_MPP
+#include <rockchip/rk_mpi.h>
+#include <rockchip/mpp_buffer.h>
+#include <rockchip/mpp_frame.h>
+#include <rockchip/mpp_packet.h>
+#include <rockchip/mpp_task.h>
+#include <rockchip/mpp_meta.h>
+
+#define MPP_ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+// ---------------------------------------------------------
+// MPP 上下文
+// 输出帧通过 holder 持有它，保证 buffer group 比所有在外的帧活得更久
+// ---------------------------------------------------------
+struct MppJpegDecoder::Context {
+    MppCtx ctx = nullptr;
+    MppApi* mpi = nullptr;
+    MppBufferGroup frm_grp = nullptr;   // 解码输出 (DRM 内存，可导出 fd)
+    MppBufferGroup pkt_grp = nullptr;   // 码流输入
+    MppBuffer pkt_buf = nullptr;
+    MppPacket packet = nullptr;
+    int width = 0;
+    int height = 0;
+    int hor_stride = 0;
+    int ver_stride = 0;
+    size_t pkt_size = 0;
+    size_t frm_size = 0;
+
+    ~Context() {
+        if (packet) mpp_packet_deinit(&packet);
+        if (pkt_buf) mpp_buffer_put(pkt_buf);
+        if (ctx) {
+            mpi->reset(ctx);
+            mpp_destroy(ctx);
+        }
+        if (pkt_grp) mpp_buffer_group_put(pkt_grp);
+        if (frm_grp) mpp_buffer_group_put(frm_grp);
+    }
+};
+
+// MPP 输出格式 -> RGA 像素格式
+static int mppToRgaFormat(MppFrameFormat fmt)
+{
+    switch (fmt & MPP_FRAME_FMT_MASK) {
+    case MPP_FMT_YUV420SP: return RK_FORMAT_YCbCr_420_SP;
+    case MPP_FMT_YUV422SP: return RK_FORMAT_YCbCr_422_SP;
+    default:               return -1;
+    }
+}
+#else
+struct MppJpegDecoder::Context {};
+#endif
+
+MppJpegDecoder::MppJpegDecoder() : is_init(false) {}
+
+MppJpegDecoder::~MppJpegDecoder() {
+    release();
+}
+
+bool MppJpegDecoder::available() {
+#ifdef ENABLE_MPP
+    return true;
+#else
+    return false;
+#endif
+}
+
+int MppJpegDecoder::init(int width, int height) {
+#ifdef ENABLE_MPP
+    release();
+
+    std::shared_ptr<Context> c = std::make_shared<Context>();
+    c->width = width;
+    c->height = height;
+    c->hor_stride = MPP_ALIGN(width, 16);
+    c->ver_stride = MPP_ALIGN(height, 16);
+    // YUV422SP 是 MJPG 最大的输出，按 2 字节/像素预留
+    c->frm_size = (size_t)c->hor_stride * c->ver_stride * 2;
+    // 码流长度不会超过原始 YUV 数据量
+    c->pkt_size = c->frm_size;
+
+    // 1. 创建解码器：MJPEG 只能走 task 接口 (输出缓冲区由调用方提供)
+    if (mpp_create(&c->ctx, &c->mpi) != MPP_OK) {
+        std::cerr << "[MppJpegDecoder] mpp_create failed" << std::endl;
+        c->ctx = nullptr;
+        return -1;
+    }
+    if (mpp_init(c->ctx, MPP_CTX_DEC, MPP_VIDEO_CodingMJPEG) != MPP_OK) {
+        std::cerr << "[MppJpegDecoder] mpp_init failed" << std::endl;
+        return -1;
+    }
+
+    // 2. 请求 NV12 输出，RGA 可直接做 NV12 -> RGB
+    MppFrameFormat out_fmt = MPP_FMT_YUV420SP;
+    c->mpi->control(c->ctx, MPP_DEC_SET_OUTPUT_FORMAT, &out_fmt);
+
+    // 3. 输入输出 buffer group (DRM 内存，可通过 fd 共享给 RGA)
+    if (mpp_buffer_group_get_internal(&c->frm_grp, MPP_BUFFER_TYPE_DRM) != MPP_OK ||
+        mpp_buffer_group_get_internal(&c->pkt_grp, MPP_BUFFER_TYPE_DRM) != MPP_OK) {
+        std::cerr << "[MppJpegDecoder] Failed to get buffer group" << std::endl;
+        return -1;
+    }
+    if (mpp_buffer_get(c->pkt_grp, &c->pkt_buf, c->pkt_size) != MPP_OK) {
+        std::cerr << "[MppJpegDecoder] Failed to allocate packet buffer" << std::endl;
+        return -1;
+    }
+    mpp_packet_init_with_buffer(&c->packet, c->pkt_buf);
+
+    m_ctx = c;
+    is_init = true;
+    return 0;
+#else
+    (void)width;
+    (void)height;
+    std::cerr << "[MppJpegDecoder] Built without MPP support (ENABLE_MPP=OFF)" << std::endl;
+    return -1;
+#endif
+}
+
+void MppJpegDecoder::release() {
+    m_ctx.reset();
+    is_init = false;
+}
+
+int MppJpegDecoder::decode(const CameraFrame& jpeg, CameraFrame& out) {
+#ifdef ENABLE_MPP
+    if (!is_init || !jpeg.compressed || !jpeg.vir_addr || jpeg.bytesused == 0) return -1;
+    Context* c = m_ctx.get();
+    if (jpeg.bytesused > c->pkt_size) {
+        std::cerr << "[MppJpegDecoder] JPEG packet too large: " << jpeg.bytesused << std::endl;
+        return -1;
+    }
+
+    // 1. 码流放入输入包 (压缩数据只有几十 KB，拷贝代价远小于 CPU 解码)
+    memcpy(mpp_buffer_get_ptr(c->pkt_buf), jpeg.vir_addr, jpeg.bytesused);
+    mpp_packet_set_pos(c->packet, mpp_buffer_get_ptr(c->pkt_buf));
+    mpp_packet_set_length(c->packet, jpeg.bytesused);
+
+    // 2. 为本帧申请输出缓冲区 (group 会复用已被下游释放的缓冲区)
+    MppBuffer frm_buf = nullptr;
+    if (mpp_buffer_get(c->frm_grp, &frm_buf, c->frm_size) != MPP_OK) {
+        std::cerr << "[MppJpegDecoder] Failed to allocate frame buffer" << std::endl;
+        return -1;
+    }
+    MppFrame frame = nullptr;
+    mpp_frame_init(&frame);
+    mpp_frame_set_buffer(frame, frm_buf);
+
+    // 3. 送入 task 并等待解码完成
+    int ret = -1;
+    MppTask task = nullptr;
+    do {
+        if (c->mpi->poll(c->ctx, MPP_PORT_INPUT, MPP_POLL_BLOCK) != MPP_OK) break;
+        if (c->mpi->dequeue(c->ctx, MPP_PORT_INPUT, &task) != MPP_OK || !task) break;
+        mpp_task_meta_set_packet(task, KEY_INPUT_PACKET, c->packet);
+        mpp_task_meta_set_frame(task, KEY_OUTPUT_FRAME, frame);
+        if (c->mpi->enqueue(c->ctx, MPP_PORT_INPUT, task) != MPP_OK) break;
+
+        if (c->mpi->poll(c->ctx, MPP_PORT_OUTPUT, MPP_POLL_BLOCK) != MPP_OK) break;
+        task = nullptr;
+        if (c->mpi->dequeue(c->ctx, MPP_PORT_OUTPUT, &task) != MPP_OK || !task) break;
+        MppFrame decoded = nullptr;
+        mpp_task_meta_get_frame(task, KEY_OUTPUT_FRAME, &decoded);
+        c->mpi->enqueue(c->ctx, MPP_PORT_OUTPUT, task);
+
+        if (!decoded || mpp_frame_get_errinfo(decoded) || mpp_frame_get_discard(decoded)) {
+            std::cerr << "[MppJpegDecoder] Corrupted MJPG frame dropped" << std::endl;
+            break;
+        }
+
+        int rga_fmt = mppToRgaFormat(mpp_frame_get_fmt(decoded));
+        if (rga_fmt < 0) {
+            std::cerr << "[MppJpegDecoder] Unsupported output format: " << mpp_frame_get_fmt(decoded) << std::endl;
+            break;
+        }
+
+        out = CameraFrame();
+        out.fd = mpp_buffer_get_fd(frm_buf);
+        out.vir_addr = mpp_buffer_get_ptr(frm_buf);
+        out.width = mpp_frame_get_width(decoded);
+        out.height = mpp_frame_get_height(decoded);
+        out.wstride = mpp_frame_get_hor_stride(decoded);
+        out.hstride = mpp_frame_get_ver_stride(decoded);
+        out.format = rga_fmt;
+
+        // 输出帧持有缓冲区引用，释放时归还 group；同时持有上下文保证 group 存活
+        std::shared_ptr<Context> ctx_ref = m_ctx;
+        mpp_buffer_inc_ref(frm_buf);
+        out.holder = std::shared_ptr<void>(nullptr, [ctx_ref, frm_buf](void*) {
+            mpp_buffer_put(frm_buf);
+        });
+        ret = 0;
+    } while (0);
+
+    mpp_frame_deinit(&frame);
+    mpp_buffer_put(frm_buf);    // 成功时 holder 还持有一份引用
+    return ret;
+#else
+    (void)jpeg;
+    (void)out;
+    return -1;
+#endif
+}
@@ -0,0 +1,45 @@
+#ifndef MPPJPEGDECODER_H
+#define MPPJPEGDECODER_H
+
+#include <memory>
+#include "device/CameraFrame.h"
+
+/**
+ * @brief 基于 Rockchip MPP (VPU) 的 MJPEG 硬件解码器
+ *
+ * 输入：V4L2 采集到的 MJPG 码流帧 (CameraFrame::compressed == true)
+ * 输出：位于 DRM/DMA 内存中的 NV12 (YUV420SP) 帧，fd 直接交给 RGA 做缩放和 NV12->RGB
+ *
+ * 解码输出缓冲区来自 MPP 内部 buffer group，输出帧的最后一个引用释放时
+ * 缓冲区自动归还 group 复用，因此下游可以像 V4L2 帧一样长期持有。
+ *
+ * 需要以 -DENABLE_MPP=ON 编译并链接 librockchip_mpp；
+ * 未开启时 init() 直接返回 -1，调用方应回退到 OpenCV 后端。
+ */
+class MppJpegDecoder {
+public:
+    MppJpegDecoder();
+    ~MppJpegDecoder();
+
+    // 按码流分辨率初始化解码器，成功返回 0，失败返回 -1
+    int init(int width, int height);
+
+    // 释放解码器 (已输出的帧仍然有效，直到其引用释放)
+    void release();
+
+    bool isInit() const { return is_init; }
+
+    // 解码一帧 MJPG，成功返回 0 并填充 out，失败返回 -1
+    int decode(const CameraFrame& jpeg, CameraFrame& out);
+
+    // 当前库是否带有 MPP 支持
+    static bool available();
+
+private:
+    struct Context;                      // MPP 上下文与 buffer group，由在外的帧共同持有
+
+    std::shared_ptr<Context> m_ctx;
+    bool is_init;
+};
+
+#endif // MPPJPEGDECODER_H
@@ -0,0 +1,43 @@
+#include "PreviewPool.h"
+
+PreviewPool::PreviewPool(int count) : m_shared(std::make_shared<Shared>())
+{
+    for (int i = 0; i < count; i++) {
+        m_shared->buffers.push_back(std::unique_ptr<Buffer>(new Buffer()));
+    }
+}
+
+QImage PreviewPool::acquire(int width, int height)
+{
+    if (width <= 0 || height <= 0) return QImage();
+    int stride = strideFor(width);
+    size_t bytes = (size_t)stride * height * 3;
+
+    Buffer* buf = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        for (auto& b : m_shared->buffers) {
+            if (!b->busy) {
+                buf = b.get();
+                break;
+            }
+        }
+        if (!buf) return QImage();
+        buf->busy = true;
+        buf->owner = m_shared;
+    }
+
+    // 只在预览尺寸变化 (窗口缩放) 时重新分配
+    if (buf->data.size() != bytes) buf->data.assign(bytes, 0);
+    return QImage(buf->data.data(), width, height, stride * 3, QImage::Format_RGB888,
+                  &PreviewPool::release, buf);
+}
+
+void PreviewPool::release(void* info)
+{
+    Buffer* buf = static_cast<Buffer*>(info);
+    // owner 在锁外析构：可能是池的最后一个引用
+    std::shared_ptr<Shared> owner = std::move(buf->owner);
+    std::lock_guard<std::mutex> lock(owner->mutex);
+    buf->busy = false;
+}
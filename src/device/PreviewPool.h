@@ -0,0 +1,50 @@
+#ifndef PREVIEWPOOL_H
+#define PREVIEWPOOL_H
+
+#include <QImage>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief 预览图缓冲区池 (RGB888)
+ *
+ * 采集线程每帧从池中取一块缓冲区，由 RGA 直接写入，再包装成 QImage 发给 UI。
+ * QImage (及其隐式共享的拷贝) 全部释放时，Qt 的 cleanupFunction 把缓冲区还回池中，
+ * 尺寸不变时不再有每帧的像素内存分配。
+ * 所有缓冲区都被 UI 占用时 acquire() 返回空 QImage，调用方丢弃这一帧预览
+ * (说明 UI 线程跟不上，继续生成只会堆积)。
+ * 池的状态由共享指针持有，CameraManager 先析构时仍在 UI 中的缓冲区也能安全归还。
+ */
+class PreviewPool {
+public:
+    explicit PreviewPool(int count = 3);
+
+    PreviewPool(const PreviewPool&) = delete;
+    PreviewPool& operator=(const PreviewPool&) = delete;
+
+    // 取一块 width x height 的缓冲区，行跨度按 16 像素对齐 (RGA 要求)
+    QImage acquire(int width, int height);
+
+    // 行跨度 (像素)
+    static int strideFor(int width) { return (width + 15) & ~15; }
+
+private:
+    struct Shared;
+    struct Buffer {
+        std::vector<unsigned char> data;
+        bool busy = false;
+        std::shared_ptr<Shared> owner;  // 借出期间持有池，归还时释放
+    };
+    struct Shared {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Buffer>> buffers;
+    };
+
+    std::shared_ptr<Shared> m_shared;
+
+    // QImage 的 cleanupFunction
+    static void release(void* info);
+};
+
+#endif // PREVIEWPOOL_H
@@ -0,0 +1,372 @@
+#include "V4l2Capture.h"
+#include <vector>
+#include <mutex>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+// ---------------------------------------------------------
+// 驱动缓冲区集合
+// 由 V4l2Capture 和所有在外的 CameraFrame 共同持有，
+// 保证帧还没被释放时 mmap 区域和 DMA-BUF fd 一直有效
+// ---------------------------------------------------------
+struct V4l2Capture::BufferPool {
+    struct Buffer {
+        void* addr = MAP_FAILED;
+        size_t length = 0;
+        int dma_fd = -1;
+        rga_buffer_handle_t rga_handle = 0;
+    };
+
+    std::mutex mutex;
+    int dev_fd = -1;        // 设备关闭后置为 -1，迟到的归还直接丢弃
+    uint32_t buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    std::vector<Buffer> buffers;
+
+    // 把缓冲区还给驱动继续采集
+    void requeue(int index) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (dev_fd < 0) return;
+
+        struct v4l2_buffer buf;
+        struct v4l2_plane planes[1];
+        memset(&buf, 0, sizeof(buf));
+        memset(planes, 0, sizeof(planes));
+        buf.type = buf_type;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = index;
+        if (buf_type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+            buf.m.planes = planes;
+            buf.length = 1;
+        }
+        if (ioctl(dev_fd, VIDIOC_QBUF, &buf) < 0) {
+            std::cerr << "[V4l2Capture] VIDIOC_QBUF failed: " << strerror(errno) << std::endl;
+        }
+    }
+
+    ~BufferPool() {
+        for (auto& b : buffers) {
+            if (b.rga_handle) releasebuffer_handle(b.rga_handle);
+            if (b.dma_fd >= 0) ::close(b.dma_fd);
+            if (b.addr != MAP_FAILED) munmap(b.addr, b.length);
+        }
+    }
+};
+
+V4l2Capture::V4l2Capture()
+    : m_fd(-1), m_bufType(V4L2_BUF_TYPE_VIDEO_CAPTURE),
+      m_width(0), m_height(0), m_wstride(0), m_pixelformat(0), m_rgaFormat(-1), m_fps(0)
+{
+}
+
+V4l2Capture::~V4l2Capture()
+{
+    close();
+}
+
+int V4l2Capture::toRgaFormat(uint32_t pixelformat)
+{
+    switch (pixelformat) {
+    case V4L2_PIX_FMT_YUYV:  return RK_FORMAT_YUYV_422;
+    case V4L2_PIX_FMT_UYVY:  return RK_FORMAT_UYVY_422;
+    case V4L2_PIX_FMT_NV12:  return RK_FORMAT_YCbCr_420_SP;
+    case V4L2_PIX_FMT_NV21:  return RK_FORMAT_YCrCb_420_SP;
+    case V4L2_PIX_FMT_BGR24: return RK_FORMAT_BGR_888;
+    case V4L2_PIX_FMT_RGB24: return RK_FORMAT_RGB_888;
+    case V4L2_PIX_FMT_MJPEG: return RK_FORMAT_UNKNOWN;  // 码流，需要解码
+    default:                 return -1;
+    }
+}
+
+// 每个像素在首平面中占用的字节数，用于把 bytesperline 换算成像素跨度
+static int bytesPerPixel(uint32_t pixelformat)
+{
+    switch (pixelformat) {
+    case V4L2_PIX_FMT_YUYV:
+    case V4L2_PIX_FMT_UYVY:  return 2;
+    case V4L2_PIX_FMT_BGR24:
+    case V4L2_PIX_FMT_RGB24: return 3;
+    default:                 return 1;  // NV12 / NV21 的 Y 平面，MJPG 不使用
+    }
+}
+
+int V4l2Capture::xioctl(unsigned long request, void* arg)
+{
+    int ret;
+    do {
+        ret = ioctl(m_fd, request, arg);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+int V4l2Capture::open(const std::string& device, int width, int height, uint32_t pixelformat,
+                      int buffer_count, int fps)
+{
+    if (isOpened()) close();
+
+    m_rgaFormat = toRgaFormat(pixelformat);
+    if (m_rgaFormat < 0) {
+        std::cerr << "[V4l2Capture] Unsupported pixel format for RGA" << std::endl;
+        return -1;
+    }
+
+    m_fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (m_fd < 0) {
+        std::cerr << "[V4l2Capture] Cannot open " << device << ": " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    // 1. 查询能力：USB 摄像头一般是单平面，RK ISP 节点是多平面接口
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (xioctl(VIDIOC_QUERYCAP, &cap) < 0) {
+        std::cerr << "[V4l2Capture] VIDIOC_QUERYCAP failed: " << strerror(errno) << std::endl;
+        close();
+        return -1;
+    }
+    uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    if (caps & V4L2_CAP_VIDEO_CAPTURE) {
+        m_bufType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    } else if (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE) {
+        m_bufType = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    } else {
+        std::cerr << "[V4l2Capture] " << device << " is not a capture device" << std::endl;
+        close();
+        return -1;
+    }
+    if (!(caps & V4L2_CAP_STREAMING)) {
+        std::cerr << "[V4l2Capture] " << device << " does not support streaming I/O" << std::endl;
+        close();
+        return -1;
+    }
+
+    // 2. 设置分辨率和像素格式，驱动可能调整，以回读的值为准
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = m_bufType;
+    if (m_bufType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        fmt.fmt.pix_mp.width = width;
+        fmt.fmt.pix_mp.height = height;
+        fmt.fmt.pix_mp.pixelformat = pixelformat;
+        fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+        fmt.fmt.pix_mp.num_planes = 1;
+    } else {
+        fmt.fmt.pix.width = width;
+        fmt.fmt.pix.height = height;
+        fmt.fmt.pix.pixelformat = pixelformat;
+        fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    }
+    if (xioctl(VIDIOC_S_FMT, &fmt) < 0) {
+        std::cerr << "[V4l2Capture] VIDIOC_S_FMT failed: " << strerror(errno) << std::endl;
+        close();
+        return -1;
+    }
+
+    int bytesperline;
+    if (m_bufType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        m_width = fmt.fmt.pix_mp.width;
+        m_height = fmt.fmt.pix_mp.height;
+        m_pixelformat = fmt.fmt.pix_mp.pixelformat;
+        bytesperline = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+    } else {
+        m_width = fmt.fmt.pix.width;
+        m_height = fmt.fmt.pix.height;
+        m_pixelformat = fmt.fmt.pix.pixelformat;
+        bytesperline = fmt.fmt.pix.bytesperline;
+    }
+    if (m_pixelformat != pixelformat) {
+        std::cerr << "[V4l2Capture] Driver refused the requested pixel format" << std::endl;
+        close();
+        return -1;
+    }
+    m_wstride = bytesperline > 0 ? bytesperline / bytesPerPixel(m_pixelformat) : m_width;
+
+    // 3. 帧率必须在 STREAMON 之前设置
+    setFrameRate(fps);
+
+    // 4. 申请、导出缓冲区并开始采集
+    if (setupBuffers(buffer_count) != 0) {
+        close();
+        return -1;
+    }
+
+    unsigned int type = m_bufType;
+    if (xioctl(VIDIOC_STREAMON, &type) < 0) {
+        std::cerr << "[V4l2Capture] VIDIOC_STREAMON failed: " << strerror(errno) << std::endl;
+        close();
+        return -1;
+    }
+
+    std::cout << "[V4l2Capture] " << device << " streaming " << m_width << "x" << m_height
+              << (m_fps > 0 ? " @" + std::to_string(m_fps) + "fps" : std::string())
+              << " with " << m_pool->buffers.size() << " DMA-BUF buffers" << std::endl;
+    return 0;
+}
+
+void V4l2Capture::setFrameRate(int fps)
+{
+    m_fps = 0;
+    struct v4l2_streamparm parm;
+    memset(&parm, 0, sizeof(parm));
+    parm.type = m_bufType;
+    if (xioctl(VIDIOC_G_PARM, &parm) < 0) return;
+    if (!(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) fps = 0;
+
+    if (fps > 0) {
+        parm.parm.capture.timeperframe.numerator = 1;
+        parm.parm.capture.timeperframe.denominator = fps;
+        if (xioctl(VIDIOC_S_PARM, &parm) < 0) {
+            std::cerr << "[V4l2Capture] VIDIOC_S_PARM " << fps << " fps failed: " << strerror(errno) << std::endl;
+        }
+    }
+    // 驱动会取最接近的档位，以回读值为准
+    const struct v4l2_fract& tpf = parm.parm.capture.timeperframe;
+    if (tpf.numerator > 0) m_fps = (int)(tpf.denominator / tpf.numerator);
+}
+
+int V4l2Capture::setupBuffers(int buffer_count)
+{
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = buffer_count;
+    req.type = m_bufType;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(VIDIOC_REQBUFS, &req) < 0 || req.count < 2) {
+        std::cerr << "[V4l2Capture] VIDIOC_REQBUFS failed: " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    m_pool = std::make_shared<BufferPool>();
+    m_pool->dev_fd = m_fd;
+    m_pool->buf_type = m_bufType;
+    m_pool->buffers.resize(req.count);
+
+    bool mplane = (m_bufType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
+    for (unsigned int i = 0; i < req.count; i++) {
+        BufferPool::Buffer& b = m_pool->buffers[i];
+
+        struct v4l2_buffer buf;
+        struct v4l2_plane planes[1];
+        memset(&buf, 0, sizeof(buf));
+        memset(planes, 0, sizeof(planes));
+        buf.type = m_bufType;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+        if (mplane) {
+            buf.m.planes = planes;
+            buf.length = 1;
+        }
+        if (xioctl(VIDIOC_QUERYBUF, &buf) < 0) {
+            std::cerr << "[V4l2Capture] VIDIOC_QUERYBUF failed: " << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        // CPU 映射：只在需要 CPU 访问 (例如 toBgrMat 兜底) 时使用
+        b.length = mplane ? planes[0].length : buf.length;
+        off_t offset = mplane ? planes[0].m.mem_offset : buf.m.offset;
+        b.addr = mmap(nullptr, b.length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, offset);
+        if (b.addr == MAP_FAILED) {
+            std::cerr << "[V4l2Capture] mmap failed: " << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        // 导出 DMA-BUF，RGA 通过 fd 直接访问物理连续的驱动内存
+        struct v4l2_exportbuffer expbuf;
+        memset(&expbuf, 0, sizeof(expbuf));
+        expbuf.type = m_bufType;
+        expbuf.index = i;
+        expbuf.plane = 0;
+        expbuf.flags = O_RDWR | O_CLOEXEC;
+        if (xioctl(VIDIOC_EXPBUF, &expbuf) < 0) {
+            std::cerr << "[V4l2Capture] VIDIOC_EXPBUF failed: " << strerror(errno) << std::endl;
+            return -1;
+        }
+        b.dma_fd = expbuf.fd;
+
+        // 提前导入 RGA，避免每帧重复映射
+        b.rga_handle = importbuffer_fd(b.dma_fd, (int)b.length);
+        if (!b.rga_handle) {
+            std::cerr << "[V4l2Capture] importbuffer_fd failed, falling back to raw fd" << std::endl;
+        }
+
+        if (xioctl(VIDIOC_QBUF, &buf) < 0) {
+            std::cerr << "[V4l2Capture] VIDIOC_QBUF failed: " << strerror(errno) << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void V4l2Capture::close()
+{
+    if (m_fd < 0) return;
+
+    unsigned int type = m_bufType;
+    xioctl(VIDIOC_STREAMOFF, &type);
+
+    // 先断开缓冲区集合与设备的联系，下游晚到的归还不再访问已关闭的 fd
+    if (m_pool) {
+        std::lock_guard<std::mutex> lock(m_pool->mutex);
+        m_pool->dev_fd = -1;
+    }
+    m_pool.reset();
+
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+int V4l2Capture::dequeue(CameraFrame& frame, int timeout_ms)
+{
+    if (m_fd < 0) return -1;
+
+    struct pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret == 0) return 1;
+    if (ret < 0) return errno == EINTR ? 1 : -1;
+    if (pfd.revents & (POLLERR | POLLHUP)) return -1;
+
+    struct v4l2_buffer buf;
+    struct v4l2_plane planes[1];
+    memset(&buf, 0, sizeof(buf));
+    memset(planes, 0, sizeof(planes));
+    buf.type = m_bufType;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if (m_bufType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+        buf.m.planes = planes;
+        buf.length = 1;
+    }
+    if (xioctl(VIDIOC_DQBUF, &buf) < 0) {
+        return errno == EAGAIN ? 1 : -1;
+    }
+
+    const BufferPool::Buffer& b = m_pool->buffers[buf.index];
+    bool mplane = (m_bufType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE);
+    frame = CameraFrame();
+    frame.fd = b.dma_fd;
+    frame.vir_addr = b.addr;
+    frame.rga_handle = b.rga_handle;
+    frame.width = m_width;
+    frame.height = m_height;
+    frame.wstride = m_wstride;
+    frame.hstride = m_height;
+    frame.format = m_rgaFormat;
+    frame.compressed = (m_pixelformat == V4L2_PIX_FMT_MJPEG);
+    frame.bytesused = mplane ? planes[0].bytesused : buf.bytesused;
+
+    // 最后一个引用释放时把缓冲区还给驱动
+    std::shared_ptr<BufferPool> pool = m_pool;
+    int index = buf.index;
+    frame.holder = std::shared_ptr<void>(nullptr, [pool, index](void*) {
+        pool->requeue(index);
+    });
+    return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef V4L2CAPTURE_H
+#define V4L2CAPTURE_H
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "device/CameraFrame.h"
+
+/**
+ * @brief 原生 V4L2 采集后端 (mmap + DMA-BUF 导出)
+ *
+ * 与 cv::VideoCapture 不同，这里不做任何 CPU 解码或拷贝：
+ *   1. VIDIOC_REQBUFS 申请驱动缓冲区并 mmap
+ *   2. VIDIOC_EXPBUF 把每个缓冲区导出为 DMA-BUF fd，并提前 importbuffer_fd 给 RGA
+ *   3. dequeue() 通过 poll 等待驱动填充，返回引用该缓冲区的 CameraFrame
+ *   4. CameraFrame 的最后一个引用释放时，缓冲区自动 VIDIOC_QBUF 回驱动
+ *
+ * 下游 (RetinaFace / 预览) 直接用 fd 交给 RGA 做缩放和颜色转换。
+ * 支持 YUYV / UYVY / NV12 等 RGA 可直接读取的原始格式；
+ * MJPG 帧以 compressed 标记输出，需要交给 MppJpegDecoder 做硬件解码。
+ */
+class V4l2Capture {
+public:
+    V4l2Capture();
+    ~V4l2Capture();
+
+    // 打开 /dev/videoX 并开始采集，pixelformat 为 V4L2_PIX_FMT_*
+    // fps > 0 时通过 VIDIOC_S_PARM 请求传感器帧率 (驱动不支持时保持默认帧率)
+    // 成功返回 0，失败返回 -1
+    int open(const std::string& device, int width, int height, uint32_t pixelformat,
+             int buffer_count = 4, int fps = 0);
+
+    // 停止采集并关闭设备 (已经交给下游的帧仍然有效，直到其引用释放)
+    void close();
+
+    bool isOpened() const { return m_fd >= 0; }
+
+    // 等待并取出一帧：成功返回 0，超时返回 1，出错返回 -1
+    int dequeue(CameraFrame& frame, int timeout_ms);
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    uint32_t pixelformat() const { return m_pixelformat; }
+    // 驱动回报的帧率，未知时为 0
+    int fps() const { return m_fps; }
+
+    // V4L2 像素格式 -> RGA 像素格式，不支持的格式返回 -1 (MJPG 返回 RK_FORMAT_UNKNOWN)
+    static int toRgaFormat(uint32_t pixelformat);
+
+private:
+    struct BufferPool;                  // 驱动缓冲区集合，由在外的帧共同持有
+
+    int m_fd;
+    uint32_t m_bufType;                 // V4L2_BUF_TYPE_VIDEO_CAPTURE(_MPLANE)
+    int m_width;
+    int m_height;
+    int m_wstride;                      // 行跨度 (像素)
+    uint32_t m_pixelformat;
+    int m_rgaFormat;
+    int m_fps;
+    std::shared_ptr<BufferPool> m_pool;
+
+    int xioctl(unsigned long request, void* arg);
+    int setupBuffers(int buffer_count);
+    void setFrameRate(int fps);
+};
+
+#endif // V4L2CAPTURE_H
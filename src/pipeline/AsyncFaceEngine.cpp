@@ -0,0 +1,284 @@
+#include "AsyncFaceEngine.h"
+#include "common/Tracer.h"
+#include <algorithm>
+
+static float elapsedMs(int64_t begin_us, int64_t end_us)
+{
+    return (end_us - begin_us) / 1000.0f;
+}
+
+AsyncFaceEngine::AsyncFaceEngine(RetinaFace* detector, MobileFaceNet* embedder, FaceDatabase* database,
+                                 QObject* parent)
+    : QObject(parent), m_detector(detector), m_embedder(embedder), m_database(database), m_nextId(1), m_stopping(false)
+{
+    qRegisterMetaType<FaceTaskResult>("FaceTaskResult");
+    m_computeThread = std::thread(&AsyncFaceEngine::computeLoop, this);
+    m_writeThread = std::thread(&AsyncFaceEngine::writeLoop, this);
+}
+
+AsyncFaceEngine::~AsyncFaceEngine()
+{
+    stop();
+}
+
+std::future<FaceTaskResult> AsyncFaceEngine::recognize(const cv::Mat& alignedFace, int slot, int* request)
+{
+    return submit(false, nullptr, alignedFace, std::vector<float>(), slot, request);
+}
+
+std::future<FaceTaskResult> AsyncFaceEngine::enroll(const cv::Mat& alignedFace, int slot, int* request)
+{
+    return submit(true, nullptr, alignedFace, std::vector<float>(), slot, request);
+}
+
+std::future<FaceTaskResult> AsyncFaceEngine::recognizeFeature(const std::vector<float>& feature, int slot, int* request)
+{
+    return submit(false, nullptr, cv::Mat(), feature, slot, request);
+}
+
+std::future<FaceTaskResult> AsyncFaceEngine::enrollFeature(const std::vector<float>& feature, int slot, int* request)
+{
+    return submit(true, nullptr, cv::Mat(), feature, slot, request);
+}
+
+std::future<FaceTaskResult> AsyncFaceEngine::recognizeFromCamera(CameraManager* camera, int slot, int* request)
+{
+    return submit(false, camera, cv::Mat(), std::vector<float>(), slot, request);
+}
+
+std::future<FaceTaskResult> AsyncFaceEngine::enrollFromCamera(CameraManager* camera, int slot, int* request)
+{
+    return submit(true, camera, cv::Mat(), std::vector<float>(), slot, request);
+}
+
+std::future<FaceTaskResult> AsyncFaceEngine::submit(bool enroll, CameraManager* camera, const cv::Mat& face,
+                                                    const std::vector<float>& feature, int slot, int* request)
+{
+    TaskPtr task = std::make_shared<Task>();
+    task->enroll = enroll;
+    task->slot = slot;
+    task->camera = camera;
+    if (!face.empty()) {
+        task->face = m_facePool.acquire();
+        face.copyTo(task->face);    // 调用方的 Mat 可能来自复用的缓冲区
+    }
+    task->feature = feature;
+    task->submit_us = Tracer::nowUs();
+    task->result.enroll = enroll;
+    std::future<FaceTaskResult> future = task->promise.get_future();
+
+    TaskPtr replaced;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        task->id = m_nextId++;
+        task->result.request = task->id;
+        if (m_stopping) {
+            replaced = task;        // 已停止：直接以取消结束
+        } else {
+            if (slot >= 0) {
+                auto it = m_slots.find(slot);
+                if (it != m_slots.end() && !it->second->committing) it->second->cancelled = true;
+                m_slots[slot] = task;
+            }
+            m_pending[task->id] = task;
+            m_computeQueue.push_back(task);
+        }
+    }
+    if (request) *request = task->id;
+    if (replaced) {
+        replaced->cancelled = true;
+        complete(replaced);
+    } else {
+        m_computeCond.notify_one();
+    }
+    return future;
+}
+
+bool AsyncFaceEngine::cancel(int request)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pending.find(request);
+    if (it == m_pending.end() || it->second->committing) return false;
+    it->second->cancelled = true;
+    return true;
+}
+
+void AsyncFaceEngine::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping && !m_computeThread.joinable() && !m_writeThread.joinable()) return;
+        m_stopping = true;
+    }
+    m_computeCond.notify_all();
+    m_writeCond.notify_all();
+    if (m_computeThread.joinable()) m_computeThread.join();
+    if (m_writeThread.joinable()) m_writeThread.join();
+
+    // 线程退出后剩下的请求全部以取消结束
+    std::vector<TaskPtr> remaining;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& kv : m_pending) remaining.push_back(kv.second);
+        m_computeQueue.clear();
+        m_writeQueue.clear();
+    }
+    for (const TaskPtr& task : remaining) {
+        task->cancelled = true;
+        complete(task);
+    }
+}
+
+void AsyncFaceEngine::detectFromCamera(const TaskPtr& task)
+{
+    // 帧引用一直持有到对齐完成，保证帧内容不被采集线程覆盖
+    FrameRef ref;
+    if (!m_detector || !task->camera->getLatestFrame(ref)) return;
+
+    std::vector<FaceInfo> faces;
+    m_detector->detect(*ref, faces);
+    if (faces.empty()) return;
+    const FaceInfo& best = *std::max_element(faces.begin(), faces.end(),
+        [](const FaceInfo& a, const FaceInfo& b) { return a.box.area() < b.box.area(); });
+
+    // 录入的特征会长期留在库里：与流水线相同的严格阈值，不合格直接返回原因
+    if (task->enroll) {
+        TraceScope trace(Tracer::STAGE_QUALITY);
+        FaceQuality::Result q;
+        if (m_quality.evaluate(*ref, best, FaceQuality::enrollmentThresholds(), q) != FaceQuality::QUALITY_OK) {
+            task->result.quality = q.verdict;
+            return;
+        }
+    }
+
+    cv::Mat bgr = ref->toBgrMat();
+    if (bgr.empty()) return;
+    task->face = m_facePool.acquire();
+    m_detector->preprocessFace(bgr, best.landmarks, task->face);
+}
+
+void AsyncFaceEngine::computeLoop()
+{
+    while (true) {
+        TaskPtr task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_computeCond.wait(lock, [this] { return m_stopping || !m_computeQueue.empty(); });
+            if (m_stopping) return;
+            task = m_computeQueue.front();
+            m_computeQueue.pop_front();
+        }
+
+        int64_t begin = Tracer::nowUs();
+        task->result.queue_ms = elapsedMs(task->submit_us, begin);
+        if (task->cancelled) {
+            complete(task);
+            continue;
+        }
+
+        // 1. 摄像头请求：取最新帧，检测 + 对齐面积最大的人脸 (NPU + RGA)
+        if (task->camera) {
+            detectFromCamera(task);
+            int64_t detected = Tracer::nowUs();
+            task->result.detect_ms = elapsedMs(begin, detected);
+            begin = detected;
+            if (task->face.empty()) {
+                if (task->result.quality == FaceQuality::QUALITY_OK) task->result.no_face = true;
+                complete(task);
+                continue;
+            }
+        }
+        if (task->cancelled) {
+            complete(task);
+            continue;
+        }
+
+        // 2. 特征提取 (NPU)
+        if (!task->face.empty()) {
+            if (m_embedder->extractFeature(task->face, task->feature) != 0 || task->feature.empty()) {
+                task->result.embed_failed = true;
+            }
+            m_facePool.release(std::move(task->face));
+            task->face = cv::Mat();
+        }
+        int64_t embedded = Tracer::nowUs();
+        task->result.embed_ms = elapsedMs(begin, embedded);
+        if (task->result.embed_failed || task->cancelled) {
+            complete(task);
+            continue;
+        }
+
+        // 3. 识别直接比对；录入交给写线程
+        if (task->enroll) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_writeQueue.push_back(task);
+            }
+            m_writeCond.notify_one();
+            continue;
+        }
+        m_database->recognize(task->feature, task->result.db);
+        task->result.db_ms = elapsedMs(embedded, Tracer::nowUs());
+        complete(task);
+    }
+}
+
+void AsyncFaceEngine::writeLoop()
+{
+    while (true) {
+        // 取出所有排队的录入 (最多 MAX_WRITE_BATCH 个)，取消的直接结束
+        std::vector<TaskPtr> batch, cancelled;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_writeCond.wait(lock, [this] { return m_stopping || !m_writeQueue.empty(); });
+            if (m_stopping) return;
+            while (!m_writeQueue.empty() && batch.size() < MAX_WRITE_BATCH) {
+                TaskPtr task = m_writeQueue.front();
+                m_writeQueue.pop_front();
+                if (task->cancelled) {
+                    cancelled.push_back(task);
+                } else {
+                    task->committing = true;
+                    batch.push_back(task);
+                }
+            }
+        }
+        for (const TaskPtr& task : cancelled) complete(task);
+        if (batch.empty()) continue;
+
+        std::vector<std::vector<float>> features;
+        features.reserve(batch.size());
+        for (const TaskPtr& task : batch) features.push_back(task->feature);
+
+        int64_t begin = Tracer::nowUs();
+        std::vector<FaceDatabase::Result> results;
+        m_database->enrollBatch(features, results);
+        float db_ms = elapsedMs(begin, Tracer::nowUs());
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (i < results.size()) batch[i]->result.db = results[i];
+            else batch[i]->result.db.status = FaceDatabase::STATUS_DB_ERROR;
+            batch[i]->result.db_ms = db_ms;
+            complete(batch[i]);
+        }
+    }
+}
+
+void AsyncFaceEngine::complete(const TaskPtr& task)
+{
+    if (!task->face.empty()) {      // 取消的请求没有经过特征提取
+        m_facePool.release(std::move(task->face));
+        task->face = cv::Mat();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending.erase(task->id);
+        auto it = m_slots.find(task->slot);
+        if (it != m_slots.end() && it->second == task) m_slots.erase(it);
+    }
+
+    task->result.cancelled = task->cancelled && !task->committing;
+    task->result.total_ms = elapsedMs(task->submit_us, Tracer::nowUs());
+    FaceTaskResult result = task->result;
+    task->promise.set_value(result);
+    QMetaObject::invokeMethod(this, [this, result]() { emit finished(result); }, Qt::QueuedConnection);
+}
@@ -0,0 +1,135 @@
+#ifndef ASYNCFACEENGINE_H
+#define ASYNCFACEENGINE_H
+
+#include <QObject>
+#include <QMetaType>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "algo/RetinaFace.h"
+#include "algo/MobileFaceNet.h"
+#include "algo/FaceQuality.h"
+#include "db/FaceDatabase.h"
+#include "common/BufferPool.h"
+
+// 一次异步识别 / 录入的结果
+struct FaceTaskResult {
+    int request = 0;            // 请求编号 (与提交时返回的编号一致)
+    bool enroll = false;
+    bool cancelled = false;     // 被同一 slot 中更新的请求取代，或被 cancel()
+    bool no_face = false;       // 摄像头请求：当前画面中没有检测到人脸 (db 未执行)
+    // 摄像头录入：人脸未通过录入质量阈值时为不合格原因 (db 未执行)，提示语见 FaceQuality::verdictMessage
+    FaceQuality::Verdict quality = FaceQuality::QUALITY_OK;
+    bool embed_failed = false;  // 特征提取失败 (db 未执行)
+    FaceDatabase::Result db;    // 状态 / 人脸ID / 相似度 / 模板数
+    float queue_ms = 0.0f;      // 提交到开始处理
+    float detect_ms = 0.0f;     // 摄像头请求的检测 + 对齐
+    float embed_ms = 0.0f;      // 特征提取
+    float db_ms = 0.0f;         // 比对或写库 (录入为所在批次的事务耗时)
+    float total_ms = 0.0f;      // 提交到完成
+};
+
+Q_DECLARE_METATYPE(FaceTaskResult)
+
+/**
+ * @brief 异步识别 / 录入接口：调用方 (界面线程) 只提交请求，不等待 NPU 与 eMMC
+ *
+ * 结构：
+ *   [计算线程] 摄像头请求先取最新帧检测、对齐 (RetinaFace) -> 特征提取 (从 MobileFaceNet 的上下文池借用上下文) -> 识别请求直接比对
+ *   [写线程]   录入请求排队，每次取出所有排队的请求在一个事务中写入 (FaceDatabase::enrollBatch)，
+ *              连续录入只提交一次，慢速 eMMC 上的写入不会阻塞界面，也不会拖慢识别
+ * 结果同时通过 std::future 与 finished 信号 (投递到 AsyncFaceEngine 所在线程) 返回，
+ * 为结构化的 FaceTaskResult，提示文字由调用方用 FaceDatabase::resultMessage 生成。
+ *
+ * 取消：提交时指定 slot (>= 0)，同一 slot 中较新的请求会取代尚未完成的旧请求
+ * (例如连续点击 "识别" 只保留最后一次)；也可以按编号 cancel()。
+ * 已经写入数据库的录入不能取消，此时结果照常返回。
+ */
+class AsyncFaceEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    // detector 为空时不支持摄像头请求 (结果为 no_face)
+    AsyncFaceEngine(RetinaFace* detector, MobileFaceNet* embedder, FaceDatabase* database,
+                    QObject* parent = nullptr);
+    ~AsyncFaceEngine();
+
+    // 识别 / 录入一张对齐好的 112x112 人脸 (内部拷贝)，request 非空时输出请求编号
+    std::future<FaceTaskResult> recognize(const cv::Mat& alignedFace, int slot = -1, int* request = nullptr);
+    std::future<FaceTaskResult> enroll(const cv::Mat& alignedFace, int slot = -1, int* request = nullptr);
+    // 已有特征时跳过特征提取
+    std::future<FaceTaskResult> recognizeFeature(const std::vector<float>& feature, int slot = -1, int* request = nullptr);
+    std::future<FaceTaskResult> enrollFeature(const std::vector<float>& feature, int slot = -1, int* request = nullptr);
+    // 从摄像头最新一帧中取面积最大的人脸：检测与对齐也在计算线程完成，界面线程不做任何推理。
+    // 录入与流水线一样先按 FaceQuality::enrollmentThresholds() 检查质量，不合格时结果带 quality。
+    // camera 必须在请求结束 (或 stop()) 之前保持有效
+    std::future<FaceTaskResult> recognizeFromCamera(CameraManager* camera, int slot = -1, int* request = nullptr);
+    std::future<FaceTaskResult> enrollFromCamera(CameraManager* camera, int slot = -1, int* request = nullptr);
+
+    // 取消尚未完成的请求，成功返回 true (请求已结束或已写入数据库时返回 false)
+    bool cancel(int request);
+
+    // 停止工作线程，未完成的请求以 cancelled 结束；析构时自动调用
+    void stop();
+
+signals:
+    void finished(const FaceTaskResult& result);
+
+private:
+    // 写线程每个事务最多合并的录入数
+    static const size_t MAX_WRITE_BATCH = 32;
+
+    struct Task {
+        int id = 0;
+        bool enroll = false;
+        int slot = -1;
+        CameraManager* camera = nullptr;    // 非空时先从摄像头取帧检测
+        cv::Mat face;                   // 为空时 feature 已给出
+        std::vector<float> feature;
+        std::promise<FaceTaskResult> promise;
+        std::atomic<bool> cancelled{false};
+        bool committing = false;        // 已交给 enrollBatch，不能再取消 (受 m_mutex 保护)
+        int64_t submit_us = 0;
+        FaceTaskResult result;
+    };
+    typedef std::shared_ptr<Task> TaskPtr;
+
+    RetinaFace* m_detector;
+    MobileFaceNet* m_embedder;
+    FaceDatabase* m_database;
+    // 请求中人脸图的拷贝：112x112 缓冲区用完归还，连续提交时不再申请内存
+    BufferPool<cv::Mat> m_facePool;
+    FaceQuality m_quality;              // 只在计算线程使用
+
+    std::mutex m_mutex;
+    std::condition_variable m_computeCond;
+    std::condition_variable m_writeCond;
+    std::deque<TaskPtr> m_computeQueue;
+    std::deque<TaskPtr> m_writeQueue;
+    std::map<int, TaskPtr> m_pending;   // 尚未完成的请求
+    std::map<int, TaskPtr> m_slots;     // slot -> 该 slot 中最新的请求
+    int m_nextId;
+    bool m_stopping;
+
+    std::thread m_computeThread;
+    std::thread m_writeThread;
+
+    std::future<FaceTaskResult> submit(bool enroll, CameraManager* camera, const cv::Mat& face,
+                                       const std::vector<float>& feature, int slot, int* request);
+    void computeLoop();
+    // 摄像头请求：在最新一帧中检测、(录入时) 质量检查并对齐面积最大的人脸到 task->face
+    void detectFromCamera(const TaskPtr& task);
+    void writeLoop();
+    // 结束一个请求：兑现 future、投递 finished 信号
+    void complete(const TaskPtr& task);
+};
+
+#endif // ASYNCFACEENGINE_H
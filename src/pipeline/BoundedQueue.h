@@ -0,0 +1,102 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+/**
+ * @brief 有界阻塞队列 (丢弃最旧策略)
+ *
+ * 用于流水线各阶段之间传递数据：
+ *   - push() 永不阻塞，队列满时丢弃最旧的元素，保证下游处理的总是最新数据
+ *   - 标记为 pinned 的元素 (例如录入请求) 不会被丢弃：队列满时跳过它丢弃下一个最旧的，
+ *     全部都是 pinned 时允许暂时超出容量
+ *   - pop() 阻塞等待，直到有数据、超时或队列被关闭
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity = 2) : m_capacity(capacity ? capacity : 1), m_closed(false), m_dropped(0) {}
+
+    // 放入一个元素，返回被丢弃的旧元素个数 (0 或 1)；队列已关闭时 item 被丢弃，返回 -1
+    int push(T item, bool pinned = false) {
+        int dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_closed) return -1;
+            if (m_items.size() >= m_capacity) {
+                for (auto it = m_items.begin(); it != m_items.end(); ++it) {
+                    if (it->pinned) continue;
+                    m_items.erase(it);
+                    dropped = 1;
+                    m_dropped++;
+                    break;
+                }
+            }
+            m_items.push_back(Entry{ std::move(item), pinned });
+        }
+        m_cond.notify_one();
+        return dropped;
+    }
+
+    // 取出一个元素：成功返回 true；超时或队列已关闭返回 false
+    bool pop(T& item, int timeout_ms) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                             [this] { return m_closed || !m_items.empty(); })) {
+            return false;
+        }
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front().item);
+        m_items.pop_front();
+        return true;
+    }
+
+    // 关闭队列并唤醒所有等待者，之后的 push 返回 -1；返回被清掉的 pinned 元素个数
+    int close() {
+        int pinned = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            for (const Entry& e : m_items) pinned += e.pinned ? 1 : 0;
+            m_items.clear();
+        }
+        m_cond.notify_all();
+        return pinned;
+    }
+
+    // 重新打开 (流水线重启时使用)
+    void reopen() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = false;
+        m_items.clear();
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_items.clear();
+    }
+
+    // 累计丢弃的元素个数
+    size_t dropped() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dropped;
+    }
+
+private:
+    struct Entry {
+        T item;
+        bool pinned;
+    };
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Entry> m_items;
+    size_t m_capacity;
+    bool m_closed;
+    size_t m_dropped;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,374 @@
+#include "RecognitionPipeline.h"
+#include "common/Tracer.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
+RecognitionPipeline::RecognitionPipeline(CameraManager* camera, RetinaFace* detector,
+                                         MobileFaceNet* embedder, FaceDatabase* database,
+                                         QObject* parent)
+    : QObject(parent),
+      m_camera(camera), m_detector(detector), m_embedder(embedder), m_database(database),
+      m_embedQueue(2), m_matchQueue(2),
+      m_featurePool(ITEM_POOL_SIZE * MAX_FACES),
+      m_detectItemPool(ITEM_POOL_SIZE), m_featureItemPool(ITEM_POOL_SIZE),
+      m_running(false), m_enrollRequested(false),
+      m_detectInterval(DEFAULT_DETECT_INTERVAL),
+      m_streamId(0), m_frameBudgetMs(0), m_dropPolicy(DROP_OLDEST), m_droppedFrames(0),
+      m_qualityGate(true), m_rejectedFaces(0)
+{
+    qRegisterMetaType<std::vector<cv::Rect>>("std::vector<cv::Rect>");
+    qRegisterMetaType<std::vector<int>>("std::vector<int>");
+    qRegisterMetaType<std::vector<FaceInfo>>("std::vector<FaceInfo>");
+}
+
+RecognitionPipeline::~RecognitionPipeline()
+{
+    stop();
+}
+
+void RecognitionPipeline::start()
+{
+    if (m_running) return;
+
+    m_embedQueue.reopen();
+    m_matchQueue.reopen();
+    m_tracker.clear();
+    m_running = true;
+
+    m_workers.emplace_back(&RecognitionPipeline::detectLoop, this);
+    m_workers.emplace_back(&RecognitionPipeline::embedLoop, this);
+    m_workers.emplace_back(&RecognitionPipeline::matchLoop, this);
+    qDebug() << "识别流水线已启动";
+}
+
+void RecognitionPipeline::stop()
+{
+    if (!m_running) return;
+
+    m_running = false;
+    // 关闭队列唤醒阻塞在 pop 上的线程；还在排队的录入请求告知调用方已取消
+    int lost_enrolls = m_embedQueue.close() + m_matchQueue.close();
+    if (lost_enrolls > 0) emit enrollFinished(-1, "识别已停止，录入取消");
+
+    for (auto& t : m_workers) {
+        if (t.joinable()) t.join();
+    }
+    m_workers.clear();
+    if (m_enrollRequested.exchange(false)) emit enrollFinished(-1, "识别已停止，录入取消");
+    qDebug() << "识别流水线已停止";
+}
+
+void RecognitionPipeline::requestEnroll()
+{
+    if (!m_running) {
+        emit enrollFinished(-1, "识别未启动，无法录入");
+        return;
+    }
+    m_enrollRequested = true;
+}
+
+void RecognitionPipeline::recycle(DetectItem& item)
+{
+    item.frame.release();
+    item.still = CameraFrame();
+    item.faces.clear();
+    item.track_ids.clear();
+    item.enroll = false;
+    m_detectItemPool.release(std::move(item));
+}
+
+void RecognitionPipeline::recycle(FeatureItem& item)
+{
+    for (std::vector<float>& feature : item.features) m_featurePool.release(std::move(feature));
+    item.features.clear();
+    item.boxes.clear();
+    item.track_ids.clear();
+    item.enroll = false;
+    m_featureItemPool.release(std::move(item));
+}
+
+int64_t RecognitionPipeline::deadlineOf(const CameraFrame& frame) const
+{
+    int budget_ms = m_frameBudgetMs;
+    if (budget_ms <= 0 || frame.timestamp_us <= 0) return 0;
+    return frame.timestamp_us + (int64_t)budget_ms * 1000;
+}
+
+// ---------------------------------------------------------
+// 阶段 1：检测 (RetinaFace，NPU)
+// ---------------------------------------------------------
+void RecognitionPipeline::detectLoop()
+{
+    uint64_t last_sequence = 0;
+    bool had_face = false;
+    int since_full = 0;     // 距上次整帧检测的帧数
+    std::vector<FaceTracker::Track> tracks;
+    std::vector<cv::Rect> last_boxes;
+    // 每帧的检测结果与信号参数，跨帧复用容量
+    std::vector<FaceInfo> faces;
+    std::vector<cv::Rect> boxes;
+    std::vector<int> faceIds;
+    std::vector<FaceInfo> tracked;
+
+    // 录入窗口：跟踪的轨迹、已经看过的帧数、目前合格且质量分最高的一帧
+    int enroll_track = -1;
+    int enroll_frames = 0;
+    DetectItem enroll_best;
+    float enroll_best_score = -1;
+    FaceQuality::Verdict enroll_verdict = FaceQuality::QUALITY_OK;     // 最近一次不合格的原因
+    int enroll_wait_frames = 0;     // 录入请求后连续没有人脸的帧数
+    auto finish_enroll = [&]() {
+        if (enroll_best_score >= 0) {
+            enroll_best.enroll = true;
+            // 录入请求不被新帧挤掉；队列已关闭 (正在停止) 时告知取消
+            if (m_embedQueue.push(std::move(enroll_best), true) < 0) {
+                emit enrollFinished(-1, "识别已停止，录入取消");
+            }
+        } else {
+            const char* hint = enroll_verdict != FaceQuality::QUALITY_OK
+                ? FaceQuality::verdictMessage(enroll_verdict) : "请正对摄像头";
+            emit enrollFinished(-1, QString("人脸质量不合格，%1").arg(hint));
+        }
+        enroll_best = DetectItem();
+        enroll_track = -1;
+        enroll_best_score = -1;
+        enroll_verdict = FaceQuality::QUALITY_OK;
+    };
+
+    while (m_running) {
+        // 睡眠到采集线程发布新帧，避免对同一帧重复检测；超时用于检查停止标志
+        if (!m_camera->waitForFrame(last_sequence, 100)) continue;
+        FrameRef ref;
+        if (!m_camera->getLatestFrame(ref) || ref.sequence() == last_sequence) continue;
+        last_sequence = ref.sequence();
+        m_detectArena.reset();
+
+        // 本帧的 NPU 请求标记为本路流；DROP_LATE 时排队超过截止时间的检测直接放弃
+        int64_t deadline = deadlineOf(*ref);
+        bool drop_late = m_dropPolicy == DROP_LATE && deadline > 0;
+        NpuStreamScope npu(m_streamId, deadline, drop_late);
+
+        // 上一帧有人脸且未到整帧检测间隔：只检测上一帧人脸框附近的 ROI
+        faces.clear();
+        int ret;
+        TraceScope detect_trace(Tracer::STAGE_DETECT);
+        if (!last_boxes.empty() && ++since_full < m_detectInterval) {
+            ret = m_detector->detectAround(*ref, last_boxes, faces, &m_detectArena);
+        } else {
+            since_full = 0;
+            ret = m_detector->detect(*ref, faces);
+            // 整帧检测的最小人脸反馈给分辨率切换策略 (RESOLUTION_FACE_SIZE)
+            if (ret == 0 && !faces.empty()) {
+                int min_side = INT_MAX;
+                for (const auto& f : faces) min_side = std::min(min_side, std::min(f.box.width, f.box.height));
+                m_detector->reportFaceSize(min_side, ref->width, ref->height);
+            }
+        }
+        detect_trace.stop();
+        if (ret != 0) {
+            if (drop_late && Tracer::nowUs() > deadline) m_droppedFrames++;
+            continue;
+        }
+
+        // 按面积从大到小保留前 MAX_FACES 张脸
+        std::sort(faces.begin(), faces.end(),
+            [](const FaceInfo& a, const FaceInfo& b){ return a.box.area() > b.box.area(); });
+        if (faces.size() > (size_t)MAX_FACES) faces.resize(MAX_FACES);
+
+        // 跟踪：关联到已有轨迹的人脸沿用缓存的识别结果 (空帧也要更新，让轨迹老化)
+        int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        m_tracker.update(faces, now_ms, tracks);
+
+        boxes.clear();
+        faceIds.clear();
+        tracked.clear();
+        for (const auto& t : tracks) {
+            boxes.push_back(t.face.box);
+            faceIds.push_back(t.face_id);
+            tracked.push_back(t.face);
+        }
+        emit facesDetected(boxes);
+        emit facesTracked(tracked, faceIds, ref->width, ref->height);
+        last_boxes = boxes;
+
+        if (tracks.empty()) {
+            if (enroll_track >= 0) finish_enroll();     // 人脸离开画面，用已经看到的最好一帧
+            // 一直没有人脸时录入请求超时，调用方不必无限等待
+            if (m_enrollRequested && ++enroll_wait_frames >= ENROLL_TIMEOUT_FRAMES) {
+                enroll_wait_frames = 0;
+                if (m_enrollRequested.exchange(false)) emit enrollFinished(-1, "录入超时，未检测到人脸");
+            }
+            if (had_face) {
+                had_face = false;
+                emit faceLost();
+            }
+            continue;
+        }
+        had_face = true;
+        enroll_wait_frames = 0;
+        emit facesRecognized(boxes, faceIds);
+
+        // 录入请求：面积最大的人脸无论是否已缓存都重新提取
+        bool enrolling = false;
+        if (!m_qualityGate && m_enrollRequested.exchange(false)) {
+            DetectItem item;
+            item.enroll = true;
+            item.faces.push_back(tracks[0].face);
+            item.track_ids.push_back(tracks[0].track_id);
+            item.frame = ref;
+            if (m_embedQueue.push(std::move(item), true) < 0) emit enrollFinished(-1, "识别已停止，录入取消");
+            enrolling = true;
+        } else if (m_qualityGate) {
+            if (enroll_track < 0 && m_enrollRequested.exchange(false)) {
+                enroll_track = tracks[0].track_id;
+                enroll_frames = 0;
+            }
+            if (enroll_track >= 0) {
+                const FaceTracker::Track* target = nullptr;
+                for (const auto& t : tracks) {
+                    if (t.track_id == enroll_track) target = &t;
+                }
+                if (target) {
+                    TraceScope quality_trace(Tracer::STAGE_QUALITY);
+                    FaceQuality::Result q;
+                    if (m_quality.evaluate(*ref, target->face, FaceQuality::enrollmentThresholds(), q)
+                            != FaceQuality::QUALITY_OK) {
+                        enroll_verdict = q.verdict;
+                    } else if (q.score > enroll_best_score) {
+                        enroll_best_score = q.score;
+                        enroll_best.faces.assign(1, target->face);
+                        enroll_best.track_ids.assign(1, target->track_id);
+                        // YUV 帧的 toBgrMat 已是新内存；BGR 帧直接返回槽位像素，才需要拷贝一份
+                        cv::Mat still = ref->toBgrMat();
+                        if (still.data == ref->mat.data) still = still.clone();
+                        enroll_best.still = CameraFrame::fromMat(still);
+                    }
+                }
+                // 轨迹丢失 (换人) 或窗口结束时录入
+                if (!target || ++enroll_frames >= ENROLL_WINDOW_FRAMES) {
+                    finish_enroll();
+                    enrolling = true;
+                }
+            }
+        }
+
+        // 需要提取特征的人脸先过质量检查：不合格的推迟到下一帧，不占用特征模型
+        // 本帧已经提交了录入时全部推迟
+        DetectItem item = m_detectItemPool.acquire();
+        for (const auto& t : tracks) {
+            if (!t.need_embed) continue;
+            if (enrolling) {
+                m_tracker.deferEmbed(t.track_id);
+                continue;
+            }
+            if (m_qualityGate) {
+                TraceScope quality_trace(Tracer::STAGE_QUALITY);
+                FaceQuality::Result q;
+                if (m_quality.evaluate(*ref, t.face, FaceQuality::recognitionThresholds(), q)
+                        != FaceQuality::QUALITY_OK) {
+                    m_tracker.deferEmbed(t.track_id);
+                    m_rejectedFaces++;
+                    continue;
+                }
+            }
+            item.faces.push_back(t.face);
+            item.track_ids.push_back(t.track_id);
+        }
+        if (item.faces.empty()) {           // 所有人脸都已识别或不合格，本帧不占用特征模型
+            recycle(item);
+            continue;
+        }
+
+        item.frame = std::move(ref);
+        m_embedQueue.push(std::move(item));
+    }
+
+    // 停止时还在挑选最好一帧的录入窗口回复取消 (尚未开始的请求由 stop() 回复)
+    if (enroll_track >= 0) emit enrollFinished(-1, "识别已停止，录入取消");
+}
+
+// ---------------------------------------------------------
+// 阶段 2：对齐 + 特征提取 (RGA 对齐写入 MobileFaceNet 输入张量，NPU 推理)
+// ---------------------------------------------------------
+void RecognitionPipeline::embedLoop()
+{
+    // 每帧复用：元素来自 m_featurePool，保留上次的容量，extractFeatures 只清空不释放
+    std::vector<std::vector<float>> features;
+    while (m_running) {
+        DetectItem item;
+        if (!m_embedQueue.pop(item, 100)) continue;
+
+        // 特征提取不丢弃 (识别结果会被轨迹缓存)，只按截止时间参与排队
+        NpuStreamScope npu(m_streamId, deadlineOf(item.image()));
+
+        // 同一帧的所有人脸只借用一次 NPU 上下文，对齐由 RGA 直接写入输入张量
+        while (features.size() < item.faces.size()) features.push_back(m_featurePool.acquire());
+        while (features.size() > item.faces.size()) {
+            m_featurePool.release(std::move(features.back()));
+            features.pop_back();
+        }
+        m_embedder->extractFeatures(item.image(), item.faces, features);
+        item.frame.release();   // 尽早归还摄像头缓冲区
+        item.still = CameraFrame();
+
+        // 提取成功的特征交给比对阶段，空出的位置从池中补上
+        FeatureItem out = m_featureItemPool.acquire();
+        for (size_t i = 0; i < features.size(); i++) {
+            if (features[i].empty()) continue;
+            out.features.push_back(std::move(features[i]));
+            features[i] = m_featurePool.acquire();
+            out.boxes.push_back(item.faces[i].box);
+            out.track_ids.push_back(item.track_ids[i]);
+        }
+        out.enroll = item.enroll;
+        recycle(item);
+        if (out.features.empty()) {
+            qWarning() << "特征提取失败";
+            // 录入请求必须有回应，否则调用方一直等待结果
+            if (out.enroll) emit enrollFinished(-1, "特征提取失败，请重试");
+            recycle(out);
+            continue;
+        }
+        bool enroll = out.enroll;
+        // 已经取出的录入请求在停止时被关闭的队列丢弃，同样要回应
+        if (m_matchQueue.push(std::move(out), enroll) < 0 && enroll) {
+            emit enrollFinished(-1, "识别已停止，录入取消");
+        }
+    }
+}
+
+// ---------------------------------------------------------
+// 阶段 3：比对 / 录入 (FaceDatabase)
+// ---------------------------------------------------------
+void RecognitionPipeline::matchLoop()
+{
+    std::string message, first_message;     // 跨帧复用容量
+    while (m_running) {
+        FeatureItem item;
+        if (!m_matchQueue.pop(item, 100)) continue;
+
+        if (item.enroll) {
+            // 录入只使用面积最大的人脸，成功后该轨迹直接缓存新的序号
+            int faceId = m_database->enrollFace(item.features[0], message);
+            if (faceId > 0) m_tracker.setIdentity(item.track_ids[0], faceId);
+            emit enrollFinished(faceId, QString::fromStdString(message));
+        } else {
+            // 只有新出现 / 缓存过期 / 质量提升的人脸会走到这里
+            first_message.clear();
+            int first_id = -1;
+            for (size_t i = 0; i < item.features.size(); i++) {
+                int faceId = m_database->recognizeFace(item.features[i], message);
+                m_tracker.setIdentity(item.track_ids[i], faceId);
+                if (i == 0) {
+                    first_id = faceId;
+                    first_message = message;
+                }
+            }
+            emit recognitionFinished(first_id, QString::fromStdString(first_message));
+        }
+        recycle(item);
+    }
+}
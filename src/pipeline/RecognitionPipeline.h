@@ -0,0 +1,191 @@
+#ifndef RECOGNITIONPIPELINE_H
+#define RECOGNITIONPIPELINE_H
+
+#include <QObject>
+#include <QString>
+#include <QMetaType>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "pipeline/BoundedQueue.h"
+#include "common/BufferPool.h"
+#include "common/FrameArena.h"
+#include "device/CameraManager.h"
+#include "algo/RetinaFace.h"
+#include "algo/MobileFaceNet.h"
+#include "algo/FaceTracker.h"
+#include "algo/FaceQuality.h"
+#include "db/FaceDatabase.h"
+
+// 跨线程信号需要注册的类型
+Q_DECLARE_METATYPE(std::vector<cv::Rect>)
+Q_DECLARE_METATYPE(std::vector<int>)
+Q_DECLARE_METATYPE(std::vector<FaceInfo>)
+
+/**
+ * @brief 后台连续人脸识别流水线
+ *
+ * 三个阶段各占一个工作线程，阶段之间用有界队列 (丢弃最旧) 连接：
+ *
+ *   [检测] RetinaFace::detect     ->  embedQueue
+ *   [特征] MobileFaceNet::extractFeatures(frame, faces) -> matchQueue
+ *          (FaceAligner 用 RGA 把人脸对齐后直接写入输入张量，CPU 不再做整帧 warpAffine)
+ *   [比对] FaceDatabase::recognizeFace / enrollFace -> 信号
+ *
+ * 这样第 N+1 帧的 RetinaFace 与第 N 帧的 MobileFaceNet 可以同时在 NPU 上排队，
+ * UI 线程只接收结果信号，不再阻塞在推理上。
+ * 每帧最多处理 MAX_FACES 张人脸 (按面积从大到小)，特征阶段整批提取；
+ * 录入只使用面积最大的人脸。
+ * 检测阶段用 FaceTracker 把人脸关联到轨迹，已识别的轨迹沿用缓存结果，
+ * 只有新出现、缓存过期或质量明显提升的人脸才进入特征阶段。
+ * 进入特征阶段前先过 FaceQuality 质量检查 (尺寸、姿态、清晰度、亮度)，不合格的人脸不占用 NPU，
+ * 轨迹下一帧再试；录入请求之后跟踪面积最大的人脸 ENROLL_WINDOW_FRAMES 帧，
+ * 用其中按录入阈值合格、质量分最高的一帧录入，全部不合格时返回原因。
+ * 每个录入请求都有且只有一次 enrollFinished：ENROLL_TIMEOUT_FRAMES 帧内没有人脸时超时，
+ * stop() 时排队中、处理中和检测阶段尚未提交的请求都回复取消。
+ * 整帧检测每 detectInterval 帧做一次，中间帧只在上一帧人脸框附近的 ROI 内检测
+ * (RetinaFace::detectAround)，新进入画面的人脸最多延迟 detectInterval - 1 帧被发现。
+ *
+ * 内存：检测线程的每帧临时数组来自 FrameArena (每帧回收)，特征向量与阶段之间传递的条目
+ * 来自 BufferPool (用完归还、保留容量)，检索的临时内存由 FaceDatabase 持有；
+ * 预热后检测 -> 特征 -> 比对的计算路径不再申请堆内存 (跨线程信号的参数拷贝除外)。
+ *
+ * 线程约束：RetinaFace / MobileFaceNet 从上下文池借用 NPU 上下文、FaceDatabase 内部加锁，
+ * 流水线运行期间其他线程 (如 FaceService 处理远程图片) 也可以直接调用；
+ * 摄像头画面的录入调用 requestEnroll()，由比对阶段完成。
+ *
+ * 多路摄像头：每个 CameraManager 一条流水线，共用同一组 RetinaFace / MobileFaceNet / FaceDatabase
+ * (模型只加载一次，上下文由 rknn_dup_context 复制)。各条流水线用 setStreamId 区分，
+ * NPU 上下文按 NpuScheduler::schedulePolicy() 在各路之间轮询或按截止时间 (采集时间 + 帧预算) 分配。
+ */
+class RecognitionPipeline : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 每路流的丢帧策略
+    enum DropPolicy {
+        DROP_OLDEST = 0,    // 默认：只处理最新帧 (帧交换与阶段队列丢弃旧的)，NPU 忙时检测排队等待
+        DROP_LATE           // 另外：检测等 NPU 超过帧预算时放弃这一帧，把 NPU 让给其他路
+    };
+
+    RecognitionPipeline(CameraManager* camera, RetinaFace* detector,
+                        MobileFaceNet* embedder, FaceDatabase* database,
+                        QObject* parent = nullptr);
+    ~RecognitionPipeline();
+
+    // 启动 / 停止所有工作线程 (stop 会等待线程退出)
+    void start();
+    void stop();
+    bool isRunning() const { return m_running; }
+
+    // 请求把下一张对齐好的人脸录入数据库 (结果通过 enrollFinished 返回)
+    void requestEnroll();
+
+    // 整帧检测间隔 (帧)，1 表示每帧都做整帧检测；画面中没有人脸时总是整帧检测
+    void setDetectInterval(int frames) { m_detectInterval = std::max(1, frames); }
+
+    // 流编号 (摄像头序号)，NPU 轮询调度按它区分各路，默认 0
+    void setStreamId(int id) { m_streamId = id; }
+    int streamId() const { return m_streamId; }
+
+    // 帧预算 (毫秒)：采集后应在多久内完成检测 / 特征提取，即 NPU 截止时间调度用的截止时间；0 = 不限
+    void setFrameBudget(int ms) { m_frameBudgetMs = std::max(0, ms); }
+
+    void setDropPolicy(DropPolicy policy) { m_dropPolicy = policy; }
+
+    // DROP_LATE 放弃的帧数
+    uint64_t droppedFrames() const { return m_droppedFrames; }
+
+    // 特征提取前的质量检查，默认开启；关闭后录入直接使用下一帧面积最大的人脸
+    void setQualityGateEnabled(bool enabled) { m_qualityGate = enabled; }
+    // 质量检查不合格、推迟提取特征的人脸数
+    uint64_t rejectedFaces() const { return m_rejectedFaces; }
+
+signals:
+    // 每帧检测结果 (原图坐标)，可用于绘制人脸框
+    void facesDetected(const std::vector<cv::Rect>& boxes);
+    // 识别结果 (面积最大的人脸)：faceId > 0 表示匹配成功
+    void recognitionFinished(int faceId, const QString& message);
+    // 每帧所有跟踪人脸的缓存识别结果，boxes 与 faceIds 一一对应 (未匹配或尚未识别为 -1)
+    void facesRecognized(const std::vector<cv::Rect>& boxes, const std::vector<int>& faceIds);
+    // 每帧所有跟踪人脸 (含关键点) 与缓存识别结果，空帧也会发出，用于绘制预览叠加层
+    void facesTracked(const std::vector<FaceInfo>& faces, const std::vector<int>& faceIds,
+                      int frameWidth, int frameHeight);
+    // 录入结果：faceId > 0 表示录入成功
+    void enrollFinished(int faceId, const QString& message);
+    // 人脸离开画面 (从有人脸变为无人脸时发出一次)
+    void faceLost();
+
+private:
+    // 每帧最多识别的人脸数
+    static const int MAX_FACES = 8;
+    // 默认整帧检测间隔
+    static const int DEFAULT_DETECT_INTERVAL = 5;
+    // 录入时挑选最好一帧的窗口 (帧)
+    static const int ENROLL_WINDOW_FRAMES = 10;
+    // 录入请求后连续多少帧没有人脸时超时 (约 3 秒 @ 30fps)
+    static const int ENROLL_TIMEOUT_FRAMES = 90;
+    // 池中保留的阶段条目数 (两个队列各 2 项 + 各阶段正在处理的)
+    static const int ITEM_POOL_SIZE = 8;
+
+    // 阶段之间传递的数据 (同一帧的多张人脸，按面积从大到小)
+    struct DetectItem {
+        FrameRef frame;             // 持有帧，直到对齐完成
+        CameraFrame still;          // 录入窗口中挑出的帧 (BGR 拷贝，不占用帧交换的槽位)，frame 为空时使用
+        std::vector<FaceInfo> faces;
+        std::vector<int> track_ids;
+        bool enroll = false;        // 录入请求 (faces 只含面积最大的人脸)
+
+        const CameraFrame& image() const { return frame.valid() ? *frame : still; }
+    };
+    struct FeatureItem {
+        std::vector<std::vector<float>> features;
+        std::vector<cv::Rect> boxes;
+        std::vector<int> track_ids;
+        bool enroll = false;
+    };
+
+    CameraManager* m_camera;
+    RetinaFace* m_detector;
+    MobileFaceNet* m_embedder;
+    FaceDatabase* m_database;
+
+    BoundedQueue<DetectItem> m_embedQueue;
+    BoundedQueue<FeatureItem> m_matchQueue;
+    FaceTracker m_tracker;
+    FaceQuality m_quality;          // 只在检测线程使用
+
+    // 检测线程的每帧临时内存 (ROI 列表等)，每帧开始时回收
+    FrameArena m_detectArena;
+    // 特征向量：特征阶段取出、比对阶段归还，保留特征维度的容量
+    BufferPool<std::vector<float>> m_featurePool;
+    // 阶段之间传递的条目：用完归还，内部数组的容量跨帧复用
+    BufferPool<DetectItem> m_detectItemPool;
+    BufferPool<FeatureItem> m_featureItemPool;
+
+    std::vector<std::thread> m_workers;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_enrollRequested;
+    std::atomic<int> m_detectInterval;
+    std::atomic<int> m_streamId;
+    std::atomic<int> m_frameBudgetMs;
+    std::atomic<DropPolicy> m_dropPolicy;
+    std::atomic<uint64_t> m_droppedFrames;
+    std::atomic<bool> m_qualityGate;
+    std::atomic<uint64_t> m_rejectedFaces;
+
+    // 帧的 NPU 截止时间 (未设置帧预算时为 0)
+    int64_t deadlineOf(const CameraFrame& frame) const;
+
+    void detectLoop();
+    void embedLoop();
+    void matchLoop();
+    // 清空条目并放回池中 (特征向量归还 m_featurePool)
+    void recycle(DetectItem& item);
+    void recycle(FeatureItem& item);
+};
+
+#endif // RECOGNITIONPIPELINE_H
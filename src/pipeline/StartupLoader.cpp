@@ -0,0 +1,81 @@
+#include "StartupLoader.h"
+#include "common/Tracer.h"
+
+StartupLoader::StartupLoader(QObject* parent)
+    : QObject(parent), m_state(STATE_IDLE), m_remaining(0)
+{
+}
+
+StartupLoader::~StartupLoader()
+{
+    wait();
+}
+
+void StartupLoader::addTask(const QString& name, std::function<int()> task)
+{
+    if (state() != STATE_IDLE) return;
+    Task t;
+    t.name = name;
+    t.run = std::move(task);
+    m_tasks.push_back(std::move(t));
+}
+
+void StartupLoader::start()
+{
+    if (state() != STATE_IDLE) return;
+    m_remaining = (int)m_tasks.size();
+    m_state = STATE_LOADING;
+    if (m_tasks.empty()) {
+        m_state = STATE_READY;
+        QMetaObject::invokeMethod(this, [this]() { emit ready(); }, Qt::QueuedConnection);
+        return;
+    }
+    for (size_t i = 0; i < m_tasks.size(); i++) {
+        m_threads.emplace_back(&StartupLoader::runTask, this, i);
+    }
+}
+
+int StartupLoader::wait()
+{
+    for (std::thread& t : m_threads) {
+        if (t.joinable()) t.join();
+    }
+    return state() == STATE_READY ? 0 : -1;
+}
+
+QString StartupLoader::failedTasks() const
+{
+    QString names;
+    if (state() != STATE_READY && state() != STATE_FAILED) return names;
+    for (const Task& t : m_tasks) {
+        if (t.ret == 0) continue;
+        if (!names.isEmpty()) names += "、";
+        names += t.name;
+    }
+    return names;
+}
+
+void StartupLoader::runTask(size_t index)
+{
+    Task& task = m_tasks[index];
+    int64_t begin = Tracer::nowUs();
+    task.ret = task.run();
+    task.elapsed_ms = (int)((Tracer::nowUs() - begin) / 1000);
+
+    QString name = task.name;
+    int ret = task.ret, elapsed = task.elapsed_ms;
+    QMetaObject::invokeMethod(this, [this, name, ret, elapsed]() { emit taskFinished(name, ret, elapsed); },
+                              Qt::QueuedConnection);
+
+    // 最后一个结束的任务决定最终状态 (fetch_sub 的 acq_rel 保证能看到其他任务的 ret)
+    if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    bool ok = true;
+    for (const Task& t : m_tasks) ok = ok && t.ret == 0;
+    m_state = ok ? STATE_READY : STATE_FAILED;
+    if (ok) {
+        QMetaObject::invokeMethod(this, [this]() { emit ready(); }, Qt::QueuedConnection);
+    } else {
+        QString names = failedTasks();
+        QMetaObject::invokeMethod(this, [this, names]() { emit failed(names); }, Qt::QueuedConnection);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef STARTUPLOADER_H
+#define STARTUPLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 启动时并行执行各模块的初始化 (模型 rknn_init、数据库打开与特征库加载)
+ *
+ * 状态机：STATE_IDLE -> start() -> STATE_LOADING -> 全部任务结束 -> STATE_READY / STATE_FAILED。
+ * 每个任务一个线程，互不等待；摄像头与预览不依赖这些任务，界面在加载期间就能显示画面，
+ * 收到 ready() 后再创建流水线、启用按钮。
+ * 信号都投递到 StartupLoader 所在线程 (通常是界面线程)；没有事件循环的程序用 wait() 阻塞等待。
+ * 任务访问的对象在任务结束前不能被其他线程使用；析构时等待所有任务结束。
+ */
+class StartupLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum State {
+        STATE_IDLE = 0,     // 尚未 start()
+        STATE_LOADING,      // 任务执行中
+        STATE_READY,        // 所有任务成功
+        STATE_FAILED        // 至少一个任务失败 (其余任务仍会执行完)
+    };
+
+    explicit StartupLoader(QObject* parent = nullptr);
+    ~StartupLoader();
+
+    // 添加一个初始化任务，返回0表示成功；需在 start() 之前调用
+    void addTask(const QString& name, std::function<int()> task);
+    // 每个任务一个线程并行执行 (只能调用一次)
+    void start();
+    // 阻塞等待所有任务结束，全部成功返回0
+    int wait();
+
+    State state() const { return (State)m_state.load(); }
+    // 失败的任务名 (顿号分隔)，结束前为空
+    QString failedTasks() const;
+
+signals:
+    // 单个任务结束 (ret 为任务返回值)
+    void taskFinished(const QString& name, int ret, int elapsedMs);
+    void ready();
+    void failed(const QString& tasks);
+
+private:
+    struct Task {
+        QString name;
+        std::function<int()> run;
+        int ret = -1;
+        int elapsed_ms = 0;
+    };
+
+    std::vector<Task> m_tasks;          // start() 之后不再增删，各线程只写自己的元素
+    std::vector<std::thread> m_threads;
+    std::atomic<int> m_state;
+    std::atomic<int> m_remaining;
+
+    void runTask(size_t index);
+};
+
+#endif // STARTUPLOADER_H
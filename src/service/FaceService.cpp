@@ -0,0 +1,488 @@
+#include "FaceService.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMetaObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <algorithm>
+#include <opencv2/imgcodecs.hpp>
+
+FaceService::FaceService(RetinaFace* detector, MobileFaceNet* embedder, FaceDatabase* database,
+                         const std::vector<RecognitionPipeline*>& pipelines, QObject* parent)
+    : QObject(parent),
+      m_detector(detector), m_embedder(embedder), m_database(database),
+      m_pipelines(pipelines), m_lastResults(pipelines.size()),
+      m_localServer(nullptr), m_tcpServer(nullptr), m_nextClient(1), m_enrollSerial(0),
+      m_stopping(false)
+{
+    // 信号在流水线线程发出，lambda 以 this 为上下文对象，排队到事件循环线程执行
+    for (int i = 0; i < (int)m_pipelines.size(); i++) {
+        RecognitionPipeline* pipeline = m_pipelines[i];
+        connect(pipeline, &RecognitionPipeline::recognitionFinished, this,
+                [this, i](int faceId, const QString& message) { onRecognitionFinished(i, faceId, message); });
+        connect(pipeline, &RecognitionPipeline::enrollFinished, this,
+                [this, i](int faceId, const QString& message) { onEnrollFinished(i, faceId, message); });
+        connect(pipeline, &RecognitionPipeline::faceLost, this,
+                [this, i] { onFaceLost(i); });
+        connect(pipeline, &RecognitionPipeline::facesTracked, this,
+                [this, i](const std::vector<FaceInfo>& faces, const std::vector<int>& faceIds, int w, int h) {
+                    onFacesTracked(i, faces, faceIds, w, h);
+                });
+    }
+}
+
+FaceService::~FaceService()
+{
+    stop();
+}
+
+int FaceService::listenLocal(const QString& path)
+{
+    // 上次异常退出留下的套接字文件会导致 listen 失败
+    QLocalServer::removeServer(path);
+    m_localServer = new QLocalServer(this);
+    if (!m_localServer->listen(path)) {
+        qWarning() << "无法监听 Unix 套接字" << path << ":" << m_localServer->errorString();
+        return -1;
+    }
+    connect(m_localServer, &QLocalServer::newConnection, this, [this] {
+        while (QLocalSocket* socket = m_localServer->nextPendingConnection()) {
+            int client = addClient(socket, true);
+            connect(socket, &QLocalSocket::disconnected, this, [this, client] { removeClient(client); });
+        }
+    });
+    qDebug() << "识别服务监听 Unix 套接字:" << path;
+    return 0;
+}
+
+int FaceService::listenTcp(int port, const QString& token, const QHostAddress& address)
+{
+    // TCP 上的请求可以录入人脸，没有口令时不对外开放
+    if (token.isEmpty()) {
+        qWarning() << "TCP 端口需要设置认证口令";
+        return -1;
+    }
+    m_tcpToken = token;
+    m_tcpServer = new QTcpServer(this);
+    if (!m_tcpServer->listen(address, (quint16)port)) {
+        qWarning() << "无法监听 TCP 端口" << port << ":" << m_tcpServer->errorString();
+        return -1;
+    }
+    connect(m_tcpServer, &QTcpServer::newConnection, this, [this] {
+        while (QTcpSocket* socket = m_tcpServer->nextPendingConnection()) {
+            int client = addClient(socket, false);
+            connect(socket, &QTcpSocket::disconnected, this, [this, client] { removeClient(client); });
+        }
+    });
+    qDebug() << "识别服务监听 TCP:" << address.toString() << port;
+    return 0;
+}
+
+// 口令比较的耗时与第一个不同字符的位置无关
+static bool tokenEquals(const QByteArray& a, const QByteArray& b)
+{
+    if (a.size() != b.size()) return false;
+    unsigned char diff = 0;
+    for (int i = 0; i < a.size(); i++) diff |= (unsigned char)(a[i] ^ b[i]);
+    return diff == 0;
+}
+
+void FaceService::startWorkers(int count)
+{
+    m_stopping = false;
+    for (int i = 0; i < std::max(1, count); i++) {
+        m_workers.emplace_back(&FaceService::workerLoop, this);
+    }
+}
+
+void FaceService::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_stopping = true;
+        m_jobs.clear();
+    }
+    m_jobCond.notify_all();
+    for (std::thread& t : m_workers) {
+        if (t.joinable()) t.join();
+    }
+    m_workers.clear();
+
+    if (m_localServer) m_localServer->close();
+    if (m_tcpServer) m_tcpServer->close();
+    for (auto& kv : m_clients) {
+        kv.second.device->blockSignals(true);
+        kv.second.device->close();
+        kv.second.device->deleteLater();
+    }
+    m_clients.clear();
+    m_pendingEnrolls.clear();
+}
+
+int FaceService::addClient(QIODevice* device, bool authorized)
+{
+    int client = m_nextClient++;
+    m_clients[client].device = device;
+    m_clients[client].authorized = authorized;
+    connect(device, &QIODevice::readyRead, this, [this, client] { readClient(client); });
+    return client;
+}
+
+void FaceService::removeClient(int client)
+{
+    auto it = m_clients.find(client);
+    if (it == m_clients.end()) return;
+    // 还在 worker 中的任务按编号查找客户端，找不到时应答直接丢弃
+    it->second.device->deleteLater();
+    m_clients.erase(it);
+}
+
+void FaceService::readClient(int client)
+{
+    auto it = m_clients.find(client);
+    if (it == m_clients.end()) return;
+    Client& c = it->second;
+    c.buffer.append(c.device->readAll());
+
+    // 逐行处理；handleRequest 不会删除客户端，c 在循环中一直有效
+    int start = 0;
+    int newline;
+    while ((newline = c.buffer.indexOf('\n', start)) >= 0) {
+        QByteArray line = c.buffer.mid(start, newline - start);
+        start = newline + 1;
+        handleRequest(client, line);
+    }
+    c.buffer.remove(0, start);
+
+    if (c.buffer.size() > MAX_LINE_BYTES) {
+        reply(client, QJsonValue(), false, -1, "请求过长");
+        c.device->close();
+    }
+}
+
+void FaceService::handleRequest(int client, const QByteArray& line)
+{
+    if (line.trimmed().isEmpty()) return;
+
+    QJsonDocument doc = QJsonDocument::fromJson(line);
+    if (!doc.isObject()) {
+        reply(client, QJsonValue(), false, -1, "请求不是合法的 JSON 对象");
+        return;
+    }
+    QJsonObject request = doc.object();
+    QJsonValue id = request.value("id");
+    QString cmd = request.value("cmd").toString();
+    Client& c = m_clients[client];
+
+    if (cmd == "auth") {
+        if (c.authorized || tokenEquals(request.value("token").toString().toUtf8(), m_tcpToken.toUtf8())) {
+            c.authorized = true;
+            reply(client, id, true, -1, "认证成功");
+        } else {
+            qWarning() << "识别服务: 口令错误，断开连接";
+            reply(client, id, false, -1, "口令错误");
+            // 回到事件循环再断开：close() 可能同步触发 disconnected 删除客户端，而 readClient 还在用它
+            QIODevice* device = c.device;
+            QTimer::singleShot(0, device, [device] { device->close(); });
+        }
+        return;
+    }
+    if (!c.authorized && cmd != "ping") {
+        reply(client, id, false, -1, "请先认证");
+        return;
+    }
+
+    if (cmd == "ping") {
+        reply(client, id, true, -1, "pong");
+    } else if (cmd == "status") {
+        size_t queued;
+        {
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            queued = m_jobs.size();
+        }
+        QJsonArray cameras;
+        for (RecognitionPipeline* pipeline : m_pipelines) {
+            QJsonObject camera;
+            camera["running"] = pipeline->isRunning();
+            camera["dropped"] = (double)pipeline->droppedFrames();
+            camera["rejected"] = (double)pipeline->rejectedFaces();
+            cameras.append(camera);
+        }
+        QJsonObject r;
+        r["id"] = id;
+        r["ok"] = true;
+        r["faces"] = m_database->getFaceCount();
+        r["cameras"] = cameras;
+        r["clients"] = (int)m_clients.size();
+        r["queued"] = (int)queued;
+        send(client, r);
+    } else if (cmd == "subscribe") {
+        c.subscribed = true;
+        c.tracks = request.value("tracks").toBool(false);
+        reply(client, id, true, -1, "已订阅");
+    } else if (cmd == "unsubscribe") {
+        c.subscribed = false;
+        c.tracks = false;
+        reply(client, id, true, -1, "已取消订阅");
+    } else if (cmd == "identify" || cmd == "enroll") {
+        bool enroll = cmd == "enroll";
+        if (request.contains("jpeg")) {
+            // 远程图片：交给 worker 线程，处理完后由 worker 投递应答
+            Job job;
+            job.client = client;
+            job.id = id;
+            job.enroll = enroll;
+            if (enroll) job.face_id = request.value("face_id").toInt(-1);
+            job.jpeg = QByteArray::fromBase64(request.value("jpeg").toString().toLatin1());
+            if (job.jpeg.isEmpty()) {
+                reply(client, id, false, -1, "图片数据为空");
+                return;
+            }
+            bool queued = false;
+            {
+                std::lock_guard<std::mutex> lock(m_jobMutex);
+                if (!m_workers.empty() && m_jobs.size() < MAX_QUEUED_JOBS) {
+                    m_jobs.push_back(std::move(job));
+                    queued = true;
+                }
+            }
+            if (!queued) {
+                reply(client, id, false, -1, "服务繁忙，请稍后重试");
+                return;
+            }
+            m_jobCond.notify_one();
+            return;
+        }
+
+        int camera = request.value("camera").toInt(0);
+        if (camera < 0 || camera >= (int)m_pipelines.size() || !m_pipelines[camera]->isRunning()) {
+            reply(client, id, false, -1, "摄像头未运行，请附带 jpeg 图片");
+        } else if (enroll) {
+            // 摄像头录入：流水线只有一个录入标志，同一路同时等待的请求共享同一个结果
+            int serial = ++m_enrollSerial;
+            m_pendingEnrolls.push_back(PendingEnroll{ client, id, camera, serial });
+            m_pipelines[camera]->requestEnroll();
+            QTimer::singleShot(ENROLL_TIMEOUT_MS, this, [this, camera, serial] {
+                finishPendingEnrolls(camera, -1, "录入超时，未检测到人脸", serial);
+            });
+        } else {
+            const LastResult& last = m_lastResults[camera];
+            QJsonObject r;
+            r["id"] = id;
+            r["ok"] = last.face_id > 0;
+            r["camera"] = camera;
+            r["face_id"] = last.face_id;
+            r["message"] = last.time_ms > 0 ? last.message : QString("未检测到人脸");
+            if (last.time_ms > 0) {
+                r["age_ms"] = (double)(QDateTime::currentMSecsSinceEpoch() - last.time_ms);
+            }
+            send(client, r);
+        }
+    } else {
+        reply(client, id, false, -1, "未知命令: " + cmd);
+    }
+}
+
+void FaceService::send(int client, const QJsonObject& obj)
+{
+    auto it = m_clients.find(client);
+    if (it == m_clients.end()) return;
+    QByteArray line = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    line.append('\n');
+    it->second.device->write(line);
+}
+
+void FaceService::broadcast(const QJsonObject& event, bool tracksOnly)
+{
+    QByteArray line;
+    for (auto& kv : m_clients) {
+        Client& c = kv.second;
+        if (!c.subscribed || (tracksOnly && !c.tracks)) continue;
+        // 对端读不过来时丢弃事件，不让写缓冲无限增长
+        if (c.device->bytesToWrite() > MAX_PENDING_WRITE) continue;
+        if (line.isEmpty()) {
+            line = QJsonDocument(event).toJson(QJsonDocument::Compact);
+            line.append('\n');
+        }
+        c.device->write(line);
+    }
+}
+
+void FaceService::reply(int client, const QJsonValue& id, bool ok, int faceId, const QString& message)
+{
+    QJsonObject r;
+    r["id"] = id;
+    r["ok"] = ok;
+    r["face_id"] = faceId;
+    r["message"] = message;
+    send(client, r);
+}
+
+void FaceService::finishPendingEnrolls(int camera, int faceId, const QString& message, int serial)
+{
+    auto it = m_pendingEnrolls.begin();
+    while (it != m_pendingEnrolls.end()) {
+        if (it->camera == camera && (serial < 0 || it->serial == serial)) {
+            reply(it->client, it->id, faceId > 0, faceId, message);
+            it = m_pendingEnrolls.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void FaceService::onRecognitionFinished(int camera, int faceId, const QString& message)
+{
+    LastResult& last = m_lastResults[camera];
+    last.face_id = faceId;
+    last.message = message;
+    last.time_ms = QDateTime::currentMSecsSinceEpoch();
+
+    QJsonObject event;
+    event["event"] = "recognized";
+    event["camera"] = camera;
+    event["face_id"] = faceId;
+    event["message"] = message;
+    event["ts"] = (double)last.time_ms;
+    broadcast(event);
+}
+
+void FaceService::onEnrollFinished(int camera, int faceId, const QString& message)
+{
+    finishPendingEnrolls(camera, faceId, message);
+
+    QJsonObject event;
+    event["event"] = "enrolled";
+    event["camera"] = camera;
+    event["face_id"] = faceId;
+    event["message"] = message;
+    event["ts"] = (double)QDateTime::currentMSecsSinceEpoch();
+    broadcast(event);
+}
+
+void FaceService::onFaceLost(int camera)
+{
+    m_lastResults[camera] = LastResult();
+
+    QJsonObject event;
+    event["event"] = "face_lost";
+    event["camera"] = camera;
+    event["ts"] = (double)QDateTime::currentMSecsSinceEpoch();
+    broadcast(event);
+}
+
+void FaceService::onFacesTracked(int camera, const std::vector<FaceInfo>& faces, const std::vector<int>& faceIds,
+                                 int frameWidth, int frameHeight)
+{
+    bool wanted = false;
+    for (const auto& kv : m_clients) {
+        if (kv.second.subscribed && kv.second.tracks) wanted = true;
+    }
+    if (!wanted) return;
+
+    QJsonArray tracks;
+    for (size_t i = 0; i < faces.size(); i++) {
+        const cv::Rect& b = faces[i].box;
+        QJsonObject t;
+        t["box"] = QJsonArray{ b.x, b.y, b.width, b.height };
+        t["face_id"] = i < faceIds.size() ? faceIds[i] : -1;
+        tracks.append(t);
+    }
+    QJsonObject event;
+    event["event"] = "tracks";
+    event["camera"] = camera;
+    event["width"] = frameWidth;
+    event["height"] = frameHeight;
+    event["faces"] = tracks;
+    broadcast(event, true);
+}
+
+void FaceService::workerLoop()
+{
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_jobMutex);
+            m_jobCond.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        QJsonObject result = processImage(job);
+        // 套接字属于事件循环线程，应答投递回去发送
+        int client = job.client;
+        QMetaObject::invokeMethod(this, [this, client, result] { send(client, result); },
+                                  Qt::QueuedConnection);
+    }
+}
+
+QJsonObject FaceService::processImage(const Job& job)
+{
+    QJsonObject r;
+    r["id"] = job.id;
+    r["ok"] = false;
+    r["face_id"] = -1;
+
+    cv::Mat data(1, job.jpeg.size(), CV_8UC1, (void*)job.jpeg.constData());
+    cv::Mat img = cv::imdecode(data, cv::IMREAD_COLOR);
+    if (img.empty()) {
+        r["message"] = "图片解码失败";
+        return r;
+    }
+
+    std::vector<FaceInfo> faces;
+    if (m_detector->detect(img, faces) != 0) {
+        r["message"] = "人脸检测失败";
+        return r;
+    }
+    r["faces"] = (int)faces.size();
+    if (faces.empty()) {
+        r["message"] = "未检测到人脸";
+        return r;
+    }
+
+    // 与录入工具一致：只取面积最大的人脸
+    const FaceInfo& best = *std::max_element(faces.begin(), faces.end(),
+        [](const FaceInfo& a, const FaceInfo& b) { return a.box.area() < b.box.area(); });
+    r["box"] = QJsonArray{ best.box.x, best.box.y, best.box.width, best.box.height };
+
+    // 质量检查：录入用严格阈值，识别用宽松阈值，不合格的不提取特征
+    FaceQuality quality;
+    FaceQuality::Result q;
+    FaceQuality::Thresholds th = job.enroll ? FaceQuality::enrollmentThresholds()
+                                            : FaceQuality::recognitionThresholds();
+    quality.evaluate(CameraFrame::fromMat(img), best, th, q);
+    r["quality"] = q.score;
+    if (q.verdict != FaceQuality::QUALITY_OK) {
+        r["message"] = QString("人脸质量不合格，%1").arg(FaceQuality::verdictMessage(q.verdict));
+        return r;
+    }
+
+    cv::Mat aligned = m_detector->preprocessFace(img, best.landmarks);
+    std::vector<float> feature;
+    if (aligned.empty() || m_embedder->extractFeature(aligned, feature) != 0 || feature.empty()) {
+        r["message"] = "特征提取失败";
+        return r;
+    }
+
+    std::string message;
+    int faceId;
+    if (job.enroll && job.face_id > 0) {
+        // 身份由客户端指定：必须与该身份本人相似才追加，防止把别人的脸挂到已有身份上
+        faceId = m_database->addTemplate(job.face_id, feature, message, true) < 0 ? -1 : job.face_id;
+    } else {
+        faceId = job.enroll ? m_database->enrollFace(feature, message)
+                            : m_database->recognizeFace(feature, message);
+    }
+    r["ok"] = faceId > 0;
+    r["face_id"] = faceId;
+    r["message"] = QString::fromStdString(message);
+    return r;
+}
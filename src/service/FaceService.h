@@ -0,0 +1,154 @@
+#ifndef FACESERVICE_H
+#define FACESERVICE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "pipeline/RecognitionPipeline.h"
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+
+/**
+ * @brief 无界面识别服务：在 Unix 套接字 (可选 TCP 端口) 上提供识别 / 录入接口并推送识别事件
+ *
+ * 协议为按行分隔的 JSON (UTF-8，每个请求 / 应答 / 事件占一行)：
+ *   请求  {"id": 1, "cmd": "identify", "jpeg": "<base64>"}
+ *   应答  {"id": 1, "ok": true, "face_id": 3, "message": "你是3号", "box": [x, y, w, h], "faces": 1}
+ *   事件  {"event": "recognized", "camera": 0, "face_id": 3, "message": "你是3号", "ts": 1700000000000}
+ * 命令：
+ *   auth token                    TCP 连接的第一个请求：共享口令，通过前只接受 ping / auth，口令错误时断开
+ *   ping / status                 存活检查 / 人脸数与运行状态
+ *   identify [jpeg | camera]      带 jpeg 时识别图片中面积最大的人脸，否则返回 camera 路 (默认 0) 最近一次的识别结果
+ *   enroll [jpeg | camera]        带 jpeg 时录入该图片，否则录入 camera 路摄像头前的下一张人脸 (录入完成后才应答)
+ *                                 jpeg 与 face_id 同时给出时把图片追加为该身份的模板
+ *                                 (须与该身份的中心向量相似，否则拒绝)
+ *   subscribe [tracks] / unsubscribe
+ *                                 订阅 recognized / enrolled / face_lost 事件，tracks 为 true 时每帧推送跟踪框
+ *
+ * Unix 套接字的访问由文件权限控制；TCP 默认只监听回环地址，且每个连接须先用口令认证。
+ * 远程图片由 worker 线程完成解码 / 检测 / 对齐 / 特征提取 / 比对，检测与特征提取从上下文池借用
+ * NPU 上下文，与摄像头流水线并行。套接字只在事件循环线程读写；写缓冲积压的订阅者
+ * (网络卡住的门禁端) 暂停推送事件，不会拖慢其他客户端。
+ */
+class FaceService : public QObject
+{
+    Q_OBJECT
+
+public:
+    // pipelines 为每路摄像头的流水线 (下标即事件中的 camera)，可以为空：只处理远程图片
+    FaceService(RetinaFace* detector, MobileFaceNet* embedder, FaceDatabase* database,
+                const std::vector<RecognitionPipeline*>& pipelines, QObject* parent = nullptr);
+    ~FaceService();
+
+    // 监听 Unix 套接字 (残留的旧套接字文件会先删除)，成功返回0
+    int listenLocal(const QString& path);
+    // 监听 TCP 端口，供门禁端直接连接，成功返回0；token 为空时拒绝监听
+    // address 默认只监听回环地址，需要其他网卡访问时由调用方显式指定 (例如 QHostAddress::Any)
+    int listenTcp(int port, const QString& token, const QHostAddress& address = QHostAddress::LocalHost);
+
+    // 启动处理远程图片的 worker 线程
+    void startWorkers(int count);
+    // 停止 worker 线程并断开所有客户端
+    void stop();
+
+private:
+    // 流水线信号 (camera 为流水线下标)
+    void onRecognitionFinished(int camera, int faceId, const QString& message);
+    void onEnrollFinished(int camera, int faceId, const QString& message);
+    void onFaceLost(int camera);
+    void onFacesTracked(int camera, const std::vector<FaceInfo>& faces, const std::vector<int>& faceIds,
+                        int frameWidth, int frameHeight);
+
+    // 单行请求上限 (base64 后的 1080p JPEG 约 1MB)
+    static const int MAX_LINE_BYTES = 16 * 1024 * 1024;
+    // 写缓冲超过此值的订阅者暂停推送事件
+    static const int MAX_PENDING_WRITE = 1024 * 1024;
+    // 等待 worker 处理的远程图片上限，超出直接返回 busy
+    static const size_t MAX_QUEUED_JOBS = 32;
+    // 摄像头录入请求的超时
+    static const int ENROLL_TIMEOUT_MS = 10000;
+
+    struct Client {
+        QIODevice* device = nullptr;
+        QByteArray buffer;          // 尚未凑成一行的数据
+        bool subscribed = false;
+        bool tracks = false;
+        bool authorized = false;    // Unix 套接字连接直接为 true，TCP 连接通过 auth 后为 true
+    };
+
+    // 一张远程图片的识别 / 录入任务 (客户端用编号引用，断开后应答直接丢弃)
+    struct Job {
+        int client = -1;
+        QJsonValue id;
+        bool enroll = false;
+        int face_id = -1;           // 录入时指定身份：追加模板
+        QByteArray jpeg;
+    };
+
+    // 等待摄像头录入结果的请求
+    struct PendingEnroll {
+        int client;
+        QJsonValue id;
+        int camera;
+        int serial;
+    };
+
+    // 每路摄像头最近一次识别结果 (identify 不带图片时返回)
+    struct LastResult {
+        int face_id = -1;
+        QString message;
+        qint64 time_ms = 0;
+    };
+
+    RetinaFace* m_detector;
+    MobileFaceNet* m_embedder;
+    FaceDatabase* m_database;
+    std::vector<RecognitionPipeline*> m_pipelines;
+    std::vector<LastResult> m_lastResults;
+
+    QLocalServer* m_localServer;
+    QTcpServer* m_tcpServer;
+    std::map<int, Client> m_clients;
+    int m_nextClient;
+    QString m_tcpToken;
+
+    std::vector<PendingEnroll> m_pendingEnrolls;
+    int m_enrollSerial;
+
+    std::deque<Job> m_jobs;
+    std::mutex m_jobMutex;
+    std::condition_variable m_jobCond;
+    bool m_stopping;
+    std::vector<std::thread> m_workers;
+
+    // 登记新连接，返回客户端编号 (调用方负责连接 disconnected 信号)
+    int addClient(QIODevice* device, bool authorized);
+    void removeClient(int client);
+    void readClient(int client);
+    void handleRequest(int client, const QByteArray& line);
+
+    // 发送一行 JSON (只能在事件循环线程调用)
+    void send(int client, const QJsonObject& obj);
+    // 推送事件给订阅者；tracksOnly 为 true 时只发给订阅了跟踪框的客户端
+    void broadcast(const QJsonObject& event, bool tracksOnly = false);
+    void reply(int client, const QJsonValue& id, bool ok, int faceId, const QString& message);
+    // serial < 0 时应答 camera 路的所有等待者，否则只应答该请求 (超时)
+    void finishPendingEnrolls(int camera, int faceId, const QString& message, int serial = -1);
+
+    void workerLoop();
+    // 远程图片：解码 -> 检测 -> 对齐面积最大的人脸 -> 特征 -> 识别或录入
+    QJsonObject processImage(const Job& job);
+};
+
+#endif // FACESERVICE_H
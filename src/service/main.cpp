@@ -0,0 +1,198 @@
+/**
+ * @file main.cpp
+ * @brief face_service：无界面识别服务 (不加载 QtWidgets，适合没有屏幕的板子)
+ *
+ * 摄像头 -> RetinaFace -> MobileFaceNet -> FaceDatabase 的流水线与主程序相同，
+ * 识别结果通过 FaceService 推送给订阅的客户端；门禁端也可以把抓拍的 JPEG 发过来识别 / 录入。
+ *
+ * 多个 --camera 时每路一条流水线，共用同一组模型与数据库，NPU 按 --schedule 在各路之间分配。
+ *
+ * 用法：
+ *   face_service [--socket /tmp/face_service.sock] [--tcp 端口 [--tcp-bind 地址] [--token 口令]]
+ *                [--camera 9 [--camera 11 ...] | --no-camera]
+ *                [--backend opencv|v4l2|mpp] [--db face_database.db] [--workers N]
+ *                [--schedule rr|deadline] [--budget 毫秒] [--drop-late]
+ *
+ * TCP 默认只监听 127.0.0.1；门禁端在其他机器上时用 --tcp-bind 0.0.0.0 (或指定网卡地址) 显式开放。
+ * TCP 连接须先发送 {"cmd":"auth","token":...}，口令取自 --token 或环境变量 FACE_SERVICE_TOKEN，未设置时不监听 TCP。
+ */
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "service/FaceService.h"
+#include "pipeline/StartupLoader.h"
+#include "common/Tracer.h"
+
+struct Options {
+    QString socket_path = "/tmp/face_service.sock";
+    int tcp_port = 0;           // 0 = 不监听 TCP
+    QString tcp_bind = "127.0.0.1";
+    QString token;              // TCP 认证口令，为空时取 FACE_SERVICE_TOKEN
+    std::vector<int> cameras;   // 为空时使用 /dev/video9
+    bool no_camera = false;     // 不打开摄像头，只处理远程图片
+    CameraManager::Backend backend = CameraManager::BACKEND_OPENCV;
+    std::string db_path = "face_database.db";
+    int workers = 2;
+    NpuSchedulePolicy schedule = NPU_SCHEDULE_ROUND_ROBIN;
+    int budget_ms = 0;          // 帧预算，0 = 不限
+    bool drop_late = false;
+};
+
+static volatile std::sig_atomic_t g_quit = 0;
+
+static void onSignal(int)
+{
+    g_quit = 1;
+}
+
+static void printUsage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " [--socket path] [--tcp port [--tcp-bind addr] [--token token]]"
+              << " [--camera id ... | --no-camera]"
+              << " [--backend opencv|v4l2|mpp] [--db path] [--workers N]"
+              << " [--schedule rr|deadline] [--budget ms] [--drop-late]" << std::endl;
+}
+
+static int parseOptions(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--socket" && has_value) opt.socket_path = argv[++i];
+        else if (arg == "--tcp" && has_value) opt.tcp_port = std::atoi(argv[++i]);
+        else if (arg == "--tcp-bind" && has_value) opt.tcp_bind = argv[++i];
+        else if (arg == "--token" && has_value) opt.token = argv[++i];
+        else if (arg == "--camera" && has_value) opt.cameras.push_back(std::atoi(argv[++i]));
+        else if (arg == "--no-camera") opt.no_camera = true;
+        else if (arg == "--db" && has_value) opt.db_path = argv[++i];
+        else if (arg == "--workers" && has_value) opt.workers = std::atoi(argv[++i]);
+        else if (arg == "--budget" && has_value) opt.budget_ms = std::atoi(argv[++i]);
+        else if (arg == "--drop-late") opt.drop_late = true;
+        else if (arg == "--schedule" && has_value) {
+            std::string name = argv[++i];
+            if (name == "rr") opt.schedule = NPU_SCHEDULE_ROUND_ROBIN;
+            else if (name == "deadline") opt.schedule = NPU_SCHEDULE_DEADLINE;
+            else return -1;
+        }
+        else if (arg == "--backend" && has_value) {
+            std::string name = argv[++i];
+            if (name == "opencv") opt.backend = CameraManager::BACKEND_OPENCV;
+            else if (name == "v4l2") opt.backend = CameraManager::BACKEND_V4L2;
+            else if (name == "mpp") opt.backend = CameraManager::BACKEND_MPP;
+            else return -1;
+        }
+        else return -1;
+    }
+    if (opt.token.isEmpty()) opt.token = QString::fromLocal8Bit(qgetenv("FACE_SERVICE_TOKEN"));
+    if (opt.no_camera) opt.cameras.clear();
+    else if (opt.cameras.empty()) opt.cameras.push_back(9);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    Options opt;
+    if (parseOptions(argc, argv, opt) != 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // 1. 模型与数据库 (与主程序相同：部署了更高分辨率的检测模型时按负载自动切换)
+    // 多路摄像头共用模型：加载前告诉调度器流数，每类任务按流数复制上下文
+    NpuScheduler::setStreamCount((int)opt.cameras.size());
+    NpuScheduler::setSchedulePolicy(opt.schedule);
+    std::vector<std::string> modelPaths = { "assets/model/retinaface_320.rknn" };
+    for (const char* extra : { "assets/model/retinaface_480.rknn", "assets/model/retinaface_640.rknn" }) {
+        if (QFile::exists(extra)) modelPaths.push_back(extra);
+    }
+    RetinaFace detector(modelPaths);
+    detector.setResolutionPolicy(RetinaFace::RESOLUTION_LOAD);
+    MobileFaceNet embedder;
+    FaceDatabase database;
+
+    // 三者互不依赖，并行初始化
+    StartupLoader loader;
+    loader.addTask("RetinaFace", [&]() { return detector.init(); });
+    loader.addTask("MobileFaceNet", [&]() { return embedder.init("assets/model/w600k_mbf.rknn"); });
+    loader.addTask("FaceDatabase", [&]() { return database.init(opt.db_path); });
+    loader.start();
+    if (loader.wait() != 0) {
+        std::cerr << "Failed to init: " << loader.failedTasks().toStdString() << std::endl;
+        return 1;
+    }
+
+    // 2. 摄像头与流水线 (没有界面，关闭预览图生成)；打不开的摄像头跳过
+    std::vector<std::unique_ptr<CameraManager>> cameras;
+    std::vector<std::unique_ptr<RecognitionPipeline>> pipelines;
+    for (int id : opt.cameras) {
+        std::unique_ptr<CameraManager> camera(new CameraManager());
+        camera->setPreviewEnabled(false);
+        if (!camera->openCamera(id, opt.backend)) {
+            std::cerr << "Failed to open camera " << id << ", skipped" << std::endl;
+            continue;
+        }
+        camera->start();
+
+        std::unique_ptr<RecognitionPipeline> pipeline(
+            new RecognitionPipeline(camera.get(), &detector, &embedder, &database));
+        pipeline->setStreamId((int)pipelines.size());
+        pipeline->setFrameBudget(opt.budget_ms);
+        if (opt.drop_late) pipeline->setDropPolicy(RecognitionPipeline::DROP_LATE);
+        cameras.push_back(std::move(camera));
+        pipelines.push_back(std::move(pipeline));
+    }
+    if (!opt.cameras.empty() && pipelines.empty()) {
+        std::cerr << "No camera opened, serving remote frames only" << std::endl;
+    }
+
+    // 3. 服务
+    std::vector<RecognitionPipeline*> pipelinePtrs;
+    for (auto& pipeline : pipelines) pipelinePtrs.push_back(pipeline.get());
+    FaceService service(&detector, &embedder, &database, pipelinePtrs);
+    if (service.listenLocal(opt.socket_path) != 0) return 1;
+    if (opt.tcp_port > 0) {
+        QHostAddress bind;
+        if (!bind.setAddress(opt.tcp_bind)) {
+            std::cerr << "Invalid --tcp-bind address: " << opt.tcp_bind.toStdString() << std::endl;
+            return 1;
+        }
+        if (service.listenTcp(opt.tcp_port, opt.token, bind) != 0) return 1;
+    }
+    service.startWorkers(opt.workers);
+    for (auto& pipeline : pipelines) pipeline->start();
+    qDebug() << "face_service 已启动, 当前人脸数量:" << database.getFaceCount();
+
+    // SIGINT / SIGTERM 只置标志，由事件循环里的定时器退出 (信号处理函数里不能调用 Qt)
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+    QTimer quitTimer;
+    QObject::connect(&quitTimer, &QTimer::timeout, [] {
+        if (g_quit) QCoreApplication::quit();
+    });
+    quitTimer.start(200);
+
+    int ret = app.exec();
+
+    // 先停流水线与 worker (都在使用摄像头、模型和数据库)，再关摄像头
+    for (auto& pipeline : pipelines) pipeline->stop();
+    service.stop();
+    for (auto& camera : cameras) {
+        camera->closeCamera();
+        camera->wait();
+    }
+
+    QByteArray tracePath = qgetenv("FACEAPP_TRACE");
+    if (!tracePath.isEmpty()) Tracer::instance().exportChromeTrace(tracePath.toStdString());
+    return ret;
+}
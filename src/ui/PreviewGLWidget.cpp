@@ -0,0 +1,226 @@
+#include "PreviewGLWidget.h"
+#include <QDebug>
+#include <algorithm>
+
+// 图像与叠加层共用的顶点变换：a_pos 为 [0,1] 图像坐标，u_rect 为图像在 NDC 中的左、上、右、下
+static const char *IMAGE_VS =
+    "attribute vec2 a_pos;\n"
+    "uniform vec4 u_rect;\n"
+    "uniform vec2 u_uvScale;\n"
+    "varying vec2 v_uv;\n"
+    "void main() {\n"
+    "    v_uv = a_pos * u_uvScale;\n"
+    "    gl_Position = vec4(mix(u_rect.xy, u_rect.zw, a_pos), 0.0, 1.0);\n"
+    "}\n";
+
+static const char *IMAGE_FS =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "uniform sampler2D u_tex;\n"
+    "varying vec2 v_uv;\n"
+    "void main() {\n"
+    "    gl_FragColor = vec4(texture2D(u_tex, v_uv).rgb, 1.0);\n"
+    "}\n";
+
+static const char *LINE_VS =
+    "attribute vec2 a_pos;\n"
+    "attribute vec3 a_color;\n"
+    "uniform vec4 u_rect;\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "    v_color = a_color;\n"
+    "    gl_Position = vec4(mix(u_rect.xy, u_rect.zw, a_pos), 0.0, 1.0);\n"
+    "}\n";
+
+static const char *LINE_FS =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "varying vec3 v_color;\n"
+    "void main() {\n"
+    "    gl_FragColor = vec4(v_color, 1.0);\n"
+    "}\n";
+
+// 关键点十字的半长 (图像宽度的比例)
+static const float LANDMARK_SIZE = 0.008f;
+
+PreviewGLWidget::PreviewGLWidget(QWidget *parent)
+    : QOpenGLWidget(parent),
+      m_imageWidth(0), m_imageHeight(0),
+      m_texture(0), m_texWidth(0), m_texHeight(0),
+      m_glReady(false)
+{
+}
+
+PreviewGLWidget::~PreviewGLWidget()
+{
+    // GL 资源必须在上下文当前时释放
+    makeCurrent();
+    if (m_texture) glDeleteTextures(1, &m_texture);
+    doneCurrent();
+}
+
+void PreviewGLWidget::setFrame(const QImage &image)
+{
+    m_frame = image;
+    update();
+}
+
+void PreviewGLWidget::setFaces(const std::vector<FaceInfo> &faces, const std::vector<int> &faceIds,
+                               int frameWidth, int frameHeight)
+{
+    m_overlay.clear();
+    if (frameWidth <= 0 || frameHeight <= 0) {
+        update();
+        return;
+    }
+
+    const float sx = 1.0f / frameWidth, sy = 1.0f / frameHeight;
+    auto vertex = [this](float x, float y, const float color[3]) {
+        m_overlay.insert(m_overlay.end(), { x, y, color[0], color[1], color[2] });
+    };
+    auto line = [&vertex](float x0, float y0, float x1, float y1, const float color[3]) {
+        vertex(x0, y0, color);
+        vertex(x1, y1, color);
+    };
+
+    static const float GREEN[3] = { 0.0f, 0.85f, 0.0f };
+    static const float ORANGE[3] = { 1.0f, 0.6f, 0.0f };
+    for (size_t i = 0; i < faces.size(); i++) {
+        const FaceInfo &f = faces[i];
+        const float *color = i < faceIds.size() && faceIds[i] > 0 ? GREEN : ORANGE;
+
+        // 预览是水平镜像的：x -> 1 - x
+        float x0 = 1.0f - (f.box.x + f.box.width) * sx, x1 = 1.0f - f.box.x * sx;
+        float y0 = f.box.y * sy, y1 = (f.box.y + f.box.height) * sy;
+        line(x0, y0, x1, y0, color);
+        line(x1, y0, x1, y1, color);
+        line(x1, y1, x0, y1, color);
+        line(x0, y1, x0, y0, color);
+
+        float dx = LANDMARK_SIZE, dy = LANDMARK_SIZE * frameWidth / frameHeight;
+        for (int p = 0; p < 5; p++) {
+            float lx = 1.0f - f.landmarks[p].x * sx, ly = f.landmarks[p].y * sy;
+            line(lx - dx, ly, lx + dx, ly, color);
+            line(lx, ly - dy, lx, ly + dy, color);
+        }
+    }
+    update();
+}
+
+void PreviewGLWidget::initializeGL()
+{
+    initializeOpenGLFunctions();
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+
+    m_imageProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, IMAGE_VS);
+    m_imageProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, IMAGE_FS);
+    m_lineProgram.addShaderFromSourceCode(QOpenGLShader::Vertex, LINE_VS);
+    m_lineProgram.addShaderFromSourceCode(QOpenGLShader::Fragment, LINE_FS);
+    if (!m_imageProgram.link() || !m_lineProgram.link()) {
+        qWarning() << "预览着色器链接失败:" << m_imageProgram.log() << m_lineProgram.log();
+        return;
+    }
+
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    // 非 2 的幂纹理 (GLES2)：只能用 CLAMP_TO_EDGE 且不生成 mipmap
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    m_glReady = true;
+}
+
+void PreviewGLWidget::resizeGL(int w, int h)
+{
+    glViewport(0, 0, w, h);
+}
+
+void PreviewGLWidget::uploadFrame()
+{
+    if (m_frame.isNull()) return;
+
+    // GLES2 没有 GL_UNPACK_ROW_LENGTH：按行跨度整行上传，采样时只取有效宽度
+    int stride = m_frame.bytesPerLine() / 3;
+    int height = m_frame.height();
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (stride != m_texWidth || height != m_texHeight) {
+        // 只在预览尺寸变化时重新分配纹理
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, stride, height, 0, GL_RGB, GL_UNSIGNED_BYTE, m_frame.constBits());
+        m_texWidth = stride;
+        m_texHeight = height;
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stride, height, GL_RGB, GL_UNSIGNED_BYTE, m_frame.constBits());
+    }
+    m_imageWidth = m_frame.width();
+    m_imageHeight = height;
+
+    // 纹理已持有像素，缓冲区还给 PreviewPool
+    m_frame = QImage();
+}
+
+void PreviewGLWidget::imageRect(float rect[4]) const
+{
+    // 预览图已按控件尺寸等比缩放，这里只需居中 (NDC 的 y 轴向上)
+    float w = std::min(1.0f, (float)m_imageWidth / std::max(1, width()));
+    float h = std::min(1.0f, (float)m_imageHeight / std::max(1, height()));
+    rect[0] = -w; rect[1] = h; rect[2] = w; rect[3] = -h;
+}
+
+void PreviewGLWidget::drawImage(const float rect[4])
+{
+    static const GLfloat QUAD[] = { 0, 0,  1, 0,  0, 1,  1, 1 };
+
+    m_imageProgram.bind();
+    int pos = m_imageProgram.attributeLocation("a_pos");
+    m_imageProgram.setUniformValue(m_imageProgram.uniformLocation("u_rect"), rect[0], rect[1], rect[2], rect[3]);
+    m_imageProgram.setUniformValue(m_imageProgram.uniformLocation("u_uvScale"),
+                                   (GLfloat)m_imageWidth / m_texWidth, 1.0f);
+    m_imageProgram.setUniformValue(m_imageProgram.uniformLocation("u_tex"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+
+    glEnableVertexAttribArray(pos);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, 0, QUAD);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDisableVertexAttribArray(pos);
+    m_imageProgram.release();
+}
+
+void PreviewGLWidget::drawOverlay(const float rect[4])
+{
+    if (m_overlay.empty()) return;
+
+    m_lineProgram.bind();
+    int pos = m_lineProgram.attributeLocation("a_pos");
+    int color = m_lineProgram.attributeLocation("a_color");
+    m_lineProgram.setUniformValue(m_lineProgram.uniformLocation("u_rect"), rect[0], rect[1], rect[2], rect[3]);
+
+    const GLsizei stride = 5 * sizeof(float);
+    glEnableVertexAttribArray(pos);
+    glEnableVertexAttribArray(color);
+    glVertexAttribPointer(pos, 2, GL_FLOAT, GL_FALSE, stride, m_overlay.data());
+    glVertexAttribPointer(color, 3, GL_FLOAT, GL_FALSE, stride, m_overlay.data() + 2);
+    glLineWidth(2.0f);
+    glDrawArrays(GL_LINES, 0, (GLsizei)(m_overlay.size() / 5));
+    glDisableVertexAttribArray(color);
+    glDisableVertexAttribArray(pos);
+    m_lineProgram.release();
+}
+
+void PreviewGLWidget::paintGL()
+{
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (!m_glReady) return;
+
+    uploadFrame();
+    if (m_texWidth == 0) return;
+
+    float rect[4];
+    imageRect(rect);
+    drawImage(rect);
+    drawOverlay(rect);
+}
@@ -0,0 +1,63 @@
+#ifndef PREVIEWGLWIDGET_H
+#define PREVIEWGLWIDGET_H
+
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QImage>
+#include <vector>
+#include "algo/FaceInfo.h"
+
+/**
+ * @brief OpenGL (ES2) 摄像头预览 + 人脸叠加层
+ *
+ * 代替每帧给 QLabel 设置 QPixmap：
+ *   - 预览图 (CameraManager 已由 RGA 缩放到控件尺寸、镜像并转成 RGB) 用 glTexSubImage2D
+ *     上传到常驻纹理，由 GPU 绘制，不经过 Qt raster 引擎的软件 blit
+ *   - 人脸框与 5 个关键点作为 GL_LINES 叠加绘制 (已识别绿色 / 未识别橙色)，CPU 只生成几十个顶点
+ * 上传后立即释放 QImage，PreviewPool 的缓冲区不会被控件长期占用。
+ * 原图坐标到预览坐标的换算 (等比缩放 + 水平镜像) 在这里完成，调用方直接传检测结果。
+ */
+class PreviewGLWidget : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+
+public:
+    explicit PreviewGLWidget(QWidget *parent = nullptr);
+    ~PreviewGLWidget();
+
+    // 显示一帧预览 (RGB888)
+    void setFrame(const QImage &image);
+
+    // 更新叠加层：faces 为原图坐标，faceIds 与 faces 一一对应 (> 0 表示已识别)
+    void setFaces(const std::vector<FaceInfo> &faces, const std::vector<int> &faceIds,
+                  int frameWidth, int frameHeight);
+
+protected:
+    void initializeGL() override;
+    void resizeGL(int w, int h) override;
+    void paintGL() override;
+
+private:
+    QImage m_frame;                 // 待上传的预览图 (上传后释放)
+    int m_imageWidth;               // 当前纹理中图像的尺寸
+    int m_imageHeight;
+    GLuint m_texture;
+    int m_texWidth;                 // 纹理分配的尺寸 (宽为行跨度)
+    int m_texHeight;
+
+    QOpenGLShaderProgram m_imageProgram;
+    QOpenGLShaderProgram m_lineProgram;
+    bool m_glReady;
+
+    // 叠加层顶点：x, y (图像归一化坐标，左上为原点), r, g, b
+    std::vector<float> m_overlay;
+
+    // 图像在控件中的位置 (NDC：左、上、右、下)，保持宽高比居中
+    void imageRect(float rect[4]) const;
+    void uploadFrame();
+    void drawImage(const float rect[4]);
+    void drawOverlay(const float rect[4]);
+};
+
+#endif // PREVIEWGLWIDGET_H
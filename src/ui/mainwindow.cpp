@@ -2,10 +2,43 @@
 #include "ui_mainwindow.h"
 #include <QDebug>
 #include <QDir>
+#include <QFile>
+#include <QGuiApplication>
+#include <QScreen>
+#include <algorithm>
+#include <sstream>
+
+// 按键的单次识别 / 录入各占一个 slot：新的按键取代尚未完成的上一次同类请求
+static const int MANUAL_ENROLL_SLOT = 1;
+
+// 多路摄像头时每帧的处理预算：检测等 NPU 超过该时间的帧直接丢弃 (DROP_LATE)
+static const int MULTI_CAMERA_FRAME_BUDGET_MS = 100;
+
+// 解析 FACEAPP_CAMERAS="9,11"，未设置时只用 /dev/video9
+static std::vector<int> cameraIdsFromEnv()
+{
+    std::vector<int> ids;
+    std::stringstream list(qgetenv("FACEAPP_CAMERAS").toStdString());
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        if (!item.empty()) ids.push_back(std::atoi(item.c_str()));
+    }
+    if (ids.empty()) ids.push_back(9);
+    return ids;
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , m_pipeline(nullptr)
+    , m_loader(nullptr)
+    , m_faceEngine(nullptr)
+    , m_preview(nullptr)
+    , m_metricsLabel(nullptr)
+    , m_metricsTimer(nullptr)
+    , m_lastStatsUs(0)
+    , m_startUs(Tracer::nowUs())
+    , m_firstFrameShown(false)
 {
     ui->setupUi(this);
     // ---------------------------------------------------------
@@ -15,6 +48,13 @@ MainWindow::MainWindow(QWidget *parent)
     this->showFullScreen();
 
     // 2. 初始化摄像头管理器
+    // FACEAPP_CAMERAS 指定多个摄像头时 (例如门禁的进门 / 出门两路)，第一个显示预览，
+    // 其余只做识别；各路共用一组模型，模型加载前告诉调度器流数，按截止时间分配 NPU
+    std::vector<int> cameraIds = cameraIdsFromEnv();
+    if (cameraIds.size() > 1) {
+        NpuScheduler::setStreamCount((int)cameraIds.size());
+        NpuScheduler::setSchedulePolicy(NPU_SCHEDULE_DEADLINE);
+    }
     m_camera = new CameraManager(this);
 
     // 3. 连接信号与槽
@@ -22,72 +62,124 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_camera, &CameraManager::newFrameCaptured,
             this, &MainWindow::updateCameraImage);
 
+    // 预览图由采集线程按 cameraLabel 尺寸生成 (之后每帧在 updateCameraImage 中同步)
+    m_camera->setPreviewSize(ui->cameraLabel->width(), ui->cameraLabel->height());
+    // 预览不超过屏幕刷新率，多余的帧只给算法；算法每帧都处理
+    if (QScreen *screen = QGuiApplication::primaryScreen()) {
+        m_camera->setPreviewFps(qRound(screen->refreshRate()));
+    }
+
     // 4. 打开摄像头并启动线程
-    // openCamera(9)  打开USB摄像头/dev/video9
-    if (m_camera->openCamera(9)) {
+    // 默认 openCamera(9)  打开USB摄像头/dev/video9
+    if (m_camera->openCamera(cameraIds[0])) {
         m_camera->start(); // 必须调用 start()，因为它是 QThread，这样 run() 才会运行
         qDebug() << "摄像头线程已启动";
+
+        // 用 OpenGL 预览替换 cameraLabel (纹理上传 + GPU 绘制人脸框)
+        // linuxfb 平台没有 OpenGL，或设置 FACEAPP_PREVIEW=label 时继续使用 QLabel
+        if (QGuiApplication::platformName() != "linuxfb" && qgetenv("FACEAPP_PREVIEW") != "label") {
+            m_preview = new PreviewGLWidget(this);
+            m_preview->setSizePolicy(ui->cameraLabel->sizePolicy());
+            ui->horizontalLayout->replaceWidget(ui->cameraLabel, m_preview);
+            ui->cameraLabel->hide();
+            m_camera->setPreviewSize(m_preview->width(), m_preview->height());
+        }
     } else {
         qDebug() << "摄像头打开失败！";
         ui->cameraLabel->setStyleSheet("color: red;");
         ui->cameraLabel->setText("摄像头打开失败，请检查设备");
     }
 
-    // ---------------------------------------------------------
-    // 初始化 RetinaFace 模型
-    // ---------------------------------------------------------
-    std::string modelPath = "assets/model/retinaface_320.rknn";
-
-    m_retinaface = new RetinaFace(modelPath);
-    int ret = m_retinaface->init();
-    if (ret != 0) {
-        qDebug() << "RetinaFace模型加载失败! 错误码:" << ret;
-        qDebug() << "尝试加载路径:" << QString::fromStdString(modelPath);
-        ui->promptLabel->setStyleSheet("color: red;"); // 设置为红色
-        ui->promptLabel->setText("RetinaFace模型加载失败");
-    } else {
-        qDebug() << "RetinaFace模型加载成功!";
+    // 其余摄像头：关闭预览，帧只给算法
+    for (size_t i = 1; i < cameraIds.size(); i++) {
+        CameraManager *camera = new CameraManager(this);
+        camera->setPreviewEnabled(false);
+        if (!camera->openCamera(cameraIds[i])) {
+            qDebug() << "摄像头" << cameraIds[i] << "打开失败";
+            delete camera;
+            continue;
+        }
+        camera->start();
+        m_extraCameras.push_back(camera);
     }
 
     // ---------------------------------------------------------
-    // 初始化 MobileFaceNet 模型
+    // 后台并行加载模型与数据库：预览已经在显示，就绪后再创建流水线、启用按钮
     // ---------------------------------------------------------
-    std::string mfnPath = "assets/model/w600k_mbf.rknn";
-    m_mobilefacenet = new MobileFaceNet(); // 创建实例
-    int mfnRet = m_mobilefacenet->init(mfnPath); // 调用 init
-
-    if (mfnRet != 0) {
-        qDebug() << "MobileFaceNet模型加载失败! 错误码:" << mfnRet;
-        ui->promptLabel->setStyleSheet("color: red;");
-        ui->promptLabel->setText("MobileFaceNet模型加载失败");
-    } else {
-        qDebug() << "MobileFaceNet模型加载成功!";
+    // 320 为默认模型；部署了更高分辨率的模型时一起加载，按检测耗时自动切换
+    // 构造时只映射模型文件 (mmap + 预读)，rknn_init 在加载线程中执行
+    std::vector<std::string> modelPaths = { "assets/model/retinaface_320.rknn" };
+    for (const char* extra : { "assets/model/retinaface_480.rknn", "assets/model/retinaface_640.rknn" }) {
+        if (QFile::exists(extra)) modelPaths.push_back(extra);
     }
+    m_retinaface = new RetinaFace(modelPaths);
+    m_retinaface->setResolutionPolicy(RetinaFace::RESOLUTION_LOAD);
+    m_mobilefacenet = new MobileFaceNet();
+    m_facedb = new FaceDatabase();
+
+    m_loader = new StartupLoader(this);
+    m_loader->addTask("RetinaFace模型", [this]() { return m_retinaface->init(); });
+    m_loader->addTask("MobileFaceNet模型", [this]() { return m_mobilefacenet->init("assets/model/w600k_mbf.rknn"); });
+    m_loader->addTask("人脸数据库", [this]() { return m_facedb->init("face_database.db"); });
+    connect(m_loader, &StartupLoader::taskFinished, this, [](const QString &name, int ret, int elapsedMs) {
+        if (ret != 0) qDebug() << name << "加载失败! 错误码:" << ret;
+        else qDebug() << name << "加载成功, 耗时" << elapsedMs << "ms";
+    });
+    connect(m_loader, &StartupLoader::ready, this, &MainWindow::onStartupReady);
+    connect(m_loader, &StartupLoader::failed, this, &MainWindow::onStartupFailed);
+
+    ui->btnRecognize->setEnabled(false);
+    ui->btnEntry->setEnabled(false);
+    ui->promptLabel->setStyleSheet("");
+    ui->promptLabel->setText("正在加载模型...");
+    m_loader->start();
 
     // ---------------------------------------------------------
-    // 初始化人脸数据库
+    // 各阶段耗时叠加层：FACEAPP_METRICS=1 时显示在预览左上角
     // ---------------------------------------------------------
-    std::string dbPath = "face_database.db"; // 数据库文件路径
-    m_facedb = new FaceDatabase();           // 创建数据库实例
-
-    int dbRet = m_facedb->init(dbPath);      // 初始化数据库
-    if (dbRet != 0) {
-        qDebug() << "人脸数据库初始化失败! 错误码:" << dbRet;
-        ui->promptLabel->setStyleSheet("color: red;");
-        ui->promptLabel->setText("人脸数据库初始化失败");
-    } else {
-        qDebug() << "人脸数据库初始化成功! 当前人脸数量:" << m_facedb->getFaceCount();
+    if (!qgetenv("FACEAPP_METRICS").isEmpty() && qgetenv("FACEAPP_METRICS") != "0") {
+        m_metricsLabel = new QLabel(previewWidget());
+        m_metricsLabel->setFont(QFont("monospace", 9));
+        m_metricsLabel->setStyleSheet("color: white; background-color: rgba(0, 0, 0, 160); padding: 4px;");
+        m_metricsLabel->move(8, 8);
+        m_metricsLabel->raise();
+        m_metricsLabel->show();
+
+        m_lastStats.resize(Tracer::STAGE_COUNT);
+        Tracer::instance().snapshot(m_lastStats.data());
+        m_lastStatsUs = Tracer::nowUs();
+        m_metricsTimer = new QTimer(this);
+        connect(m_metricsTimer, &QTimer::timeout, this, &MainWindow::updateMetrics);
+        m_metricsTimer->start(1000);
     }
+
 }
 
 MainWindow::~MainWindow()
 {
+    // 先等加载线程结束 (还在初始化模型和数据库)，再停止流水线 (工作线程还在使用摄像头、模型和数据库)
+    delete m_loader;
+    m_loader = nullptr;
+    stopPipelines();
+    delete m_faceEngine;    // 等待正在进行的特征提取与写库结束
+    m_faceEngine = nullptr;
+
+    // FACEAPP_TRACE=<文件> 时导出最近的事件，用 chrome://tracing 或 ui.perfetto.dev 打开
+    QByteArray tracePath = qgetenv("FACEAPP_TRACE");
+    if (!tracePath.isEmpty() && Tracer::instance().exportChromeTrace(tracePath.toStdString()) == 0) {
+        qDebug() << "Chrome trace 已导出到" << tracePath;
+    }
+
     // 程序退出前，安全关闭摄像头线程
     if (m_camera->isRunning()) {
         m_camera->closeCamera(); // 调用关闭标志位函数
         m_camera->quit();        // 告诉线程退出事件循环
         m_camera->wait();        // 等待线程真正结束，防止崩溃
     }
+    for (CameraManager *camera : m_extraCameras) {
+        camera->closeCamera();
+        camera->wait();
+    }
 
     // 释放模型内存
     if (m_retinaface) {
@@ -112,132 +204,241 @@ MainWindow::~MainWindow()
 // 接收并显示图像
 void MainWindow::updateCameraImage(const QImage &image)
 {
-    if (!image.isNull()) {
+    // 把当前预览控件尺寸告诉采集线程：RGA 直接按该尺寸等比缩放 (Qt::KeepAspectRatio)，
+    // 这里不再做 CPU 平滑缩放；窗口缩放后下一帧起生效
+    QWidget *view = previewWidget();
+    m_camera->setPreviewSize(view->width(), view->height());
+
+    if (image.isNull()) return;
+    if (!m_firstFrameShown) {
+        // 冷启动到第一帧预览的时间 (模型仍可能在后台加载)
+        m_firstFrameShown = true;
+        qDebug() << "首帧预览, 启动耗时" << (Tracer::nowUs() - m_startUs) / 1000 << "ms";
+    }
+    if (m_preview) {
+        m_preview->setFrame(image);
+    } else {
         // 将 QImage 转换为 QPixmap 才能在 Label 上显示
-        QPixmap pix = QPixmap::fromImage(image);
+        ui->cameraLabel->setPixmap(QPixmap::fromImage(image));
+    }
+}
 
-        // 为了适应屏幕大小，我们让图片自动缩放填充 cameraLabel
-        // Qt::KeepAspectRatio: 保持比例（不会把人脸拉扁）
-        // Qt::KeepAspectRatioByExpanding: 充满整个框（可能会裁掉一点边缘）
-        // Qt::SmoothTransformation: 缩放时平滑处理（画质更好，但稍微费一点CPU）
-        int w = ui->cameraLabel->width();
-        int h = ui->cameraLabel->height();
+// 每秒刷新：各阶段最近一秒的次数 / 均值 / P50 / P99，以及 NPU 利用率
+void MainWindow::updateMetrics()
+{
+    std::vector<Tracer::StageStats> now(Tracer::STAGE_COUNT);
+    Tracer::instance().snapshot(now.data());
+    int64_t nowUs = Tracer::nowUs();
+    double seconds = std::max(1e-3, (nowUs - m_lastStatsUs) / 1e6);
+
+    QString text = QString::asprintf("%-13s %5s %7s %7s %7s", "stage", "/s", "avg", "p50", "p99");
+    uint64_t npuUs = 0;
+    for (int s = 0; s < Tracer::STAGE_COUNT; s++) {
+        Tracer::StageStats d = now[s].since(m_lastStats[s]);
+        if (s == Tracer::STAGE_NPU_DETECT || s == Tracer::STAGE_NPU_EMBED) npuUs += d.total_us;
+        if (d.count == 0) continue;
+        text += QString::asprintf("\n%-13s %5.1f %7.2f %7.2f %7.2f",
+                                  Tracer::stageName((Tracer::Stage)s), d.count / seconds,
+                                  d.meanMs(), d.percentileMs(0.5), d.percentileMs(0.99));
+    }
+    // 多核 NPU 按核心数归一化
+    double npuLoad = npuUs / (seconds * 1e6 * NpuScheduler::coreCount());
+    text += QString::asprintf("\nNPU %.0f%%   (ms)", std::min(1.0, npuLoad) * 100);
+
+    m_metricsLabel->setText(text);
+    m_metricsLabel->adjustSize();
+    m_lastStats.swap(now);
+    m_lastStatsUs = nowUs;
+}
+
+QWidget *MainWindow::previewWidget() const
+{
+    return m_preview ? static_cast<QWidget *>(m_preview) : static_cast<QWidget *>(ui->cameraLabel);
+}
+
+// 显示一条操作结果
+void MainWindow::showPrompt(int faceId, const QString &message)
+{
+    ui->promptLabel->setStyleSheet(faceId > 0 ? "color: green;" : "color: orange;");
+    ui->promptLabel->setText(message);
+}
+
+// 模型与数据库就绪：创建流水线 (检测 / 对齐 / 特征 / 比对 各一个线程)，启用按钮并开始连续识别
+void MainWindow::onStartupReady()
+{
+    qDebug() << "模型与数据库就绪, 启动耗时" << (Tracer::nowUs() - m_startUs) / 1000 << "ms,"
+             << "当前人脸数量:" << m_facedb->getFaceCount();
+
+    m_faceEngine = new AsyncFaceEngine(m_retinaface, m_mobilefacenet, m_facedb, this);
+    connect(m_faceEngine, &AsyncFaceEngine::finished, this, &MainWindow::onFaceTaskFinished);
+
+    m_pipeline = new RecognitionPipeline(m_camera, m_retinaface, m_mobilefacenet, m_facedb, this);
+    connect(m_pipeline, &RecognitionPipeline::recognitionFinished,
+            this, &MainWindow::onRecognitionFinished);
+    connect(m_pipeline, &RecognitionPipeline::enrollFinished,
+            this, &MainWindow::onEnrollFinished);
+    connect(m_pipeline, &RecognitionPipeline::faceLost,
+            this, &MainWindow::onFaceLost);
+    if (m_preview) {
+        connect(m_pipeline, &RecognitionPipeline::facesTracked,
+                m_preview, &PreviewGLWidget::setFaces);
+    }
 
-        ui->cameraLabel->setPixmap(pix.scaled(w, h, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+    // 其余摄像头的流水线：结果带上摄像头编号显示在同一个提示栏
+    for (size_t i = 0; i < m_extraCameras.size(); i++) {
+        RecognitionPipeline *pipeline = new RecognitionPipeline(m_extraCameras[i], m_retinaface,
+                                                                m_mobilefacenet, m_facedb, this);
+        pipeline->setStreamId((int)i + 1);
+        QString name = QString("摄像头%1: ").arg((int)i + 2);
+        connect(pipeline, &RecognitionPipeline::recognitionFinished, this,
+                [this, name](int faceId, const QString &message) { showPrompt(faceId, name + message); });
+        m_extraPipelines.push_back(pipeline);
     }
+    if (!m_extraPipelines.empty()) {
+        m_pipeline->setFrameBudget(MULTI_CAMERA_FRAME_BUDGET_MS);
+        m_pipeline->setDropPolicy(RecognitionPipeline::DROP_LATE);
+        for (RecognitionPipeline *pipeline : m_extraPipelines) {
+            pipeline->setFrameBudget(MULTI_CAMERA_FRAME_BUDGET_MS);
+            pipeline->setDropPolicy(RecognitionPipeline::DROP_LATE);
+        }
+    }
+
+    ui->btnRecognize->setEnabled(true);
+    ui->btnEntry->setEnabled(true);
+    ui->promptLabel->setStyleSheet("");
+    ui->promptLabel->setText("");
+
+    // 所有模块就绪后自动开始连续识别，无需按键
+    startPipelines();
+    ui->btnRecognize->setText("停止\n识别");
 }
 
-// "人脸识别"按钮逻辑
-void MainWindow::on_btnRecognize_clicked()
+// 有模块加载失败：按钮保持禁用，提示出错的模块
+void MainWindow::onStartupFailed(const QString &tasks)
 {
-    qDebug() << "开始执行人脸识别流程...";
+    ui->promptLabel->setStyleSheet("color: red;");
+    ui->promptLabel->setText(tasks + "加载失败");
+}
 
-    // 1. 检查模型和数据库是否就绪
-    if (!m_retinaface || !m_mobilefacenet || !m_facedb) {
-        qDebug() << "错误：模型或数据库未初始化，无法进行识别！";
-        ui->promptLabel->setStyleSheet("color: red;");
-        ui->promptLabel->setText("系统初始化异常，请检查");
-        return;
+void MainWindow::startPipelines()
+{
+    if (m_pipeline) m_pipeline->start();
+    for (RecognitionPipeline *pipeline : m_extraPipelines) pipeline->start();
+}
+
+void MainWindow::stopPipelines()
+{
+    if (m_pipeline) m_pipeline->stop();
+    for (RecognitionPipeline *pipeline : m_extraPipelines) pipeline->stop();
+}
+
+// 流水线识别结果
+void MainWindow::onRecognitionFinished(int faceId, const QString &message)
+{
+    showPrompt(faceId, message);
+}
+
+// 流水线录入结果
+void MainWindow::onEnrollFinished(int faceId, const QString &message)
+{
+    if (faceId > 0) {
+        qDebug() << "人脸录入成功！" << message;
+    } else {
+        qDebug() << "人脸录入失败:" << message;
     }
+    showPrompt(faceId, message);
+}
 
-    // 2. 从摄像头实时画面中获取对齐好的 112x112 人脸图像
-    qDebug() << "正在从摄像头获取人脸图像...";
-    cv::Mat alignedFace = m_retinaface->getAlignedFaceFromCamera(*m_camera);
+// 人脸离开画面
+void MainWindow::onFaceLost()
+{
+    ui->promptLabel->setStyleSheet("");
+    ui->promptLabel->setText("");
+}
 
-    if (alignedFace.empty()) {
+// 单次识别 / 录入结果：被新的按键取代的请求不再显示
+void MainWindow::onFaceTaskFinished(const FaceTaskResult &result)
+{
+    if (result.cancelled) return;
+    if (result.no_face) {
         qDebug() << "未能在当前画面中检测到人脸";
         ui->promptLabel->setStyleSheet("color: red;");
-        ui->promptLabel->setText("未检测到人脸，请正对摄像头");
+        ui->promptLabel->setText("未检测到人脸，请靠近并正对摄像头");
         return;
     }
-    qDebug() << "成功检测到人脸! 尺寸:" << alignedFace.cols << "x" << alignedFace.rows;
-
-    // 3. 调用 MobileFaceNet 提取人脸特征向量
-    qDebug() << "正在提取人脸特征...";
-    std::vector<float> feature;
-    int ret = m_mobilefacenet->extractFeature(alignedFace, feature);
-
-    if (ret != 0 || feature.empty()) {
-        qDebug() << "特征提取失败，RKNN推理返回码:" << ret;
+    if (result.quality != FaceQuality::QUALITY_OK) {
+        QString message = QString("人脸质量不合格，%1").arg(FaceQuality::verdictMessage(result.quality));
+        qDebug() << message;
+        ui->promptLabel->setStyleSheet("color: red;");
+        ui->promptLabel->setText(message);
+        return;
+    }
+    if (result.embed_failed) {
+        qDebug() << "特征提取失败";
         ui->promptLabel->setStyleSheet("color: red;");
         ui->promptLabel->setText("特征提取失败，请重试");
         return;
     }
-    qDebug() << "特征提取成功！维度：" << feature.size();
 
-    // 4. 在数据库中查找匹配的人脸
-    qDebug() << "正在数据库中查找匹配人脸...";
-    std::string message;
-    int faceId = m_facedb->recognizeFace(feature, message);
-
-    // 5. 根据返回结果更新UI提示
-    if (faceId > 0) {
-        // 识别成功
-        qDebug() << "人脸识别成功！" << QString::fromStdString(message);
-        ui->promptLabel->setStyleSheet("color: green;");
-        ui->promptLabel->setText(QString::fromStdString(message));
-    } else {
-        // 识别失败（数据库中没有匹配的人脸）
-        qDebug() << "人脸识别失败:" << QString::fromStdString(message);
-        ui->promptLabel->setStyleSheet("color: orange;");
-        ui->promptLabel->setText(QString::fromStdString(message));
-    }
+    QString message = QString::fromStdString(FaceDatabase::resultMessage(result.db));
+    qDebug() << (result.enroll ? "人脸录入:" : "人脸识别:") << message
+             << "相似度" << result.db.similarity
+             << "排队/检测/特征/数据库" << result.queue_ms << result.detect_ms << result.embed_ms
+             << result.db_ms << "ms";
+    showPrompt(FaceDatabase::resultSucceeded(result.db) ? result.db.face_id : -1, message);
 }
 
-// "人脸录入"按钮逻辑
-void MainWindow::on_btnEntry_clicked()
+// "人脸识别"按钮逻辑
+void MainWindow::on_btnRecognize_clicked()
 {
-    qDebug() << "开始执行人脸录入流程...";
-
-    // 1. 检查模型和数据库是否就绪
-    if (!m_retinaface || !m_mobilefacenet || !m_facedb) {
-        qDebug() << "错误：模型或数据库未初始化，无法进行录入！";
+    // 流水线模式下按钮用来开关连续识别
+    if (m_pipeline && m_pipeline->isRunning()) {
+        stopPipelines();
+        if (m_preview) {
+            // 排在已投递的 facesTracked 之后清除叠加层
+            QMetaObject::invokeMethod(m_preview, [this]() { m_preview->setFaces({}, {}, 0, 0); },
+                                      Qt::QueuedConnection);
+        }
+        ui->btnRecognize->setText("人脸\n识别");
+        ui->promptLabel->setStyleSheet("");
+        ui->promptLabel->setText("连续识别已暂停");
+        return;
+    }
+    // 暂停时重新开始连续识别 (流水线与模型同时就绪后才创建)
+    if (!m_pipeline) {
+        qDebug() << "错误：模型或数据库未初始化，无法进行识别！";
         ui->promptLabel->setStyleSheet("color: red;");
         ui->promptLabel->setText("系统初始化异常，请检查");
         return;
     }
+    startPipelines();
+    ui->btnRecognize->setText("停止\n识别");
+}
 
-    // 2. 从摄像头实时画面中获取对齐好的 112x112 人脸图像
-    // 该函数在 RetinaFace 类中实现，已经包含了检测、对齐和裁剪逻辑
-    qDebug() << "正在从摄像头获取人脸图像...";
-    cv::Mat alignedFace = m_retinaface->getAlignedFaceFromCamera(*m_camera);
-
-    if (alignedFace.empty()) {
-        qDebug() << "未能在当前画面中检测到人脸";
-        ui->promptLabel->setStyleSheet("color: red;");
-        ui->promptLabel->setText("未检测到人脸，请靠近并正对摄像头");
+// "人脸录入"按钮逻辑
+void MainWindow::on_btnEntry_clicked()
+{
+    // 流水线运行时模型由工作线程独占，录入交给比对阶段处理下一张人脸
+    if (m_pipeline && m_pipeline->isRunning()) {
+        m_pipeline->requestEnroll();
+        ui->promptLabel->setStyleSheet("");
+        ui->promptLabel->setText("正在录入，请正对摄像头");
         return;
     }
-    qDebug() << "成功检测到人脸! 尺寸:" << alignedFace.cols << "x" << alignedFace.rows;
 
-    // 3. 调用 MobileFaceNet 提取人脸特征向量
-    qDebug() << "正在提取人脸特征...";
-    std::vector<float> feature;
-    int ret = m_mobilefacenet->extractFeature(alignedFace, feature);
+    qDebug() << "开始执行人脸录入流程...";
 
-    if (ret != 0 || feature.empty()) {
-        qDebug() << "特征提取失败，RKNN推理返回码:" << ret;
+    // 1. 检查模型和数据库是否就绪
+    if (!m_retinaface || !m_mobilefacenet || !m_facedb || !m_faceEngine) {
+        qDebug() << "错误：模型或数据库未初始化，无法进行录入！";
         ui->promptLabel->setStyleSheet("color: red;");
-        ui->promptLabel->setText("特征提取失败，请重试");
+        ui->promptLabel->setText("系统初始化异常，请检查");
         return;
     }
-    qDebug() << "特征提取成功！维度：" << feature.size();
-
-    // 4. 将特征向量存入数据库
-    qDebug() << "正在将特征存入数据库...";
-    std::string message;
-    int faceId = m_facedb->enrollFace(feature, message);
 
-    // 5. 根据返回结果更新UI提示
-    if (faceId > 0) {
-        // 录入成功
-        qDebug() << "人脸录入成功！" << QString::fromStdString(message);
-        ui->promptLabel->setStyleSheet("color: green;");
-        ui->promptLabel->setText(QString::fromStdString(message));
-    } else {
-        // 录入失败（可能是重复录入）
-        qDebug() << "人脸录入失败:" << QString::fromStdString(message);
-        ui->promptLabel->setStyleSheet("color: orange;");
-        ui->promptLabel->setText(QString::fromStdString(message));
-    }
+    // 2. 检测、对齐、特征提取与写库全部交给 AsyncFaceEngine 的工作线程
+    // (写线程合并连续的录入为一个事务)，结果由 onFaceTaskFinished 显示
+    m_faceEngine->enrollFromCamera(m_camera, MANUAL_ENROLL_SLOT);
+    ui->promptLabel->setStyleSheet("");
+    ui->promptLabel->setText("正在录入...");
 }
@@ -4,10 +4,18 @@
 #include <QMainWindow>
 #include <QImage>
 #include <QPixmap>
+#include <QLabel>
+#include <QTimer>
+#include <vector>
 #include "device/CameraManager.h"
 #include "algo/RetinaFace.h"
 #include "algo/MobileFaceNet.h"
 #include "db/FaceDatabase.h"
+#include "pipeline/AsyncFaceEngine.h"
+#include "pipeline/RecognitionPipeline.h"
+#include "pipeline/StartupLoader.h"
+#include "ui/PreviewGLWidget.h"
+#include "common/Tracer.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -28,6 +36,20 @@ private slots:
     void on_btnEntry_clicked();      // 人脸录入
     void on_btnRecognize_clicked();  // 人脸识别
 
+    // 接收 RecognitionPipeline 的结果信号
+    void onRecognitionFinished(int faceId, const QString &message);
+    void onEnrollFinished(int faceId, const QString &message);
+    void onFaceLost();
+
+    // 按键触发的单次识别 / 录入结果 (AsyncFaceEngine)
+    void onFaceTaskFinished(const FaceTaskResult &result);
+
+    // 刷新各阶段耗时叠加层 (每秒一次)
+    void updateMetrics();
+
+    // 后台加载结束 (StartupLoader)
+    void onStartupReady();
+    void onStartupFailed(const QString &tasks);
 
 private:
     Ui::MainWindow *ui;
@@ -35,6 +57,34 @@ private:
     RetinaFace *m_retinaface;       // 人脸检测模型指针
     MobileFaceNet *m_mobilefacenet; // 人脸特征提取模型指针
     FaceDatabase *m_facedb;         // 人脸数据库管理对象指针
+    RecognitionPipeline *m_pipeline; // 后台连续识别流水线 (第一个摄像头，带预览)，就绪后才创建
+    StartupLoader *m_loader;        // 启动时并行加载模型与数据库
+    AsyncFaceEngine *m_faceEngine;  // 流水线暂停时按键的单次录入 (检测、特征提取与写库都不在界面线程)，就绪后才创建
+
+    // 其余摄像头 (FACEAPP_CAMERAS 指定多个时)：不显示预览，各自一条流水线，共用模型与数据库
+    std::vector<CameraManager *> m_extraCameras;
+    std::vector<RecognitionPipeline *> m_extraPipelines;
+    PreviewGLWidget *m_preview;     // OpenGL 预览 (为空时回退到 cameraLabel)
+
+    // 耗时叠加层 (FACEAPP_METRICS=1 时显示)，统计最近一秒的直方图增量
+    QLabel *m_metricsLabel;
+    QTimer *m_metricsTimer;
+    std::vector<Tracer::StageStats> m_lastStats;
+    int64_t m_lastStatsUs;
+
+    // 冷启动计时 (构造时刻)，首帧预览与就绪时打印耗时
+    int64_t m_startUs;
+    bool m_firstFrameShown;
+
+    // 预览显示控件 (OpenGL 预览或 cameraLabel)
+    QWidget *previewWidget() const;
+
+    // 显示一条操作结果 (绿色=成功，橙色=未通过，红色=错误)
+    void showPrompt(int faceId, const QString &message);
+
+    // 启动 / 停止所有摄像头的流水线
+    void startPipelines();
+    void stopPipelines();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,539 @@
+/**
+ * @file face_bench.cpp
+ * @brief 无界面的性能基准：检测 / 特征提取 / 特征库检索
+ *
+ * 不需要摄像头和屏幕，结果可以在不同固件、librknnrt 版本之间直接对比：
+ *   [detect]  把录制的视频或图片目录预先解码到内存，循环送入 RetinaFace::detect (每个模型分辨率一组)
+ *   [embed]   检测出的最大人脸对齐后送入 MobileFaceNet::extractFeature (没有人脸的帧取中心区域)
+ *   [search]  生成 1k / 10k / 100k 条随机归一化特征，用 enrollFaces 写入临时目录下的 FaceDatabase
+ *             (默认 INT8 特征库，达到规模后自动启用 IVF)，测 recognize 的端到端检索；
+ *             另有一行同样查询直接打在 FeatureGallery / IvfIndex 上的结果作参考
+ * 每个阶段输出调用次数、吞吐、均值 / P50 / P95 / P99 延迟与峰值 RSS (VmHWM，阶段开始时清零)，
+ * 以及 Tracer 记录的子阶段 (det.resize / det.rknn_run / npu.detect ...) 统计。
+ * 结果为 JSON (stdout 或 --out)，人类可读的摘要打印到 stderr。
+ *
+ * 用法：
+ *   face_bench [--frames 视频或图片目录] [--det 检测模型 (可重复)] [--rec 特征模型]
+ *              [--galleries 1000,10000,100000] [--format int8|fp16|fp32] [--nprobe N]
+ *              [--iterations N] [--warmup N] [--max-frames N] [--out 结果.json]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <opencv2/imgcodecs.hpp>
+
+#include "algo/RetinaFace.h"
+#include "algo/MobileFaceNet.h"
+#include "algo/NpuScheduler.h"
+#include "common/Tracer.h"
+#include "db/FaceDatabase.h"
+#include "db/FeatureGallery.h"
+#include "db/IvfIndex.h"
+
+namespace fs = std::filesystem;
+
+// 建库时每次 enrollFaces 的人脸数 (与 face_enroll_cli 相同)
+static const size_t BUILD_CHUNK = 512;
+
+struct Options {
+    std::string frames;
+    std::vector<std::string> det_models;
+    std::string rec_model = "assets/model/w600k_mbf.rknn";
+    std::vector<int> galleries = { 1000, 10000, 100000 };
+    FeatureGallery::Format format = FeatureGallery::FORMAT_INT8;
+    int nprobe = 8;
+    int iterations = 200;
+    int warmup = 10;
+    int max_frames = 100;
+    int dim = 512;          // 没有特征模型时合成特征的维度
+    std::string out_path;
+};
+
+// 一个阶段的测量结果
+struct StageResult {
+    std::string name;
+    std::vector<double> samples_ms;
+    double wall_s = 0;
+    long peak_rss_kb = -1;
+    std::vector<std::pair<std::string, std::string>> extra;   // 附加字段 (已格式化为 JSON 值)
+    std::string substages;                                     // Tracer 子阶段 (JSON 数组)
+};
+
+static void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " [--frames video|dir] [--det model]... [--rec model]"
+              << " [--galleries 1000,10000,100000] [--format int8|fp16|fp32] [--nprobe N]"
+              << " [--iterations N] [--warmup N] [--max-frames N] [--dim N] [--out file.json]" << std::endl;
+}
+
+static int parseOptions(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--frames" && has_value) opt.frames = argv[++i];
+        else if (arg == "--det" && has_value) opt.det_models.push_back(argv[++i]);
+        else if (arg == "--rec" && has_value) opt.rec_model = argv[++i];
+        else if (arg == "--out" && has_value) opt.out_path = argv[++i];
+        else if (arg == "--nprobe" && has_value) opt.nprobe = std::atoi(argv[++i]);
+        else if (arg == "--iterations" && has_value) opt.iterations = std::atoi(argv[++i]);
+        else if (arg == "--warmup" && has_value) opt.warmup = std::atoi(argv[++i]);
+        else if (arg == "--max-frames" && has_value) opt.max_frames = std::atoi(argv[++i]);
+        else if (arg == "--dim" && has_value) opt.dim = std::atoi(argv[++i]);
+        else if (arg == "--galleries" && has_value) {
+            opt.galleries.clear();
+            std::stringstream ss(argv[++i]);
+            std::string item;
+            while (std::getline(ss, item, ',')) {
+                if (std::atoi(item.c_str()) > 0) opt.galleries.push_back(std::atoi(item.c_str()));
+            }
+        } else if (arg == "--format" && has_value) {
+            std::string f = argv[++i];
+            if (f == "fp32") opt.format = FeatureGallery::FORMAT_FP32;
+            else if (f == "fp16") opt.format = FeatureGallery::FORMAT_FP16;
+            else if (f == "int8") opt.format = FeatureGallery::FORMAT_INT8;
+            else return -1;
+        } else return -1;
+    }
+    if (opt.det_models.empty()) opt.det_models.push_back("assets/model/retinaface_320.rknn");
+    if (opt.iterations <= 0 || opt.warmup < 0 || opt.max_frames <= 0 || opt.dim <= 0) return -1;
+    return 0;
+}
+
+static const char* formatName(FeatureGallery::Format format) {
+    switch (format) {
+    case FeatureGallery::FORMAT_FP32: return "fp32";
+    case FeatureGallery::FORMAT_FP16: return "fp16";
+    default: return "int8";
+    }
+}
+
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if ((unsigned char)c < 0x20) out += ' ';
+        else out += c;
+    }
+    return out + "\"";
+}
+
+// ---------------------------------------------------------
+// 峰值 RSS：/proc/self/clear_refs 写 5 把 VmHWM 重置为当前 RSS (Linux >= 4.0)
+// ---------------------------------------------------------
+static void resetPeakRss() {
+    std::ofstream f("/proc/self/clear_refs");
+    if (f) f << "5";
+}
+
+static long peakRssKb() {
+    std::ifstream f("/proc/self/status");
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) return std::atol(line.c_str() + 6);
+    }
+    return -1;
+}
+
+// ---------------------------------------------------------
+// 输入帧：视频文件或图片目录，预先解码到内存，不计入检测耗时
+// ---------------------------------------------------------
+static std::vector<cv::Mat> loadFrames(const std::string& path, int max_frames) {
+    std::vector<cv::Mat> frames;
+    std::error_code ec;
+    if (fs::is_directory(path, ec)) {
+        std::vector<std::string> paths;
+        for (const fs::directory_entry& entry : fs::directory_iterator(path, ec)) {
+            if (!entry.is_regular_file()) continue;
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp") {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        for (const std::string& p : paths) {
+            if ((int)frames.size() >= max_frames) break;
+            cv::Mat img = cv::imread(p, cv::IMREAD_COLOR);
+            if (!img.empty()) frames.push_back(img);
+        }
+        return frames;
+    }
+
+    cv::VideoCapture cap;
+    if (!cap.open(path)) return frames;
+    cv::Mat img;
+    while ((int)frames.size() < max_frames && cap.read(img) && !img.empty()) {
+        frames.push_back(img.clone());
+    }
+    return frames;
+}
+
+// ---------------------------------------------------------
+// 测量
+// ---------------------------------------------------------
+
+// Tracer 在两次快照之间记录的子阶段，格式化为 JSON 数组
+static std::string traceDelta(const std::vector<Tracer::StageStats>& before) {
+    std::vector<Tracer::StageStats> after(Tracer::STAGE_COUNT);
+    Tracer::instance().snapshot(after.data());
+    std::string out = "[";
+    for (int s = 0; s < Tracer::STAGE_COUNT; s++) {
+        Tracer::StageStats d = after[s].since(before[s]);
+        if (d.count == 0) continue;
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%s{\"name\":\"%s\",\"calls\":%llu,\"mean_ms\":%.3f,\"p50_ms\":%.3f,\"p99_ms\":%.3f}",
+                 out.size() > 1 ? "," : "", Tracer::stageName((Tracer::Stage)s),
+                 (unsigned long long)d.count, d.meanMs(), d.percentileMs(0.5), d.percentileMs(0.99));
+        out += buf;
+    }
+    return out + "]";
+}
+
+// 先预热 warmup 次，再计时 iterations 次；fn 的参数为第几次调用
+static StageResult measure(const std::string& name, int warmup, int iterations,
+                           const std::function<void(int)>& fn) {
+    for (int i = 0; i < warmup; i++) fn(i);
+
+    StageResult r;
+    r.name = name;
+    r.samples_ms.reserve(iterations);
+    std::vector<Tracer::StageStats> before(Tracer::STAGE_COUNT);
+    Tracer::instance().snapshot(before.data());
+    resetPeakRss();
+
+    double begin = nowMs();
+    for (int i = 0; i < iterations; i++) {
+        double t0 = nowMs();
+        fn(warmup + i);
+        r.samples_ms.push_back(nowMs() - t0);
+    }
+    r.wall_s = (nowMs() - begin) / 1000.0;
+    r.peak_rss_kb = peakRssKb();
+    r.substages = traceDelta(before);
+    return r;
+}
+
+static double percentile(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)std::ceil(q * sorted.size());
+    return sorted[std::min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+static std::string stageJson(const StageResult& r) {
+    std::vector<double> sorted = r.samples_ms;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (double v : sorted) sum += v;
+    size_t n = sorted.size();
+
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "{\"name\":%s,\"calls\":%zu,\"throughput_per_s\":%.2f,\"mean_ms\":%.3f,"
+             "\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,\"peak_rss_kb\":%ld",
+             jsonString(r.name).c_str(), n, r.wall_s > 0 ? n / r.wall_s : 0.0, n ? sum / n : 0.0,
+             percentile(sorted, 0.50), percentile(sorted, 0.95), percentile(sorted, 0.99),
+             n ? sorted.back() : 0.0, r.peak_rss_kb);
+    std::string out = buf;
+    for (const auto& kv : r.extra) out += ",\"" + kv.first + "\":" + kv.second;
+    if (!r.substages.empty()) out += ",\"substages\":" + r.substages;
+    return out + "}";
+}
+
+static void printSummary(const StageResult& r) {
+    std::vector<double> sorted = r.samples_ms;
+    std::sort(sorted.begin(), sorted.end());
+    fprintf(stderr, "%-28s %8zu calls %9.1f/s  p50 %8.3f  p95 %8.3f  p99 %8.3f ms  rss %ld KB\n",
+            r.name.c_str(), sorted.size(), r.wall_s > 0 ? sorted.size() / r.wall_s : 0.0,
+            percentile(sorted, 0.50), percentile(sorted, 0.95), percentile(sorted, 0.99), r.peak_rss_kb);
+}
+
+// ---------------------------------------------------------
+// 各阶段
+// ---------------------------------------------------------
+
+// 检测：每个模型分辨率一组；顺带收集每帧最大人脸的对齐图供特征阶段使用
+static void benchDetect(RetinaFace& detector, const std::vector<cv::Mat>& frames, const Options& opt,
+                        std::vector<StageResult>& results, std::vector<cv::Mat>& aligned) {
+    std::vector<FaceInfo> faces;
+    for (int v = 0; v < detector.variantCount(); v++) {
+        detector.setVariant(v);
+        cv::Size size = detector.inputSize();
+        std::string name = "detect." + std::to_string(size.width) + "x" + std::to_string(size.height);
+
+        long total_faces = 0;
+        StageResult r = measure(name, opt.warmup, opt.iterations, [&](int i) {
+            faces.clear();
+            detector.detect(frames[i % frames.size()], faces);
+            total_faces += (long)faces.size();
+        });
+        r.extra.push_back({ "faces_per_frame", std::to_string((double)total_faces / (opt.warmup + opt.iterations)) });
+        results.push_back(r);
+        printSummary(r);
+    }
+
+    // 对齐输入用最后一个 (通常分辨率最高) 模型的检测结果
+    for (const cv::Mat& frame : frames) {
+        faces.clear();
+        if (detector.detect(frame, faces) == 0 && !faces.empty()) {
+            const FaceInfo& best = *std::max_element(faces.begin(), faces.end(),
+                [](const FaceInfo& a, const FaceInfo& b) { return a.box.area() < b.box.area(); });
+            cv::Mat face = detector.preprocessFace(frame, best.landmarks);
+            if (!face.empty()) {
+                aligned.push_back(face);
+                continue;
+            }
+        }
+        // 没有人脸时取中心正方形，保证特征阶段有输入 (耗时与内容无关)
+        int side = std::min(frame.cols, frame.rows);
+        cv::Mat crop = frame(cv::Rect((frame.cols - side) / 2, (frame.rows - side) / 2, side, side));
+        cv::Mat face;
+        cv::resize(crop, face, cv::Size(112, 112));
+        aligned.push_back(face);
+    }
+}
+
+static void benchEmbed(MobileFaceNet& embedder, const std::vector<cv::Mat>& aligned, const Options& opt,
+                       std::vector<StageResult>& results) {
+    std::vector<float> feature;
+    StageResult r = measure("embed", opt.warmup, opt.iterations, [&](int i) {
+        embedder.extractFeature(aligned[i % aligned.size()], feature);
+    });
+    r.extra.push_back({ "batch", std::to_string(embedder.batchSize()) });
+    results.push_back(r);
+    printSummary(r);
+}
+
+// 第 i 条合成特征：以 i 为种子生成，查询时可以重新生成同一条再加噪声
+static void syntheticFeature(int i, int dim, std::vector<float>& out) {
+    std::mt19937 rng(0x9e3779b9u ^ (uint32_t)i);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    out.resize(dim);
+    float norm = 0;
+    for (float& v : out) { v = normal(rng); norm += v * v; }
+    norm = 1.0f / std::sqrt(norm);
+    for (float& v : out) v *= norm;
+}
+
+// 临时数据库文件 (含 WAL、共享特征库与 IVF 索引)，构造与析构时删除；须比 FaceDatabase 活得更久
+struct TempDatabase {
+    std::string path;
+
+    explicit TempDatabase(int faces)
+        : path((fs::temp_directory_path() / ("face_bench_" + std::to_string(getpid()) + "_"
+                                             + std::to_string(faces) + ".db")).string()) {
+        removeFiles();
+    }
+    ~TempDatabase() { removeFiles(); }
+
+    void removeFiles() const {
+        for (const char* ext : { "", "-wal", "-shm", ".gallery", ".gallery.lock", ".ivf" }) {
+            std::remove((path + ext).c_str());
+        }
+    }
+};
+
+static void benchSearch(int faces, const Options& opt, int dim, std::vector<StageResult>& results) {
+    std::string suffix = std::string(formatName(opt.format)) + "." + std::to_string(faces);
+
+    // 1. 建库：与主程序相同的 FaceDatabase (SQLite + 常驻特征库 + 达到规模后的 IVF)，
+    //    按离线录入工具的块大小调用 enrollFaces (只计一次)
+    TempDatabase temp(faces);
+    FaceDatabase database;
+    database.setGalleryFormat(opt.format, FaceDatabase::DEFAULT_RERANK_TOP_K);
+    database.setSearchParams(opt.nprobe);
+    if (database.init(temp.path) != 0) {
+        std::cerr << "Failed to create benchmark database " << temp.path << std::endl;
+        return;
+    }
+    std::vector<int> ids(faces, -1);
+    std::vector<std::vector<float>> chunk;
+    std::vector<int> chunk_ids;
+    resetPeakRss();
+    double t0 = nowMs();
+    for (int begin = 0; begin < faces; begin += (int)BUILD_CHUNK) {
+        int count = std::min(faces - begin, (int)BUILD_CHUNK);
+        chunk.resize(count);
+        for (int c = 0; c < count; c++) syntheticFeature(begin + c, dim, chunk[c]);
+        if (database.enrollFaces(chunk, &chunk_ids) < 0) {
+            std::cerr << "Failed to enroll benchmark faces" << std::endl;
+            return;
+        }
+        std::copy(chunk_ids.begin(), chunk_ids.end(), ids.begin() + begin);
+    }
+    StageResult build;
+    build.name = "db.build." + suffix;
+    build.samples_ms.push_back(nowMs() - t0);
+    build.wall_s = build.samples_ms[0] / 1000.0;
+    build.peak_rss_kb = peakRssKb();
+    build.extra.push_back({ "faces", std::to_string(database.getFaceCount()) });
+    results.push_back(build);
+    printSummary(build);
+
+    // 2. 查询：随机选一条库内特征加噪声 (余弦约 0.7)，统计识别结果是否为原特征的身份
+    std::mt19937 rng(12345);
+    std::normal_distribution<float> noise(0.0f, 1.0f / std::sqrt((float)dim));
+    std::vector<std::vector<float>> queries(256);
+    std::vector<int> truth(queries.size());
+    for (size_t q = 0; q < queries.size(); q++) {
+        truth[q] = (int)(rng() % faces);
+        syntheticFeature(truth[q], dim, queries[q]);
+        for (float& v : queries[q]) v += noise(rng);
+    }
+
+    // 主程序实际走的路径：加锁、同步共享库、线性 / IVF 候选、读取模板精确重排
+    FaceDatabase::Result result;
+    int hits = 0;
+    StageResult db = measure("search.db." + suffix, opt.warmup, opt.iterations, [&](int i) {
+        size_t q = i % queries.size();
+        database.recognize(queries[q], result);
+        if (i >= opt.warmup && result.face_id > 0 && result.face_id == ids[truth[q]]) hits++;
+    });
+    db.extra.push_back({ "ivf", faces >= FaceDatabase::ANN_MIN_FACES ? "true" : "false" });
+    db.extra.push_back({ "recall_at_1", std::to_string((double)hits / opt.iterations) });
+    results.push_back(db);
+    printSummary(db);
+
+    // 3. 参考：同样的查询直接打在内存特征库上 (不加锁、不重排)，FaceDatabase 的额外开销即两行之差
+    FeatureGallery gallery;
+    gallery.setFormat(opt.format);
+    std::vector<float> feature;
+    for (int i = 0; i < faces; i++) {
+        syntheticFeature(i, dim, feature);
+        gallery.add(i + 1, feature.data(), dim);
+    }
+    IvfIndex ivf;
+    ivf.setNprobe(opt.nprobe);
+    bool use_ivf = faces >= FaceDatabase::ANN_MIN_FACES;
+    t0 = nowMs();
+    if (use_ivf && ivf.train(gallery, (int)std::sqrt((double)faces)) != 0) {     // 与 FaceDatabase 相同的簇数
+        std::cerr << "IVF training failed for " << faces << " faces" << std::endl;
+        return;
+    }
+    double train_ms = nowMs() - t0;
+
+    std::vector<GalleryMatch> out;
+    hits = 0;
+    StageResult raw = measure("search.raw." + suffix, opt.warmup, opt.iterations, [&](int i) {
+        size_t q = i % queries.size();
+        if (use_ivf) {
+            ivf.search(gallery, queries[q].data(), dim, FaceDatabase::DEFAULT_RERANK_TOP_K, out);
+        } else {
+            gallery.searchTopK(queries[q].data(), dim, FaceDatabase::DEFAULT_RERANK_TOP_K, out);
+        }
+        if (i >= opt.warmup && !out.empty() && out[0].id == truth[q] + 1) hits++;
+    });
+    raw.extra.push_back({ "gallery_bytes", std::to_string(gallery.memoryBytes()) });
+    if (use_ivf) {
+        raw.extra.push_back({ "nlist", std::to_string(ivf.nlist()) });
+        raw.extra.push_back({ "nprobe", std::to_string(opt.nprobe) });
+        raw.extra.push_back({ "train_ms", std::to_string(train_ms) });
+    }
+    raw.extra.push_back({ "recall_at_1", std::to_string((double)hits / opt.iterations) });
+    results.push_back(raw);
+    printSummary(raw);
+}
+
+// 运行环境：内核 / librknnrt / NPU 驱动版本，用于跨固件对比
+static std::string systemJson(const MobileFaceNet* embedder) {
+    struct utsname uts;
+    std::string kernel = uname(&uts) == 0 ? std::string(uts.release) + " " + uts.machine : "unknown";
+    std::string api = "unknown", driver = "unknown";
+    if (embedder) embedder->sdkVersion(api, driver);
+
+    std::string out = "{\"kernel\":" + jsonString(kernel)
+                    + ",\"rknn_api\":" + jsonString(api)
+                    + ",\"rknn_driver\":" + jsonString(driver)
+                    + ",\"npu_cores\":" + std::to_string(NpuScheduler::coreCount())
+                    + ",\"cpu_threads\":" + std::to_string(std::thread::hardware_concurrency()) + "}";
+    return out;
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (parseOptions(argc, argv, opt) != 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<StageResult> results;
+    MobileFaceNet embedder;
+    bool have_embedder = false;
+    int dim = opt.dim;
+
+    // 1. 检测 / 特征 (需要输入帧和模型)
+    if (!opt.frames.empty()) {
+        std::vector<cv::Mat> frames = loadFrames(opt.frames, opt.max_frames);
+        if (frames.empty()) {
+            std::cerr << "No frames loaded from " << opt.frames << std::endl;
+            return 1;
+        }
+        std::cerr << "Loaded " << frames.size() << " frames from " << opt.frames << std::endl;
+
+        RetinaFace detector(opt.det_models);
+        if (detector.init() != 0) {
+            std::cerr << "Failed to init RetinaFace" << std::endl;
+            return 1;
+        }
+        std::vector<cv::Mat> aligned;
+        benchDetect(detector, frames, opt, results, aligned);
+
+        if (embedder.init(opt.rec_model) != 0) {
+            std::cerr << "Failed to init MobileFaceNet: " << opt.rec_model << std::endl;
+            return 1;
+        }
+        have_embedder = true;
+        dim = embedder.featureDim();
+        benchEmbed(embedder, aligned, opt, results);
+    } else {
+        std::cerr << "No --frames given, running gallery search only (dim " << dim << ")" << std::endl;
+    }
+
+    // 2. 特征库检索 (纯 CPU，不需要模型)
+    for (int faces : opt.galleries) benchSearch(faces, opt, dim, results);
+
+    // 3. 输出 JSON
+    std::string json = "{\"tool\":\"face_bench\",\"version\":1,\"timestamp\":" + std::to_string((long long)time(NULL))
+                     + ",\"system\":" + systemJson(have_embedder ? &embedder : nullptr)
+                     + ",\"config\":{\"frames\":" + jsonString(opt.frames)
+                     + ",\"iterations\":" + std::to_string(opt.iterations)
+                     + ",\"warmup\":" + std::to_string(opt.warmup)
+                     + ",\"gallery_format\":\"" + formatName(opt.format) + "\""
+                     + ",\"feature_dim\":" + std::to_string(dim) + "}"
+                     + ",\"stages\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        json += (i ? ",\n  " : "\n  ") + stageJson(results[i]);
+    }
+    json += "\n]}\n";
+
+    if (opt.out_path.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream f(opt.out_path);
+        if (!(f << json)) {
+            std::cerr << "Failed to write " << opt.out_path << std::endl;
+            return 1;
+        }
+        std::cerr << "Results written to " << opt.out_path << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,317 @@
+/**
+ * @file face_enroll_cli.cpp
+ * @brief 离线批量录入工具
+ *
+ * 扫描一个目录中的证件照，检测 + 对齐 + 提取特征后批量写入 FaceDatabase
+ * (与主程序相同的库结构，可直接替换板端的 face_database.db)。
+ *
+ * 并行结构：
+ *   [解码/检测/对齐] N 个 CPU 线程 (默认 = CPU 核数)，imread 与仿射对齐在 CPU 上并行，
+ *                   检测时从 RetinaFace 的上下文池借用 NPU 上下文；
+ *                   对齐前按录入阈值做质量检查 (与主程序的录入相同)，不合格的照片不入库
+ *   [特征提取]      每个 MobileFaceNet 上下文一个线程，每次取出一批对齐人脸连续推理
+ *   [入库]          全部完成后按文件名顺序分块调用 enrollFaces (每块一个事务)
+ *
+ * 用法：
+ *   face_enroll_cli <照片目录> [--db face_database.db] [--det 检测模型] [--rec 特征模型]
+ *                   [--threads N] [--batch N] [--report 结果.csv]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/imgcodecs.hpp>
+
+#include "algo/RetinaFace.h"
+#include "algo/MobileFaceNet.h"
+#include "algo/FaceQuality.h"
+#include "db/FaceDatabase.h"
+
+namespace fs = std::filesystem;
+
+// 每个事务写入的人脸数
+static const size_t ENROLL_CHUNK = 512;
+
+struct Options {
+    std::string photo_dir;
+    std::string db_path = "face_database.db";
+    std::string det_model = "assets/model/retinaface_320.rknn";
+    std::string rec_model = "assets/model/w600k_mbf.rknn";
+    std::string report_path;
+    int threads = 0;        // 0 = CPU 核数
+    int batch = 16;
+};
+
+// 一张照片的处理结果
+struct PhotoResult {
+    std::string path;
+    std::string status = "pending";
+    std::vector<float> feature;
+    int face_id = -1;
+};
+
+// 对齐完成、等待提取特征的人脸
+struct AlignedJob {
+    size_t index;
+    cv::Mat face;
+};
+
+/**
+ * @brief 不丢弃的阻塞队列 (离线任务每个元素都必须处理)
+ * push 在队列满时阻塞，形成背压，避免解码线程把内存占满
+ */
+class JobQueue {
+public:
+    explicit JobQueue(size_t capacity) : m_capacity(capacity), m_closed(false) {}
+
+    void push(AlignedJob job) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return m_items.size() < m_capacity; });
+        m_items.push_back(std::move(job));
+        m_notEmpty.notify_one();
+    }
+
+    // 取出最多 max_count 个元素，队列关闭且为空时返回 false
+    bool popBatch(std::vector<AlignedJob>& out, size_t max_count) {
+        out.clear();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        while (!m_items.empty() && out.size() < max_count) {
+            out.push_back(std::move(m_items.front()));
+            m_items.pop_front();
+        }
+        m_notFull.notify_all();
+        return !out.empty();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+    std::deque<AlignedJob> m_items;
+    size_t m_capacity;
+    bool m_closed;
+};
+
+static void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <photo_dir> [--db path] [--det model] [--rec model]"
+              << " [--threads N] [--batch N] [--report file.csv]" << std::endl;
+}
+
+static int parseOptions(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--db" && has_value) opt.db_path = argv[++i];
+        else if (arg == "--det" && has_value) opt.det_model = argv[++i];
+        else if (arg == "--rec" && has_value) opt.rec_model = argv[++i];
+        else if (arg == "--report" && has_value) opt.report_path = argv[++i];
+        else if (arg == "--threads" && has_value) opt.threads = std::atoi(argv[++i]);
+        else if (arg == "--batch" && has_value) opt.batch = std::atoi(argv[++i]);
+        else if (!arg.empty() && arg[0] != '-' && opt.photo_dir.empty()) opt.photo_dir = arg;
+        else return -1;
+    }
+    if (opt.photo_dir.empty()) return -1;
+    if (opt.threads <= 0) opt.threads = std::max(1u, std::thread::hardware_concurrency());
+    if (opt.batch <= 0) opt.batch = 1;
+    return 0;
+}
+
+// 收集目录下的图片文件，按文件名排序保证每次运行的录入顺序一致
+static std::vector<std::string> listPhotos(const std::string& dir) {
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const fs::directory_entry& entry : fs::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file()) continue;
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (ext == ".jpg" || ext == ".jpeg" || ext == ".png" || ext == ".bmp") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    if (ec) std::cerr << "Failed to read directory " << dir << ": " << ec.message() << std::endl;
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// 解码 + 检测 + 对齐：证件照只取面积最大的人脸
+// 质量不合格的报告状态
+static const char* qualityStatus(FaceQuality::Verdict verdict) {
+    switch (verdict) {
+    case FaceQuality::QUALITY_TOO_SMALL: return "quality_too_small";
+    case FaceQuality::QUALITY_POSE:      return "quality_pose";
+    case FaceQuality::QUALITY_BLUR:      return "quality_blur";
+    case FaceQuality::QUALITY_DARK:      return "quality_dark";
+    case FaceQuality::QUALITY_BRIGHT:    return "quality_bright";
+    default:                             return "quality_ok";
+    }
+}
+
+static void alignWorker(RetinaFace& detector, std::vector<PhotoResult>& results,
+                        std::atomic<size_t>& next, JobQueue& queue) {
+    std::vector<FaceInfo> faces;
+    FaceQuality quality;    // 非线程安全，每个线程一份
+    const FaceQuality::Thresholds thresholds = FaceQuality::enrollmentThresholds();
+    for (size_t i = next++; i < results.size(); i = next++) {
+        PhotoResult& r = results[i];
+        cv::Mat img = cv::imread(r.path, cv::IMREAD_COLOR);
+        if (img.empty()) {
+            r.status = "decode_failed";
+            continue;
+        }
+
+        faces.clear();
+        if (detector.detect(img, faces) != 0 || faces.empty()) {
+            r.status = "no_face";
+            continue;
+        }
+        const FaceInfo& best = *std::max_element(faces.begin(), faces.end(),
+            [](const FaceInfo& a, const FaceInfo& b) { return a.box.area() < b.box.area(); });
+
+        FaceQuality::Result q;
+        if (quality.evaluate(CameraFrame::fromMat(img), best, thresholds, q) != FaceQuality::QUALITY_OK) {
+            r.status = qualityStatus(q.verdict);
+            continue;
+        }
+
+        cv::Mat aligned = detector.preprocessFace(img, best.landmarks);
+        if (aligned.empty()) {
+            r.status = "align_failed";
+            continue;
+        }
+        queue.push(AlignedJob{ i, aligned });
+    }
+}
+
+// 特征提取：一次取出一批，整批交给 extractFeatures (只借用一次 NPU 上下文)
+static void embedWorker(MobileFaceNet& embedder, std::vector<PhotoResult>& results,
+                        JobQueue& queue, size_t batch) {
+    std::vector<AlignedJob> jobs;
+    std::vector<cv::Mat> faces;
+    std::vector<std::vector<float>> features;
+    while (queue.popBatch(jobs, batch)) {
+        faces.clear();
+        for (AlignedJob& job : jobs) faces.push_back(job.face);
+        embedder.extractFeatures(faces, features);
+        for (size_t i = 0; i < jobs.size(); i++) {
+            PhotoResult& r = results[jobs[i].index];
+            r.feature = std::move(features[i]);
+            if (r.feature.empty()) r.status = "embed_failed";
+        }
+    }
+}
+
+static void writeReport(const std::string& path, const std::vector<PhotoResult>& results) {
+    FILE* fp = path.empty() ? stdout : fopen(path.c_str(), "w");
+    if (!fp) {
+        std::cerr << "Failed to open report: " << path << std::endl;
+        return;
+    }
+    fprintf(fp, "file,face_id,status\n");
+    for (const PhotoResult& r : results) {
+        fprintf(fp, "%s,%d,%s\n", r.path.c_str(), r.face_id, r.status.c_str());
+    }
+    if (fp != stdout) fclose(fp);
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (parseOptions(argc, argv, opt) != 0) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> paths = listPhotos(opt.photo_dir);
+    if (paths.empty()) {
+        std::cerr << "No photos found in " << opt.photo_dir << std::endl;
+        return 1;
+    }
+
+    // 1. 初始化模型与数据库
+    RetinaFace detector(opt.det_model);
+    if (detector.init() != 0) {
+        std::cerr << "Failed to init RetinaFace: " << opt.det_model << std::endl;
+        return 1;
+    }
+    MobileFaceNet embedder;
+    if (embedder.init(opt.rec_model) != 0) {
+        std::cerr << "Failed to init MobileFaceNet: " << opt.rec_model << std::endl;
+        return 1;
+    }
+    FaceDatabase database;
+    if (database.init(opt.db_path) != 0) {
+        std::cerr << "Failed to open database: " << opt.db_path << std::endl;
+        return 1;
+    }
+
+    std::vector<PhotoResult> results(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) results[i].path = paths[i];
+
+    std::cout << "Processing " << paths.size() << " photos with " << opt.threads
+              << " CPU threads, " << embedder.contextCount() << " NPU embed contexts" << std::endl;
+
+    // 2. 并行解码 / 检测 / 对齐 / 提取特征
+    JobQueue queue((size_t)opt.batch * embedder.contextCount() * 2);
+    std::atomic<size_t> next(0);
+
+    std::vector<std::thread> embed_threads;
+    for (int i = 0; i < embedder.contextCount(); i++) {
+        embed_threads.emplace_back(embedWorker, std::ref(embedder), std::ref(results),
+                                   std::ref(queue), (size_t)opt.batch);
+    }
+    std::vector<std::thread> align_threads;
+    for (int i = 0; i < opt.threads; i++) {
+        align_threads.emplace_back(alignWorker, std::ref(detector), std::ref(results),
+                                   std::ref(next), std::ref(queue));
+    }
+    for (std::thread& t : align_threads) t.join();
+    queue.close();
+    for (std::thread& t : embed_threads) t.join();
+
+    // 3. 按文件名顺序分块入库，每块一个事务
+    int enrolled = 0;
+    std::vector<std::vector<float>> chunk;
+    std::vector<size_t> chunk_index;
+    std::vector<int> ids;
+    for (size_t i = 0; i <= results.size(); i++) {
+        if (i < results.size()) {
+            PhotoResult& r = results[i];
+            if (r.status != "pending") continue;
+            chunk.push_back(std::move(r.feature));
+            chunk_index.push_back(i);
+            if (chunk.size() < ENROLL_CHUNK) continue;
+        }
+        if (chunk.empty()) break;
+
+        int ret = database.enrollFaces(chunk, &ids);
+        for (size_t c = 0; c < chunk_index.size(); c++) {
+            PhotoResult& r = results[chunk_index[c]];
+            r.face_id = ret < 0 ? -1 : ids[c];
+            r.status = ret < 0 ? "db_failed" : (ids[c] < 0 ? "duplicate" : "enrolled");
+        }
+        if (ret > 0) enrolled += ret;
+        chunk.clear();
+        chunk_index.clear();
+    }
+
+    writeReport(opt.report_path, results);
+    std::cout << "Enrolled " << enrolled << " / " << results.size() << " photos, "
+              << database.getFaceCount() << " faces in " << opt.db_path << std::endl;
+    return enrolled > 0 ? 0 : 1;
+}